@@ -0,0 +1,50 @@
+#include "ChangeTracker.h"
+#include <algorithm>
+
+ChangeTracker::ChangeTracker()
+{
+}
+
+ChangeTracker::ChangeTracker(std::uint32_t copyCount) :
+	m_copies(copyCount)
+{
+}
+
+void ChangeTracker::MarkChanged(std::uint32_t index)
+{
+	if (index >= m_versions.size()) {
+		m_versions.resize(index + 1, 0);
+	}
+
+	// A change no copy has synced yet covers this one as well.
+	std::uint64_t newestSyncedVersion = 0;
+	for (const auto& copy : m_copies) {
+		newestSyncedVersion = std::max(newestSyncedVersion, copy.SyncedVersion);
+	}
+	if (m_versions[index] > newestSyncedVersion) {
+		return;
+	}
+
+	m_log.push_back(index);
+	m_versions[index] = ++m_version;
+}
+
+void ChangeTracker::Invalidate(std::uint32_t copy)
+{
+	m_copies[copy].IsInvalid = true;
+}
+
+void ChangeTracker::Trim()
+{
+	auto oldestSyncedVersion = m_version;
+	for (const auto& copy : m_copies) {
+		if (!copy.IsInvalid) {
+			oldestSyncedVersion = std::min(oldestSyncedVersion, copy.SyncedVersion);
+		}
+	}
+
+	while (m_logStartVersion < oldestSyncedVersion) {
+		m_log.pop_front();
+		m_logStartVersion++;
+	}
+}
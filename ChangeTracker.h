@@ -0,0 +1,77 @@
+#ifndef CHANGETRACKER_H_
+#define CHANGETRACKER_H_
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Tracks which elements of an array changed since each of several copies of it
+// was last brought up to date, e.g. one copy per frame context. Every change
+// gets the next version and is appended to a log, and every copy records the
+// version it was last synced at. Syncing a copy visits only the elements
+// changed after that version, each of them once, so an unchanged array costs
+// nothing. The log is trimmed once all copies have passed an entry.
+class ChangeTracker
+{
+public:
+	ChangeTracker();
+	explicit ChangeTracker(std::uint32_t copyCount);
+
+	void MarkChanged(std::uint32_t index);
+
+	// The copy lost its contents, e.g. because it was recreated larger. Its next
+	// Sync visits every element.
+	void Invalidate(std::uint32_t copy);
+
+	// Calls func(index) for every element below elementCount that changed since
+	// the copy's last Sync and records the copy as up to date. Returns the
+	// number of elements visited.
+	template <typename TFunc>
+	std::size_t Sync(std::uint32_t copy, std::uint32_t elementCount, TFunc&& func)
+	{
+		std::size_t visited = 0;
+		if (m_copies[copy].IsInvalid) {
+			for (std::uint32_t index = 0; index < elementCount; index++) {
+				func(index);
+			}
+			visited = elementCount;
+		}
+		else {
+			for (auto version = m_copies[copy].SyncedVersion; version < m_version; version++) {
+				auto index = m_log[static_cast<std::size_t>(version - m_logStartVersion)];
+				// Only the latest change of an element counts, earlier ones are stale.
+				if (index < elementCount && m_versions[index] == version + 1) {
+					func(index);
+					visited++;
+				}
+			}
+		}
+
+		m_copies[copy].IsInvalid = false;
+		m_copies[copy].SyncedVersion = m_version;
+		Trim();
+		return visited;
+	}
+
+	std::uint64_t GetVersion() const { return m_version; }
+	std::size_t GetLogSize() const { return m_log.size(); }
+
+private:
+	struct Copy
+	{
+		std::uint64_t SyncedVersion = 0;
+		bool IsInvalid = true;
+	};
+
+	void Trim();
+
+	// Version of the last change of every element, 0 if it never changed.
+	std::vector<std::uint64_t> m_versions;
+	// Element index of every change from m_logStartVersion to m_version.
+	std::deque<std::uint32_t> m_log;
+	std::uint64_t m_logStartVersion = 0;
+	std::uint64_t m_version = 0;
+	std::vector<Copy> m_copies;
+};
+
+#endif
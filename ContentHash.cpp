@@ -0,0 +1,46 @@
+#include "ContentHash.h"
+#include <cstring>
+
+namespace {
+
+const std::uint64_t Prime1 = 0x9e3779b185ebca87ull;
+const std::uint64_t Prime2 = 0xc2b2ae3d27d4eb4full;
+
+// Finalizer of MurmurHash3, every input bit affects every output bit.
+std::uint64_t Mix(std::uint64_t value)
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ull;
+	value ^= value >> 33;
+	return value;
+}
+
+}
+
+std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t seed)
+{
+	auto bytes = static_cast<const std::uint8_t*>(data);
+	std::uint64_t hash = seed ^ (size * Prime1);
+
+	std::size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		std::uint64_t word;
+		std::memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ Mix(word * Prime2)) * Prime1;
+	}
+
+	if (i < size) {
+		std::uint64_t tail = 0;
+		std::memcpy(&tail, bytes + i, size - i);
+		hash = (hash ^ Mix(tail * Prime2)) * Prime1;
+	}
+
+	return Mix(hash);
+}
+
+std::uint64_t HashCombine(std::uint64_t seed, std::uint64_t value)
+{
+	return Mix(seed ^ (value + Prime1 + (seed << 6) + (seed >> 2)));
+}
@@ -0,0 +1,14 @@
+#ifndef CONTENTHASH_H_
+#define CONTENTHASH_H_
+
+#include <cstdint>
+#include <cstddef>
+
+// Fast non-cryptographic 64 bit hash for deduplicating content such as mesh
+// data. Reads eight bytes per step.
+std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t seed = 0);
+
+// Mixes value into seed, order dependent.
+std::uint64_t HashCombine(std::uint64_t seed, std::uint64_t value);
+
+#endif
@@ -0,0 +1,368 @@
+#include "D3D12Backend.h"
+#include "d3dUtility.h"
+#include "d3dx12.h"
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+D3D12CommandRecorder::D3D12CommandRecorder(ID3D12GraphicsCommandList* commandList) :
+	m_commandList(commandList)
+{
+}
+
+ID3D12GraphicsCommandList* D3D12CommandRecorder::GetCommandList() const
+{
+	return m_commandList;
+}
+
+void D3D12CommandRecorder::ResourceBarrier(std::uint32_t numBarriers, const ::ResourceBarrier* barriers)
+{
+	// Most calls carry a handful of barriers so translate on the stack.
+	D3D12_RESOURCE_BARRIER localBarriers[16];
+	std::vector<D3D12_RESOURCE_BARRIER> heapBarriers;
+	D3D12_RESOURCE_BARRIER* d3dBarriers = localBarriers;
+	if (numBarriers > _countof(localBarriers)) {
+		heapBarriers.resize(numBarriers);
+		d3dBarriers = heapBarriers.data();
+	}
+
+	for (std::uint32_t i = 0; i < numBarriers; i++) {
+		const auto& barrier = barriers[i];
+		auto& d3dBarrier = d3dBarriers[i];
+		d3dBarrier.Type = static_cast<D3D12_RESOURCE_BARRIER_TYPE>(barrier.Type);
+		d3dBarrier.Flags = static_cast<D3D12_RESOURCE_BARRIER_FLAGS>(barrier.Flags);
+
+		switch (barrier.Type) {
+		case BarrierType::Transition:
+			d3dBarrier.Transition.pResource = ToD3D12(barrier.Resource);
+			d3dBarrier.Transition.StateBefore = static_cast<D3D12_RESOURCE_STATES>(barrier.StateBefore);
+			d3dBarrier.Transition.StateAfter = static_cast<D3D12_RESOURCE_STATES>(barrier.StateAfter);
+			d3dBarrier.Transition.Subresource = barrier.Subresource;
+			break;
+		case BarrierType::Aliasing:
+			d3dBarrier.Aliasing.pResourceBefore = ToD3D12(barrier.Resource);
+			d3dBarrier.Aliasing.pResourceAfter = ToD3D12(barrier.ResourceAfter);
+			break;
+		case BarrierType::UnorderedAccess:
+			d3dBarrier.UAV.pResource = ToD3D12(barrier.Resource);
+			break;
+		}
+	}
+
+	m_commandList->ResourceBarrier(numBarriers, d3dBarriers);
+}
+
+void D3D12CommandRecorder::CopyBufferRegion(RHIResource dst, std::uint64_t dstOffset, RHIResource src, std::uint64_t srcOffset, std::uint64_t numBytes)
+{
+	m_commandList->CopyBufferRegion(ToD3D12(dst), dstOffset, ToD3D12(src), srcOffset, numBytes);
+}
+
+void D3D12CommandRecorder::SetPipelineState(PipelineStateHandle pipelineState)
+{
+	m_commandList->SetPipelineState(reinterpret_cast<ID3D12PipelineState*>(pipelineState));
+}
+
+void D3D12CommandRecorder::SetGraphicsRootSignature(RootSignatureHandle rootSignature)
+{
+	m_commandList->SetGraphicsRootSignature(reinterpret_cast<ID3D12RootSignature*>(rootSignature));
+}
+
+void D3D12CommandRecorder::SetDescriptorHeaps(std::uint32_t numHeaps, const DescriptorHeapHandle* heaps)
+{
+	// At most one CBV/SRV/UAV and one sampler heap can be bound, so this has room to spare.
+	ID3D12DescriptorHeap* d3dHeaps[4];
+	assert(numHeaps <= _countof(d3dHeaps));
+	numHeaps = std::min<std::uint32_t>(numHeaps, _countof(d3dHeaps));
+	for (std::uint32_t i = 0; i < numHeaps; i++) {
+		d3dHeaps[i] = reinterpret_cast<ID3D12DescriptorHeap*>(heaps[i]);
+	}
+	m_commandList->SetDescriptorHeaps(numHeaps, d3dHeaps);
+}
+
+void D3D12CommandRecorder::SetGraphicsRootDescriptorTable(std::uint32_t rootParameterIndex, GpuDescriptorHandle baseDescriptor)
+{
+	D3D12_GPU_DESCRIPTOR_HANDLE handle;
+	handle.ptr = baseDescriptor.ptr;
+	m_commandList->SetGraphicsRootDescriptorTable(rootParameterIndex, handle);
+}
+
+void D3D12CommandRecorder::SetGraphicsRoot32BitConstant(std::uint32_t rootParameterIndex, std::uint32_t srcData, std::uint32_t destOffsetIn32BitValues)
+{
+	m_commandList->SetGraphicsRoot32BitConstant(rootParameterIndex, srcData, destOffsetIn32BitValues);
+}
+
+void D3D12CommandRecorder::SetGraphicsRoot32BitConstants(std::uint32_t rootParameterIndex, std::uint32_t num32BitValuesToSet, const void* srcData, std::uint32_t destOffsetIn32BitValues)
+{
+	m_commandList->SetGraphicsRoot32BitConstants(rootParameterIndex, num32BitValuesToSet, srcData, destOffsetIn32BitValues);
+}
+
+void D3D12CommandRecorder::SetGraphicsRootConstantBufferView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation)
+{
+	m_commandList->SetGraphicsRootConstantBufferView(rootParameterIndex, bufferLocation);
+}
+
+void D3D12CommandRecorder::SetGraphicsRootShaderResourceView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation)
+{
+	m_commandList->SetGraphicsRootShaderResourceView(rootParameterIndex, bufferLocation);
+}
+
+void D3D12CommandRecorder::IASetPrimitiveTopology(PrimitiveTopology topology)
+{
+	m_commandList->IASetPrimitiveTopology(static_cast<D3D12_PRIMITIVE_TOPOLOGY>(topology));
+}
+
+void D3D12CommandRecorder::IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t numViews, const VertexBufferBinding* views)
+{
+	D3D12_VERTEX_BUFFER_VIEW d3dViews[D3D12_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	assert(numViews <= _countof(d3dViews));
+	numViews = std::min<std::uint32_t>(numViews, _countof(d3dViews));
+	for (std::uint32_t i = 0; i < numViews; i++) {
+		d3dViews[i].BufferLocation = views[i].BufferLocation;
+		d3dViews[i].SizeInBytes = views[i].SizeInBytes;
+		d3dViews[i].StrideInBytes = views[i].StrideInBytes;
+	}
+	m_commandList->IASetVertexBuffers(startSlot, numViews, d3dViews);
+}
+
+void D3D12CommandRecorder::IASetIndexBuffer(const IndexBufferBinding* view)
+{
+	if (view == nullptr) {
+		m_commandList->IASetIndexBuffer(nullptr);
+		return;
+	}
+
+	D3D12_INDEX_BUFFER_VIEW d3dView;
+	d3dView.BufferLocation = view->BufferLocation;
+	d3dView.SizeInBytes = view->SizeInBytes;
+	d3dView.Format = view->Format == IndexFormat::Uint16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	m_commandList->IASetIndexBuffer(&d3dView);
+}
+
+void D3D12CommandRecorder::RSSetViewports(std::uint32_t numViewports, const Viewport* viewports)
+{
+	// The layouts of Viewport and D3D12_VIEWPORT are identical.
+	static_assert(sizeof(Viewport) == sizeof(D3D12_VIEWPORT), "Viewport must match D3D12_VIEWPORT");
+	m_commandList->RSSetViewports(numViewports, reinterpret_cast<const D3D12_VIEWPORT*>(viewports));
+}
+
+void D3D12CommandRecorder::RSSetScissorRects(std::uint32_t numRects, const ScissorRect* rects)
+{
+	static_assert(sizeof(ScissorRect) == sizeof(D3D12_RECT), "ScissorRect must match D3D12_RECT");
+	m_commandList->RSSetScissorRects(numRects, reinterpret_cast<const D3D12_RECT*>(rects));
+}
+
+void D3D12CommandRecorder::OMSetRenderTargets(std::uint32_t numRenderTargets, const CpuDescriptorHandle* renderTargets, const CpuDescriptorHandle* depthStencil)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE d3dRenderTargets[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT];
+	for (std::uint32_t i = 0; i < numRenderTargets && i < _countof(d3dRenderTargets); i++) {
+		d3dRenderTargets[i].ptr = renderTargets[i].ptr;
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE d3dDepthStencil;
+	if (depthStencil != nullptr) {
+		d3dDepthStencil.ptr = depthStencil->ptr;
+	}
+
+	m_commandList->OMSetRenderTargets(numRenderTargets, numRenderTargets > 0 ? d3dRenderTargets : nullptr, FALSE,
+		depthStencil != nullptr ? &d3dDepthStencil : nullptr);
+}
+
+void D3D12CommandRecorder::ClearRenderTargetView(CpuDescriptorHandle renderTarget, const float color[4])
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE handle;
+	handle.ptr = renderTarget.ptr;
+	m_commandList->ClearRenderTargetView(handle, color, 0, nullptr);
+}
+
+void D3D12CommandRecorder::ClearDepthStencilView(CpuDescriptorHandle depthStencil, float depth, std::uint8_t stencil)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE handle;
+	handle.ptr = depthStencil.ptr;
+	m_commandList->ClearDepthStencilView(handle, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, depth, stencil, 0, nullptr);
+}
+
+void D3D12CommandRecorder::DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+	std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation)
+{
+	m_commandList->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+}
+
+D3D12RenderDevice::D3D12RenderDevice(ID3D12Device* device) :
+	m_device(device)
+{
+}
+
+void D3D12RenderDevice::CreateConstantBufferView(GpuVirtualAddress bufferLocation, std::uint32_t sizeInBytes, CpuDescriptorHandle destDescriptor)
+{
+	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
+	cbvDesc.BufferLocation = bufferLocation;
+	cbvDesc.SizeInBytes = sizeInBytes;
+
+	D3D12_CPU_DESCRIPTOR_HANDLE handle;
+	handle.ptr = destDescriptor.ptr;
+	m_device->CreateConstantBufferView(&cbvDesc, handle);
+}
+
+void D3D12RenderDevice::CopyDescriptorsSimple(std::uint32_t numDescriptors, CpuDescriptorHandle destStart, CpuDescriptorHandle srcStart)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE dest;
+	dest.ptr = destStart.ptr;
+	D3D12_CPU_DESCRIPTOR_HANDLE src;
+	src.ptr = srcStart.ptr;
+	m_device->CopyDescriptorsSimple(numDescriptors, dest, src, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+RHIResource D3D12RenderDevice::CreateBuffer(std::uint64_t byteSize, HeapType heapType, ResourceState initialState)
+{
+	ID3D12Resource* buffer = nullptr;
+
+	auto heapProperties = CD3DX12_HEAP_PROPERTIES(static_cast<D3D12_HEAP_TYPE>(heapType));
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+	ThrowIfFailed(m_device->CreateCommittedResource(
+		&heapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		static_cast<D3D12_RESOURCE_STATES>(initialState),
+		nullptr,
+		IID_PPV_ARGS(&buffer)));
+
+	// The reference CreateCommittedResource returned is handed to the caller.
+	return ToRHI(buffer);
+}
+
+void D3D12RenderDevice::AddRef(RHIResource resource)
+{
+	ToD3D12(resource)->AddRef();
+}
+
+void D3D12RenderDevice::Release(RHIResource resource)
+{
+	ToD3D12(resource)->Release();
+}
+
+void* D3D12RenderDevice::Map(RHIResource buffer)
+{
+	void* data = nullptr;
+	ThrowIfFailed(ToD3D12(buffer)->Map(0, nullptr, &data));
+	return data;
+}
+
+GpuVirtualAddress D3D12RenderDevice::GetGpuVirtualAddress(RHIResource buffer)
+{
+	return ToD3D12(buffer)->GetGPUVirtualAddress();
+}
+
+std::unique_ptr<ICommandList> D3D12RenderDevice::CreateCommandList(CommandListType type)
+{
+	return std::make_unique<D3D12CommandList>(m_device, static_cast<D3D12_COMMAND_LIST_TYPE>(type));
+}
+
+std::unique_ptr<IFence> D3D12RenderDevice::CreateFence()
+{
+	return std::make_unique<D3D12Fence>(m_device);
+}
+
+D3D12CommandList::D3D12CommandList(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type)
+{
+	ThrowIfFailed(device->CreateCommandAllocator(type, IID_PPV_ARGS(&m_allocator)));
+	ThrowIfFailed(device->CreateCommandList(0, type, m_allocator.Get(), nullptr, IID_PPV_ARGS(&m_commandList)));
+	ThrowIfFailed(m_commandList->Close());
+
+	m_recorder = D3D12CommandRecorder(m_commandList.Get());
+}
+
+ID3D12GraphicsCommandList* D3D12CommandList::GetCommandList() const
+{
+	return m_commandList.Get();
+}
+
+ICommandRecorder& D3D12CommandList::GetRecorder()
+{
+	return m_recorder;
+}
+
+void D3D12CommandList::Reset()
+{
+	ThrowIfFailed(m_allocator->Reset());
+	ThrowIfFailed(m_commandList->Reset(m_allocator.Get(), nullptr));
+}
+
+void D3D12CommandList::Close()
+{
+	ThrowIfFailed(m_commandList->Close());
+}
+
+D3D12Fence::D3D12Fence(ID3D12Device* device)
+{
+	ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+
+	m_event = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+	if (m_event == nullptr) {
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+	}
+}
+
+D3D12Fence::~D3D12Fence()
+{
+	if (m_event != nullptr) {
+		CloseHandle(m_event);
+	}
+}
+
+ID3D12Fence* D3D12Fence::GetFence() const
+{
+	return m_fence.Get();
+}
+
+std::uint64_t D3D12Fence::GetCompletedValue() const
+{
+	return m_fence->GetCompletedValue();
+}
+
+void D3D12Fence::Wait(std::uint64_t value)
+{
+	if (m_fence->GetCompletedValue() >= value) {
+		return;
+	}
+
+	// The event is auto reset, so it can be armed again for the next wait.
+	ThrowIfFailed(m_fence->SetEventOnCompletion(value, m_event));
+	WaitForSingleObject(m_event, INFINITE);
+}
+
+D3D12CommandQueue::D3D12CommandQueue(ID3D12CommandQueue* queue) :
+	m_queue(queue)
+{
+}
+
+ID3D12CommandQueue* D3D12CommandQueue::GetQueue() const
+{
+	return m_queue;
+}
+
+CommandListType D3D12CommandQueue::GetType() const
+{
+	return static_cast<CommandListType>(m_queue->GetDesc().Type);
+}
+
+void D3D12CommandQueue::ExecuteCommandLists(std::uint32_t numCommandLists, ICommandList* const* commandLists)
+{
+	// A frame submits one command list per recording thread.
+	ID3D12CommandList* d3dCommandLists[16];
+	std::vector<ID3D12CommandList*> heapCommandLists;
+	ID3D12CommandList** lists = d3dCommandLists;
+	if (numCommandLists > _countof(d3dCommandLists)) {
+		heapCommandLists.resize(numCommandLists);
+		lists = heapCommandLists.data();
+	}
+
+	for (std::uint32_t i = 0; i < numCommandLists; i++) {
+		lists[i] = static_cast<D3D12CommandList*>(commandLists[i])->GetCommandList();
+	}
+	m_queue->ExecuteCommandLists(numCommandLists, lists);
+}
+
+void D3D12CommandQueue::Signal(IFence& fence, std::uint64_t value)
+{
+	ThrowIfFailed(m_queue->Signal(static_cast<D3D12Fence&>(fence).GetFence(), value));
+}
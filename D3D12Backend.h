@@ -0,0 +1,160 @@
+#ifndef D3D12BACKEND_H_
+#define D3D12BACKEND_H_
+
+#include "RHI.h"
+#include <wrl.h>
+#include <d3d12.h>
+
+// D3D12 implementation of the render hardware interface. Handles hold the
+// native interface pointers, so converting between the two is free.
+
+inline RHIResource ToRHI(ID3D12Resource* resource)
+{
+	return reinterpret_cast<RHIResource>(resource);
+}
+
+inline ID3D12Resource* ToD3D12(RHIResource resource)
+{
+	return reinterpret_cast<ID3D12Resource*>(resource);
+}
+
+inline CpuDescriptorHandle ToRHI(D3D12_CPU_DESCRIPTOR_HANDLE handle)
+{
+	return CpuDescriptorHandle{ handle.ptr };
+}
+
+inline GpuDescriptorHandle ToRHI(D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+	return GpuDescriptorHandle{ handle.ptr };
+}
+
+inline VertexBufferBinding ToRHI(const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+	return VertexBufferBinding{ view.BufferLocation, view.SizeInBytes, view.StrideInBytes };
+}
+
+inline IndexBufferBinding ToRHI(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+	return IndexBufferBinding{ view.BufferLocation, view.SizeInBytes,
+		view.Format == DXGI_FORMAT_R16_UINT ? IndexFormat::Uint16 : IndexFormat::Uint32 };
+}
+
+class D3D12CommandRecorder : public ICommandRecorder
+{
+public:
+	D3D12CommandRecorder() {};
+	D3D12CommandRecorder(ID3D12GraphicsCommandList* commandList);
+
+	ID3D12GraphicsCommandList* GetCommandList() const;
+
+	// Inherited via ICommandRecorder
+	virtual void ResourceBarrier(std::uint32_t numBarriers, const ::ResourceBarrier* barriers) override;
+	virtual void CopyBufferRegion(RHIResource dst, std::uint64_t dstOffset, RHIResource src, std::uint64_t srcOffset, std::uint64_t numBytes) override;
+
+	virtual void SetPipelineState(PipelineStateHandle pipelineState) override;
+	virtual void SetGraphicsRootSignature(RootSignatureHandle rootSignature) override;
+	virtual void SetDescriptorHeaps(std::uint32_t numHeaps, const DescriptorHeapHandle* heaps) override;
+	virtual void SetGraphicsRootDescriptorTable(std::uint32_t rootParameterIndex, GpuDescriptorHandle baseDescriptor) override;
+	virtual void SetGraphicsRoot32BitConstant(std::uint32_t rootParameterIndex, std::uint32_t srcData, std::uint32_t destOffsetIn32BitValues) override;
+	virtual void SetGraphicsRoot32BitConstants(std::uint32_t rootParameterIndex, std::uint32_t num32BitValuesToSet, const void* srcData, std::uint32_t destOffsetIn32BitValues) override;
+	virtual void SetGraphicsRootConstantBufferView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation) override;
+	virtual void SetGraphicsRootShaderResourceView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation) override;
+
+	virtual void IASetPrimitiveTopology(PrimitiveTopology topology) override;
+	virtual void IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t numViews, const VertexBufferBinding* views) override;
+	virtual void IASetIndexBuffer(const IndexBufferBinding* view) override;
+
+	virtual void RSSetViewports(std::uint32_t numViewports, const Viewport* viewports) override;
+	virtual void RSSetScissorRects(std::uint32_t numRects, const ScissorRect* rects) override;
+	virtual void OMSetRenderTargets(std::uint32_t numRenderTargets, const CpuDescriptorHandle* renderTargets, const CpuDescriptorHandle* depthStencil) override;
+	virtual void ClearRenderTargetView(CpuDescriptorHandle renderTarget, const float color[4]) override;
+	virtual void ClearDepthStencilView(CpuDescriptorHandle depthStencil, float depth, std::uint8_t stencil) override;
+
+	virtual void DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation) override;
+
+private:
+	ID3D12GraphicsCommandList* m_commandList = nullptr;
+};
+
+class D3D12RenderDevice : public IRenderDevice
+{
+public:
+	D3D12RenderDevice() {};
+	D3D12RenderDevice(ID3D12Device* device);
+
+	// Inherited via IRenderDevice
+	virtual void CreateConstantBufferView(GpuVirtualAddress bufferLocation, std::uint32_t sizeInBytes, CpuDescriptorHandle destDescriptor) override;
+	virtual void CopyDescriptorsSimple(std::uint32_t numDescriptors, CpuDescriptorHandle destStart, CpuDescriptorHandle srcStart) override;
+
+	virtual RHIResource CreateBuffer(std::uint64_t byteSize, HeapType heapType, ResourceState initialState) override;
+	virtual void AddRef(RHIResource resource) override;
+	virtual void Release(RHIResource resource) override;
+	virtual void* Map(RHIResource buffer) override;
+	virtual GpuVirtualAddress GetGpuVirtualAddress(RHIResource buffer) override;
+
+	virtual std::unique_ptr<ICommandList> CreateCommandList(CommandListType type) override;
+	virtual std::unique_ptr<IFence> CreateFence() override;
+
+private:
+	ID3D12Device* m_device = nullptr;
+};
+
+// A command list with its own allocator.
+class D3D12CommandList : public ICommandList
+{
+public:
+	D3D12CommandList(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type);
+
+	ID3D12GraphicsCommandList* GetCommandList() const;
+
+	// Inherited via ICommandList
+	virtual ICommandRecorder& GetRecorder() override;
+	virtual void Reset() override;
+	virtual void Close() override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_allocator;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_commandList;
+	D3D12CommandRecorder m_recorder;
+};
+
+// Waits on one event that is reused for every wait.
+class D3D12Fence : public IFence
+{
+public:
+	explicit D3D12Fence(ID3D12Device* device);
+	~D3D12Fence();
+
+	D3D12Fence(const D3D12Fence&) = delete;
+	D3D12Fence& operator=(const D3D12Fence&) = delete;
+
+	ID3D12Fence* GetFence() const;
+
+	// Inherited via IFence
+	virtual std::uint64_t GetCompletedValue() const override;
+	virtual void Wait(std::uint64_t value) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+	HANDLE m_event = nullptr;
+};
+
+class D3D12CommandQueue : public ICommandQueue
+{
+public:
+	D3D12CommandQueue() {};
+	D3D12CommandQueue(ID3D12CommandQueue* queue);
+
+	ID3D12CommandQueue* GetQueue() const;
+
+	// Inherited via ICommandQueue
+	virtual CommandListType GetType() const override;
+	virtual void ExecuteCommandLists(std::uint32_t numCommandLists, ICommandList* const* commandLists) override;
+	virtual void Signal(IFence& fence, std::uint64_t value) override;
+
+private:
+	ID3D12CommandQueue* m_queue = nullptr;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "DescriptorAllocator.h"
+#include "d3dUtility.h"
+
+DescriptorAllocator::DescriptorAllocator(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+	UINT persistentCount, UINT transientCount, UINT stagingCount) :
+	m_device(device),
+	m_type(type),
+	m_descriptorSize(device->GetDescriptorHandleIncrementSize(type)),
+	m_shaderVisible(type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV || type == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER),
+	m_indices(persistentCount, transientCount),
+	m_staging(stagingCount)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc;
+	heapDesc.NumDescriptors = m_indices.GetCount();
+	heapDesc.Type = type;
+	heapDesc.Flags = m_shaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	heapDesc.NodeMask = 0;
+	ThrowIfFailed(m_device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(m_heap.GetAddressOf())));
+
+	m_cpuStart = m_heap->GetCPUDescriptorHandleForHeapStart();
+	if (m_shaderVisible) {
+		m_gpuStart = m_heap->GetGPUDescriptorHandleForHeapStart();
+	}
+
+	if (stagingCount > 0) {
+		D3D12_DESCRIPTOR_HEAP_DESC stagingHeapDesc;
+		stagingHeapDesc.NumDescriptors = stagingCount;
+		stagingHeapDesc.Type = type;
+		stagingHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+		stagingHeapDesc.NodeMask = 0;
+		ThrowIfFailed(m_device->CreateDescriptorHeap(&stagingHeapDesc, IID_PPV_ARGS(m_stagingHeap.GetAddressOf())));
+		m_stagingStart = m_stagingHeap->GetCPUDescriptorHandleForHeapStart();
+	}
+}
+
+DescriptorRange DescriptorAllocator::AllocatePersistent(UINT count)
+{
+	auto index = m_indices.AllocatePersistent(count);
+	if (index == DescriptorIndexAllocator::InvalidIndex) {
+		ThrowIfFailed(E_OUTOFMEMORY);
+	}
+	return MakeRange(index, count);
+}
+
+DescriptorRange DescriptorAllocator::AllocateTransient(UINT count)
+{
+	auto index = m_indices.AllocateTransient(count);
+	if (index == DescriptorIndexAllocator::InvalidIndex) {
+		ThrowIfFailed(E_OUTOFMEMORY);
+	}
+	return MakeRange(index, count);
+}
+
+DescriptorRange DescriptorAllocator::AllocateStaging(UINT count)
+{
+	auto offset = m_staging.Allocate(count);
+	if (offset == RangeAllocator::InvalidOffset) {
+		ThrowIfFailed(E_OUTOFMEMORY);
+	}
+
+	DescriptorRange range;
+	range.Cpu.ptr = m_stagingStart.ptr + offset * m_descriptorSize;
+	range.Index = static_cast<UINT>(offset);
+	range.Count = count;
+	return range;
+}
+
+void DescriptorAllocator::FreePersistent(const DescriptorRange& range, UINT64 fenceValue)
+{
+	if (range.IsValid()) {
+		m_indices.FreePersistent(range.Index, fenceValue);
+	}
+}
+
+void DescriptorAllocator::FreeStaging(const DescriptorRange& range)
+{
+	if (range.IsValid()) {
+		m_staging.Free(range.Index);
+	}
+}
+
+DescriptorRange DescriptorAllocator::CopyToTransient(D3D12_CPU_DESCRIPTOR_HANDLE source, UINT count)
+{
+	auto range = AllocateTransient(count);
+	m_device->CopyDescriptorsSimple(count, range.Cpu, source, m_type);
+	return range;
+}
+
+void DescriptorAllocator::Submit(UINT64 fenceValue)
+{
+	m_indices.Submit(fenceValue);
+}
+
+void DescriptorAllocator::Reclaim(UINT64 completedFenceValue)
+{
+	m_indices.Reclaim(completedFenceValue);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::GetCpuHandle(UINT index) const
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE handle;
+	handle.ptr = m_cpuStart.ptr + static_cast<SIZE_T>(index) * m_descriptorSize;
+	return handle;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE DescriptorAllocator::GetGpuHandle(UINT index) const
+{
+	D3D12_GPU_DESCRIPTOR_HANDLE handle = {};
+	if (m_shaderVisible) {
+		handle.ptr = m_gpuStart.ptr + static_cast<UINT64>(index) * m_descriptorSize;
+	}
+	return handle;
+}
+
+DescriptorAllocator::Stats DescriptorAllocator::GetStats() const
+{
+	Stats stats;
+	stats.Heap = m_indices.GetStats();
+	stats.StagingUsed = static_cast<UINT>(m_staging.GetUsedSize());
+	stats.StagingCapacity = static_cast<UINT>(m_staging.GetSize());
+	return stats;
+}
+
+DescriptorRange DescriptorAllocator::MakeRange(UINT index, UINT count) const
+{
+	DescriptorRange range;
+	range.Cpu = GetCpuHandle(index);
+	range.Gpu = GetGpuHandle(index);
+	range.Index = index;
+	range.Count = count;
+	return range;
+}
@@ -0,0 +1,85 @@
+#ifndef DESCRIPTORALLOCATOR_H_
+#define DESCRIPTORALLOCATOR_H_
+
+#include "DescriptorIndexAllocator.h"
+#include "RangeAllocator.h"
+#include <wrl.h>
+#include <d3d12.h>
+
+// Count consecutive descriptors of a DescriptorAllocator's heap.
+struct DescriptorRange
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE Cpu = {};
+	// Zero for heaps that are not shader visible.
+	D3D12_GPU_DESCRIPTOR_HANDLE Gpu = {};
+	UINT Index = DescriptorIndexAllocator::InvalidIndex;
+	UINT Count = 0;
+
+	bool IsValid() const { return Index != DescriptorIndexAllocator::InvalidIndex; }
+};
+
+// Owns the descriptor heap of one type and hands out ranges of it:
+// - persistent ranges for long lived views, freed once the GPU is done with them,
+// - transient ranges for tables built every frame, retired with the frame's fence,
+// - staging ranges in a CPU only heap. Views are created there and copied into
+//   a transient table, the staging heap can be written while the GPU reads the
+//   shader visible one.
+// CBV_SRV_UAV and sampler heaps are shader visible, RTV and DSV heaps are not
+// and only use the persistent region.
+class DescriptorAllocator
+{
+public:
+	struct Stats
+	{
+		DescriptorIndexAllocator::Stats Heap;
+		UINT StagingUsed = 0;
+		UINT StagingCapacity = 0;
+	};
+
+	DescriptorAllocator() {};
+	DescriptorAllocator(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+		UINT persistentCount, UINT transientCount = 0, UINT stagingCount = 0);
+
+	// Throw when the region is full.
+	DescriptorRange AllocatePersistent(UINT count = 1);
+	DescriptorRange AllocateTransient(UINT count);
+	DescriptorRange AllocateStaging(UINT count = 1);
+
+	// The range may still be used by frames in flight, it is reused once
+	// Reclaim saw fenceValue completed.
+	void FreePersistent(const DescriptorRange& range, UINT64 fenceValue);
+	// Staging descriptors are only read by CopyDescriptors, they can be freed right away.
+	void FreeStaging(const DescriptorRange& range);
+
+	// Copies count staging descriptors starting at source into a new transient table.
+	DescriptorRange CopyToTransient(D3D12_CPU_DESCRIPTOR_HANDLE source, UINT count);
+
+	// Tags the transient ranges of the frame with the fence value it was signaled with.
+	void Submit(UINT64 fenceValue);
+	void Reclaim(UINT64 completedFenceValue);
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(UINT index) const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(UINT index) const;
+	ID3D12DescriptorHeap* GetHeap() const { return m_heap.Get(); }
+	UINT GetDescriptorSize() const { return m_descriptorSize; }
+	Stats GetStats() const;
+
+private:
+	DescriptorRange MakeRange(UINT index, UINT count) const;
+
+	ID3D12Device* m_device = nullptr;
+	D3D12_DESCRIPTOR_HEAP_TYPE m_type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	UINT m_descriptorSize = 0;
+	bool m_shaderVisible = false;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_heap;
+	D3D12_CPU_DESCRIPTOR_HANDLE m_cpuStart = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE m_gpuStart = {};
+	DescriptorIndexAllocator m_indices;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_stagingHeap;
+	D3D12_CPU_DESCRIPTOR_HANDLE m_stagingStart = {};
+	RangeAllocator m_staging;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "DescriptorIndexAllocator.h"
+
+DescriptorIndexAllocator::DescriptorIndexAllocator()
+{
+}
+
+DescriptorIndexAllocator::DescriptorIndexAllocator(std::uint32_t persistentCount, std::uint32_t transientCount) :
+	m_persistentCount(persistentCount),
+	m_persistent(persistentCount),
+	m_transient(transientCount)
+{
+}
+
+std::uint32_t DescriptorIndexAllocator::AllocatePersistent(std::uint32_t count)
+{
+	auto offset = m_persistent.Allocate(count);
+	return offset != RangeAllocator::InvalidOffset ? static_cast<std::uint32_t>(offset) : InvalidIndex;
+}
+
+std::uint32_t DescriptorIndexAllocator::AllocateTransient(std::uint32_t count)
+{
+	auto offset = m_transient.Allocate(count);
+	return offset != StagingRing::InvalidOffset ? m_persistentCount + static_cast<std::uint32_t>(offset) : InvalidIndex;
+}
+
+void DescriptorIndexAllocator::FreePersistent(std::uint32_t index, std::uint64_t fenceValue)
+{
+	if (index == InvalidIndex) {
+		return;
+	}
+
+	PendingFree pendingFree;
+	pendingFree.Index = index;
+	pendingFree.FenceValue = fenceValue;
+	m_pendingFrees.push_back(pendingFree);
+}
+
+void DescriptorIndexAllocator::Submit(std::uint64_t fenceValue)
+{
+	m_transient.Submit(fenceValue);
+}
+
+void DescriptorIndexAllocator::Reclaim(std::uint64_t completedFenceValue)
+{
+	m_transient.Reclaim(completedFenceValue);
+
+	// Fence values are increasing, so the frees are retired in order.
+	while (!m_pendingFrees.empty() && m_pendingFrees.front().FenceValue <= completedFenceValue) {
+		m_persistent.Free(m_pendingFrees.front().Index);
+		m_pendingFrees.pop_front();
+	}
+}
+
+std::uint32_t DescriptorIndexAllocator::GetCount() const
+{
+	return m_persistentCount + static_cast<std::uint32_t>(m_transient.GetSize());
+}
+
+DescriptorIndexAllocator::Stats DescriptorIndexAllocator::GetStats() const
+{
+	Stats stats;
+	stats.PersistentUsed = static_cast<std::uint32_t>(m_persistent.GetUsedSize());
+	stats.PendingFreeRanges = static_cast<std::uint32_t>(m_pendingFrees.size());
+	stats.PersistentCapacity = m_persistentCount;
+	stats.TransientInFlight = static_cast<std::uint32_t>(m_transient.GetStats().BytesInFlight);
+	stats.TransientCapacity = static_cast<std::uint32_t>(m_transient.GetSize());
+	return stats;
+}
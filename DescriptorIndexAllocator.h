@@ -0,0 +1,61 @@
+#ifndef DESCRIPTORINDEXALLOCATOR_H_
+#define DESCRIPTORINDEXALLOCATOR_H_
+
+#include "RangeAllocator.h"
+#include "StagingRing.h"
+#include <cstdint>
+#include <deque>
+
+// Hands out descriptor indices of one heap split into two regions:
+//   [0, persistentCount)                     long lived views, first fit free list.
+//   [persistentCount, persistentCount + transientCount)
+//                                            tables built for one frame, a ring.
+// Persistent ranges may still be referenced by command lists in flight when
+// they are freed, so they are only reused once the given fence value has been
+// reached. Transient ranges are all retired by Submit and Reclaim like a
+// StagingRing.
+class DescriptorIndexAllocator
+{
+public:
+	static const std::uint32_t InvalidIndex = 0xffffffff;
+
+	struct Stats
+	{
+		std::uint32_t PersistentUsed = 0;
+		std::uint32_t PendingFreeRanges = 0;
+		std::uint32_t PersistentCapacity = 0;
+		std::uint32_t TransientInFlight = 0;
+		std::uint32_t TransientCapacity = 0;
+	};
+
+	DescriptorIndexAllocator();
+	DescriptorIndexAllocator(std::uint32_t persistentCount, std::uint32_t transientCount);
+
+	// Both return InvalidIndex when the region is full.
+	std::uint32_t AllocatePersistent(std::uint32_t count);
+	std::uint32_t AllocateTransient(std::uint32_t count);
+
+	// The range is reused after Reclaim saw fenceValue completed.
+	void FreePersistent(std::uint32_t index, std::uint64_t fenceValue);
+
+	// Tags the transient ranges allocated since the last Submit with fenceValue.
+	void Submit(std::uint64_t fenceValue);
+	void Reclaim(std::uint64_t completedFenceValue);
+
+	std::uint32_t GetCount() const;
+	Stats GetStats() const;
+
+private:
+	struct PendingFree
+	{
+		std::uint32_t Index = 0;
+		std::uint64_t FenceValue = 0;
+	};
+
+	std::uint32_t m_persistentCount = 0;
+	RangeAllocator m_persistent;
+	std::deque<PendingFree> m_pendingFrees;
+	StagingRing m_transient;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "DirtyRanges.h"
+#include <algorithm>
+#include <cstring>
+
+void FindDirtyRanges(const void* previous, std::size_t previousSize, const void* current, std::size_t currentSize,
+	std::vector<ByteRange>& ranges, std::size_t blockSize, std::size_t mergeDistance)
+{
+	auto previousBytes = static_cast<const std::uint8_t*>(previous);
+	auto currentBytes = static_cast<const std::uint8_t*>(current);
+	blockSize = std::max<std::size_t>(blockSize, 1);
+
+	auto firstRange = ranges.size();
+	for (std::size_t offset = 0; offset < currentSize; offset += blockSize) {
+		auto length = std::min(blockSize, currentSize - offset);
+		if (offset + length <= previousSize && std::memcmp(previousBytes + offset, currentBytes + offset, length) == 0) {
+			continue;
+		}
+
+		if (ranges.size() > firstRange) {
+			auto& last = ranges.back();
+			if (offset - (last.Offset + last.Size) < mergeDistance) {
+				last.Size = offset + length - last.Offset;
+				continue;
+			}
+		}
+
+		ByteRange range;
+		range.Offset = offset;
+		range.Size = length;
+		ranges.push_back(range);
+	}
+}
+
+std::uint64_t GetTotalSize(const std::vector<ByteRange>& ranges)
+{
+	std::uint64_t size = 0;
+	for (const auto& range : ranges) {
+		size += range.Size;
+	}
+	return size;
+}
@@ -0,0 +1,25 @@
+#ifndef DIRTYRANGES_H_
+#define DIRTYRANGES_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+struct ByteRange
+{
+	std::uint64_t Offset = 0;
+	std::uint64_t Size = 0;
+};
+
+// Appends the byte ranges in which current differs from previous. Bytes of
+// current past the end of previous are always dirty. The data is compared in
+// blocks of blockSize bytes, and dirty blocks less than mergeDistance bytes apart
+// are merged into one range: every range becomes a copy of its own, and
+// uploading a small gap is cheaper than another copy.
+void FindDirtyRanges(const void* previous, std::size_t previousSize, const void* current, std::size_t currentSize,
+	std::vector<ByteRange>& ranges, std::size_t blockSize = 64, std::size_t mergeDistance = 256);
+
+// Sum of the sizes of the ranges.
+std::uint64_t GetTotalSize(const std::vector<ByteRange>& ranges);
+
+#endif
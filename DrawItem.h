@@ -0,0 +1,25 @@
+#ifndef DRAWITEM_H_
+#define DRAWITEM_H_
+
+#include "RHI.h"
+#include "FrustumCulling.h"
+
+// Everything needed to draw one piece of geometry.
+struct DrawItem
+{
+	// Stream 0, and stream 1 for split vertices. AttributeBuffer has a size of 0
+	// for interleaved vertices and passes that only read positions skip it.
+	VertexBufferBinding VertexBuffer;
+	VertexBufferBinding AttributeBuffer;
+	IndexBufferBinding IndexBuffer;
+	std::uint32_t IndexCount = 0;
+	std::uint32_t StartIndexLocation = 0;
+	std::int32_t BaseVertexLocation = 0;
+	// Index of the object's transform in FrameBindings::ObjectTransforms.
+	std::uint32_t ObjectIndex = 0;
+
+	// World space bounds, used for culling.
+	Aabb Bounds;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "DrawQueue.h"
+#include "ContentHash.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+std::uint64_t DrawSortKey::Make(std::uint32_t pass, std::uint32_t pipeline, std::uint32_t depthBucket,
+	std::uint32_t geometry, std::uint32_t depth)
+{
+	return (static_cast<std::uint64_t>(pass & ((1u << PassBits) - 1)) << PassShift) |
+		(static_cast<std::uint64_t>(pipeline & ((1u << PipelineBits) - 1)) << PipelineShift) |
+		(static_cast<std::uint64_t>(depthBucket & ((1u << DepthBucketBits) - 1)) << DepthBucketShift) |
+		(static_cast<std::uint64_t>(geometry & ((1u << GeometryBits) - 1)) << GeometryShift) |
+		(static_cast<std::uint64_t>(depth & ((1u << DepthBits) - 1)) << DepthShift);
+}
+
+std::uint32_t GetGeometrySortId(const DrawItem& drawItem)
+{
+	auto hash = HashCombine(drawItem.VertexBuffer.BufferLocation, drawItem.IndexBuffer.BufferLocation);
+	return static_cast<std::uint32_t>(hash ^ (hash >> 32)) & ((1u << DrawSortKey::GeometryBits) - 1);
+}
+
+float GetViewDepth(const Aabb& bounds, const float viewProj[16])
+{
+	const float* w = viewProj + 12;
+	return w[0] * bounds.Center[0] + w[1] * bounds.Center[1] + w[2] * bounds.Center[2] + w[3];
+}
+
+std::uint32_t GetDepthSortBucket(float viewDepth, float maxDepth)
+{
+	const std::uint32_t maxBucket = (1u << DrawSortKey::DepthBits) - 1;
+
+	auto t = maxDepth > 0.0f ? viewDepth / maxDepth : 0.0f;
+	// Also catches NaN.
+	if (!(t > 0.0f)) {
+		return 0;
+	}
+	if (t >= 1.0f) {
+		return maxBucket;
+	}
+	return static_cast<std::uint32_t>(t * maxBucket);
+}
+
+std::uint32_t GetCoarseDepthBucket(float viewDepth, float nearZ, float farZ, std::uint32_t bucketCount)
+{
+	bucketCount = std::min<std::uint32_t>(bucketCount, 1u << DrawSortKey::DepthBucketBits);
+	if (bucketCount <= 1 || !(nearZ > 0.0f) || !(farZ > nearZ) || !(viewDepth > nearZ)) {
+		return 0;
+	}
+
+	auto t = std::log(viewDepth / nearZ) / std::log(farZ / nearZ);
+	return std::min<std::uint32_t>(static_cast<std::uint32_t>(t * bucketCount), bucketCount - 1);
+}
+
+void DrawQueue::Clear()
+{
+	m_packets.clear();
+	m_drawOrder.clear();
+}
+
+void DrawQueue::Push(std::uint64_t key, std::uint32_t drawItem)
+{
+	DrawPacket packet;
+	packet.Key = key;
+	packet.DrawItem = drawItem;
+	m_packets.push_back(packet);
+}
+
+void DrawQueue::Build(const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>& visibleDrawItems,
+	const float viewProj[16], const DrawSortSettings& settings, JobSystem& jobs)
+{
+	m_packets.resize(visibleDrawItems.size());
+	m_drawOrder.clear();
+
+	jobs.ParallelFor("BuildDrawQueue", visibleDrawItems.size(), 16384, [&](std::size_t begin, std::size_t end) {
+		for (auto i = begin; i < end; i++) {
+			auto index = visibleDrawItems[i];
+			const auto& drawItem = drawItems[index];
+
+			auto viewDepth = GetViewDepth(drawItem.Bounds, viewProj);
+			m_packets[i].Key = DrawSortKey::Make(settings.Pass, settings.Pipeline,
+				GetCoarseDepthBucket(viewDepth, settings.NearZ, settings.FarZ, settings.DepthBucketCount),
+				GetGeometrySortId(drawItem), GetDepthSortBucket(viewDepth, settings.FarZ));
+			m_packets[i].DrawItem = index;
+		}
+	});
+}
+
+void DrawQueue::Sort()
+{
+	RadixSort(nullptr, 0);
+}
+
+void DrawQueue::Sort(JobSystem& jobs, std::size_t packetsPerJob)
+{
+	RadixSort(&jobs, std::max<std::size_t>(packetsPerJob, 1));
+}
+
+void DrawQueue::RadixSort(JobSystem* jobs, std::size_t packetsPerJob)
+{
+	auto count = m_packets.size();
+	m_scratch.resize(count);
+	m_drawOrder.resize(count);
+	if (count == 0) {
+		return;
+	}
+
+	auto rangeSize = jobs != nullptr ? packetsPerJob : count;
+	auto rangeCount = (count + rangeSize - 1) / rangeSize;
+	m_histograms.resize(rangeCount * RadixSize);
+
+	auto forEachRange = [&](const char* name, auto&& func) {
+		auto rangeFunc = [&](std::size_t range) {
+			auto begin = range * rangeSize;
+			func(range, begin, std::min<std::size_t>(begin + rangeSize, count));
+		};
+		if (jobs != nullptr && rangeCount > 1) {
+			jobs->ParallelFor(name, rangeCount, 1, [&](std::size_t begin, std::size_t end) {
+				for (auto range = begin; range < end; range++) {
+					rangeFunc(range);
+				}
+			});
+		}
+		else {
+			for (std::size_t range = 0; range < rangeCount; range++) {
+				rangeFunc(range);
+			}
+		}
+	};
+
+	for (std::uint32_t shift = 0; shift < 64; shift += RadixBits) {
+		forEachRange("DrawQueueHistogram", [&](std::size_t range, std::size_t begin, std::size_t end) {
+			auto counts = m_histograms.data() + range * RadixSize;
+			std::fill(counts, counts + RadixSize, 0u);
+			for (auto i = begin; i < end; i++) {
+				counts[(m_packets[i].Key >> shift) & (RadixSize - 1)]++;
+			}
+		});
+
+		// Nothing moves if all keys have the same digit.
+		bool sameDigit = false;
+		for (std::uint32_t digit = 0; digit < RadixSize && !sameDigit; digit++) {
+			std::size_t digitCount = 0;
+			for (std::size_t range = 0; range < rangeCount; range++) {
+				digitCount += m_histograms[range * RadixSize + digit];
+			}
+			sameDigit = digitCount == count;
+		}
+		if (sameDigit) {
+			continue;
+		}
+
+		// Offsets ordered by digit, then by range, keep the sort stable.
+		std::uint32_t offset = 0;
+		for (std::uint32_t digit = 0; digit < RadixSize; digit++) {
+			for (std::size_t range = 0; range < rangeCount; range++) {
+				auto& counter = m_histograms[range * RadixSize + digit];
+				auto digitCount = counter;
+				counter = offset;
+				offset += digitCount;
+			}
+		}
+
+		forEachRange("DrawQueueScatter", [&](std::size_t range, std::size_t begin, std::size_t end) {
+			auto offsets = m_histograms.data() + range * RadixSize;
+			for (auto i = begin; i < end; i++) {
+				m_scratch[offsets[(m_packets[i].Key >> shift) & (RadixSize - 1)]++] = m_packets[i];
+			}
+		});
+		std::swap(m_packets, m_scratch);
+	}
+
+	forEachRange("DrawQueueOrder", [&](std::size_t, std::size_t begin, std::size_t end) {
+		for (auto i = begin; i < end; i++) {
+			m_drawOrder[i] = m_packets[i].DrawItem;
+		}
+	});
+}
@@ -0,0 +1,119 @@
+#ifndef DRAWQUEUE_H_
+#define DRAWQUEUE_H_
+
+#include "DrawItem.h"
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// 64 bit key draws are submitted in, most significant field first:
+// pass (4 bits) | pipeline (12 bits) | depth bucket (8 bits) | geometry (16 bits) | depth (24 bits).
+// Sorting by it groups the draws that share state so the submit loop can skip
+// the state that is already bound. The coarse depth bucket splits each pipeline's
+// draws into front to back ranges first, trading some state changes for early-Z
+// rejection; with a single bucket draws are sorted by state and then by depth.
+struct DrawSortKey
+{
+	static const std::uint32_t PassBits = 4;
+	static const std::uint32_t PipelineBits = 12;
+	static const std::uint32_t DepthBucketBits = 8;
+	static const std::uint32_t GeometryBits = 16;
+	static const std::uint32_t DepthBits = 24;
+
+	static const std::uint32_t DepthShift = 0;
+	static const std::uint32_t GeometryShift = DepthShift + DepthBits;
+	static const std::uint32_t DepthBucketShift = GeometryShift + GeometryBits;
+	static const std::uint32_t PipelineShift = DepthBucketShift + DepthBucketBits;
+	static const std::uint32_t PassShift = PipelineShift + PipelineBits;
+
+	// Fields are masked to their width.
+	static std::uint64_t Make(std::uint32_t pass, std::uint32_t pipeline, std::uint32_t depthBucket,
+		std::uint32_t geometry, std::uint32_t depth);
+
+	static std::uint32_t GetPass(std::uint64_t key) { return GetField(key, PassShift, PassBits); }
+	static std::uint32_t GetPipeline(std::uint64_t key) { return GetField(key, PipelineShift, PipelineBits); }
+	static std::uint32_t GetDepthBucket(std::uint64_t key) { return GetField(key, DepthBucketShift, DepthBucketBits); }
+	static std::uint32_t GetGeometry(std::uint64_t key) { return GetField(key, GeometryShift, GeometryBits); }
+	static std::uint32_t GetDepth(std::uint64_t key) { return GetField(key, DepthShift, DepthBits); }
+
+private:
+	static std::uint32_t GetField(std::uint64_t key, std::uint32_t shift, std::uint32_t bits)
+	{
+		return static_cast<std::uint32_t>((key >> shift) & ((1ull << bits) - 1));
+	}
+};
+
+// Same value for draw items using the same vertex and index buffer, e.g. meshes
+// in the same GeometryArena pages. Different buffers may collide, which only
+// costs a redundant bind.
+std::uint32_t GetGeometrySortId(const DrawItem& drawItem);
+
+// View depth of the center of the bounds, the w of the clip space position.
+// viewProj uses the layout of FrustumCulling.h.
+float GetViewDepth(const Aabb& bounds, const float viewProj[16]);
+
+// Quantizes a view depth in [0, maxDepth] to the depth field, clamping outside of it.
+std::uint32_t GetDepthSortBucket(float viewDepth, float maxDepth);
+
+// One of bucketCount ranges of view depth between nearZ and farZ, front to back.
+// The ranges grow logarithmically so close draws, which occlude the most, are
+// split the finest.
+std::uint32_t GetCoarseDepthBucket(float viewDepth, float nearZ, float farZ, std::uint32_t bucketCount);
+
+// How DrawQueue::Build keys the draws of a pass.
+struct DrawSortSettings
+{
+	std::uint32_t Pass = 0;
+	std::uint32_t Pipeline = 0;
+	// 1 to 256, see DrawSortKey.
+	std::uint32_t DepthBucketCount = 1;
+	float NearZ = 1.0f;
+	float FarZ = 1000.0f;
+};
+
+struct DrawPacket
+{
+	std::uint64_t Key = 0;
+	// Index into the draw items the queue was built from.
+	std::uint32_t DrawItem = 0;
+};
+
+// The draws of a frame as packets, sorted by key with an LSD radix sort of
+// 8 bits per pass. Passes over bytes all keys share are skipped, so unused
+// fields cost a histogram only.
+class DrawQueue
+{
+public:
+	void Clear();
+	void Push(std::uint64_t key, std::uint32_t drawItem);
+
+	// Replaces the packets with one per visible draw item, keyed by view depth and
+	// geometry. visibleDrawItems is e.g. the output of FrustumCuller::Cull.
+	void Build(const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>& visibleDrawItems,
+		const float viewProj[16], const DrawSortSettings& settings, JobSystem& jobs);
+
+	// Stable, packets with equal keys keep their order.
+	void Sort();
+	// Every pass histograms and scatters ranges of packetsPerJob packets as jobs.
+	void Sort(JobSystem& jobs, std::size_t packetsPerJob = 16384);
+
+	const std::vector<DrawPacket>& GetPackets() const { return m_packets; }
+	// Draw item indices in the order of the packets, valid after Sort. Can be
+	// passed to SceneRenderer as the draw items to draw.
+	const std::vector<std::uint32_t>& GetDrawOrder() const { return m_drawOrder; }
+
+private:
+	static const std::uint32_t RadixBits = 8;
+	static const std::uint32_t RadixSize = 1 << RadixBits;
+
+	void RadixSort(JobSystem* jobs, std::size_t packetsPerJob);
+
+	std::vector<DrawPacket> m_packets;
+	std::vector<DrawPacket> m_scratch;
+	std::vector<std::uint32_t> m_drawOrder;
+	// RadixSize counters per range of packets.
+	std::vector<std::uint32_t> m_histograms;
+};
+
+#endif
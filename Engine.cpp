@@ -9,22 +9,36 @@
 #include "ResourceManager.h"
 #include "d3dUtility.h"
 #include "MeshGenerator.h"
+#include <algorithm>
 
 
 using namespace Microsoft::WRL;
 
-Engine::Engine(WindowManager& windowManager, ICamera& camera, InputManager& inputManager) :
+namespace {
+
+// The core stores matrices in Float4x4, which has the layout of XMFLOAT4X4.
+void StoreFloat4x4(Float4x4& destination, DirectX::FXMMATRIX matrix)
+{
+	static_assert(sizeof(Float4x4) == sizeof(DirectX::XMFLOAT4X4), "Float4x4 must match XMFLOAT4X4");
+	DirectX::XMStoreFloat4x4(reinterpret_cast<DirectX::XMFLOAT4X4*>(&destination), matrix);
+}
+
+}
+
+Engine::Engine(WindowManager& windowManager, ICamera& camera, InputManager& inputManager,
+	const FramePacingSettings& framePacing, const DepthSettings& depthSettings) :
+	m_framePacing{ framePacing },
+	m_depthSettings{ depthSettings },
 	m_windowManager{ windowManager },
 	m_camera{ camera },
 	m_inputManager{ inputManager },
 	m_scissorRect{ 0, 0, static_cast<LONG>(windowManager.GetWidth()), static_cast<LONG>(windowManager.GetHeight()) },
 	m_viewport{ 0.0f, 0.0f, static_cast<float>(windowManager.GetWidth()), static_cast<float>(windowManager.GetHeight()) , 0.0f, 1.0f },
 	m_dxgiFactoryFlags{ 0 },
-	m_rtvDescriptorSize{ 0 },
-	m_dsvDescriptorSize{ 0 },
-	m_cbvDescriptorSize{ 0 },
 	m_frameIndex{ 0 }
 {
+	m_framePacing.BackBufferCount = std::max<UINT>(std::min<UINT>(m_framePacing.BackBufferCount, DXGI_MAX_SWAP_CHAIN_BUFFERS), 2);
+	m_framePacing.FrameContextCount = std::max<UINT>(m_framePacing.FrameContextCount, 1);
 }
 
 void Engine::Initialize()
@@ -32,8 +46,14 @@ void Engine::Initialize()
 	m_windowManager.CreateMainWindow();
 	InitializeD3D12();
 
-	// Set up the resource manager
-	m_resourceManager = ResourceManager(m_commandList.Get(), m_device.Get());
+	// Set up the platform neutral part of the frame, which owns the resource manager
+	FrameRendererSettings frameSettings;
+	frameSettings.FrameContextCount = m_framePacing.FrameContextCount;
+	frameSettings.Depth = m_depthSettings;
+	frameSettings.MaxRecordingThreads = std::min<UINT>(m_jobs.GetThreadCount(), 8);
+	frameSettings.VertexFormat = m_vertexFormat;
+	m_frameRenderer = std::make_unique<FrameRenderer>(m_rhiDevice, m_rhiCommandQueue, m_rhiCopyQueue, m_jobs, frameSettings);
+	BuildTimestampQueries();
 
 	// Initialize system (CPU) timer
 	SystemTime().Initialize();
@@ -41,7 +61,6 @@ void Engine::Initialize()
 	m_cpuTimer.Reset();
 
 	// Prepare geometry
-	BuildConstantBuffers();
 	BuildGeometry();
 	BuildRootSignatures();
 	BuildShadersAndInputLayouts();
@@ -50,39 +69,23 @@ void Engine::Initialize()
 	// Setup the camera and input
 	m_inputManager.CaptureMouseInputs();
 
-	m_camera.SetFrustum(0.25f * 3.14f, (float)m_windowManager.GetWidth() / m_windowManager.GetHeight(), 1.0f, 1000);
+	m_camera.SetFrustum(0.25f * 3.14f, (float)m_windowManager.GetWidth() / m_windowManager.GetHeight(), m_nearZ, m_farZ);
 	m_camera.LookAt(
 		DirectX::XMVectorSet(-5.0f, 15.0f, -25.0f, 1.0f),
 		DirectX::XMVectorZero(),
 		DirectX::XMVectorSet(0.0f, 1.0f, 0.f, 0.0f));
 
-	ThrowIfFailed(m_commandList->Close());
-	ID3D12CommandList* cmdsLists[] = { m_commandList.Get() };
-	m_commandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
-
-	// Wait until initialization is complete.
-	WaitForPreviousFrame();
+	// Start the geometry uploads. The meshes show up once they are done, the
+	// first frames do not wait for them.
+	m_frameRenderer->GetResourceManager().FlushUploads();
 }
 
 void Engine::Update()
 {
-	// Get the frameContext for updating
-	auto currFrameContext = m_resourceManager.GetCurrentFrameContext();
-
-	// Get fencevalue
-	auto currFenceValue = currFrameContext->Fence;
-
-	// If the current value of the most recent completed fence is less than the current frames fence value
-	// then wait. For example the first Signal set the completed value to 1. Then if the GPU is slow we might
-	// cycle all the way through until we reach the same FrameContext but the Signal has not yet been executed
-	// on the GPU so the CompletedValue is still -1 (the default value). So we must wait for it to complete.
-	if (currFrameContext->Fence > 0 && m_fence->GetCompletedValue() < currFrameContext->Fence) {
-		HANDLE eventHandle = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
-
-		ThrowIfFailed(m_fence->SetEventOnCompletion(m_fenceValue, eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
-	}
+	// Waits for the frame context the frame is recorded in.
+	m_frameRenderer->BeginFrame();
+	m_cbvSrvUavDescriptors.Reclaim(m_frameRenderer->GetFramePacer().GetCompletedValue());
+	ReadTimestamps(static_cast<UINT>(m_frameRenderer->GetResourceManager().GetCurrentFrameIndex()));
 
 	// Update time
 	m_cpuTimer.Stop();
@@ -116,109 +119,183 @@ void Engine::Update()
 	auto viewProj = XMMatrixMultiply(view, proj);
 
 
-	PassConstants passConstants;
-	passConstants.DeltaTime = deltaTime;
-	passConstants.TotalTime = currTime;
-	DirectX::XMStoreFloat4x4(&passConstants.ViewProj, XMMatrixTranspose(viewProj));
-
-	for (int i = 0; i < m_resourceManager.numFrameContexts; i++) {
-		m_resourceManager.UpdateConstantBuffer<PassConstants>("PassConstants", i, passConstants);
-	}
+	// Culls and sorts the draw items for this view.
+	FrameView frameView;
+	StoreFloat4x4(frameView.ViewProj, XMMatrixTranspose(viewProj));
+	frameView.NearZ = m_nearZ;
+	frameView.FarZ = m_farZ;
+	frameView.DeltaTime = deltaTime;
+	frameView.TotalTime = currTime;
+	m_frameRenderer->Update(frameView);
 
 	// Update geometry
+	auto& instances = m_frameRenderer->GetInstances();
+	instances.Begin();
+	if (m_frameRenderer->GetResourceManager().IsMeshResident(m_boxInstanceMesh)) {
+		for (const auto& transform : m_boxInstances) {
+			instances.Add(m_boxInstanceGeometry, transform);
+		}
+	}
+	instances.End();
 }
 
 void Engine::Render()
 {
-	auto commandAllocator = m_resourceManager.GetCurrentFrameContext()->m_cmdListAlloc;
-	ThrowIfFailed(commandAllocator->Reset());
-
-	ThrowIfFailed(m_commandList->Reset(commandAllocator.Get(), m_PSO.Get()));
-
-	m_commandList->RSSetViewports(1, &m_viewport);
-	m_commandList->RSSetScissorRects(1, &m_scissorRect);
-
-	// Change current front buffer to be the render target/back buffer
-	auto resourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
-		m_swapChainRenderTargets[m_frameIndex].Get(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-	m_commandList->ResourceBarrier(1, &resourceBarrier);
-
-
-	// Clear the back buffer and depth buffer.
-	auto renderTargetView = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-		m_rtvHeap->GetCPUDescriptorHandleForHeapStart(),
-		m_frameIndex,
-		m_rtvDescriptorSize);
-	m_commandList->ClearRenderTargetView(renderTargetView,
-		DirectX::Colors::LightSteelBlue, 0, nullptr);
-
-	auto depthStencilView = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-		m_dsvHeap->GetCPUDescriptorHandleForHeapStart(),
-		0,
-		m_dsvDescriptorSize);
-	m_commandList->ClearDepthStencilView(depthStencilView, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
-
-	// Specify the buffers we are going to render to.
-	m_commandList->OMSetRenderTargets(1, &renderTargetView, true, &depthStencilView);
-
-	// Draw box
-	ID3D12DescriptorHeap* descriptorHeaps[] = { m_cbvHeap.Get() };
-	m_commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-
-	m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+	auto frameContextIndex = static_cast<UINT>(m_frameRenderer->GetResourceManager().GetCurrentFrameIndex());
+	auto commandListCount = m_frameRenderer->BeginRecording();
+
+	// The frame's GPU time spans from the start of the first command list to the end of the last one.
+	auto firstCommandList = static_cast<D3D12CommandList&>(m_frameRenderer->GetCommandList(0)).GetCommandList();
+	firstCommandList->EndQuery(m_timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, frameContextIndex * 2);
+
+	FrameTargets targets;
+	targets.RenderTargetView = ToRHI(m_rtvDescriptors.GetCpuHandle(m_backBufferRtvs.Index + m_frameIndex));
+	targets.DepthStencilView = ToRHI(m_depthStencilView.Cpu);
+	targets.View = { m_viewport.TopLeftX, m_viewport.TopLeftY, m_viewport.Width, m_viewport.Height, m_viewport.MinDepth, m_viewport.MaxDepth };
+	targets.Scissor = { m_scissorRect.left, m_scissorRect.top, m_scissorRect.right, m_scissorRect.bottom };
+	for (int i = 0; i < 4; i++) {
+		targets.ClearColor[i] = DirectX::Colors::LightSteelBlue.f[i];
+	}
 
-	auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_cbvHeap->GetGPUDescriptorHandleForHeapStart());
-	int passCBIndex = m_resourceManager.GetCurrentFrameIndex();
-	cbvHandle.Offset(passCBIndex, m_cbvDescriptorSize);
-	m_commandList->SetGraphicsRootDescriptorTable(1, m_cbvHeap->GetGPUDescriptorHandleForHeapStart());
+	// The depth pre-pass pipelines are only used if it is enabled in the settings.
+	FrameBindings pipelines;
+	pipelines.PipelineState = reinterpret_cast<PipelineStateHandle>(m_PSO.Get());
+	pipelines.RootSignature = reinterpret_cast<RootSignatureHandle>(m_rootSignature.Get());
+	pipelines.CbvHeap = reinterpret_cast<DescriptorHeapHandle>(m_cbvSrvUavDescriptors.GetHeap());
+	pipelines.DepthPrepassPipelineState = reinterpret_cast<PipelineStateHandle>(m_depthPrepassPSO.Get());
+	pipelines.DepthEqualPipelineState = reinterpret_cast<PipelineStateHandle>(m_depthEqualPSO.Get());
+	pipelines.InstancedPipelineState = reinterpret_cast<PipelineStateHandle>(m_instancedPSO.Get());
+
+	// The command recording itself is platform neutral so that it can also be
+	// run and profiled against the recording backend. The render graph moves
+	// the back buffer between present and render target state.
+	m_frameRenderer->Record(targets, pipelines, ToRHI(m_swapChainRenderTargets[m_frameIndex].Get()), ToRHI(m_dsBuffer.Get()));
+
+	auto lastCommandList = static_cast<D3D12CommandList&>(m_frameRenderer->GetCommandList(commandListCount - 1)).GetCommandList();
+	lastCommandList->EndQuery(m_timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, frameContextIndex * 2 + 1);
+	lastCommandList->ResolveQueryData(m_timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, frameContextIndex * 2, 2,
+		m_timestampReadback.Get(), frameContextIndex * 2 * sizeof(UINT64));
+	m_timestampsPending[frameContextIndex] = true;
+
+	// Done recording commands, submits all chunks at once in the order of the draws.
+	m_frameRenderer->Submit();
 
-	auto meshes = m_resourceManager.GetAllMeshes();
-	for (auto meshPair : meshes) {
-		auto mesh = meshPair.second;
+	// swap the back and front buffers
+	ThrowIfFailed(m_swapChain->Present(0, 0));
 
-		auto vertexBufferView = mesh.VertexBufferView();
-		auto indexBufferView = mesh.IndexBufferView();
+	m_cbvSrvUavDescriptors.Submit(m_frameRenderer->EndFrame());
+	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
 
-		m_commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
-		m_commandList->IASetIndexBuffer(&indexBufferView);
-		m_commandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	ReportFrameStats();
+}
 
-		cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_cbvHeap->GetGPUDescriptorHandleForHeapStart());
-		cbvHandle.Offset(mesh.cbPerObjectIndex + m_resourceManager.numFrameContexts, m_cbvDescriptorSize);
-		m_commandList->SetGraphicsRootDescriptorTable(0, cbvHandle);
+void Engine::ReportFrameStats()
+{
+	// Core utilization of the last frame, once every few seconds.
+	if (++m_renderedFrames % 300 != 0) {
+		return;
+	}
 
-		m_commandList->DrawIndexedInstanced(
-			mesh.DrawArgs[mesh.Name].IndexCount,
-			1, 0, 0, 0);
+	auto stats = m_jobs.GetFrameStats();
+	auto report = "Jobs: " + std::to_string(stats.JobCount) + " in " + std::to_string(stats.WallMs) +
+		"ms, utilization " + std::to_string(static_cast<int>(stats.GetUtilization() * 100.0)) + "%, busy ms per thread:";
+	for (auto busyMs : stats.BusyMs) {
+		report += " " + std::to_string(busyMs);
 	}
 
-	// Indicate a state transition on the resource usage.
-	resourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
-		m_swapChainRenderTargets[m_frameIndex].Get(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-	m_commandList->ResourceBarrier(1, &resourceBarrier);
+	const auto& pacing = m_frameRenderer->GetFramePacer().GetStats();
+	report += "\nFrames in flight: " + std::to_string(m_framePacing.FrameContextCount) +
+		", CPU stall: last " + std::to_string(pacing.LastStallMs) + "ms, average " +
+		std::to_string(pacing.TotalStallMs / std::max<UINT64>(pacing.FrameCount, 1)) + "ms, stalled in " +
+		std::to_string(pacing.StalledFrameCount) + " of " + std::to_string(pacing.FrameCount) + " frames\n";
+
+	auto submit = m_frameRenderer->GetSubmitStats();
+	report += "State changes: " + std::to_string(submit.GetIssued()) + " issued, " + std::to_string(submit.GetFiltered()) +
+		" filtered for " + std::to_string(submit.Draws) + " draws (vertex buffers " + std::to_string(submit.VertexBuffer.Issued) + "/" +
+		std::to_string(submit.VertexBuffer.Filtered) + ", index buffers " + std::to_string(submit.IndexBuffer.Issued) + "/" +
+		std::to_string(submit.IndexBuffer.Filtered) + ", object indices " + std::to_string(submit.ObjectIndex.Issued) + "/" +
+		std::to_string(submit.ObjectIndex.Filtered) + ")\n";
+
+	const auto& depthSettings = m_frameRenderer->GetSettings().Depth;
+	report += "Depth: pre-pass " + std::string(depthSettings.DepthPrepass ? "on" : "off") + ", " +
+		std::to_string(depthSettings.DepthBucketCount) + " buckets, " + std::to_string(submit.DepthPrepassDraws) +
+		" pre-pass draws, GPU frame time last " + std::to_string(m_lastGpuFrameMs) + "ms, average " +
+		std::to_string(m_totalGpuFrameMs / std::max<UINT64>(m_gpuFrameCount, 1)) + "ms\n";
+
+	auto& resourceManager = m_frameRenderer->GetResourceManager();
+	auto uploads = resourceManager.GetUploadStats();
+	report += "Staging: " + std::to_string(uploads.Ring.BytesInFlight) + " bytes in flight (peak " +
+		std::to_string(uploads.Ring.PeakBytesInFlight) + "), " + std::to_string(uploads.Ring.TotalBytesAllocated) + " bytes in " +
+		std::to_string(uploads.CopyCount) + " copies and " + std::to_string(uploads.FlushCount) + " submissions\n";
+
+	auto transforms = resourceManager.GetTransformUploadStats();
+	report += "Object transforms: " + std::to_string(transforms.LastFrameCount) + " written last frame (" +
+		std::to_string(transforms.LastFrameBytes) + " bytes), " + std::to_string(transforms.TotalBytes) + " bytes in total\n";
+
+	auto updates = resourceManager.GetUpdateStats();
+	report += "Mesh updates: " + std::to_string(updates.UpdateCount) + ", " + std::to_string(updates.UploadedBytes) + " bytes uploaded, " +
+		std::to_string(updates.UnchangedBytes) + " unchanged, " + std::to_string(updates.ReallocationCount) + " moved, " +
+		std::to_string(updates.CopyOnWriteCount) + " copied on write\n";
+
+	auto descriptors = m_cbvSrvUavDescriptors.GetStats();
+	report += "Descriptors: " + std::to_string(descriptors.Heap.PersistentUsed) + " of " + std::to_string(descriptors.Heap.PersistentCapacity) +
+		" persistent (" + std::to_string(descriptors.Heap.PendingFreeRanges) + " ranges pending free), " +
+		std::to_string(descriptors.Heap.TransientInFlight) + " of " + std::to_string(descriptors.Heap.TransientCapacity) + " transient, " +
+		std::to_string(descriptors.StagingUsed) + " of " + std::to_string(descriptors.StagingCapacity) + " staging\n";
+	::OutputDebugStringA(report.c_str());
+}
 
-	// Done recording commands.
-	ThrowIfFailed(m_commandList->Close());
+void Engine::BuildTimestampQueries()
+{
+	auto frameContextCount = m_framePacing.FrameContextCount;
+	ThrowIfFailed(m_commandQueue->GetTimestampFrequency(&m_timestampFrequency));
 
-	// Add the command list to the queue for execution.
-	ID3D12CommandList* cmdsLists[] = { m_commandList.Get() };
-	m_commandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = frameContextCount * 2;
+	ThrowIfFailed(m_device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_timestampHeap)));
 
-	// swap the back and front buffers
-	ThrowIfFailed(m_swapChain->Present(0, 0));
+	auto readbackProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+	auto readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(static_cast<UINT64>(frameContextCount) * 2 * sizeof(UINT64));
+	ThrowIfFailed(m_device->CreateCommittedResource(
+		&readbackProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&readbackDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&m_timestampReadback)));
 
-	m_resourceManager.GetCurrentFrameContext()->Fence = ++m_fenceValue;
-	m_commandQueue->Signal(m_fence.Get(), m_fenceValue);
-	m_frameIndex = (m_frameIndex + 1) % m_frameCount;
-	m_resourceManager.CycleFrameContext();
+	m_timestampsPending.assign(frameContextCount, false);
+}
 
-	meshes.clear();
+void Engine::ReadTimestamps(UINT frameContextIndex)
+{
+	if (!m_timestampsPending[frameContextIndex] || m_timestampFrequency == 0) {
+		return;
+	}
+	m_timestampsPending[frameContextIndex] = false;
+
+	D3D12_RANGE readRange = { frameContextIndex * 2 * sizeof(UINT64), (frameContextIndex * 2 + 2) * sizeof(UINT64) };
+	UINT64* timestamps = nullptr;
+	ThrowIfFailed(m_timestampReadback->Map(0, &readRange, reinterpret_cast<void**>(&timestamps)));
+	auto begin = timestamps[frameContextIndex * 2];
+	auto end = timestamps[frameContextIndex * 2 + 1];
+	D3D12_RANGE writtenRange = { 0, 0 };
+	m_timestampReadback->Unmap(0, &writtenRange);
+
+	if (end > begin) {
+		m_lastGpuFrameMs = static_cast<double>(end - begin) * 1000.0 / m_timestampFrequency;
+		m_totalGpuFrameMs += m_lastGpuFrameMs;
+		m_gpuFrameCount++;
+	}
 }
 
 void Engine::Destroy()
 {
+	// Resources must not be released while the GPU still uses them.
+	if (m_frameRenderer != nullptr) {
+		m_frameRenderer->Flush();
+	}
 }
 
 void Engine::InitializeD3D12()
@@ -229,10 +306,8 @@ void Engine::InitializeD3D12()
 #endif
 	BuildDXGIFactory();
 	Build3DDevice();
-	BuildSyncObjects();
 	BuildCommandObjects();
 	BuildDescriptorHeaps();
-	SetDescriptorSizes();
 	BuildSwapChain();
 }
 
@@ -258,13 +333,7 @@ void Engine::Build3DDevice()
 {
 	// Because we pass nullptr the first hardware adapter found by factory::EnumAdapters is used
 	ThrowIfFailed(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_PPV_ARGS(&m_device)));
-}
-
-void Engine::BuildSyncObjects()
-{
-	// Create a fence to help synchronize the CPU and GPU
-	ThrowIfFailed(m_device->CreateFence(
-		0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+	m_rhiDevice = D3D12RenderDevice(m_device.Get());
 }
 
 void Engine::BuildCommandObjects()
@@ -280,69 +349,35 @@ void Engine::BuildCommandObjects()
 	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
 	ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue)));
 
-	ThrowIfFailed(m_device->CreateCommandAllocator(
-		D3D12_COMMAND_LIST_TYPE_DIRECT,
-		IID_PPV_ARGS(m_commandAllocator.GetAddressOf())));
+	D3D12_COMMAND_QUEUE_DESC copyQueueDesc = {};
+	copyQueueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	copyQueueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	ThrowIfFailed(m_device->CreateCommandQueue(&copyQueueDesc, IID_PPV_ARGS(&m_copyQueue)));
 
-	// Notice how we associate a CommandAllocator with the CommandList.
-	ThrowIfFailed(m_device->CreateCommandList(
-		0,
-		D3D12_COMMAND_LIST_TYPE_DIRECT,
-		m_commandAllocator.Get(),
-		nullptr,
-		IID_PPV_ARGS(m_commandList.GetAddressOf())));
+	// The command lists and their allocators are created per frame context by the frame renderer.
+	m_rhiCommandQueue = D3D12CommandQueue(m_commandQueue.Get());
+	m_rhiCopyQueue = D3D12CommandQueue(m_copyQueue.Get());
 }
 
 void Engine::BuildDescriptorHeaps()
 {
-	// Build a heap for storing our 2 render target views
-	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc;
-	rtvHeapDesc.NumDescriptors = m_frameCount;
-	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-	rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	rtvHeapDesc.NodeMask = 0;
-	ThrowIfFailed(m_device->CreateDescriptorHeap(
-		&rtvHeapDesc, IID_PPV_ARGS(m_rtvHeap.GetAddressOf())));
-
-	// Create a heap for storing the depth-stencil view
-	D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
-	dsvHeapDesc.NumDescriptors = 1;
-	dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-	dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	dsvHeapDesc.NodeMask = 0;
-	ThrowIfFailed(m_device->CreateDescriptorHeap(
-		&dsvHeapDesc,
-		IID_PPV_ARGS(m_dsvHeap.GetAddressOf())));
-
-	// Create a heap for storing the constant buffer views
-	// 1 per pass descriptor and 2 descriptors for, one for each box.
-	D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc;
-	cbvHeapDesc.NumDescriptors = (1 + 6) * m_resourceManager.numFrameContexts;
-	cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	cbvHeapDesc.NodeMask = 0;
-	ThrowIfFailed(m_device->CreateDescriptorHeap(
-		&cbvHeapDesc,
-		IID_PPV_ARGS(m_cbvHeap.GetAddressOf())));
-}
-
-void Engine::SetDescriptorSizes()
-{
-	m_rtvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(
-		D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-
-	m_dsvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(
-		D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-
-	m_cbvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(
-		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	// One render target view per back buffer and the depth-stencil view.
+	m_rtvDescriptors = DescriptorAllocator(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV, m_framePacing.BackBufferCount);
+	m_dsvDescriptors = DescriptorAllocator(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1);
+	m_backBufferRtvs = m_rtvDescriptors.AllocatePersistent(m_framePacing.BackBufferCount);
+	m_depthStencilView = m_dsvDescriptors.AllocatePersistent();
+
+	// The shader visible heap for CBV/SRV/UAV tables. Constants are bound as root
+	// CBVs, the heap is for views of textures and buffers: long lived ones in the
+	// persistent region, tables built per frame in the transient ring.
+	m_cbvSrvUavDescriptors = DescriptorAllocator(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 16384, 16384, 4096);
 }
 
 void Engine::BuildSwapChain()
 {
 	// Describe and create the swap chain.
 	DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-	swapChainDesc.BufferCount = m_frameCount;
+	swapChainDesc.BufferCount = m_framePacing.BackBufferCount;
 	swapChainDesc.Width = m_windowManager.GetWidth();
 	swapChainDesc.Height = m_windowManager.GetHeight();
 	swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -366,14 +401,12 @@ void Engine::BuildSwapChain()
 
 	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle{ m_rtvHeap->GetCPUDescriptorHandleForHeapStart() };
-
 	// Create a RTV for each frame in the swapchain.
-	for (UINT n = 0; n < m_frameCount; n++)
+	m_swapChainRenderTargets.resize(m_framePacing.BackBufferCount);
+	for (UINT n = 0; n < m_framePacing.BackBufferCount; n++)
 	{
 		ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_swapChainRenderTargets[n])));
-		m_device->CreateRenderTargetView(m_swapChainRenderTargets[n].Get(), nullptr, rtvHandle);
-		rtvHandle.Offset(1, m_rtvDescriptorSize);
+		m_device->CreateRenderTargetView(m_swapChainRenderTargets[n].Get(), nullptr, m_rtvDescriptors.GetCpuHandle(m_backBufferRtvs.Index + n));
 	}
 
 	// Create the DSV view and resource
@@ -399,13 +432,7 @@ void Engine::BuildSwapChain()
 		IID_PPV_ARGS(&m_dsBuffer)
 	));
 
-	m_device->CreateDepthStencilView(m_dsBuffer.Get(), &depthStencilDesc, m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
-}
-
-void Engine::BuildConstantBuffers()
-{
-	m_resourceManager.AddConstantBuffer("PassConstants", sizeof(MeshConstants), 1, m_cbvHeap.Get(), m_cbvDescriptorSize);
-	m_resourceManager.AddConstantBuffer("MeshConstants", sizeof(MeshConstants), 6, m_cbvHeap.Get(), m_cbvDescriptorSize);
+	m_device->CreateDepthStencilView(m_dsBuffer.Get(), &depthStencilDesc, m_depthStencilView.Cpu);
 }
 
 void Engine::BuildGeometry()
@@ -414,49 +441,63 @@ void Engine::BuildGeometry()
 
 	auto unitBox2World = DirectX::XMMatrixTranspose(DirectX::XMMatrixTranslation(2.0f, 2.0f, 2.0f));
 	Mesh unitBox2 = MeshGenerator().GenerateUnitBox("unitBox2");
-	DirectX::XMStoreFloat4x4(&unitBox2.World, unitBox2World);
+	StoreFloat4x4(unitBox2.World, unitBox2World);
 
 	auto unitBox3World = DirectX::XMMatrixTranspose(DirectX::XMMatrixTranslation(-2.0f, 2.0f, -2.0f));
 	Mesh unitBox3 = MeshGenerator().GenerateUnitBox("unitBox3");
-	DirectX::XMStoreFloat4x4(&unitBox3.World, unitBox3World);
+	StoreFloat4x4(unitBox3.World, unitBox3World);
 
 	Mesh grid = MeshGenerator().GenerateGrid("grid", 20, 25);
 
 	auto sphere1World = DirectX::XMMatrixScaling(4.0f, 4.0f, 4.0f);
 	sphere1World *= DirectX::XMMatrixTranslation(0.0f, 8.0f, 2.0f);
 	Mesh sphere1 = MeshGenerator().GenerateSphere("sphere1");
-	DirectX::XMStoreFloat4x4(&sphere1.World, DirectX::XMMatrixTranspose(sphere1World));
+	StoreFloat4x4(sphere1.World, DirectX::XMMatrixTranspose(sphere1World));
 
 	auto teapot1World = DirectX::XMMatrixScaling(3.0f, 3.0f, 3.0f);
 	teapot1World *= DirectX::XMMatrixTranslation(6.0f, 0.0f, 0.0f);
 	Mesh teapot1 = MeshGenerator().GenerateTeapot("teapot1");
-	DirectX::XMStoreFloat4x4(&teapot1.World, DirectX::XMMatrixTranspose(teapot1World));
-
-	m_resourceManager.AddMesh(unitBox1);
-	m_resourceManager.AddMesh(unitBox2);
-	m_resourceManager.AddMesh(unitBox3);
-	m_resourceManager.AddMesh(sphere1);
-	m_resourceManager.AddMesh(teapot1);
-	m_resourceManager.AddMesh(grid);
-
-	MeshConstants meshConstants;
-	meshConstants.World = unitBox1.World;
-	m_resourceManager.UpdateConstantBuffer<MeshConstants>("MeshConstants", 0, meshConstants);
-
-	meshConstants.World = unitBox2.World;
-	m_resourceManager.UpdateConstantBuffer<MeshConstants>("MeshConstants", 1, meshConstants);
-
-	meshConstants.World = unitBox3.World;
-	m_resourceManager.UpdateConstantBuffer<MeshConstants>("MeshConstants", 2, meshConstants);
-
-	meshConstants.World = sphere1.World;
-	m_resourceManager.UpdateConstantBuffer<MeshConstants>("MeshConstants", 3, meshConstants);
+	StoreFloat4x4(teapot1.World, DirectX::XMMatrixTranspose(teapot1World));
+
+	// The meshes are independent, optimize each of them as a job.
+	Mesh* generatedMeshes[] = { &unitBox1, &unitBox2, &unitBox3, &grid, &sphere1, &teapot1 };
+	MeshOptimizationStats optimizationStats[_countof(generatedMeshes)];
+	m_jobs.ParallelFor("OptimizeMesh", _countof(generatedMeshes), 1, [&](std::size_t begin, std::size_t end) {
+		for (auto i = begin; i < end; i++) {
+			optimizationStats[i] = MeshGenerator::OptimizeMesh(*generatedMeshes[i]);
+		}
+	});
+
+	for (std::size_t i = 0; i < _countof(generatedMeshes); i++) {
+		const auto& stats = optimizationStats[i];
+		auto report = generatedMeshes[i]->Name + " ACMR: " + std::to_string(stats.Before.Acmr) + " -> " + std::to_string(stats.After.Acmr) +
+			" ATVR: " + std::to_string(stats.Before.Atvr) + " -> " + std::to_string(stats.After.Atvr) + "\n";
+		::OutputDebugStringA(report.c_str());
+	}
 
-	meshConstants.World = teapot1.World;
-	m_resourceManager.UpdateConstantBuffer<MeshConstants>("MeshConstants", 4, meshConstants);
+	auto& resourceManager = m_frameRenderer->GetResourceManager();
+	MeshHandle meshes[] = {
+		resourceManager.AddMesh(unitBox1),
+		resourceManager.AddMesh(unitBox2),
+		resourceManager.AddMesh(unitBox3),
+		resourceManager.AddMesh(sphere1),
+		resourceManager.AddMesh(teapot1),
+		resourceManager.AddMesh(grid)
+	};
 
-	meshConstants.World = grid.World;
-	m_resourceManager.UpdateConstantBuffer<MeshConstants>("MeshConstants", 5, meshConstants);
+	// A field of small boxes sharing the unit box geometry, drawn with a single instanced draw.
+	m_boxInstanceMesh = meshes[0];
+	m_boxInstanceGeometry = m_frameRenderer->GetInstances().AddGeometry(resourceManager.GetInstancedGeometry(m_boxInstanceMesh));
+	for (int row = 0; row < 16; row++) {
+		for (int col = 0; col < 16; col++) {
+			auto world = DirectX::XMMatrixScaling(0.15f, 0.15f, 0.15f);
+			world *= DirectX::XMMatrixTranslation(-10.0f + row * 1.25f, -0.85f, -12.0f + col * 1.25f);
+
+			InstanceTransform transform;
+			DirectX::XMStoreFloat4x4(reinterpret_cast<DirectX::XMFLOAT4X4*>(transform.World), DirectX::XMMatrixTranspose(world));
+			m_boxInstances.push_back(transform);
+		}
+	}
 }
 
 void Engine::BuildRootSignatures()
@@ -473,13 +514,19 @@ void Engine::BuildRootSignatures()
 		featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
 	}
 
-	CD3DX12_DESCRIPTOR_RANGE1 ranges[2];
-	CD3DX12_ROOT_PARAMETER1 rootParameters[2];
+	CD3DX12_ROOT_PARAMETER1 rootParameters[RootParameter_Count];
+
+	// The constants and transforms are allocated from the frame's upload memory,
+	// so they are bound by address and need no descriptors. Draws select their
+	// transform in the packed buffer (t1) with a single root constant (b0).
+	rootParameters[RootParameter_ObjectIndex].InitAsConstants(1, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	rootParameters[RootParameter_PassCbv].InitAsConstantBufferView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC, D3D12_SHADER_VISIBILITY_VERTEX);
+	rootParameters[RootParameter_ObjectTransforms].InitAsShaderResourceView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC, D3D12_SHADER_VISIBILITY_VERTEX);
 
-	ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
-	ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
-	rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_VERTEX);
-	rootParameters[1].InitAsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_VERTEX);
+	// Instanced draws read their transforms from a structured buffer (t0) and the
+	// batch's instance offset and position decoding from root constants (b2).
+	rootParameters[RootParameter_InstanceTransforms].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_VERTEX);
+	rootParameters[RootParameter_BatchConstants].InitAsConstants(InstanceBatchConstantCount, 2, 0, D3D12_SHADER_VISIBILITY_VERTEX);
 
 	// Allow input layout and deny uneccessary access to certain pipeline stages.
 	D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
@@ -506,18 +553,40 @@ void Engine::BuildShadersAndInputLayouts()
 	UINT compileFlags = 0;
 #endif
 
-	ThrowIfFailed(D3DCompileFromFile(L"VertexShader.hlsl", nullptr, nullptr, "main", "vs_5_0", compileFlags, 0, &m_vertexShader, nullptr));
+	// The vertex shader decodes the attributes of the compact vertex formats.
+	std::vector<D3D_SHADER_MACRO> defines;
+	for (auto defineName : GetVertexFormatDefines(m_vertexFormat)) {
+		defines.push_back({ defineName, defineName ? "1" : nullptr });
+	}
+
+	ThrowIfFailed(D3DCompileFromFile(L"VertexShader.hlsl", defines.data(), nullptr, "main", "vs_5_0", compileFlags, 0, &m_vertexShader, nullptr));
+
+	// Same shader without the attributes, for the depth pre-pass.
+	auto depthDefines = defines;
+	depthDefines.insert(depthDefines.begin(), D3D_SHADER_MACRO{ "DEPTH_ONLY", "1" });
+	ThrowIfFailed(D3DCompileFromFile(L"VertexShader.hlsl", depthDefines.data(), nullptr, "main", "vs_5_0", compileFlags, 0, &m_depthVertexShader, nullptr));
+
+	// Same shader reading the world matrix from the instance buffer.
+	defines.insert(defines.begin(), D3D_SHADER_MACRO{ "INSTANCED", "1" });
+	ThrowIfFailed(D3DCompileFromFile(L"VertexShader.hlsl", defines.data(), nullptr, "main", "vs_5_0", compileFlags, 0, &m_instancedVertexShader, nullptr));
+
 	ThrowIfFailed(D3DCompileFromFile(L"PixelShader.hlsl", nullptr, nullptr, "main", "ps_5_0", compileFlags, 0, &m_pixelShader, nullptr));
 
 	// Define the vertex input layout.
-	m_inputLayout =
-	{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 28, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 40, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 52, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-	};
+	auto vertexLayout = BuildVertexLayout(m_vertexFormat);
+	m_inputLayout.clear();
+	for (const auto& element : vertexLayout.Elements) {
+		m_inputLayout.push_back({ element.SemanticName, element.SemanticIndex, static_cast<DXGI_FORMAT>(element.Format),
+			element.InputSlot, element.AlignedByteOffset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+
+	// The depth pre-pass reads the position stream only.
+	auto positionLayout = BuildPositionLayout(m_vertexFormat);
+	m_depthInputLayout.clear();
+	for (const auto& element : positionLayout.Elements) {
+		m_depthInputLayout.push_back({ element.SemanticName, element.SemanticIndex, static_cast<DXGI_FORMAT>(element.Format),
+			element.InputSlot, element.AlignedByteOffset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
 }
 
 void Engine::BuildPSO()
@@ -546,26 +615,22 @@ void Engine::BuildPSO()
 	psoDesc.SampleDesc.Count = 1;
 	ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_PSO)));
 
-}
+	// After a depth pre-pass the depth buffer is final, only the fragments on it are shaded.
+	auto depthEqualDesc = psoDesc;
+	depthEqualDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+	depthEqualDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	ThrowIfFailed(m_device->CreateGraphicsPipelineState(&depthEqualDesc, IID_PPV_ARGS(&m_depthEqualPSO)));
 
-void Engine::WaitForPreviousFrame() {
-	// WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
-// This is code implemented as such for simplicity. More advanced samples 
-// illustrate how to use fences for efficient resource usage.
+	// The pre-pass only writes depth: no pixel shader and no render target.
+	auto depthPrepassDesc = psoDesc;
+	depthPrepassDesc.InputLayout = { m_depthInputLayout.data(), (UINT)m_depthInputLayout.size() };
+	depthPrepassDesc.VS = { reinterpret_cast<UINT8*>(m_depthVertexShader->GetBufferPointer()), m_depthVertexShader->GetBufferSize() };
+	depthPrepassDesc.PS = { nullptr, 0 };
+	depthPrepassDesc.NumRenderTargets = 0;
+	depthPrepassDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+	ThrowIfFailed(m_device->CreateGraphicsPipelineState(&depthPrepassDesc, IID_PPV_ARGS(&m_depthPrepassPSO)));
 
-	m_fenceValue++;
-	ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_fenceValue));
+	psoDesc.VS = { reinterpret_cast<UINT8*>(m_instancedVertexShader->GetBufferPointer()), m_instancedVertexShader->GetBufferSize() };
+	ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_instancedPSO)));
 
-	auto completedValue = m_fence->GetCompletedValue();
-	// Wait until the previous frame is finished.
-	if (completedValue < m_fenceValue)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
-
-		ThrowIfFailed(m_fence->SetEventOnCompletion(m_fenceValue, eventHandle));
-		WaitForSingleObject(eventHandle, INFINITE);
-		CloseHandle(eventHandle);
-	}
 }
-
-
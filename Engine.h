@@ -3,7 +3,7 @@
 
 #include "EventManager.h"
 #include "WindowManager.h"
-#include "ResourceManager.h"
+#include "FrameRenderer.h"
 
 #include <wrl.h>
 #include <dxgi1_4.h>
@@ -20,13 +20,20 @@
 #include "ICamera.h"
 #include <memory>
 #include "InputManager.h"
+#include "D3D12Backend.h"
+#include "SceneRenderer.h"
+#include "JobSystem.h"
+#include "FramePacer.h"
+#include "DescriptorAllocator.h"
 
 using Microsoft::WRL::ComPtr;
 
 class Engine
 {
 public:
-	Engine(WindowManager& windowManager, ICamera& camera, InputManager& inputManager);
+	Engine(WindowManager& windowManager, ICamera& camera, InputManager& inputManager,
+		const FramePacingSettings& framePacing = FramePacingSettings(),
+		const DepthSettings& depthSettings = DepthSettings());
 
 	void Initialize();
 	void Update();
@@ -34,14 +41,14 @@ public:
 	void Destroy();
 
 private:
-	static const UINT m_frameCount{ 2 };
+	FramePacingSettings m_framePacing;
+	DepthSettings m_depthSettings;
 	CpuTimer m_cpuTimer;
 	double m_currTime{ 0 };
 
 	WindowManager& m_windowManager;
 	InputManager& m_inputManager;
 
-	ResourceManager m_resourceManager;
 	ICamera& m_camera;
 
 	D3D12_VIEWPORT m_viewport;
@@ -49,47 +56,80 @@ private:
 	UINT m_dxgiFactoryFlags;
 	ComPtr<IDXGIFactory4> m_factory;
 	ComPtr<ID3D12Device> m_device;
-	ComPtr<ID3D12Fence> m_fence;
-	UINT64 m_fenceValue = 0;
 	ComPtr<IDXGISwapChain3> m_swapChain;
 	UINT m_frameIndex;
-	ComPtr<ID3D12Resource> m_swapChainRenderTargets[m_frameCount];
+	std::vector<ComPtr<ID3D12Resource>> m_swapChainRenderTargets;
 	ComPtr<ID3D12Resource> m_dsBuffer;
 	ComPtr<ID3D12CommandQueue> m_commandQueue;
-	ComPtr<ID3D12CommandAllocator> m_commandAllocator;
-	ComPtr<ID3D12GraphicsCommandList> m_commandList;
-	ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
-	ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
-	ComPtr<ID3D12DescriptorHeap> m_cbvHeap;
-	UINT m_rtvDescriptorSize;
-	UINT m_dsvDescriptorSize;
-	UINT m_cbvDescriptorSize;
+	// Geometry uploads run on this queue while the direct queue renders.
+	ComPtr<ID3D12CommandQueue> m_copyQueue;
+	D3D12RenderDevice m_rhiDevice;
+	D3D12CommandQueue m_rhiCommandQueue;
+	D3D12CommandQueue m_rhiCopyQueue;
+	DescriptorAllocator m_rtvDescriptors;
+	DescriptorAllocator m_dsvDescriptors;
+	DescriptorAllocator m_cbvSrvUavDescriptors;
+	DescriptorRange m_backBufferRtvs;
+	DescriptorRange m_depthStencilView;
 
 	ComPtr<ID3DBlob> m_vertexShader;
+	ComPtr<ID3DBlob> m_instancedVertexShader;
+	ComPtr<ID3DBlob> m_depthVertexShader;
 	ComPtr<ID3DBlob> m_pixelShader;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> m_inputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> m_depthInputLayout;
+	// Positions in a stream of their own, so the depth pre-pass fetches only them.
+	std::uint32_t m_vertexFormat = VertexFormatFlags_Compact | VertexFormatFlags_SplitStreams;
 
 	ComPtr<ID3D12RootSignature> m_rootSignature = nullptr;
 	ComPtr<ID3D12PipelineState> m_PSO = nullptr;
-
+	ComPtr<ID3D12PipelineState> m_instancedPSO = nullptr;
+	ComPtr<ID3D12PipelineState> m_depthPrepassPSO = nullptr;
+	ComPtr<ID3D12PipelineState> m_depthEqualPSO = nullptr;
+
+	// Runs the mesh optimization, culling and command recording. Every frame
+	// starts a new measurement of how busy the threads are.
+	JobSystem m_jobs;
+	UINT64 m_renderedFrames = 0;
+	void ReportFrameStats();
+
+	// The platform neutral part of the frame: pacing, resources, culling, sorting
+	// and recording. Draws are recorded on up to 8 threads.
+	std::unique_ptr<FrameRenderer> m_frameRenderer;
+
+	// Small boxes drawn with one instanced draw.
+	MeshHandle m_boxInstanceMesh;
+	std::uint32_t m_boxInstanceGeometry = 0;
+	std::vector<InstanceTransform> m_boxInstances;
+
+	float m_nearZ = 1.0f;
+	float m_farZ = 1000.0f;
+
+	// GPU time of the frames, measured with two timestamps per frame context.
+	// A frame context's timestamps are read once its frame has executed.
+	ComPtr<ID3D12QueryHeap> m_timestampHeap;
+	ComPtr<ID3D12Resource> m_timestampReadback;
+	UINT64 m_timestampFrequency = 0;
+	std::vector<bool> m_timestampsPending;
+	double m_lastGpuFrameMs = 0.0;
+	double m_totalGpuFrameMs = 0.0;
+	UINT64 m_gpuFrameCount = 0;
+	void BuildTimestampQueries();
+	void ReadTimestamps(UINT frameContextIndex);
 
 	// Initialization functions
 	void InitializeD3D12();
 	void EnableDebugLayer();
 	void BuildDXGIFactory();
 	void Build3DDevice();
-	void BuildSyncObjects();
 	void BuildCommandObjects();
 	void BuildDescriptorHeaps();
-	void SetDescriptorSizes();
 	void BuildSwapChain();
 
-	void BuildConstantBuffers();
 	void BuildGeometry();
 	void BuildRootSignatures();
 	void BuildShadersAndInputLayouts();
 	void BuildPSO();
-	void WaitForPreviousFrame();
 };
 
 #endif
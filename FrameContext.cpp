@@ -3,3 +3,10 @@
 FrameContext::FrameContext()
 {
 }
+
+void FrameContext::ReserveCommandLists(IRenderDevice& device, std::uint32_t count)
+{
+	while (m_commandLists.size() < count) {
+		m_commandLists.push_back(device.CreateCommandList(CommandListType::Direct));
+	}
+}
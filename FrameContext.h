@@ -1,21 +1,42 @@
 #ifndef FRAMECONTEXT_H_ 
 #define FRAMECONTEXT_H_
 
-#include "UploadBuffer.h"
-#include <unordered_map>
+#include "RHI.h"
+#include "UploadAllocator.h"
+#include "Mesh.h"
+#include "ObjectTransform.h"
+#include <memory>
+#include <vector>
 
 class FrameContext {
 public: 
 	FrameContext();
 
-	// Each frame requires its own allocator so that it can be reset while another frame is rendering.
-	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_cmdListAlloc = nullptr;
+	// Command lists of the frame, each with memory of its own so that it can be
+	// reset while another frame is rendering and recorded on its own thread.
+	// The first one records the start of the frame. Created closed.
+	void ReserveCommandLists(IRenderDevice& device, std::uint32_t count);
+	std::vector<std::unique_ptr<ICommandList>> m_commandLists;
 
-	// Similarly the CBs might change between frames so each frame requires their own CBs
-	std::unordered_map<std::string, std::unique_ptr<UploadBuffer>> m_constantBuffers;
+	// Similarly constants and other dynamic data change between frames so each
+	// frame allocates them from its own upload memory. Reset when the fence is reached.
+	UploadAllocator m_uploadAllocator;
+
+	// The frame's copy of the object transforms, persistently mapped upload
+	// memory. Kept from frame to frame, only transforms that changed since the
+	// frame context was last used are written.
+	ResourceRef m_objectTransforms;
+	ObjectTransform* m_mappedObjectTransforms = nullptr;
+	std::uint32_t m_objectTransformCapacity = 0;
+
+	// Geometry replaced or deleted while the frame was recorded. Earlier frames
+	// may still draw it, so it is freed when the fence is reached.
+	std::vector<GeometryHandle> m_retiredGeometry;
+	// Geometry buffers compaction replaced while the frame was recorded.
+	std::vector<ResourceRef> m_retiredBuffers;
 
 	// Each frame keeps its own fence value to check if it can execute or needs to wait
-	UINT64 Fence = 0;
+	std::uint64_t Fence = 0;
 };
 
 #endif
@@ -0,0 +1,57 @@
+#include "FramePacer.h"
+#include <chrono>
+
+FramePacer::FramePacer(IRenderDevice& device) :
+	m_fence(device.CreateFence())
+{
+}
+
+std::uint64_t FramePacer::Signal(ICommandQueue& queue)
+{
+	queue.Signal(*m_fence, ++m_lastSignaledValue);
+	return m_lastSignaledValue;
+}
+
+void FramePacer::WaitForFrame(std::uint64_t fenceValue)
+{
+	auto stallMs = Wait(fenceValue);
+
+	m_stats.LastStallMs = stallMs;
+	m_stats.TotalStallMs += stallMs;
+	m_stats.FrameCount++;
+	if (stallMs > 0.0) {
+		m_stats.StalledFrameCount++;
+	}
+}
+
+void FramePacer::Flush(ICommandQueue& queue)
+{
+	Wait(Signal(queue));
+}
+
+bool FramePacer::IsComplete(std::uint64_t fenceValue) const
+{
+	return m_fence->GetCompletedValue() >= fenceValue;
+}
+
+std::uint64_t FramePacer::GetCompletedValue() const
+{
+	return m_fence->GetCompletedValue();
+}
+
+const FramePacingStats& FramePacer::GetStats() const
+{
+	return m_stats;
+}
+
+double FramePacer::Wait(std::uint64_t fenceValue)
+{
+	// A value of 0 is never signaled, the frame context has not been used yet.
+	if (fenceValue == 0 || IsComplete(fenceValue)) {
+		return 0.0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	m_fence->Wait(fenceValue);
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,63 @@
+#ifndef FRAMEPACER_H_
+#define FRAMEPACER_H_
+
+#include "RHI.h"
+#include <cstdint>
+#include <memory>
+
+// Frames buffered between the CPU and the GPU. More frames in flight hide GPU
+// hitches at the cost of latency.
+struct FramePacingSettings
+{
+	// Swap chain buffers, 2 to DXGI_MAX_SWAP_CHAIN_BUFFERS.
+	std::uint32_t BackBufferCount = 2;
+	// Frames the CPU may record ahead of the GPU, each with its own frame context.
+	std::uint32_t FrameContextCount = 3;
+};
+
+struct FramePacingStats
+{
+	// Time the CPU waited for the GPU before recording the last frame.
+	double LastStallMs = 0.0;
+	double TotalStallMs = 0.0;
+	std::uint64_t FrameCount = 0;
+	std::uint64_t StalledFrameCount = 0;
+};
+
+// Owns the fence of a command queue. Frames wait for the fence value their
+// frame context was signaled with, not for the latest signal, so the GPU keeps
+// working on the frames after it.
+class FramePacer
+{
+public:
+	explicit FramePacer(IRenderDevice& device);
+
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+
+	// Signals the next fence value on queue and returns it.
+	std::uint64_t Signal(ICommandQueue& queue);
+
+	// Blocks until the GPU reached fenceValue. Called once per frame with the
+	// fence value of the frame context about to be reused, the time spent is
+	// recorded as that frame's stall.
+	void WaitForFrame(std::uint64_t fenceValue);
+
+	// Blocks until everything submitted to queue has executed.
+	void Flush(ICommandQueue& queue);
+
+	// Blocks until the GPU reached fenceValue and returns the milliseconds waited.
+	double Wait(std::uint64_t fenceValue);
+
+	bool IsComplete(std::uint64_t fenceValue) const;
+	std::uint64_t GetCompletedValue() const;
+
+	const FramePacingStats& GetStats() const;
+
+private:
+	std::unique_ptr<IFence> m_fence;
+	std::uint64_t m_lastSignaledValue = 0;
+	FramePacingStats m_stats;
+};
+
+#endif
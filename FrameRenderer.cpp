@@ -0,0 +1,179 @@
+#include "FrameRenderer.h"
+#include <algorithm>
+
+FrameRenderer::FrameRenderer(IRenderDevice& device, ICommandQueue& directQueue, ICommandQueue& copyQueue, JobSystem& jobs,
+	const FrameRendererSettings& settings) :
+	m_device(device),
+	m_directQueue(directQueue),
+	m_jobs(jobs),
+	m_settings(settings),
+	m_resourceManager(device, copyQueue, directQueue, settings.FrameContextCount),
+	m_framePacer(device)
+{
+	m_settings.FrameContextCount = std::max<std::uint32_t>(m_settings.FrameContextCount, 1);
+	m_settings.MaxRecordingThreads = std::max<std::uint32_t>(m_settings.MaxRecordingThreads, 1);
+	m_settings.Depth.DepthBucketCount = std::max<std::uint32_t>(
+		std::min<std::uint32_t>(m_settings.Depth.DepthBucketCount, 1u << DrawSortKey::DepthBucketBits), 1);
+
+	m_resourceManager.SetVertexFormat(m_settings.VertexFormat);
+}
+
+ResourceManager& FrameRenderer::GetResourceManager()
+{
+	return m_resourceManager;
+}
+
+InstanceBatcher& FrameRenderer::GetInstances()
+{
+	return m_instances;
+}
+
+const FramePacer& FrameRenderer::GetFramePacer() const
+{
+	return m_framePacer;
+}
+
+const FrameRendererSettings& FrameRenderer::GetSettings() const
+{
+	return m_settings;
+}
+
+const SubmitStats& FrameRenderer::GetSubmitStats() const
+{
+	return m_sceneRenderer.GetSubmitStats();
+}
+
+void FrameRenderer::BeginFrame()
+{
+	m_jobs.BeginFrame();
+
+	// The frame context is reused once the GPU has executed the frame that was
+	// last recorded with it. Only that frame is waited for, the frames submitted
+	// after it keep the GPU busy meanwhile.
+	auto frameContext = m_resourceManager.GetCurrentFrameContext();
+	m_framePacer.WaitForFrame(frameContext->Fence);
+	frameContext->m_uploadAllocator.Reset();
+	m_resourceManager.FreeRetiredGeometry();
+
+	// Meshes whose uploads finished on the copy queue are drawn from this frame on.
+	m_resourceManager.UpdateResidency();
+}
+
+void FrameRenderer::Update(const FrameView& view)
+{
+	PassConstants passConstants;
+	passConstants.ViewProj = view.ViewProj;
+	passConstants.DeltaTime = view.DeltaTime;
+	passConstants.TotalTime = view.TotalTime;
+	m_passConstants = m_resourceManager.UploadFrameData(passConstants);
+
+	const auto& drawItems = m_resourceManager.GetDrawItems();
+	if (m_cullerVersion != m_resourceManager.GetDrawItemsVersion()) {
+		m_culler.Resize(static_cast<std::uint32_t>(drawItems.size()));
+		m_jobs.ParallelFor("UpdateBounds", drawItems.size(), 4096, [&](std::size_t begin, std::size_t end) {
+			for (auto i = begin; i < end; i++) {
+				m_culler.SetBounds(static_cast<std::uint32_t>(i), drawItems[i].Bounds);
+			}
+		});
+		m_cullerVersion = m_resourceManager.GetDrawItemsVersion();
+	}
+	m_culler.Cull(ExtractFrustum(&view.ViewProj.m[0][0]), m_visibleDrawItems, m_jobs);
+
+	// All draws use one pass and pipeline for now, the keys order them front to
+	// back in coarse depth ranges and group them by geometry within a range.
+	DrawSortSettings sortSettings;
+	sortSettings.DepthBucketCount = m_settings.Depth.DepthBucketCount;
+	sortSettings.NearZ = view.NearZ;
+	sortSettings.FarZ = view.FarZ;
+	m_drawQueue.Build(drawItems, m_visibleDrawItems, &view.ViewProj.m[0][0], sortSettings, m_jobs);
+	m_drawQueue.Sort(m_jobs);
+}
+
+std::uint32_t FrameRenderer::BeginRecording()
+{
+	// Only split the draws when there are enough of them to pay for the extra threads.
+	m_commandListCount = SceneRenderer::GetRecorderCount(m_drawQueue.GetDrawOrder().size(), m_settings.MaxRecordingThreads);
+
+	auto frameContext = m_resourceManager.GetCurrentFrameContext();
+	frameContext->ReserveCommandLists(m_device, m_commandListCount);
+
+	m_frameRecorders.clear();
+	m_frameCommandLists.clear();
+	for (std::uint32_t i = 0; i < m_commandListCount; i++) {
+		auto commandList = frameContext->m_commandLists[i].get();
+		commandList->Reset();
+		m_frameRecorders.push_back(&commandList->GetRecorder());
+		m_frameCommandLists.push_back(commandList);
+	}
+
+	return m_commandListCount;
+}
+
+ICommandList& FrameRenderer::GetCommandList(std::uint32_t index)
+{
+	return *m_frameCommandLists[index];
+}
+
+std::uint32_t FrameRenderer::GetCommandListCount() const
+{
+	return m_commandListCount;
+}
+
+void FrameRenderer::Record(const FrameTargets& targets, const FrameBindings& pipelines, RHIResource backBuffer, RHIResource depthBuffer)
+{
+	// The copies run ahead of the draws, which read the new placements. The draw
+	// item indices the draw queue refers to stay the same.
+	if (m_resourceManager.GetFragmentedGeometrySize() > m_settings.GeometryCompactionThreshold) {
+		m_resourceManager.CompactGeometry(*m_frameRecorders.front());
+	}
+
+	auto bindings = pipelines;
+	bindings.PassConstants = m_passConstants;
+	bindings.ObjectTransforms = m_resourceManager.UpdateObjectTransforms();
+	bindings.InstanceBuffer = m_resourceManager.UpdateInstanceBuffer(m_instances.GetTransforms());
+	if (!m_settings.Depth.DepthPrepass) {
+		bindings.DepthPrepassPipelineState = 0;
+		bindings.DepthEqualPipelineState = 0;
+	}
+
+	// The scene pass records into all recorders, the barriers after it go to the last one.
+	m_renderGraph.Reset();
+	auto backBufferResource = m_renderGraph.ImportResource("BackBuffer", backBuffer, ResourceState::Present, ResourceState::Present);
+	auto depthBufferResource = m_renderGraph.ImportResource("DepthBuffer", depthBuffer, ResourceState::DepthWrite, ResourceState::DepthWrite);
+	auto scenePass = m_renderGraph.AddPass("Scene", [&](ICommandRecorder&) {
+		m_sceneRenderer.RecordFrameParallel(m_jobs, m_frameRecorders.data(), m_commandListCount, targets, bindings,
+			m_resourceManager.GetDrawItems(), &m_drawQueue.GetDrawOrder(), m_instances);
+	});
+	m_renderGraph.Write(scenePass, backBufferResource, ResourceState::RenderTarget);
+	m_renderGraph.Write(scenePass, depthBufferResource, ResourceState::DepthWrite);
+	m_renderGraph.Compile();
+	m_renderGraph.Execute(*m_frameRecorders.front(), m_frameRecorders.back());
+}
+
+void FrameRenderer::Submit()
+{
+	for (auto commandList : m_frameCommandLists) {
+		commandList->Close();
+	}
+
+	// Start the uploads of meshes added this frame, they are drawn once resident.
+	m_resourceManager.FlushUploads();
+
+	// Submit all chunks at once, in the order of the draws.
+	m_directQueue.ExecuteCommandLists(m_commandListCount, m_frameCommandLists.data());
+}
+
+std::uint64_t FrameRenderer::EndFrame()
+{
+	auto fenceValue = m_framePacer.Signal(m_directQueue);
+	m_resourceManager.GetCurrentFrameContext()->Fence = fenceValue;
+	m_resourceManager.CycleFrameContext();
+	return fenceValue;
+}
+
+void FrameRenderer::Flush()
+{
+	// Resources must not be released while the GPU still uses them.
+	m_framePacer.Flush(m_directQueue);
+	m_resourceManager.WaitForUploads();
+}
@@ -0,0 +1,142 @@
+#ifndef FRAMERENDERER_H_
+#define FRAMERENDERER_H_
+
+#include "RHI.h"
+#include "MathTypes.h"
+#include "MathHelper.h"
+#include "ResourceManager.h"
+#include "FramePacer.h"
+#include "SceneRenderer.h"
+#include "RenderGraph.h"
+#include "InstanceBatcher.h"
+#include "FrustumCulling.h"
+#include "DrawQueue.h"
+#include "JobSystem.h"
+#include "VertexFormat.h"
+#include <cstdint>
+#include <vector>
+
+// How the opaque draws are ordered and shaded. Which is fastest depends on the
+// scene, compare the "Depth:" line of the frame stats.
+struct DepthSettings
+{
+	// Draws all opaque draw items into the depth buffer first and shades them
+	// afterwards with an EQUAL depth test, so every pixel is shaded once.
+	bool DepthPrepass = false;
+	// Front to back view depth ranges the opaque draws are sorted in before they
+	// are grouped by state, see DrawSortKey. 1 sorts by state only.
+	std::uint32_t DepthBucketCount = 16;
+};
+
+struct FrameRendererSettings
+{
+	// Frames the CPU may record ahead of the GPU, see FramePacingSettings.
+	std::uint32_t FrameContextCount = ResourceManager::DefaultFrameContextCount;
+	DepthSettings Depth;
+	// Draws are recorded on up to this many threads, one command list each.
+	std::uint32_t MaxRecordingThreads = 1;
+	// Deleted meshes leave holes in the geometry pages, they are compacted once
+	// this many bytes are scattered over holes.
+	std::uint64_t GeometryCompactionThreshold = 16 * 1024 * 1024;
+	// Positions in a stream of their own, so the depth pre-pass fetches only them.
+	std::uint32_t VertexFormat = VertexFormatFlags_Compact | VertexFormatFlags_SplitStreams;
+};
+
+// The camera and time of a frame.
+struct FrameView
+{
+	// Stored transposed, the layout the shaders and culling expect.
+	Float4x4 ViewProj = MathHelper().GetIdentity4x4();
+	float NearZ = 1.0f;
+	float FarZ = 1000.0f;
+	double DeltaTime = 0.0;
+	double TotalTime = 0.0;
+};
+
+// The platform neutral part of Engine::Update and Engine::Render: frame pacing,
+// residency, culling, sorting and the parallel recording of a frame. The
+// platform code owns the window, swap chain and pipeline objects and calls, per
+// frame:
+//
+//     BeginFrame, Update, BeginRecording, Record, Submit, EndFrame
+//
+// Anything it records itself goes into GetCommandList(0) before Record, which
+// starts the frame there, or into the last command list after Record.
+class FrameRenderer
+{
+public:
+	FrameRenderer(IRenderDevice& device, ICommandQueue& directQueue, ICommandQueue& copyQueue, JobSystem& jobs,
+		const FrameRendererSettings& settings = FrameRendererSettings());
+
+	FrameRenderer(const FrameRenderer&) = delete;
+	FrameRenderer& operator=(const FrameRenderer&) = delete;
+
+	ResourceManager& GetResourceManager();
+	// Instances drawn this frame. Fill between Begin and End after Update.
+	InstanceBatcher& GetInstances();
+	const FramePacer& GetFramePacer() const;
+	const FrameRendererSettings& GetSettings() const;
+	// Summed over all command lists of the last recorded frame.
+	const SubmitStats& GetSubmitStats() const;
+
+	// Waits until the GPU is done with the frame context the frame is recorded
+	// in, then frees what that frame left behind and makes the meshes whose
+	// uploads finished resident.
+	void BeginFrame();
+
+	// Uploads the pass constants, culls the draw items against the view and
+	// sorts the visible ones into the order they are recorded in.
+	void Update(const FrameView& view);
+
+	// Resets the frame context's command lists for recording and returns their
+	// number, one per recording thread the frame's draws are worth.
+	std::uint32_t BeginRecording();
+	ICommandList& GetCommandList(std::uint32_t index);
+	std::uint32_t GetCommandListCount() const;
+
+	// Records the frame into the command lists. pipelines holds the pipeline
+	// objects, the buffers of the frame are filled in here. The render graph
+	// moves backBuffer between present and render target state.
+	void Record(const FrameTargets& targets, const FrameBindings& pipelines, RHIResource backBuffer, RHIResource depthBuffer);
+
+	// Closes the command lists, starts the uploads of the meshes added this frame
+	// and executes the command lists in order.
+	void Submit();
+
+	// Signals the direct queue after the frame, moves on to the next frame
+	// context and returns the fence value the frame completes with.
+	std::uint64_t EndFrame();
+
+	// Blocks until the GPU executed all frames and uploads.
+	void Flush();
+
+private:
+	IRenderDevice& m_device;
+	ICommandQueue& m_directQueue;
+	JobSystem& m_jobs;
+	FrameRendererSettings m_settings;
+
+	ResourceManager m_resourceManager;
+	FramePacer m_framePacer;
+	SceneRenderer m_sceneRenderer;
+	// Passes of the frame, places the back buffer and depth buffer barriers.
+	RenderGraph m_renderGraph;
+	InstanceBatcher m_instances;
+
+	// Draw items inside the camera frustum. The bounds are refreshed when the draw items change.
+	FrustumCuller m_culler;
+	std::uint64_t m_cullerVersion = ~0ull;
+	std::vector<std::uint32_t> m_visibleDrawItems;
+
+	// The visible draw items sorted by state and depth, the order they are recorded in.
+	DrawQueue m_drawQueue;
+
+	// Constants of the frame in the current frame context's upload memory.
+	GpuVirtualAddress m_passConstants = 0;
+
+	std::uint32_t m_commandListCount = 0;
+	std::vector<ICommandRecorder*> m_frameRecorders;
+	std::vector<ICommandList*> m_frameCommandLists;
+};
+
+#endif
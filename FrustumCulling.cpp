@@ -0,0 +1,297 @@
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUMCULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUMCULLING_SSE
+#endif
+
+namespace {
+
+std::uint32_t PaddedCount(std::uint32_t count)
+{
+	return (count + FrustumCuller::BatchSize - 1) / FrustumCuller::BatchSize * FrustumCuller::BatchSize;
+}
+
+// Appends base + lane for every set bit of mask without branching on the bits.
+std::uint32_t AppendVisible(std::uint32_t* visible, std::uint32_t visibleCount, std::uint32_t base, int mask)
+{
+	for (std::uint32_t lane = 0; lane < FrustumCuller::BatchSize; lane++) {
+		visible[visibleCount] = base + lane;
+		visibleCount += (mask >> lane) & 1;
+	}
+	return visibleCount;
+}
+
+}
+
+Aabb TransformAabb(const Aabb& box, const float matrix[16])
+{
+	Aabb result;
+	for (int row = 0; row < 3; row++) {
+		const float* m = matrix + row * 4;
+		result.Center[row] = m[0] * box.Center[0] + m[1] * box.Center[1] + m[2] * box.Center[2] + m[3];
+		result.Extents[row] = std::fabs(m[0]) * box.Extents[0] + std::fabs(m[1]) * box.Extents[1] + std::fabs(m[2]) * box.Extents[2];
+	}
+	return result;
+}
+
+Aabb MakeAabb(const float minimum[3], const float maximum[3])
+{
+	Aabb result;
+	for (int i = 0; i < 3; i++) {
+		result.Center[i] = (minimum[i] + maximum[i]) * 0.5f;
+		result.Extents[i] = (maximum[i] - minimum[i]) * 0.5f;
+	}
+	return result;
+}
+
+Aabb ComputeAabb(const float* points, std::size_t count, std::size_t stride)
+{
+	if (count == 0) {
+		return Aabb();
+	}
+
+	float minimum[3] = { points[0], points[1], points[2] };
+	float maximum[3] = { points[0], points[1], points[2] };
+	auto bytes = reinterpret_cast<const std::uint8_t*>(points);
+	for (std::size_t i = 1; i < count; i++) {
+		auto point = reinterpret_cast<const float*>(bytes + i * stride);
+		for (int axis = 0; axis < 3; axis++) {
+			minimum[axis] = std::min(minimum[axis], point[axis]);
+			maximum[axis] = std::max(maximum[axis], point[axis]);
+		}
+	}
+	return MakeAabb(minimum, maximum);
+}
+
+Aabb MergeAabb(const Aabb& a, const Aabb& b)
+{
+	float minimum[3];
+	float maximum[3];
+	for (int i = 0; i < 3; i++) {
+		minimum[i] = std::min(a.Center[i] - a.Extents[i], b.Center[i] - b.Extents[i]);
+		maximum[i] = std::max(a.Center[i] + a.Extents[i], b.Center[i] + b.Extents[i]);
+	}
+	return MakeAabb(minimum, maximum);
+}
+
+Frustum ExtractFrustum(const float viewProj[16])
+{
+	// Gribb and Hartmann: with clip = M * v the planes are sums of the rows of M.
+	const float* x = viewProj;
+	const float* y = viewProj + 4;
+	const float* z = viewProj + 8;
+	const float* w = viewProj + 12;
+
+	Frustum frustum;
+	for (int i = 0; i < 4; i++) {
+		frustum.Planes[0][i] = w[i] + x[i];
+		frustum.Planes[1][i] = w[i] - x[i];
+		frustum.Planes[2][i] = w[i] + y[i];
+		frustum.Planes[3][i] = w[i] - y[i];
+		frustum.Planes[4][i] = z[i];
+		frustum.Planes[5][i] = w[i] - z[i];
+	}
+	return frustum;
+}
+
+void FrustumCuller::Resize(std::uint32_t count)
+{
+	// Padding boxes are never reported, their values do not matter.
+	m_count = count;
+	auto paddedCount = PaddedCount(count);
+	for (auto array : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ }) {
+		array->resize(paddedCount, 0.0f);
+	}
+}
+
+void FrustumCuller::SetBounds(const Aabb* bounds, std::uint32_t count)
+{
+	Resize(count);
+	for (std::uint32_t i = 0; i < count; i++) {
+		SetBounds(i, bounds[i]);
+	}
+}
+
+void FrustumCuller::SetBounds(std::uint32_t index, const Aabb& bounds)
+{
+	m_centerX[index] = bounds.Center[0];
+	m_centerY[index] = bounds.Center[1];
+	m_centerZ[index] = bounds.Center[2];
+	m_extentX[index] = bounds.Extents[0];
+	m_extentY[index] = bounds.Extents[1];
+	m_extentZ[index] = bounds.Extents[2];
+}
+
+std::uint32_t FrustumCuller::GetCount() const
+{
+	return m_count;
+}
+
+std::uint32_t FrustumCuller::Cull(const Frustum& frustum, std::vector<std::uint32_t>& visible) const
+{
+	visible.resize(PaddedCount(m_count));
+	auto visibleCount = CullRange(frustum, 0, PaddedCount(m_count), visible.data());
+	visible.resize(visibleCount);
+	return visibleCount;
+}
+
+std::uint32_t FrustumCuller::Cull(const Frustum& frustum, std::vector<std::uint32_t>& visible, JobSystem& jobs, std::uint32_t boxesPerJob) const
+{
+	auto paddedCount = PaddedCount(m_count);
+	boxesPerJob = PaddedCount(std::max<std::uint32_t>(boxesPerJob, 1));
+	visible.resize(paddedCount);
+
+	// Every range writes its visible boxes to the start of its own part of
+	// visible, the parts are moved together afterwards.
+	std::vector<std::uint32_t> rangeCounts((paddedCount + boxesPerJob - 1) / boxesPerJob);
+	jobs.ParallelFor("Cull", paddedCount, boxesPerJob, [&](std::size_t begin, std::size_t end) {
+		rangeCounts[begin / boxesPerJob] = CullRange(frustum, static_cast<std::uint32_t>(begin),
+			static_cast<std::uint32_t>(end), visible.data() + begin);
+	});
+
+	std::uint32_t visibleCount = 0;
+	for (std::size_t range = 0; range < rangeCounts.size(); range++) {
+		auto source = visible.begin() + range * boxesPerJob;
+		std::copy(source, source + rangeCounts[range], visible.begin() + visibleCount);
+		visibleCount += rangeCounts[range];
+	}
+	visible.resize(visibleCount);
+	return visibleCount;
+}
+
+std::uint32_t FrustumCuller::CullRange(const Frustum& frustum, std::uint32_t begin, std::uint32_t end, std::uint32_t* visible) const
+{
+#if defined(FRUSTUMCULLING_AVX) || defined(FRUSTUMCULLING_SSE)
+	std::uint32_t visibleCount = 0;
+
+	// A box is outside a plane when its center is further behind it than the
+	// projection of its extents onto the plane normal.
+#if defined(FRUSTUMCULLING_AVX)
+	__m256 normalX[6], normalY[6], normalZ[6], absNormalX[6], absNormalY[6], absNormalZ[6], distance[6];
+	const auto signMask = _mm256_set1_ps(-0.0f);
+	for (int p = 0; p < 6; p++) {
+		normalX[p] = _mm256_set1_ps(frustum.Planes[p][0]);
+		normalY[p] = _mm256_set1_ps(frustum.Planes[p][1]);
+		normalZ[p] = _mm256_set1_ps(frustum.Planes[p][2]);
+		distance[p] = _mm256_set1_ps(frustum.Planes[p][3]);
+		absNormalX[p] = _mm256_andnot_ps(signMask, normalX[p]);
+		absNormalY[p] = _mm256_andnot_ps(signMask, normalY[p]);
+		absNormalZ[p] = _mm256_andnot_ps(signMask, normalZ[p]);
+	}
+
+	for (std::uint32_t base = begin; base < end; base += BatchSize) {
+		auto centerX = _mm256_loadu_ps(&m_centerX[base]);
+		auto centerY = _mm256_loadu_ps(&m_centerY[base]);
+		auto centerZ = _mm256_loadu_ps(&m_centerZ[base]);
+		auto extentX = _mm256_loadu_ps(&m_extentX[base]);
+		auto extentY = _mm256_loadu_ps(&m_extentY[base]);
+		auto extentZ = _mm256_loadu_ps(&m_extentZ[base]);
+
+		auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			auto d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(centerX, normalX[p]), _mm256_mul_ps(centerY, normalY[p])),
+				_mm256_mul_ps(centerZ, normalZ[p])), distance[p]);
+			auto r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(extentX, absNormalX[p]), _mm256_mul_ps(extentY, absNormalY[p])),
+				_mm256_mul_ps(extentZ, absNormalZ[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		visibleCount = AppendVisible(visible, visibleCount, base, _mm256_movemask_ps(inside));
+	}
+#else
+	__m128 normalX[6], normalY[6], normalZ[6], absNormalX[6], absNormalY[6], absNormalZ[6], distance[6];
+	const auto signMask = _mm_set1_ps(-0.0f);
+	for (int p = 0; p < 6; p++) {
+		normalX[p] = _mm_set1_ps(frustum.Planes[p][0]);
+		normalY[p] = _mm_set1_ps(frustum.Planes[p][1]);
+		normalZ[p] = _mm_set1_ps(frustum.Planes[p][2]);
+		distance[p] = _mm_set1_ps(frustum.Planes[p][3]);
+		absNormalX[p] = _mm_andnot_ps(signMask, normalX[p]);
+		absNormalY[p] = _mm_andnot_ps(signMask, normalY[p]);
+		absNormalZ[p] = _mm_andnot_ps(signMask, normalZ[p]);
+	}
+
+	for (std::uint32_t base = begin; base < end; base += BatchSize) {
+		int mask = 0;
+		for (std::uint32_t half = 0; half < BatchSize; half += 4) {
+			auto centerX = _mm_loadu_ps(&m_centerX[base + half]);
+			auto centerY = _mm_loadu_ps(&m_centerY[base + half]);
+			auto centerZ = _mm_loadu_ps(&m_centerZ[base + half]);
+			auto extentX = _mm_loadu_ps(&m_extentX[base + half]);
+			auto extentY = _mm_loadu_ps(&m_extentY[base + half]);
+			auto extentZ = _mm_loadu_ps(&m_extentZ[base + half]);
+
+			auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++) {
+				auto d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, normalX[p]), _mm_mul_ps(centerY, normalY[p])),
+					_mm_mul_ps(centerZ, normalZ[p])), distance[p]);
+				auto r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, absNormalX[p]), _mm_mul_ps(extentY, absNormalY[p])),
+					_mm_mul_ps(extentZ, absNormalZ[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+			}
+			mask |= _mm_movemask_ps(inside) << half;
+		}
+
+		visibleCount = AppendVisible(visible, visibleCount, base, mask);
+	}
+#endif
+
+	// Drop the padding boxes of the last batch.
+	while (visibleCount > 0 && visible[visibleCount - 1] >= m_count) {
+		visibleCount--;
+	}
+	return visibleCount;
+#else
+	std::uint32_t visibleCount = 0;
+	for (auto i = begin; i < end && i < m_count; i++) {
+		if (IsVisible(frustum, i)) {
+			visible[visibleCount++] = i;
+		}
+	}
+	return visibleCount;
+#endif
+}
+
+bool FrustumCuller::IsVisible(const Frustum& frustum, std::uint32_t index) const
+{
+	for (int p = 0; p < 6; p++) {
+		const float* plane = frustum.Planes[p];
+		float d = m_centerX[index] * plane[0] + m_centerY[index] * plane[1] + m_centerZ[index] * plane[2] + plane[3];
+		float r = m_extentX[index] * std::fabs(plane[0]) + m_extentY[index] * std::fabs(plane[1]) + m_extentZ[index] * std::fabs(plane[2]);
+		if (d + r < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::uint32_t FrustumCuller::CullScalar(const Frustum& frustum, std::vector<std::uint32_t>& visible) const
+{
+	visible.clear();
+
+	for (std::uint32_t i = 0; i < m_count; i++) {
+		if (IsVisible(frustum, i)) {
+			visible.push_back(i);
+		}
+	}
+
+	return static_cast<std::uint32_t>(visible.size());
+}
+
+const char* FrustumCuller::GetInstructionSet()
+{
+#if defined(FRUSTUMCULLING_AVX)
+	return "AVX";
+#elif defined(FRUSTUMCULLING_SSE)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
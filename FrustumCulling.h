@@ -0,0 +1,79 @@
+#ifndef FRUSTUMCULLING_H_
+#define FRUSTUMCULLING_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class JobSystem;
+
+// Axis aligned bounding box.
+struct Aabb
+{
+	float Center[3] = { 0.0f, 0.0f, 0.0f };
+	float Extents[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+// Matrices are row-major and transform column vectors, the layout of the
+// transposed matrices in Mesh::World and PassConstants::ViewProj.
+
+// Bounding box of box transformed by matrix.
+Aabb TransformAabb(const Aabb& box, const float matrix[16]);
+
+// Box spanning minimum to maximum.
+Aabb MakeAabb(const float minimum[3], const float maximum[3]);
+// Bounding box of count points, stride bytes apart. Empty at the origin for no points.
+Aabb ComputeAabb(const float* points, std::size_t count, std::size_t stride);
+// Bounding box of both boxes.
+Aabb MergeAabb(const Aabb& a, const Aabb& b);
+
+// Planes a*x + b*y + c*z + d >= 0 for points inside, in the order left, right,
+// bottom, top, near, far. Uses the D3D clip space depth range of 0 to w.
+struct Frustum
+{
+	float Planes[6][4] = {};
+};
+
+Frustum ExtractFrustum(const float viewProj[16]);
+
+// Tests boxes against a frustum. The boxes are kept as a structure of arrays,
+// padded to a multiple of 8, and tested 8 at a time with AVX, or as two halves
+// of 4 with SSE when AVX is not enabled at compile time.
+class FrustumCuller
+{
+public:
+	static const std::uint32_t BatchSize = 8;
+
+	void Resize(std::uint32_t count);
+	void SetBounds(const Aabb* bounds, std::uint32_t count);
+	void SetBounds(std::uint32_t index, const Aabb& bounds);
+	std::uint32_t GetCount() const;
+
+	// Writes the indices of the boxes intersecting the frustum to visible in
+	// ascending order and returns their number.
+	std::uint32_t Cull(const Frustum& frustum, std::vector<std::uint32_t>& visible) const;
+
+	// Same result, with ranges of boxesPerJob boxes culled as jobs.
+	std::uint32_t Cull(const Frustum& frustum, std::vector<std::uint32_t>& visible, JobSystem& jobs, std::uint32_t boxesPerJob = 16384) const;
+
+	// One box at a time, for comparison with Cull.
+	std::uint32_t CullScalar(const Frustum& frustum, std::vector<std::uint32_t>& visible) const;
+
+	// "AVX", "SSE" or "scalar".
+	static const char* GetInstructionSet();
+
+private:
+	// Culls the boxes [begin, end), begin a multiple of BatchSize, into visible.
+	std::uint32_t CullRange(const Frustum& frustum, std::uint32_t begin, std::uint32_t end, std::uint32_t* visible) const;
+	bool IsVisible(const Frustum& frustum, std::uint32_t index) const;
+
+	std::uint32_t m_count = 0;
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+};
+
+#endif
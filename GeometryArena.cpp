@@ -0,0 +1,346 @@
+#include "GeometryArena.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+std::uint32_t GetIndexSize(IndexFormat indexFormat)
+{
+	return indexFormat == IndexFormat::Uint16 ? 2 : 4;
+}
+
+}
+
+GeometryArena::GeometryArena(IRenderDevice& device, std::uint64_t vertexPageSize, std::uint64_t indexPageSize) :
+	m_device(&device),
+	m_vertexPageSize(vertexPageSize),
+	m_indexPageSize(indexPageSize)
+{
+}
+
+GeometryHandle GeometryArena::Allocate(std::uint32_t vertexStride, std::uint32_t positionStride, std::uint32_t vertexCount, IndexFormat indexFormat,
+	std::uint32_t indexCount, std::uint32_t vertexCapacity, std::uint32_t indexCapacity)
+{
+	Allocation allocation;
+	allocation.VertexSize = static_cast<std::uint64_t>(vertexStride) * vertexCount;
+	allocation.IndexSize = static_cast<std::uint64_t>(GetIndexSize(indexFormat)) * indexCount;
+	allocation.VertexCapacity = static_cast<std::uint64_t>(vertexStride) * std::max<std::uint32_t>(vertexCount, vertexCapacity);
+	allocation.IndexCapacity = static_cast<std::uint64_t>(GetIndexSize(indexFormat)) * std::max<std::uint32_t>(indexCount, indexCapacity);
+	allocation.VertexPage = AllocateInPage(false, vertexStride, positionStride, allocation.VertexCapacity, allocation.VertexOffset);
+	allocation.IndexPage = AllocateInPage(true, GetIndexSize(indexFormat), 0, allocation.IndexCapacity, allocation.IndexOffset);
+	allocation.IsAllocated = true;
+
+	GeometryHandle handle;
+	if (m_freeAllocationHead != GeometryHandle::InvalidIndex) {
+		handle.Index = m_freeAllocationHead;
+		m_freeAllocationHead = m_allocations[handle.Index].NextFree;
+		m_allocations[handle.Index] = allocation;
+	}
+	else {
+		handle.Index = static_cast<std::uint32_t>(m_allocations.size());
+		m_allocations.push_back(allocation);
+	}
+
+	return handle;
+}
+
+void GeometryArena::Free(GeometryHandle handle)
+{
+	if (!handle.IsValid() || handle.Index >= m_allocations.size() || !m_allocations[handle.Index].IsAllocated) {
+		return;
+	}
+
+	auto& allocation = m_allocations[handle.Index];
+	m_pages[allocation.VertexPage].Allocator.Free(allocation.VertexOffset);
+	m_pages[allocation.IndexPage].Allocator.Free(allocation.IndexOffset);
+
+	allocation.IsAllocated = false;
+	allocation.NextFree = m_freeAllocationHead;
+	m_freeAllocationHead = handle.Index;
+}
+
+bool GeometryArena::Resize(GeometryHandle handle, std::uint32_t vertexCount, std::uint32_t indexCount)
+{
+	auto& allocation = m_allocations[handle.Index];
+	auto vertexSize = static_cast<std::uint64_t>(m_pages[allocation.VertexPage].ElementSize) * vertexCount;
+	auto indexSize = static_cast<std::uint64_t>(m_pages[allocation.IndexPage].ElementSize) * indexCount;
+	if (vertexSize > allocation.VertexCapacity || indexSize > allocation.IndexCapacity) {
+		return false;
+	}
+
+	allocation.VertexSize = vertexSize;
+	allocation.IndexSize = indexSize;
+	return true;
+}
+
+std::uint32_t GeometryArena::GetVertexCapacity(GeometryHandle handle) const
+{
+	const auto& allocation = m_allocations[handle.Index];
+	return static_cast<std::uint32_t>(allocation.VertexCapacity / m_pages[allocation.VertexPage].ElementSize);
+}
+
+std::uint32_t GeometryArena::GetIndexCapacity(GeometryHandle handle) const
+{
+	const auto& allocation = m_allocations[handle.Index];
+	return static_cast<std::uint32_t>(allocation.IndexCapacity / m_pages[allocation.IndexPage].ElementSize);
+}
+
+void GeometryArena::Upload(StagingUploader& uploader, GeometryHandle handle, const void* vertices, const void* indices)
+{
+	const auto& allocation = m_allocations[handle.Index];
+	UploadVertices(uploader, handle, 0, vertices, allocation.VertexSize);
+	UploadIndices(uploader, handle, 0, indices, allocation.IndexSize);
+}
+
+void GeometryArena::UploadVertices(StagingUploader& uploader, GeometryHandle handle, std::uint64_t byteOffset, const void* data, std::uint64_t byteSize)
+{
+	const auto& allocation = m_allocations[handle.Index];
+	const auto& page = m_pages[allocation.VertexPage];
+	if (page.PositionStride == 0) {
+		uploader.Upload(page.Buffer, allocation.VertexOffset + byteOffset, data, byteSize, page.State);
+		return;
+	}
+
+	// Split the copy at the end of the positions, each stream goes to its region.
+	auto firstVertex = allocation.VertexOffset / page.ElementSize;
+	auto positionSize = allocation.VertexSize / page.ElementSize * page.PositionStride;
+	auto bytes = static_cast<const std::uint8_t*>(data);
+	if (byteOffset < positionSize) {
+		auto size = std::min<std::uint64_t>(byteSize, positionSize - byteOffset);
+		uploader.Upload(page.Buffer, firstVertex * page.PositionStride + byteOffset, bytes, size, page.State);
+		byteOffset += size;
+		bytes += size;
+		byteSize -= size;
+	}
+	if (byteSize > 0) {
+		auto attributeStride = page.ElementSize - page.PositionStride;
+		uploader.Upload(page.Buffer, page.GetAttributeOffset() + firstVertex * attributeStride + byteOffset - positionSize,
+			bytes, byteSize, page.State);
+	}
+}
+
+void GeometryArena::UploadIndices(StagingUploader& uploader, GeometryHandle handle, std::uint64_t byteOffset, const void* data, std::uint64_t byteSize)
+{
+	const auto& allocation = m_allocations[handle.Index];
+	const auto& page = m_pages[allocation.IndexPage];
+	uploader.Upload(page.Buffer, allocation.IndexOffset + byteOffset, data, byteSize, page.State);
+}
+
+VertexBufferBinding GeometryArena::GetVertexBufferView(GeometryHandle handle) const
+{
+	const auto& page = m_pages[m_allocations[handle.Index].VertexPage];
+
+	VertexBufferBinding vbv;
+	vbv.BufferLocation = page.Address;
+	if (page.PositionStride == 0) {
+		vbv.StrideInBytes = page.ElementSize;
+		vbv.SizeInBytes = static_cast<std::uint32_t>(page.Allocator.GetSize());
+	}
+	else {
+		vbv.StrideInBytes = page.PositionStride;
+		vbv.SizeInBytes = static_cast<std::uint32_t>(page.GetAttributeOffset());
+	}
+
+	return vbv;
+}
+
+VertexBufferBinding GeometryArena::GetAttributeBufferView(GeometryHandle handle) const
+{
+	const auto& page = m_pages[m_allocations[handle.Index].VertexPage];
+
+	VertexBufferBinding vbv;
+	if (page.PositionStride != 0) {
+		auto attributeStride = page.ElementSize - page.PositionStride;
+		vbv.BufferLocation = page.Address + page.GetAttributeOffset();
+		vbv.StrideInBytes = attributeStride;
+		vbv.SizeInBytes = static_cast<std::uint32_t>(page.Allocator.GetSize() / page.ElementSize * attributeStride);
+	}
+
+	return vbv;
+}
+
+IndexBufferBinding GeometryArena::GetIndexBufferView(GeometryHandle handle) const
+{
+	const auto& page = m_pages[m_allocations[handle.Index].IndexPage];
+
+	IndexBufferBinding ibv;
+	ibv.BufferLocation = page.Address;
+	ibv.Format = page.ElementSize == 2 ? IndexFormat::Uint16 : IndexFormat::Uint32;
+	ibv.SizeInBytes = static_cast<std::uint32_t>(page.Allocator.GetSize());
+
+	return ibv;
+}
+
+SubmeshGeometry GeometryArena::GetPlacement(GeometryHandle handle) const
+{
+	const auto& allocation = m_allocations[handle.Index];
+
+	SubmeshGeometry placement;
+	placement.IndexCount = static_cast<std::uint32_t>(allocation.IndexSize / m_pages[allocation.IndexPage].ElementSize);
+	placement.StartIndexLocation = static_cast<std::uint32_t>(allocation.IndexOffset / m_pages[allocation.IndexPage].ElementSize);
+	placement.BaseVertexLocation = static_cast<std::int32_t>(allocation.VertexOffset / m_pages[allocation.VertexPage].ElementSize);
+
+	return placement;
+}
+
+std::uint32_t GeometryArena::Compact(ICommandRecorder& recorder)
+{
+	// The pages move to new buffers, with the transitions of all pages in one
+	// call before the copies and one after them.
+	struct PageCompaction
+	{
+		std::uint32_t PageIndex;
+		std::vector<RangeAllocator::Move> Moves;
+		ResourceRef Buffer;
+	};
+	std::vector<PageCompaction> compactions;
+
+	m_stateTracker.Reset();
+	for (std::uint32_t pageIndex = 0; pageIndex < m_pages.size(); pageIndex++) {
+		auto& page = m_pages[pageIndex];
+		if (page.Allocator.IsCompact()) {
+			continue;
+		}
+
+		PageCompaction compaction;
+		compaction.PageIndex = pageIndex;
+		compaction.Moves = page.Allocator.Compact();
+		compaction.Buffer = CreateBuffer(page.Allocator.GetSize());
+
+		m_stateTracker.SetInitialState(page.Buffer.Get(), page.State);
+		m_stateTracker.Transition(page.Buffer.Get(), ResourceState::CopySource);
+		m_stateTracker.SetInitialState(compaction.Buffer.Get(), ResourceState::Common);
+		m_stateTracker.Transition(compaction.Buffer.Get(), ResourceState::CopyDest);
+		compactions.push_back(std::move(compaction));
+	}
+	if (compactions.empty()) {
+		return 0;
+	}
+
+	m_stateTracker.FlushBarriers(recorder);
+
+	for (auto& compaction : compactions) {
+		auto pageIndex = compaction.PageIndex;
+		auto& page = m_pages[pageIndex];
+		auto& buffer = compaction.Buffer;
+
+		std::unordered_map<std::uint64_t, std::uint64_t> newOffsets;
+		for (const auto& move : compaction.Moves) {
+			if (page.PositionStride == 0) {
+				recorder.CopyBufferRegion(buffer.Get(), move.DestOffset, page.Buffer.Get(), move.SourceOffset, move.Size);
+			}
+			else {
+				// Moves are in whole vertices, copy them in both regions.
+				auto attributeStride = page.ElementSize - page.PositionStride;
+				auto sourceVertex = move.SourceOffset / page.ElementSize;
+				auto destVertex = move.DestOffset / page.ElementSize;
+				auto vertexCount = move.Size / page.ElementSize;
+				recorder.CopyBufferRegion(buffer.Get(), destVertex * page.PositionStride,
+					page.Buffer.Get(), sourceVertex * page.PositionStride, vertexCount * page.PositionStride);
+				recorder.CopyBufferRegion(buffer.Get(), page.GetAttributeOffset() + destVertex * attributeStride,
+					page.Buffer.Get(), page.GetAttributeOffset() + sourceVertex * attributeStride, vertexCount * attributeStride);
+			}
+			newOffsets[move.SourceOffset] = move.DestOffset;
+		}
+
+		for (auto& allocation : m_allocations) {
+			if (!allocation.IsAllocated) {
+				continue;
+			}
+			if (allocation.VertexPage == pageIndex) {
+				allocation.VertexOffset = newOffsets[allocation.VertexOffset];
+			}
+			if (allocation.IndexPage == pageIndex) {
+				allocation.IndexOffset = newOffsets[allocation.IndexOffset];
+			}
+		}
+
+		m_stateTracker.Transition(buffer.Get(), ResourceState::Common);
+		m_retiredBuffers.push_back(std::move(page.Buffer));
+		page.Buffer = std::move(buffer);
+		page.Address = m_device->GetGpuVirtualAddress(page.Buffer.Get());
+		page.State = ResourceState::Common;
+	}
+	m_stateTracker.FlushBarriers(recorder);
+
+	return static_cast<std::uint32_t>(compactions.size());
+}
+
+void GeometryArena::TakeRetiredBuffers(std::vector<ResourceRef>& buffers)
+{
+	for (auto& buffer : m_retiredBuffers) {
+		buffers.push_back(std::move(buffer));
+	}
+	m_retiredBuffers.clear();
+}
+
+std::uint32_t GeometryArena::GetPageCount() const
+{
+	return static_cast<std::uint32_t>(m_pages.size());
+}
+
+std::uint64_t GeometryArena::GetUsedSize() const
+{
+	std::uint64_t used = 0;
+	for (const auto& page : m_pages) {
+		used += page.Allocator.GetUsedSize();
+	}
+	return used;
+}
+
+std::uint64_t GeometryArena::GetFragmentedSize() const
+{
+	std::uint64_t fragmented = 0;
+	for (const auto& page : m_pages) {
+		fragmented += page.Allocator.GetSize() - page.Allocator.GetUsedSize() - page.Allocator.GetLargestFreeRange();
+	}
+	return fragmented;
+}
+
+std::uint64_t GeometryArena::GetCapacity() const
+{
+	std::uint64_t capacity = 0;
+	for (const auto& page : m_pages) {
+		capacity += page.Allocator.GetSize();
+	}
+	return capacity;
+}
+
+std::uint32_t GeometryArena::AllocateInPage(bool isIndexPage, std::uint32_t elementSize, std::uint32_t positionStride, std::uint64_t size, std::uint64_t& offset)
+{
+	// Empty ranges still get a place so every allocation has a valid page.
+	size = std::max<std::uint64_t>(size, elementSize);
+
+	for (std::uint32_t i = 0; i < m_pages.size(); i++) {
+		auto& page = m_pages[i];
+		if (page.IsIndexPage != isIndexPage || page.ElementSize != elementSize || page.PositionStride != positionStride) {
+			continue;
+		}
+
+		offset = page.Allocator.Allocate(size, elementSize);
+		if (offset != RangeAllocator::InvalidOffset) {
+			return i;
+		}
+	}
+
+	// Meshes larger than the default page size get a page of their own.
+	auto pageSize = std::max<std::uint64_t>(isIndexPage ? m_indexPageSize : m_vertexPageSize, size);
+
+	Page page;
+	page.Buffer = CreateBuffer(pageSize);
+	page.Address = m_device->GetGpuVirtualAddress(page.Buffer.Get());
+	page.Allocator.Reset(pageSize);
+	page.ElementSize = elementSize;
+	page.PositionStride = positionStride;
+	page.IsIndexPage = isIndexPage;
+	offset = page.Allocator.Allocate(size, elementSize);
+	m_pages.push_back(std::move(page));
+
+	return static_cast<std::uint32_t>(m_pages.size() - 1);
+}
+
+ResourceRef GeometryArena::CreateBuffer(std::uint64_t size)
+{
+	return ResourceRef(m_device, m_device->CreateBuffer(size, HeapType::Default, ResourceState::Common));
+}
@@ -0,0 +1,122 @@
+#ifndef GEOMETRYARENA_H_
+#define GEOMETRYARENA_H_
+
+#include "RangeAllocator.h"
+#include "Mesh.h"
+#include "StagingUploader.h"
+#include "ResourceStateTracker.h"
+#include "RHI.h"
+#include <cstdint>
+#include <vector>
+
+// Packs the geometry of many meshes into a few large default heap buffers.
+// Vertices with the same stride and indices with the same format share pages, so
+// meshes in one page are drawn with a single vertex and index buffer binding.
+// A mesh that does not fit into an existing page gets a new page.
+// Vertices with split streams (see VertexFormat.h) are kept in pages with two
+// regions: the positions of all vertices of the page first, then their other
+// attributes. A vertex has the same index in both, so one base vertex works for
+// both streams.
+class GeometryArena
+{
+public:
+	GeometryArena() {};
+	GeometryArena(IRenderDevice& device, std::uint64_t vertexPageSize = 32 * 1024 * 1024, std::uint64_t indexPageSize = 8 * 1024 * 1024);
+
+	// Reserves room for vertexCapacity vertices and indexCapacity indices, at least
+	// the counts, so the geometry can grow in place with Resize. vertexStride is
+	// the size of a vertex over all streams, positionStride the size of its
+	// position stream or 0 for interleaved vertices.
+	GeometryHandle Allocate(std::uint32_t vertexStride, std::uint32_t positionStride, std::uint32_t vertexCount, IndexFormat indexFormat,
+		std::uint32_t indexCount, std::uint32_t vertexCapacity = 0, std::uint32_t indexCapacity = 0);
+	void Free(GeometryHandle handle);
+
+	// Changes the vertex and index count in place. Returns false if they exceed
+	// the capacity, the geometry then needs a new allocation.
+	bool Resize(GeometryHandle handle, std::uint32_t vertexCount, std::uint32_t indexCount);
+	std::uint32_t GetVertexCapacity(GeometryHandle handle) const;
+	std::uint32_t GetIndexCapacity(GeometryHandle handle) const;
+
+	// Queues the copy of the mesh data into its place. The pages rest in the
+	// COMMON state between command lists, buffers are promoted implicitly when drawn.
+	void Upload(StagingUploader& uploader, GeometryHandle handle, const void* vertices, const void* indices);
+
+	// Queue copies into part of the geometry. byteOffset is relative to the start
+	// of the geometry's vertices or indices. Vertices with split streams are
+	// addressed as packed by EncodeVertices, for the current vertex count.
+	void UploadVertices(StagingUploader& uploader, GeometryHandle handle, std::uint64_t byteOffset, const void* data, std::uint64_t byteSize);
+	void UploadIndices(StagingUploader& uploader, GeometryHandle handle, std::uint64_t byteOffset, const void* data, std::uint64_t byteSize);
+
+	// Bindings of the whole page the geometry lives in. The vertex buffer binding
+	// is stream 0, all attributes or only the positions. The attribute binding is
+	// stream 1 and empty for interleaved vertices.
+	VertexBufferBinding GetVertexBufferView(GeometryHandle handle) const;
+	VertexBufferBinding GetAttributeBufferView(GeometryHandle handle) const;
+	IndexBufferBinding GetIndexBufferView(GeometryHandle handle) const;
+
+	// Start index and base vertex of the geometry inside its pages. Add these to
+	// the mesh's own submeshes when drawing.
+	SubmeshGeometry GetPlacement(GeometryHandle handle) const;
+
+	// Moves all geometry to the front of its pages by copying every page with
+	// holes into a fresh buffer. Placements change, so draw data must be rebuilt.
+	// The old buffers are kept until TakeRetiredBuffers hands them to the caller,
+	// who releases them once the GPU has finished the command list. Returns the
+	// number of pages that were compacted.
+	std::uint32_t Compact(ICommandRecorder& recorder);
+	void TakeRetiredBuffers(std::vector<ResourceRef>& buffers);
+
+	std::uint32_t GetPageCount() const;
+	std::uint64_t GetUsedSize() const;
+	// Free space outside the largest free range of each page, which Compact merges into it.
+	std::uint64_t GetFragmentedSize() const;
+	std::uint64_t GetCapacity() const;
+
+private:
+	struct Page
+	{
+		ResourceRef Buffer;
+		GpuVirtualAddress Address = 0;
+		RangeAllocator Allocator;
+		ResourceState State = ResourceState::Common;
+
+		// Vertex stride or index size of everything in the page.
+		std::uint32_t ElementSize = 0;
+		// Size of the positions of pages with split streams, 0 for interleaved vertices.
+		std::uint32_t PositionStride = 0;
+		bool IsIndexPage = false;
+
+		// Start of the attribute region of pages with split streams.
+		std::uint64_t GetAttributeOffset() const { return Allocator.GetSize() / ElementSize * PositionStride; }
+	};
+
+	struct Allocation
+	{
+		std::uint32_t VertexPage = 0;
+		std::uint64_t VertexOffset = 0;
+		std::uint64_t VertexSize = 0;
+		std::uint64_t VertexCapacity = 0;
+		std::uint32_t IndexPage = 0;
+		std::uint64_t IndexOffset = 0;
+		std::uint64_t IndexSize = 0;
+		std::uint64_t IndexCapacity = 0;
+		std::uint32_t NextFree = GeometryHandle::InvalidIndex;
+		bool IsAllocated = false;
+	};
+
+	std::uint32_t AllocateInPage(bool isIndexPage, std::uint32_t elementSize, std::uint32_t positionStride, std::uint64_t size, std::uint64_t& offset);
+	ResourceRef CreateBuffer(std::uint64_t size);
+
+	IRenderDevice* m_device = nullptr;
+	std::uint64_t m_vertexPageSize = 0;
+	std::uint64_t m_indexPageSize = 0;
+
+	std::vector<Page> m_pages;
+	std::vector<Allocation> m_allocations;
+	std::uint32_t m_freeAllocationHead = GeometryHandle::InvalidIndex;
+
+	std::vector<ResourceRef> m_retiredBuffers;
+	ResourceStateTracker m_stateTracker;
+};
+
+#endif
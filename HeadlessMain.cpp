@@ -0,0 +1,1346 @@
+// Headless entry point. Drives the platform neutral core through the recording
+// backend so the CPU cost of a frame can be profiled without a window or GPU.
+//
+// Usage: dx12_headless [meshCount] [frameCount] [threadCount]
+//        dx12_headless optimize [gridSize]
+//        dx12_headless instancing [instanceCount] [frameCount]
+//        dx12_headless cull [boxCount] [iterations] [threadCount]
+//        dx12_headless binding [meshCount] [frameCount]
+//        dx12_headless sort [meshCount] [geometryCount] [iterations] [threadCount]
+//        dx12_headless depth [meshCount] [geometryCount]
+//        dx12_headless graph [frameCount]
+//        dx12_headless states [commandListCount] [passesPerList] [threadCount]
+//        dx12_headless engine [meshCount] [frameCount] [threadCount]
+
+#include "RecordingBackend.h"
+#include "SceneRenderer.h"
+#include "MeshRegistry.h"
+#include "MeshOptimizer.h"
+#include "RangeAllocator.h"
+#include "InstanceBatcher.h"
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+#include "DrawQueue.h"
+#include "ObjectTransform.h"
+#include "VertexFormat.h"
+#include "RenderGraph.h"
+#include "ResourceStateTracker.h"
+#include "FrameRenderer.h"
+#include "MeshGenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Stand-in for the CPU side mesh data the registry keeps next to the draw data.
+struct SyntheticMesh
+{
+	std::uint64_t VertexOffset = 0;
+	std::uint64_t IndexOffset = 0;
+};
+
+// Every mesh is a box placed in one shared vertex and index buffer, the same
+// way GeometryArena packs meshes in the application.
+void BuildSyntheticScene(RecordingDevice& device, MeshRegistry<SyntheticMesh>& meshes, int meshCount)
+{
+	const std::uint32_t vertexStride = 24;
+	const std::uint32_t vertexCount = 8;
+	const std::uint32_t indexCount = 36;
+
+	RangeAllocator vertexAllocator(static_cast<std::uint64_t>(meshCount) * vertexCount * vertexStride);
+	RangeAllocator indexAllocator(static_cast<std::uint64_t>(meshCount) * indexCount * 2);
+	auto vertexBuffer = device.CreateResource();
+	auto indexBuffer = device.CreateResource();
+
+	meshes.Reserve(meshCount);
+
+	for (int i = 0; i < meshCount; i++) {
+		SyntheticMesh mesh;
+		mesh.VertexOffset = vertexAllocator.Allocate(vertexCount * vertexStride, vertexStride);
+		mesh.IndexOffset = indexAllocator.Allocate(indexCount * 2, 2);
+
+		DrawItem drawItem;
+		drawItem.VertexBuffer = { vertexBuffer << 32, static_cast<std::uint32_t>(vertexAllocator.GetSize()), vertexStride };
+		drawItem.IndexBuffer = { indexBuffer << 32, static_cast<std::uint32_t>(indexAllocator.GetSize()), IndexFormat::Uint16 };
+		drawItem.IndexCount = indexCount;
+		drawItem.StartIndexLocation = static_cast<std::uint32_t>(mesh.IndexOffset / 2);
+		drawItem.BaseVertexLocation = static_cast<std::int32_t>(mesh.VertexOffset / vertexStride);
+		drawItem.ObjectIndex = static_cast<std::uint32_t>(i);
+
+		meshes.Add(mesh, drawItem);
+	}
+}
+
+void PrintVertexCacheStats(const char* label, const std::vector<std::uint32_t>& indices, std::size_t vertexCount)
+{
+	auto stats = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+	std::printf("%-14s ACMR: %.3f  ATVR: %.3f\n", label, stats.Acmr, stats.Atvr);
+}
+
+// Runs the mesh optimizer on a grid in the same row-major order MeshGenerator::GenerateGrid emits.
+int RunMeshOptimizer(int gridSize)
+{
+	std::vector<float> positions;
+	for (int row = 0; row <= gridSize; row++) {
+		for (int col = 0; col <= gridSize; col++) {
+			positions.push_back(static_cast<float>(row));
+			positions.push_back(0.0f);
+			positions.push_back(static_cast<float>(col));
+		}
+	}
+
+	std::vector<std::uint32_t> indices;
+	for (int row = 0; row < gridSize; row++) {
+		for (int col = 0; col < gridSize; col++) {
+			std::uint32_t tile = row * (gridSize + 1) + col;
+			std::uint32_t above = tile + gridSize + 1;
+			indices.insert(indices.end(), { tile, above + 1, above, tile, tile + 1, above + 1 });
+		}
+	}
+
+	auto vertexCount = positions.size() / 3;
+	std::printf("grid: %dx%d, triangles: %zu, vertices: %zu\n", gridSize, gridSize, indices.size() / 3, vertexCount);
+	PrintVertexCacheStats("input", indices, vertexCount);
+
+	OptimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount);
+	PrintVertexCacheStats("vertex cache", indices, vertexCount);
+
+	OptimizeOverdraw(indices.data(), indices.data(), indices.size(), positions.data(), sizeof(float) * 3, vertexCount);
+	PrintVertexCacheStats("overdraw", indices, vertexCount);
+
+	std::vector<std::uint32_t> remap;
+	OptimizeVertexFetch(indices.data(), indices.size(), vertexCount, remap);
+	PrintVertexCacheStats("vertex fetch", indices, vertexCount);
+
+	return 0;
+}
+
+FrameTargets MakeFrameTargets(RecordingDevice& device)
+{
+	FrameTargets targets;
+	targets.BackBuffer = device.CreateResource();
+	targets.RenderTargetView = { 1 };
+	targets.DepthStencilView = { 2 };
+	targets.View = { 0.0f, 0.0f, 900.0f, 600.0f, 0.0f, 1.0f };
+	targets.Scissor = { 0, 0, 900, 600 };
+	return targets;
+}
+
+// Records frameCount frames and returns the average CPU time of one frame in milliseconds.
+double RecordFrames(SceneRenderer& sceneRenderer, RecordingCommandList& commandList, const FrameTargets& targets,
+	const FrameBindings& bindings, const std::vector<DrawItem>& drawItems, const InstanceBatcher& instances, int frameCount)
+{
+	double totalSeconds = 0.0;
+	for (int frame = 0; frame < frameCount; frame++) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		commandList.Reset();
+		sceneRenderer.RecordFrame(commandList, targets, bindings, drawItems, instances);
+
+		auto end = std::chrono::high_resolution_clock::now();
+		totalSeconds += std::chrono::duration<double>(end - start).count();
+	}
+	return frameCount > 0 ? totalSeconds * 1000.0 / frameCount : 0.0;
+}
+
+// Draws the same boxes once with a draw per box and once as instances of a single geometry.
+int RunInstancing(int instanceCount, int frameCount)
+{
+	RecordingDevice device;
+	RecordingCommandList commandList;
+	SceneRenderer sceneRenderer;
+
+	MeshRegistry<SyntheticMesh> meshes;
+	BuildSyntheticScene(device, meshes, instanceCount);
+
+	auto targets = MakeFrameTargets(device);
+	FrameBindings bindings;
+	bindings.PipelineState = 1;
+	bindings.InstancedPipelineState = 2;
+	bindings.RootSignature = 1;
+	bindings.CbvHeap = 1;
+	bindings.PassConstants = device.CreateResource() << 32;
+	bindings.ObjectTransforms = device.CreateResource() << 32;
+	bindings.InstanceBuffer = device.CreateResource() << 32;
+
+	InstanceBatcher noInstances;
+	auto perDrawMs = RecordFrames(sceneRenderer, commandList, targets, bindings, meshes.GetDrawItems(), noInstances, frameCount);
+	auto perDrawCommands = commandList.GetStream().Commands.size();
+
+	InstanceBatcher instances;
+	const auto& box = meshes.GetDrawItems().front();
+	InstancedGeometry geometry;
+	geometry.VertexBuffer = box.VertexBuffer;
+	geometry.IndexBuffer = box.IndexBuffer;
+	geometry.IndexCount = box.IndexCount;
+	geometry.StartIndexLocation = box.StartIndexLocation;
+	geometry.BaseVertexLocation = box.BaseVertexLocation;
+	auto boxGeometry = instances.AddGeometry(geometry);
+
+	instances.Begin();
+	for (int i = 0; i < instanceCount; i++) {
+		InstanceTransform transform;
+		transform.World[3] = static_cast<float>(i);
+		instances.Add(boxGeometry, transform);
+	}
+	instances.End();
+
+	std::vector<DrawItem> noDrawItems;
+	auto instancedMs = RecordFrames(sceneRenderer, commandList, targets, bindings, noDrawItems, instances, frameCount);
+	const auto& stream = commandList.GetStream();
+
+	std::printf("instances: %d, frames: %d\n", instanceCount, frameCount);
+	std::printf("per draw:  %.3f ms per frame, %zu commands\n", perDrawMs, perDrawCommands);
+	std::printf("instanced: %.3f ms per frame, %zu commands (draws: %u), instance data: %zu bytes\n",
+		instancedMs, stream.Commands.size(), stream.GetCount(RecordedCommandType::DrawIndexedInstanced),
+		instances.GetTransforms().size() * sizeof(InstanceTransform));
+
+	return 0;
+}
+
+// Records the draws of the synthetic scene with the per-draw bindings of three
+// root signature layouts: a descriptor table with a CBV per object, a root CBV
+// per object and the object index as a root constant into a structured buffer
+// of transforms, the layout Engine::BuildRootSignatures uses.
+int RunBindingCost(int meshCount, int frameCount)
+{
+	RecordingDevice device;
+	RecordingCommandList commandList;
+
+	MeshRegistry<SyntheticMesh> meshes;
+	BuildSyntheticScene(device, meshes, meshCount);
+	const auto& drawItems = meshes.GetDrawItems();
+
+	auto targets = MakeFrameTargets(device);
+	const DescriptorHeapHandle cbvHeap = 1;
+	const GpuVirtualAddress passConstants = device.CreateResource() << 32;
+	const GpuVirtualAddress objectData = device.CreateResource() << 32;
+	const std::uint32_t descriptorSize = 32;
+	const std::uint32_t constantBufferSize = 256;
+
+	struct Result
+	{
+		const char* Name;
+		double Ms;
+		std::size_t Commands;
+		std::size_t ObjectBytes;
+	};
+
+	auto record = [&](const char* name, std::size_t objectBytes, auto bindObject) {
+		double totalSeconds = 0.0;
+		for (int frame = 0; frame < frameCount; frame++) {
+			auto start = std::chrono::high_resolution_clock::now();
+
+			commandList.Reset();
+			commandList.SetPipelineState(1);
+			commandList.RSSetViewports(1, &targets.View);
+			commandList.RSSetScissorRects(1, &targets.Scissor);
+			commandList.OMSetRenderTargets(1, &targets.RenderTargetView, &targets.DepthStencilView);
+			commandList.SetDescriptorHeaps(1, &cbvHeap);
+			commandList.SetGraphicsRootSignature(1);
+			commandList.SetGraphicsRootConstantBufferView(RootParameter_PassCbv, passConstants);
+			commandList.IASetPrimitiveTopology(PrimitiveTopology::TriangleList);
+
+			// All boxes share one vertex and index buffer.
+			commandList.IASetVertexBuffers(0, 1, &drawItems.front().VertexBuffer);
+			commandList.IASetIndexBuffer(&drawItems.front().IndexBuffer);
+			for (const auto& drawItem : drawItems) {
+				bindObject(drawItem);
+				commandList.DrawIndexedInstanced(drawItem.IndexCount, 1, drawItem.StartIndexLocation, drawItem.BaseVertexLocation, 0);
+			}
+
+			auto end = std::chrono::high_resolution_clock::now();
+			totalSeconds += std::chrono::duration<double>(end - start).count();
+		}
+
+		Result result;
+		result.Name = name;
+		result.Ms = frameCount > 0 ? totalSeconds * 1000.0 / frameCount : 0.0;
+		result.Commands = commandList.GetStream().Commands.size();
+		result.ObjectBytes = objectBytes * drawItems.size();
+		return result;
+	};
+
+	Result results[] = {
+		record("descriptor table", constantBufferSize, [&](const DrawItem& drawItem) {
+			commandList.SetGraphicsRootDescriptorTable(RootParameter_ObjectIndex,
+				GpuDescriptorHandle{ static_cast<std::uint64_t>(drawItem.ObjectIndex) * descriptorSize });
+		}),
+		record("root CBV", constantBufferSize, [&](const DrawItem& drawItem) {
+			commandList.SetGraphicsRootConstantBufferView(RootParameter_ObjectIndex,
+				objectData + static_cast<GpuVirtualAddress>(drawItem.ObjectIndex) * constantBufferSize);
+		}),
+		record("root constant", sizeof(ObjectTransform), [&](const DrawItem& drawItem) {
+			commandList.SetGraphicsRoot32BitConstant(RootParameter_ObjectIndex, drawItem.ObjectIndex, 0);
+		}),
+	};
+
+	std::printf("meshes: %d, frames: %d\n", meshCount, frameCount);
+	for (const auto& result : results) {
+		std::printf("%-16s %.3f ms per frame, %zu commands, %zu bytes of object data read per frame\n",
+			result.Name, result.Ms, result.Commands, result.ObjectBytes);
+	}
+	std::printf("the descriptor table layout also needs %d descriptors in the shader visible heap\n", meshCount);
+
+	return 0;
+}
+
+// Culls randomly placed boxes on one core with the SIMD and the scalar path.
+// Camera at the origin looking down +z with a 60 degree vertical field of
+// view, the transposed result of XMMatrixPerspectiveFovLH.
+void MakeViewProj(float viewProj[16], float nearZ, float farZ)
+{
+	const float yScale = 1.0f / std::tan(3.14159265f / 6.0f);
+	const float xScale = yScale / 1.5f;
+	const float matrix[16] = {
+		xScale, 0.0f, 0.0f, 0.0f,
+		0.0f, yScale, 0.0f, 0.0f,
+		0.0f, 0.0f, farZ / (farZ - nearZ), -nearZ * farZ / (farZ - nearZ),
+		0.0f, 0.0f, 1.0f, 0.0f };
+	std::copy(matrix, matrix + 16, viewProj);
+}
+
+int RunCulling(int boxCount, int iterations, std::uint32_t threadCount)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> extent(0.5f, 2.0f);
+
+	std::vector<Aabb> boxes(boxCount);
+	for (auto& box : boxes) {
+		for (int i = 0; i < 3; i++) {
+			box.Center[i] = position(random);
+			box.Extents[i] = extent(random);
+		}
+	}
+
+	FrustumCuller culler;
+	culler.SetBounds(boxes.data(), static_cast<std::uint32_t>(boxes.size()));
+
+	float viewProj[16];
+	MakeViewProj(viewProj, 0.1f, 1000.0f);
+	auto frustum = ExtractFrustum(viewProj);
+
+	std::vector<std::uint32_t> visible;
+	std::vector<std::uint32_t> visibleScalar;
+
+	auto time = [&](auto cull) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			cull();
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		return iterations > 0 ? std::chrono::duration<double>(end - start).count() * 1000.0 / iterations : 0.0;
+	};
+
+	auto simdMs = time([&]() { culler.Cull(frustum, visible); });
+	auto scalarMs = time([&]() { culler.CullScalar(frustum, visibleScalar); });
+
+	JobSystem jobs(threadCount);
+	std::vector<std::uint32_t> visibleJobs;
+	auto jobsMs = time([&]() { culler.Cull(frustum, visibleJobs, jobs); });
+
+	std::printf("boxes: %d, iterations: %d, visible: %zu\n", boxCount, iterations, visible.size());
+	std::printf("%-6s %.3f ms per cull\n", FrustumCuller::GetInstructionSet(), simdMs);
+	std::printf("%-6s %.3f ms per cull\n", "scalar", scalarMs);
+	std::printf("%-6s %.3f ms per cull on %u threads\n", FrustumCuller::GetInstructionSet(), jobsMs, threadCount);
+	if (visible != visibleScalar || visible != visibleJobs) {
+		std::printf("mismatch: scalar path found %zu visible boxes\n", visibleScalar.size());
+		return 1;
+	}
+
+	return 0;
+}
+
+}
+
+// Sorts the draws of meshes spread over geometryCount vertex and index buffers,
+// in random order, and records them unsorted and sorted to count the state
+// changes the submit loop filters. Every mesh has two submeshes.
+int RunDrawSort(int meshCount, int geometryCount, int iterations, std::uint32_t threadCount)
+{
+	RecordingDevice device;
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<int> geometryIndex(0, std::max(geometryCount, 1) - 1);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> depth(1.0f, 1000.0f);
+
+	std::vector<VertexBufferBinding> vertexBuffers;
+	std::vector<IndexBufferBinding> indexBuffers;
+	for (int i = 0; i < std::max(geometryCount, 1); i++) {
+		vertexBuffers.push_back({ device.CreateResource() << 32, 1 << 24, 24 });
+		indexBuffers.push_back({ device.CreateResource() << 32, 1 << 24, IndexFormat::Uint16 });
+	}
+
+	std::vector<DrawItem> drawItems;
+	for (int i = 0; i < meshCount; i++) {
+		auto geometry = geometryIndex(random);
+
+		DrawItem drawItem;
+		drawItem.VertexBuffer = vertexBuffers[geometry];
+		drawItem.IndexBuffer = indexBuffers[geometry];
+		drawItem.IndexCount = 36;
+		drawItem.ObjectIndex = static_cast<std::uint32_t>(i);
+		drawItem.Bounds.Center[0] = position(random);
+		drawItem.Bounds.Center[1] = position(random);
+		drawItem.Bounds.Center[2] = depth(random);
+		drawItems.push_back(drawItem);
+
+		drawItem.StartIndexLocation = 36;
+		drawItems.push_back(drawItem);
+	}
+
+	std::vector<std::uint32_t> allDrawItems(drawItems.size());
+	for (std::size_t i = 0; i < allDrawItems.size(); i++) {
+		allDrawItems[i] = static_cast<std::uint32_t>(i);
+	}
+
+	DrawSortSettings settings;
+	settings.NearZ = 0.1f;
+	settings.FarZ = 1000.0f;
+	float viewProj[16];
+	MakeViewProj(viewProj, settings.NearZ, settings.FarZ);
+
+	JobSystem jobs(threadCount);
+	DrawQueue queue;
+	std::vector<DrawPacket> reference;
+
+	auto time = [&](auto sort) {
+		double totalSeconds = 0.0;
+		for (int i = 0; i < iterations; i++) {
+			queue.Build(drawItems, allDrawItems, viewProj, settings, jobs);
+			auto start = std::chrono::high_resolution_clock::now();
+			sort();
+			auto end = std::chrono::high_resolution_clock::now();
+			totalSeconds += std::chrono::duration<double>(end - start).count();
+		}
+		return iterations > 0 ? totalSeconds * 1000.0 / iterations : 0.0;
+	};
+
+	auto stdSortMs = time([&]() {
+		reference = queue.GetPackets();
+		std::stable_sort(reference.begin(), reference.end(),
+			[](const DrawPacket& a, const DrawPacket& b) { return a.Key < b.Key; });
+	});
+	auto radixMs = time([&]() { queue.Sort(); });
+	auto parallelMs = time([&]() { queue.Sort(jobs); });
+
+	std::printf("draws: %zu, geometries: %d, iterations: %d\n", drawItems.size(), geometryCount, iterations);
+	std::printf("%-14s %.3f ms per sort\n", "std::sort", stdSortMs);
+	std::printf("%-14s %.3f ms per sort\n", "radix", radixMs);
+	std::printf("%-14s %.3f ms per sort on %u threads\n", "radix", parallelMs, threadCount);
+
+	const auto& packets = queue.GetPackets();
+	for (std::size_t i = 0; i < packets.size(); i++) {
+		if (packets[i].Key != reference[i].Key || packets[i].DrawItem != reference[i].DrawItem) {
+			std::printf("mismatch at packet %zu\n", i);
+			return 1;
+		}
+	}
+
+	RecordingCommandList commandList;
+	SceneRenderer sceneRenderer;
+	auto targets = MakeFrameTargets(device);
+
+	FrameBindings bindings;
+	bindings.PipelineState = 1;
+	bindings.RootSignature = 1;
+	bindings.CbvHeap = 1;
+	bindings.PassConstants = device.CreateResource() << 32;
+	bindings.ObjectTransforms = device.CreateResource() << 32;
+
+	auto record = [&](const char* label, const std::vector<std::uint32_t>& order) {
+		commandList.Reset();
+		sceneRenderer.RecordFrame(commandList, targets, bindings, drawItems, order, InstanceBatcher());
+
+		const auto& stats = sceneRenderer.GetSubmitStats();
+		std::printf("%-8s %llu state changes issued, %llu filtered (vertex buffers %llu/%llu, index buffers %llu/%llu, object indices %llu/%llu)\n",
+			label,
+			static_cast<unsigned long long>(stats.GetIssued()), static_cast<unsigned long long>(stats.GetFiltered()),
+			static_cast<unsigned long long>(stats.VertexBuffer.Issued), static_cast<unsigned long long>(stats.VertexBuffer.Filtered),
+			static_cast<unsigned long long>(stats.IndexBuffer.Issued), static_cast<unsigned long long>(stats.IndexBuffer.Filtered),
+			static_cast<unsigned long long>(stats.ObjectIndex.Issued), static_cast<unsigned long long>(stats.ObjectIndex.Filtered));
+	};
+	record("unsorted", allDrawItems);
+	record("sorted", queue.GetDrawOrder());
+
+	return 0;
+}
+
+// Software stand-in for early-Z: the screen is split into tiles holding the
+// nearest depth drawn so far, and every draw covers the tiles of its projected
+// bounds at the depth of their nearest point. Counts the tiles that would be shaded.
+class TileDepthBuffer
+{
+public:
+	static const int Width = 160;
+	static const int Height = 90;
+
+	void Clear()
+	{
+		m_depth.assign(Width * Height, 1.0f);
+	}
+
+	// Calls func(tileDepth, drawDepth) for every covered tile.
+	template <typename TFunc>
+	void ForEachTile(const Aabb& bounds, const float viewProj[16], TFunc&& func)
+	{
+		float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f, minZ = 1.0f;
+		for (int corner = 0; corner < 8; corner++) {
+			float point[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			for (int i = 0; i < 3; i++) {
+				point[i] = bounds.Center[i] + (corner & (1 << i) ? bounds.Extents[i] : -bounds.Extents[i]);
+			}
+			float clip[4];
+			for (int row = 0; row < 4; row++) {
+				const float* m = viewProj + row * 4;
+				clip[row] = m[0] * point[0] + m[1] * point[1] + m[2] * point[2] + m[3];
+			}
+			if (clip[3] <= 0.0f) {
+				return;
+			}
+			minX = std::min(minX, clip[0] / clip[3]);
+			maxX = std::max(maxX, clip[0] / clip[3]);
+			minY = std::min(minY, clip[1] / clip[3]);
+			maxY = std::max(maxY, clip[1] / clip[3]);
+			minZ = std::min(minZ, clip[2] / clip[3]);
+		}
+
+		auto toTile = [](float ndc, int size) { return std::max(0, std::min(size - 1, static_cast<int>((ndc * 0.5f + 0.5f) * size))); };
+		if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f || minZ > 1.0f) {
+			return;
+		}
+		for (int y = toTile(minY, Height); y <= toTile(maxY, Height); y++) {
+			for (int x = toTile(minX, Width); x <= toTile(maxX, Width); x++) {
+				func(m_depth[y * Width + x], minZ);
+			}
+		}
+	}
+
+	std::uint64_t GetCoveredCount() const
+	{
+		return std::count_if(m_depth.begin(), m_depth.end(), [](float depth) { return depth < 1.0f; });
+	}
+
+private:
+	std::vector<float> m_depth;
+};
+
+// Draws boxes spread over geometryCount vertex and index buffers in the order of
+// several depth bucket counts, with and without a depth pre-pass, and compares
+// the state changes of the submission with the tiles early-Z would shade.
+int RunDepthSorting(int meshCount, int geometryCount)
+{
+	RecordingDevice device;
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<int> geometryIndex(0, std::max(geometryCount, 1) - 1);
+	std::uniform_real_distribution<float> position(-300.0f, 300.0f);
+	std::uniform_real_distribution<float> depth(5.0f, 800.0f);
+	std::uniform_real_distribution<float> extent(2.0f, 30.0f);
+
+	std::vector<VertexBufferBinding> vertexBuffers;
+	std::vector<IndexBufferBinding> indexBuffers;
+	for (int i = 0; i < std::max(geometryCount, 1); i++) {
+		vertexBuffers.push_back({ device.CreateResource() << 32, 1 << 24, 24 });
+		indexBuffers.push_back({ device.CreateResource() << 32, 1 << 24, IndexFormat::Uint16 });
+	}
+
+	std::vector<DrawItem> drawItems(meshCount);
+	std::vector<std::uint32_t> allDrawItems(meshCount);
+	for (int i = 0; i < meshCount; i++) {
+		auto geometry = geometryIndex(random);
+		auto& drawItem = drawItems[i];
+		drawItem.VertexBuffer = vertexBuffers[geometry];
+		drawItem.IndexBuffer = indexBuffers[geometry];
+		drawItem.IndexCount = 36;
+		drawItem.ObjectIndex = static_cast<std::uint32_t>(i);
+		drawItem.Bounds.Center[0] = position(random);
+		drawItem.Bounds.Center[1] = position(random);
+		drawItem.Bounds.Center[2] = depth(random);
+		for (int axis = 0; axis < 3; axis++) {
+			drawItem.Bounds.Extents[axis] = extent(random);
+		}
+		allDrawItems[i] = static_cast<std::uint32_t>(i);
+	}
+
+	DrawSortSettings settings;
+	settings.NearZ = 1.0f;
+	settings.FarZ = 1000.0f;
+	float viewProj[16];
+	MakeViewProj(viewProj, settings.NearZ, settings.FarZ);
+
+	JobSystem jobs(1);
+	DrawQueue queue;
+	RecordingCommandList commandList;
+	SceneRenderer sceneRenderer;
+	TileDepthBuffer tiles;
+	auto targets = MakeFrameTargets(device);
+
+	FrameBindings bindings;
+	bindings.PipelineState = 1;
+	bindings.RootSignature = 1;
+	bindings.CbvHeap = 1;
+	bindings.PassConstants = device.CreateResource() << 32;
+	bindings.ObjectTransforms = device.CreateResource() << 32;
+
+	std::printf("draws: %d, geometries: %d\n", meshCount, geometryCount);
+
+	// The pre-pass fetches a vertex's stride of stream 0, all of it unless positions are split off.
+	auto interleavedLayout = BuildPositionLayout(VertexFormatFlags_Compact);
+	auto splitLayout = BuildPositionLayout(VertexFormatFlags_Compact | VertexFormatFlags_SplitStreams);
+	std::printf("pre-pass vertex fetch: %u bytes interleaved, %u bytes with split streams\n",
+		interleavedLayout.Stride, splitLayout.Stride);
+
+	const std::uint32_t bucketCounts[] = { 1, 4, 16, 64, 256 };
+	for (auto bucketCount : bucketCounts) {
+		settings.DepthBucketCount = bucketCount;
+		queue.Build(drawItems, allDrawItems, viewProj, settings, jobs);
+		queue.Sort();
+		const auto& order = queue.GetDrawOrder();
+
+		// Without a pre-pass a tile is shaded whenever the draw is in front of what was drawn before.
+		std::uint64_t shadedTiles = 0;
+		tiles.Clear();
+		for (auto index : order) {
+			tiles.ForEachTile(drawItems[index].Bounds, viewProj, [&](float& tileDepth, float drawDepth) {
+				if (drawDepth < tileDepth) {
+					tileDepth = drawDepth;
+					shadedTiles++;
+				}
+			});
+		}
+
+		// After a pre-pass only the nearest draw of every tile passes the EQUAL test.
+		auto coveredTiles = tiles.GetCoveredCount();
+
+		for (int prepass = 0; prepass < 2; prepass++) {
+			bindings.DepthPrepassPipelineState = prepass ? 2 : 0;
+			bindings.DepthEqualPipelineState = prepass ? 3 : 0;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			commandList.Reset();
+			sceneRenderer.RecordFrame(commandList, targets, bindings, drawItems, order, InstanceBatcher());
+			auto end = std::chrono::high_resolution_clock::now();
+
+			const auto& stats = sceneRenderer.GetSubmitStats();
+			std::printf("buckets %3u, pre-pass %-3s: %.3f ms, %llu draws, %llu state changes issued, %llu filtered\n",
+				bucketCount, prepass ? "on" : "off", std::chrono::duration<double>(end - start).count() * 1000.0,
+				static_cast<unsigned long long>(stats.Draws),
+				static_cast<unsigned long long>(stats.GetIssued()), static_cast<unsigned long long>(stats.GetFiltered()));
+		}
+		std::printf("    shaded tiles: %llu without pre-pass, %llu with it (%.2fx overdraw saved)\n",
+			static_cast<unsigned long long>(shadedTiles), static_cast<unsigned long long>(coveredTiles),
+			coveredTiles > 0 ? static_cast<double>(shadedTiles) / coveredTiles : 0.0);
+	}
+
+	return 0;
+}
+
+std::string GetStateName(ResourceState state)
+{
+	static const struct { ResourceState State; const char* Name; } names[] = {
+		{ ResourceState::VertexAndConstantBuffer, "VertexAndConstantBuffer" }, { ResourceState::IndexBuffer, "IndexBuffer" },
+		{ ResourceState::RenderTarget, "RenderTarget" }, { ResourceState::UnorderedAccess, "UnorderedAccess" },
+		{ ResourceState::DepthWrite, "DepthWrite" }, { ResourceState::DepthRead, "DepthRead" },
+		{ ResourceState::NonPixelShaderResource, "NonPixelShaderResource" }, { ResourceState::PixelShaderResource, "PixelShaderResource" },
+		{ ResourceState::IndirectArgument, "IndirectArgument" }, { ResourceState::CopyDest, "CopyDest" }, { ResourceState::CopySource, "CopySource" } };
+
+	std::string name;
+	for (const auto& entry : names) {
+		if ((state & entry.State) == entry.State) {
+			name += (name.empty() ? "" : "|") + std::string(entry.Name);
+		}
+	}
+	return name.empty() ? "Common" : name;
+}
+
+// A frame of a deferred renderer: shadows, depth pre-pass, G-buffer, lighting,
+// bloom and a debug overlay nothing reads, which the graph culls. Remembers what
+// it declared so the recorded barriers can be checked against it.
+struct SampleFrameGraph
+{
+	struct Access
+	{
+		std::uint32_t Pass;
+		std::uint32_t Resource;
+		ResourceState State;
+	};
+
+	std::vector<Access> Accesses;
+	std::uint32_t PassCount = 0;
+	// Per resource. Transient resources start and end in their initial state.
+	std::vector<ResourceState> StartStates;
+	std::vector<ResourceState> EndStates;
+	std::vector<std::uint64_t> Sizes;
+
+	void Build(RenderGraph& graph, RHIResource backBuffer, RHIResource depthBuffer)
+	{
+		const std::uint64_t MB = 1024 * 1024;
+		graph.Reset();
+		Accesses.clear();
+		PassCount = 0;
+		StartStates.clear();
+		EndStates.clear();
+		Sizes.clear();
+
+		auto backBufferResource = Import(graph, "BackBuffer", backBuffer, ResourceState::Present, ResourceState::Present);
+		auto depth = Import(graph, "Depth", depthBuffer, ResourceState::DepthWrite, ResourceState::DepthWrite);
+		auto shadowMap = CreateTransient(graph, "ShadowMap", 16 * MB, ResourceState::DepthWrite);
+		auto albedo = CreateTransient(graph, "Albedo", 8 * MB, ResourceState::RenderTarget);
+		auto normals = CreateTransient(graph, "Normals", 8 * MB, ResourceState::RenderTarget);
+		auto lighting = CreateTransient(graph, "Lighting", 16 * MB, ResourceState::RenderTarget);
+		auto bloom = CreateTransient(graph, "Bloom", 4 * MB, ResourceState::UnorderedAccess);
+		auto overlay = CreateTransient(graph, "DebugOverlay", 8 * MB, ResourceState::RenderTarget);
+
+		auto shadows = AddPass(graph, "Shadows");
+		Use(graph, shadows, shadowMap, ResourceState::DepthWrite, true);
+
+		auto depthPrepass = AddPass(graph, "DepthPrepass");
+		Use(graph, depthPrepass, depth, ResourceState::DepthWrite, true);
+
+		auto gbuffer = AddPass(graph, "GBuffer");
+		Use(graph, gbuffer, depth, ResourceState::DepthRead, false);
+		Use(graph, gbuffer, albedo, ResourceState::RenderTarget, true);
+		Use(graph, gbuffer, normals, ResourceState::RenderTarget, true);
+
+		auto lightingPass = AddPass(graph, "Lighting");
+		Use(graph, lightingPass, shadowMap, ResourceState::PixelShaderResource, false);
+		Use(graph, lightingPass, albedo, ResourceState::PixelShaderResource, false);
+		Use(graph, lightingPass, normals, ResourceState::PixelShaderResource, false);
+		Use(graph, lightingPass, lighting, ResourceState::RenderTarget, true);
+
+		auto bloomDownsample = AddPass(graph, "BloomDownsample");
+		Use(graph, bloomDownsample, lighting, ResourceState::NonPixelShaderResource, false);
+		Use(graph, bloomDownsample, bloom, ResourceState::UnorderedAccess, true);
+
+		auto bloomBlur = AddPass(graph, "BloomBlur");
+		Use(graph, bloomBlur, bloom, ResourceState::UnorderedAccess, true);
+
+		auto debugOverlay = AddPass(graph, "DebugOverlay");
+		Use(graph, debugOverlay, depth, ResourceState::PixelShaderResource, false);
+		Use(graph, debugOverlay, overlay, ResourceState::RenderTarget, true);
+
+		auto composite = AddPass(graph, "Composite");
+		Use(graph, composite, lighting, ResourceState::PixelShaderResource, false);
+		Use(graph, composite, bloom, ResourceState::PixelShaderResource, false);
+		Use(graph, composite, backBufferResource, ResourceState::RenderTarget, true);
+	}
+
+	std::uint32_t Import(RenderGraph& graph, const char* name, RHIResource resource, ResourceState initialState, ResourceState finalState)
+	{
+		StartStates.push_back(initialState);
+		EndStates.push_back(finalState);
+		Sizes.push_back(0);
+		return graph.ImportResource(name, resource, initialState, finalState);
+	}
+
+	std::uint32_t CreateTransient(RenderGraph& graph, const char* name, std::uint64_t size, ResourceState initialState)
+	{
+		TransientResourceDesc desc;
+		desc.Size = size;
+		desc.InitialState = initialState;
+		StartStates.push_back(initialState);
+		EndStates.push_back(initialState);
+		Sizes.push_back(size);
+		return graph.CreateTransientResource(name, desc);
+	}
+
+	// Every pass marks where it runs in the stream with its index as pipeline state.
+	std::uint32_t AddPass(RenderGraph& graph, const char* name)
+	{
+		auto pass = PassCount++;
+		graph.AddPass(name, [pass](ICommandRecorder& recorder) {
+			recorder.SetPipelineState(pass + 1);
+		});
+		return pass;
+	}
+
+	void Use(RenderGraph& graph, std::uint32_t pass, std::uint32_t resource, ResourceState state, bool isWrite)
+	{
+		if (isWrite) {
+			graph.Write(pass, resource, state);
+		}
+		else {
+			graph.Read(pass, resource, state);
+		}
+		Accesses.push_back({ pass, resource, state });
+	}
+};
+
+// Replays the barriers of a recorded frame, checking that every pass finds its
+// resources in the states it declared, that split barriers are complete and
+// that transient resources sharing memory are activated by an aliasing barrier.
+// Prints and returns the number of errors.
+int ValidateBarrierStream(const RenderGraph& graph, const SampleFrameGraph& frame, const RecordedCommandStream& stream)
+{
+	auto resourceCount = static_cast<std::uint32_t>(frame.StartStates.size());
+	std::map<RHIResource, std::uint32_t> resources;
+	auto states = frame.StartStates;
+	std::vector<bool> pendingSplits(resourceCount, false);
+	std::vector<bool> active(resourceCount, true);
+	for (std::uint32_t i = 0; i < resourceCount; i++) {
+		resources[graph.GetResource(i)] = i;
+	}
+
+	auto sharesMemory = [&](std::uint32_t a, std::uint32_t b) {
+		auto offsetA = graph.GetTransientOffset(a);
+		auto offsetB = graph.GetTransientOffset(b);
+		return a != b && offsetA != RenderGraph::InvalidOffset && offsetB != RenderGraph::InvalidOffset &&
+			offsetA < offsetB + frame.Sizes[b] && offsetB < offsetA + frame.Sizes[a];
+	};
+	for (std::uint32_t i = 0; i < resourceCount; i++) {
+		for (std::uint32_t other = 0; other < resourceCount; other++) {
+			if (sharesMemory(i, other)) {
+				active[i] = false;
+			}
+		}
+	}
+
+	int errors = 0;
+	auto fail = [&](const std::string& message) {
+		std::printf("    error: %s\n", message.c_str());
+		errors++;
+	};
+
+	for (const auto& command : stream.Commands) {
+		if (command.Type == RecordedCommandType::ResourceBarrier) {
+			for (auto i = command.Range.First; i < command.Range.First + command.Range.Count; i++) {
+				const auto& barrier = stream.Barriers[i];
+				if (barrier.Type == BarrierType::Aliasing) {
+					auto after = resources[barrier.ResourceAfter];
+					for (std::uint32_t other = 0; other < resourceCount; other++) {
+						if (sharesMemory(after, other)) {
+							active[other] = false;
+						}
+					}
+					active[after] = true;
+					continue;
+				}
+
+				auto resource = resources[barrier.Resource];
+				if (!active[resource]) {
+					fail(std::string("barrier on inactive ") + graph.GetResourceName(resource));
+				}
+				if (barrier.Type != BarrierType::Transition) {
+					continue;
+				}
+				if (barrier.StateBefore != states[resource]) {
+					fail(std::string(graph.GetResourceName(resource)) + " is " + GetStateName(states[resource]) +
+						", the barrier expects " + GetStateName(barrier.StateBefore));
+				}
+				if (barrier.Flags == BarrierFlags::BeginOnly) {
+					pendingSplits[resource] = true;
+				}
+				else {
+					if (barrier.Flags == BarrierFlags::EndOnly && !pendingSplits[resource]) {
+						fail(std::string("split barrier of ") + graph.GetResourceName(resource) + " ends without beginning");
+					}
+					pendingSplits[resource] = false;
+					states[resource] = barrier.StateAfter;
+				}
+			}
+		}
+		else if (command.Type == RecordedCommandType::SetPipelineState) {
+			auto pass = static_cast<std::uint32_t>(command.Handle - 1);
+			for (const auto& access : frame.Accesses) {
+				if (access.Pass != pass) {
+					continue;
+				}
+				auto name = std::string(graph.GetPassName(pass)) + " uses " + graph.GetResourceName(access.Resource);
+				if ((states[access.Resource] & access.State) != access.State) {
+					fail(name + " in " + GetStateName(states[access.Resource]) + " instead of " + GetStateName(access.State));
+				}
+				if (pendingSplits[access.Resource]) {
+					fail(name + " during a split barrier");
+				}
+				if (!active[access.Resource]) {
+					fail(name + " without an aliasing barrier");
+				}
+			}
+		}
+	}
+
+	for (std::uint32_t i = 0; i < resourceCount; i++) {
+		if (pendingSplits[i]) {
+			fail(std::string("split barrier of ") + graph.GetResourceName(i) + " never ends");
+		}
+		if (states[i] != frame.EndStates[i]) {
+			fail(std::string(graph.GetResourceName(i)) + " ends in " + GetStateName(states[i]));
+		}
+	}
+	return errors;
+}
+
+void PrintBarrierStream(const RenderGraph& graph, const SampleFrameGraph& frame, const RecordedCommandStream& stream)
+{
+	std::map<RHIResource, std::uint32_t> resources;
+	for (std::uint32_t i = 0; i < frame.StartStates.size(); i++) {
+		resources[graph.GetResource(i)] = i;
+	}
+
+	for (const auto& command : stream.Commands) {
+		if (command.Type == RecordedCommandType::SetPipelineState) {
+			std::printf("  pass %s\n", graph.GetPassName(static_cast<std::uint32_t>(command.Handle - 1)));
+			continue;
+		}
+		if (command.Type != RecordedCommandType::ResourceBarrier) {
+			continue;
+		}
+
+		std::printf("  ResourceBarrier(%u)\n", command.Range.Count);
+		for (auto i = command.Range.First; i < command.Range.First + command.Range.Count; i++) {
+			const auto& barrier = stream.Barriers[i];
+			switch (barrier.Type) {
+			case BarrierType::Transition:
+				std::printf("    transition %s %s -> %s%s\n", graph.GetResourceName(resources[barrier.Resource]),
+					GetStateName(barrier.StateBefore).c_str(), GetStateName(barrier.StateAfter).c_str(),
+					barrier.Flags == BarrierFlags::BeginOnly ? " (begin)" : barrier.Flags == BarrierFlags::EndOnly ? " (end)" : "");
+				break;
+			case BarrierType::Aliasing:
+				std::printf("    aliasing %s -> %s\n", barrier.Resource != 0 ? graph.GetResourceName(resources[barrier.Resource]) : "any",
+					graph.GetResourceName(resources[barrier.ResourceAfter]));
+				break;
+			case BarrierType::UnorderedAccess:
+				std::printf("    uav %s\n", graph.GetResourceName(resources[barrier.Resource]));
+				break;
+			}
+		}
+	}
+}
+
+// Builds, compiles and records the sample frame graph frameCount times, prints
+// the barriers of the first frame and checks the barriers of all of them.
+int RunRenderGraph(int frameCount)
+{
+	RecordingDevice device;
+	RecordingCommandList commandList;
+	RenderGraph graph;
+	SampleFrameGraph frame;
+	auto backBuffer = device.CreateResource();
+	auto depthBuffer = device.CreateResource();
+
+	// Placed resources are cached by heap offset and size, a real backend would
+	// create them in one heap of GetTransientHeapSize bytes.
+	std::map<std::pair<std::uint64_t, std::uint64_t>, RHIResource> placedResources;
+
+	int errors = 0;
+	double totalSeconds = 0.0;
+	for (int frameIndex = 0; frameIndex < std::max(frameCount, 1); frameIndex++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		frame.Build(graph, backBuffer, depthBuffer);
+		graph.Compile();
+		for (std::uint32_t i = 0; i < frame.Sizes.size(); i++) {
+			auto offset = graph.GetTransientOffset(i);
+			if (offset != RenderGraph::InvalidOffset) {
+				auto& placed = placedResources[std::make_pair(offset, frame.Sizes[i])];
+				if (placed == 0) {
+					placed = device.CreateResource();
+				}
+				graph.SetTransientResource(i, placed);
+			}
+		}
+		commandList.Reset();
+		graph.Execute(commandList);
+		totalSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (frameIndex == 0) {
+			PrintBarrierStream(graph, frame, commandList.GetStream());
+		}
+		errors += ValidateBarrierStream(graph, frame, commandList.GetStream());
+	}
+
+	const auto& stats = graph.GetStats();
+	std::printf("passes: %u, culled %u\n", stats.PassCount, stats.CulledPassCount);
+	std::printf("barriers: %u transitions (%u split), %u aliasing, %u uav in %u ResourceBarrier calls\n",
+		stats.TransitionCount, stats.SplitTransitionCount, stats.AliasingBarrierCount, stats.UavBarrierCount, stats.BarrierBatchCount);
+	std::printf("transient memory: %.1f MB heap for %.1f MB of resources\n",
+		stats.TransientHeapSize / (1024.0 * 1024.0), stats.TransientResourceSize / (1024.0 * 1024.0));
+	std::printf("build, compile and record: %.3f us per frame, %d frames, %d errors\n",
+		totalSeconds * 1000000.0 / std::max(frameCount, 1), std::max(frameCount, 1), errors);
+	return errors == 0 ? 0 : 1;
+}
+
+// Records commandListCount command lists in parallel, each transitioning random
+// resources shared by all lists, and submits them in order, resolving their
+// initial states against the global states. Replays the submitted stream to
+// check every barrier starts from the state its resource is in, and compares
+// the ResourceBarrier calls with recording every transition on its own.
+int RunResourceStates(int commandListCount, int passesPerList, std::uint32_t threadCount)
+{
+	const std::uint32_t resourceCount = 64;
+	const std::uint32_t resourcesPerPass = 8;
+	const ResourceState states[] = { ResourceState::RenderTarget, ResourceState::PixelShaderResource,
+		ResourceState::NonPixelShaderResource, ResourceState::PixelShaderResource | ResourceState::NonPixelShaderResource,
+		ResourceState::CopyDest, ResourceState::CopySource, ResourceState::UnorderedAccess, ResourceState::Common };
+
+	commandListCount = std::max(commandListCount, 1);
+	RecordingDevice device;
+	std::vector<RHIResource> resources(resourceCount);
+	for (auto& resource : resources) {
+		resource = device.CreateResource();
+	}
+
+	JobSystem jobs(threadCount);
+	std::vector<RecordingCommandList> commandLists(commandListCount);
+	std::vector<ResourceStateTracker> trackers(commandListCount);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	jobs.ParallelFor("RecordCommandList", commandListCount, 1, [&](std::size_t begin, std::size_t end) {
+		for (auto list = begin; list < end; list++) {
+			std::mt19937 random(static_cast<std::uint32_t>(list));
+			std::uniform_int_distribution<std::uint32_t> resourceIndex(0, resourceCount - 1);
+			std::uniform_int_distribution<std::size_t> stateIndex(0, sizeof(states) / sizeof(states[0]) - 1);
+
+			auto& tracker = trackers[list];
+			tracker.Reset();
+			commandLists[list].Reset();
+			for (int pass = 0; pass < passesPerList; pass++) {
+				for (std::uint32_t i = 0; i < resourcesPerPass; i++) {
+					tracker.Transition(resources[resourceIndex(random)], states[stateIndex(random)]);
+				}
+				tracker.FlushBarriers(commandLists[list]);
+				commandLists[list].DrawIndexedInstanced(3, 1, 0, 0, 0);
+			}
+		}
+	});
+	auto recorded = std::chrono::high_resolution_clock::now();
+
+	// Submit: every list gets a list with its resolved barriers in front of it.
+	GlobalResourceStates globalStates;
+	RecordingCommandQueue queue;
+	RecordingCommandList resolveList;
+	std::vector<::ResourceBarrier> resolvedBarriers;
+	std::uint64_t resolvedCount = 0;
+	for (int list = 0; list < commandListCount; list++) {
+		resolvedBarriers.clear();
+		trackers[list].Resolve(globalStates, resolvedBarriers);
+		resolvedCount += resolvedBarriers.size();
+
+		resolveList.Reset();
+		if (!resolvedBarriers.empty()) {
+			resolveList.ResourceBarrier(static_cast<std::uint32_t>(resolvedBarriers.size()), resolvedBarriers.data());
+		}
+		RecordingCommandList* submitted[] = { &resolveList, &commandLists[list] };
+		queue.ExecuteCommandLists(2, submitted);
+	}
+	auto submitted = std::chrono::high_resolution_clock::now();
+
+	// Replay the submitted barriers.
+	std::map<RHIResource, ResourceState> replayedStates;
+	std::uint64_t errors = 0;
+	const auto& stream = queue.GetStream();
+	for (const auto& barrier : stream.Barriers) {
+		if (barrier.Type != BarrierType::Transition) {
+			continue;
+		}
+		auto& state = replayedStates[barrier.Resource];
+		if (barrier.StateBefore != state) {
+			errors++;
+		}
+		state = barrier.StateAfter;
+	}
+	for (auto resource : resources) {
+		if (replayedStates[resource] != globalStates.GetState(resource)) {
+			errors++;
+		}
+	}
+
+	ResourceStateStats stats;
+	for (const auto& tracker : trackers) {
+		const auto& trackerStats = tracker.GetStats();
+		stats.Requested += trackerStats.Requested;
+		stats.Recorded += trackerStats.Recorded;
+		stats.Elided += trackerStats.Elided;
+		stats.Merged += trackerStats.Merged;
+		stats.Deferred += trackerStats.Deferred;
+		stats.ResourceBarrierCalls += trackerStats.ResourceBarrierCalls;
+	}
+
+	// Recording every requested transition that changes the state with a call of its own.
+	std::uint64_t changingTransitions = 0;
+	std::map<RHIResource, ResourceState> serialStates;
+	for (int list = 0; list < commandListCount; list++) {
+		std::mt19937 random(static_cast<std::uint32_t>(list));
+		std::uniform_int_distribution<std::uint32_t> resourceIndex(0, resourceCount - 1);
+		std::uniform_int_distribution<std::size_t> stateIndex(0, sizeof(states) / sizeof(states[0]) - 1);
+		for (int i = 0; i < passesPerList * static_cast<int>(resourcesPerPass); i++) {
+			auto& state = serialStates[resources[resourceIndex(random)]];
+			auto newState = states[stateIndex(random)];
+			if (state != newState) {
+				changingTransitions++;
+				state = newState;
+			}
+		}
+	}
+
+	std::printf("command lists: %d, passes per list: %d, resources: %u, threads: %u\n",
+		commandListCount, passesPerList, resourceCount, threadCount);
+	std::printf("transitions: %llu requested, %llu recorded, %llu elided, %llu merged, %llu resolved at submit for %llu deferred\n",
+		static_cast<unsigned long long>(stats.Requested), static_cast<unsigned long long>(stats.Recorded),
+		static_cast<unsigned long long>(stats.Elided), static_cast<unsigned long long>(stats.Merged),
+		static_cast<unsigned long long>(resolvedCount), static_cast<unsigned long long>(stats.Deferred));
+	std::printf("ResourceBarrier calls: %u (%llu in the lists), %llu with one call per transition\n",
+		stream.GetCount(RecordedCommandType::ResourceBarrier), static_cast<unsigned long long>(stats.ResourceBarrierCalls),
+		static_cast<unsigned long long>(changingTransitions));
+	std::printf("record: %.3f ms, resolve and submit: %.3f ms, %llu errors\n",
+		std::chrono::duration<double>(recorded - start).count() * 1000.0,
+		std::chrono::duration<double>(submitted - recorded).count() * 1000.0, static_cast<unsigned long long>(errors));
+	return errors == 0 ? 0 : 1;
+}
+
+// Runs the frame of Engine::Update and Engine::Render through FrameRenderer:
+// meshes generated by MeshGenerator and packed, uploaded and placed by
+// ResourceManager, frame contexts paced by fences, culling, sorting and the
+// parallel recording. Only the window, swap chain, pipeline objects and GPU
+// timestamps of Engine are left out.
+int RunEngine(int meshCount, int frameCount, std::uint32_t threadCount)
+{
+	RecordingDevice device;
+	RecordingCommandQueue directQueue(CommandListType::Direct);
+	RecordingCommandQueue copyQueue(CommandListType::Copy);
+	JobSystem jobs(threadCount);
+
+	// The settings Engine::Initialize uses.
+	FrameRendererSettings settings;
+	settings.MaxRecordingThreads = std::min<std::uint32_t>(threadCount, 8);
+	FrameRenderer frameRenderer(device, directQueue, copyQueue, jobs, settings);
+	auto& resourceManager = frameRenderer.GetResourceManager();
+
+	// The meshes share the geometry of a few generated ones, like the boxes of
+	// Engine::BuildGeometry, and are spread over a field in front of the camera.
+	Mesh prototypes[] = {
+		MeshGenerator::GenerateUnitBox("box"),
+		MeshGenerator::GenerateSphere("sphere"),
+		MeshGenerator::GenerateGrid("grid", 20, 25)
+	};
+	for (auto& prototype : prototypes) {
+		MeshGenerator::OptimizeMesh(prototype);
+	}
+
+	auto side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(meshCount))));
+	std::vector<MeshHandle> meshes;
+	for (int i = 0; i < meshCount; i++) {
+		auto mesh = prototypes[i % 3];
+		mesh.Name = mesh.Name + std::to_string(i);
+
+		// Transposed translation, as Engine stores world matrices.
+		mesh.World.m[0][3] = (i % side - side / 2) * 3.0f;
+		mesh.World.m[1][3] = -2.0f;
+		mesh.World.m[2][3] = 5.0f + (i / side) * 3.0f;
+		meshes.push_back(resourceManager.AddMesh(std::move(mesh)));
+	}
+
+	// The field of small instanced boxes of Engine::BuildGeometry.
+	auto& instances = frameRenderer.GetInstances();
+	auto boxInstanceGeometry = instances.AddGeometry(resourceManager.GetInstancedGeometry(meshes.front()));
+	std::vector<InstanceTransform> boxInstances;
+	for (int row = 0; row < 16; row++) {
+		for (int col = 0; col < 16; col++) {
+			InstanceTransform transform = {};
+			transform.World[0] = 0.15f;
+			transform.World[5] = 0.15f;
+			transform.World[10] = 0.15f;
+			transform.World[15] = 1.0f;
+			transform.World[3] = -10.0f + row * 1.25f;
+			transform.World[7] = -0.85f;
+			transform.World[11] = 8.0f + col * 1.25f;
+			boxInstances.push_back(transform);
+		}
+	}
+	resourceManager.FlushUploads();
+
+	auto targets = MakeFrameTargets(device);
+	// The render graph places the back buffer barriers.
+	auto backBuffer = targets.BackBuffer;
+	targets.BackBuffer = 0;
+	auto depthBuffer = device.CreateResource();
+
+	FrameBindings pipelines;
+	pipelines.PipelineState = 1;
+	pipelines.RootSignature = 1;
+	pipelines.CbvHeap = 1;
+	pipelines.InstancedPipelineState = 2;
+	pipelines.DepthPrepassPipelineState = 3;
+	pipelines.DepthEqualPipelineState = 4;
+
+	FrameView view;
+	MakeViewProj(&view.ViewProj.m[0][0], view.NearZ, view.FarZ);
+
+	JobFrameStats frameStats;
+	double updateSeconds = 0.0;
+	double renderSeconds = 0.0;
+	for (int frame = 0; frame < frameCount; frame++) {
+		// Only the last frame's commands are kept.
+		directQueue.Reset();
+		copyQueue.Reset();
+
+		auto updateStart = std::chrono::high_resolution_clock::now();
+
+		frameRenderer.BeginFrame();
+		view.DeltaTime = 1.0 / 60.0;
+		view.TotalTime = frame / 60.0;
+		frameRenderer.Update(view);
+
+		instances.Begin();
+		if (resourceManager.IsMeshResident(meshes.front())) {
+			for (const auto& transform : boxInstances) {
+				instances.Add(boxInstanceGeometry, transform);
+			}
+		}
+		instances.End();
+
+		auto renderStart = std::chrono::high_resolution_clock::now();
+
+		frameRenderer.BeginRecording();
+		frameRenderer.Record(targets, pipelines, backBuffer, depthBuffer);
+		frameRenderer.Submit();
+		frameRenderer.EndFrame();
+
+		auto end = std::chrono::high_resolution_clock::now();
+		updateSeconds += std::chrono::duration<double>(renderStart - updateStart).count();
+		renderSeconds += std::chrono::duration<double>(end - renderStart).count();
+		frameStats = jobs.GetFrameStats();
+	}
+	frameRenderer.Flush();
+
+	const auto& stream = directQueue.GetStream();
+	const auto& submit = frameRenderer.GetSubmitStats();
+	auto transforms = resourceManager.GetTransformUploadStats();
+	auto uploads = resourceManager.GetUploadStats();
+	const auto& pacing = frameRenderer.GetFramePacer().GetStats();
+	const auto& buffers = device.GetBufferStats();
+	std::printf("meshes: %d, frames: %d, threads: %u\n", meshCount, frameCount, threadCount);
+	std::printf("cpu time per frame: update %.3f ms, render %.3f ms\n",
+		frameCount > 0 ? updateSeconds * 1000.0 / frameCount : 0.0, frameCount > 0 ? renderSeconds * 1000.0 / frameCount : 0.0);
+	std::printf("last frame: %u jobs, thread utilization %.0f%% (", frameStats.JobCount, frameStats.GetUtilization() * 100.0);
+	for (std::size_t i = 0; i < frameStats.BusyMs.size(); i++) {
+		std::printf(i > 0 ? ", %.3f ms" : "%.3f ms", frameStats.BusyMs[i]);
+	}
+	std::printf(")\n");
+	std::printf("commands per frame: %zu in %u command lists (draws: %llu of %zu draw items, state changes: %llu issued, %llu filtered)\n",
+		stream.Commands.size(), frameRenderer.GetCommandListCount(), static_cast<unsigned long long>(submit.Draws),
+		resourceManager.GetDrawItems().size(), static_cast<unsigned long long>(submit.GetIssued()),
+		static_cast<unsigned long long>(submit.GetFiltered()));
+	std::printf("geometry: %u unique, %llu bytes staged in %llu copies and %llu submissions\n",
+		resourceManager.GetUniqueGeometryCount(), static_cast<unsigned long long>(uploads.Ring.TotalBytesAllocated),
+		static_cast<unsigned long long>(uploads.CopyCount), static_cast<unsigned long long>(uploads.FlushCount));
+	std::printf("object transforms: %u written last frame, %llu bytes in total\n",
+		transforms.LastFrameCount, static_cast<unsigned long long>(transforms.TotalBytes));
+	std::printf("buffers: %u live (%llu bytes), %llu created\n", buffers.LiveBuffers,
+		static_cast<unsigned long long>(buffers.LiveBytes), static_cast<unsigned long long>(buffers.CreatedBuffers));
+	std::printf("frame pacing: %llu frames, %llu stalled\n", static_cast<unsigned long long>(pacing.FrameCount),
+		static_cast<unsigned long long>(pacing.StalledFrameCount));
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && std::strcmp(argv[1], "optimize") == 0) {
+		return RunMeshOptimizer(argc > 2 ? std::atoi(argv[2]) : 100);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "cull") == 0) {
+		return RunCulling(argc > 2 ? std::atoi(argv[2]) : 1000000, argc > 3 ? std::atoi(argv[3]) : 20,
+			static_cast<std::uint32_t>(std::max(argc > 4 ? std::atoi(argv[4]) : 1, 1)));
+	}
+	if (argc > 1 && std::strcmp(argv[1], "sort") == 0) {
+		return RunDrawSort(argc > 2 ? std::atoi(argv[2]) : 100000, argc > 3 ? std::atoi(argv[3]) : 64, argc > 4 ? std::atoi(argv[4]) : 20,
+			static_cast<std::uint32_t>(std::max(argc > 5 ? std::atoi(argv[5]) : 1, 1)));
+	}
+	if (argc > 1 && std::strcmp(argv[1], "depth") == 0) {
+		return RunDepthSorting(argc > 2 ? std::atoi(argv[2]) : 20000, argc > 3 ? std::atoi(argv[3]) : 16);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "graph") == 0) {
+		return RunRenderGraph(argc > 2 ? std::atoi(argv[2]) : 1000);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "states") == 0) {
+		return RunResourceStates(argc > 2 ? std::atoi(argv[2]) : 16, argc > 3 ? std::atoi(argv[3]) : 200,
+			static_cast<std::uint32_t>(std::max(argc > 4 ? std::atoi(argv[4]) : 1, 1)));
+	}
+	if (argc > 1 && std::strcmp(argv[1], "binding") == 0) {
+		return RunBindingCost(std::max(argc > 2 ? std::atoi(argv[2]) : 100000, 1), argc > 3 ? std::atoi(argv[3]) : 50);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "engine") == 0) {
+		return RunEngine(std::max(argc > 2 ? std::atoi(argv[2]) : 10000, 1), argc > 3 ? std::atoi(argv[3]) : 100,
+			static_cast<std::uint32_t>(std::max(argc > 4 ? std::atoi(argv[4]) : 1, 1)));
+	}
+	if (argc > 1 && std::strcmp(argv[1], "instancing") == 0) {
+		return RunInstancing(std::max(argc > 2 ? std::atoi(argv[2]) : 10000, 1), argc > 3 ? std::atoi(argv[3]) : 100);
+	}
+
+	int meshCount = argc > 1 ? std::atoi(argv[1]) : 10000;
+	int frameCount = argc > 2 ? std::atoi(argv[2]) : 100;
+	auto threadCount = static_cast<std::uint32_t>(std::max(argc > 3 ? std::atoi(argv[3]) : 1, 1));
+
+	RecordingDevice device;
+	JobSystem jobs(threadCount);
+	std::vector<RecordingCommandList> commandLists(threadCount);
+	std::vector<ICommandRecorder*> recorders;
+	std::vector<RecordingCommandList*> submitted;
+	RecordingCommandQueue commandQueue;
+	SceneRenderer sceneRenderer;
+
+	MeshRegistry<SyntheticMesh> meshes;
+	BuildSyntheticScene(device, meshes, meshCount);
+
+	auto targets = MakeFrameTargets(device);
+
+	FrameBindings bindings;
+	bindings.PipelineState = 1;
+	bindings.RootSignature = 1;
+	bindings.CbvHeap = 1;
+	bindings.PassConstants = device.CreateResource() << 32;
+	bindings.ObjectTransforms = device.CreateResource() << 32;
+
+	JobFrameStats frameStats;
+	double totalSeconds = 0.0;
+	for (int frame = 0; frame < frameCount; frame++) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		jobs.BeginFrame();
+		auto recorderCount = SceneRenderer::GetRecorderCount(meshes.GetDrawItems().size(), threadCount);
+		recorders.clear();
+		submitted.clear();
+		for (std::uint32_t i = 0; i < recorderCount; i++) {
+			commandLists[i].Reset();
+			recorders.push_back(&commandLists[i]);
+			submitted.push_back(&commandLists[i]);
+		}
+
+		commandQueue.Reset();
+		sceneRenderer.RecordFrameParallel(jobs, recorders.data(), recorderCount, targets, bindings,
+			meshes.GetDrawItems(), nullptr, InstanceBatcher());
+
+		commandQueue.ExecuteCommandLists(recorderCount, submitted.data());
+		commandQueue.Signal(frame + 1);
+
+		auto end = std::chrono::high_resolution_clock::now();
+		totalSeconds += std::chrono::duration<double>(end - start).count();
+		frameStats = jobs.GetFrameStats();
+	}
+
+	const auto& stream = commandQueue.GetStream();
+	std::printf("meshes: %d, frames: %d, threads: %u\n", meshCount, frameCount, threadCount);
+	std::printf("cpu time per frame: %.3f ms\n", frameCount > 0 ? totalSeconds * 1000.0 / frameCount : 0.0);
+	std::printf("last frame: %u jobs, thread utilization %.0f%% (", frameStats.JobCount, frameStats.GetUtilization() * 100.0);
+	for (std::size_t i = 0; i < frameStats.BusyMs.size(); i++) {
+		std::printf(i > 0 ? ", %.3f ms" : "%.3f ms", frameStats.BusyMs[i]);
+	}
+	std::printf(")\n");
+	std::printf("commands per frame: %zu (draws: %u, barriers: %u, vertex/index buffer binds: %u/%u)\n",
+		stream.Commands.size(),
+		stream.GetCount(RecordedCommandType::DrawIndexedInstanced),
+		stream.GetCount(RecordedCommandType::ResourceBarrier),
+		stream.GetCount(RecordedCommandType::IASetVertexBuffers),
+		stream.GetCount(RecordedCommandType::IASetIndexBuffer));
+
+	return 0;
+}
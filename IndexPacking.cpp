@@ -0,0 +1,69 @@
+#include "IndexPacking.h"
+#include <algorithm>
+
+IndexFormat ChooseIndexFormat(std::size_t vertexCount)
+{
+	return vertexCount <= MaxIndex16VertexCount ? IndexFormat::Uint16 : IndexFormat::Uint32;
+}
+
+bool PackIndices16(const std::uint32_t* indices, std::size_t indexCount,
+	std::vector<std::uint16_t>& indices16, std::vector<IndexRange>& ranges, std::size_t maxRanges)
+{
+	indices16.clear();
+	ranges.clear();
+
+	// Grow each range one triangle at a time until its vertices no longer fit in 16 bits.
+	std::size_t rangeStart = 0;
+	std::uint32_t rangeMin = 0xffffffff;
+	std::uint32_t rangeMax = 0;
+
+	auto closeRange = [&](std::size_t rangeEnd) {
+		IndexRange range;
+		range.IndexCount = static_cast<std::uint32_t>(rangeEnd - rangeStart);
+		range.StartIndexLocation = static_cast<std::uint32_t>(rangeStart);
+		range.BaseVertexLocation = static_cast<std::int32_t>(rangeMin);
+		ranges.push_back(range);
+	};
+
+	for (std::size_t i = 0; i + 2 < indexCount; i += 3) {
+		auto triangleMin = std::min({ indices[i], indices[i + 1], indices[i + 2] });
+		auto triangleMax = std::max({ indices[i], indices[i + 1], indices[i + 2] });
+
+		// A single triangle spanning more than 16 bits can never be packed.
+		if (triangleMax - triangleMin >= MaxIndex16VertexCount) {
+			indices16.clear();
+			ranges.clear();
+			return false;
+		}
+
+		auto newMin = std::min(rangeMin, triangleMin);
+		auto newMax = std::max(rangeMax, triangleMax);
+		if (i > rangeStart && newMax - newMin >= MaxIndex16VertexCount) {
+			closeRange(i);
+			rangeStart = i;
+			newMin = triangleMin;
+			newMax = triangleMax;
+		}
+		rangeMin = newMin;
+		rangeMax = newMax;
+	}
+
+	if (indexCount >= 3) {
+		closeRange(indexCount - indexCount % 3);
+	}
+
+	if (ranges.size() > maxRanges) {
+		ranges.clear();
+		return false;
+	}
+
+	indices16.resize(indexCount - indexCount % 3);
+	for (const auto& range : ranges) {
+		for (std::uint32_t i = 0; i < range.IndexCount; i++) {
+			auto index = range.StartIndexLocation + i;
+			indices16[index] = static_cast<std::uint16_t>(indices[index] - static_cast<std::uint32_t>(range.BaseVertexLocation));
+		}
+	}
+
+	return true;
+}
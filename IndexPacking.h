@@ -0,0 +1,29 @@
+#ifndef INDEXPACKING_H_
+#define INDEXPACKING_H_
+
+#include "RHI.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// A range of indices drawn with one DrawIndexedInstanced call.
+struct IndexRange
+{
+	std::uint32_t IndexCount = 0;
+	std::uint32_t StartIndexLocation = 0;
+	std::int32_t BaseVertexLocation = 0;
+};
+
+static const std::size_t MaxIndex16VertexCount = 0x10000;
+
+// 16 bit indices are used whenever every vertex can be addressed by them.
+IndexFormat ChooseIndexFormat(std::size_t vertexCount);
+
+// Packs a triangle list into 16 bit indices. Meshes with more than 65 536
+// vertices are split into consecutive ranges that each address at most 65 536
+// vertices relative to their own BaseVertexLocation. Returns false, leaving the
+// outputs empty, if that would take more than maxRanges ranges.
+bool PackIndices16(const std::uint32_t* indices, std::size_t indexCount,
+	std::vector<std::uint16_t>& indices16, std::vector<IndexRange>& ranges, std::size_t maxRanges = 4);
+
+#endif
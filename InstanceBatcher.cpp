@@ -0,0 +1,78 @@
+#include "InstanceBatcher.h"
+
+std::uint32_t InstanceBatcher::AddGeometry(const InstancedGeometry& geometry)
+{
+	m_geometries.push_back(geometry);
+	return static_cast<std::uint32_t>(m_geometries.size() - 1);
+}
+
+const InstancedGeometry& InstanceBatcher::GetGeometry(std::uint32_t geometry) const
+{
+	return m_geometries[geometry];
+}
+
+std::size_t InstanceBatcher::GetGeometryCount() const
+{
+	return m_geometries.size();
+}
+
+void InstanceBatcher::Begin()
+{
+	m_addedGeometries.clear();
+	m_addedTransforms.clear();
+	m_transforms.clear();
+	m_batches.clear();
+}
+
+void InstanceBatcher::Add(std::uint32_t geometry, const InstanceTransform& transform)
+{
+	m_addedGeometries.push_back(geometry);
+	m_addedTransforms.push_back(transform);
+}
+
+void InstanceBatcher::End()
+{
+	// Counting sort by geometry, instances of one geometry keep the order they were added in.
+	m_offsets.assign(m_geometries.size() + 1, 0);
+	for (auto geometry : m_addedGeometries) {
+		m_offsets[geometry + 1]++;
+	}
+	for (std::size_t i = 0; i < m_geometries.size(); i++) {
+		if (m_offsets[i + 1] > 0) {
+			InstanceBatch batch;
+			batch.Geometry = static_cast<std::uint32_t>(i);
+			batch.StartInstance = m_offsets[i];
+			batch.InstanceCount = m_offsets[i + 1];
+			m_batches.push_back(batch);
+		}
+		m_offsets[i + 1] += m_offsets[i];
+	}
+
+	m_transforms.resize(m_addedTransforms.size());
+	for (std::size_t i = 0; i < m_addedTransforms.size(); i++) {
+		m_transforms[m_offsets[m_addedGeometries[i]]++] = m_addedTransforms[i];
+	}
+}
+
+const std::vector<InstanceBatch>& InstanceBatcher::GetBatches() const
+{
+	return m_batches;
+}
+
+const std::vector<InstanceTransform>& InstanceBatcher::GetTransforms() const
+{
+	return m_transforms;
+}
+
+InstanceBatchConstants InstanceBatcher::GetBatchConstants(const InstanceBatch& batch) const
+{
+	const auto& geometry = m_geometries[batch.Geometry];
+
+	InstanceBatchConstants constants;
+	constants.InstanceOffset = batch.StartInstance;
+	for (int i = 0; i < 3; i++) {
+		constants.PositionOffset[i] = geometry.PositionOffset[i];
+		constants.PositionScale[i] = geometry.PositionScale[i];
+	}
+	return constants;
+}
@@ -0,0 +1,82 @@
+#ifndef INSTANCEBATCHER_H_
+#define INSTANCEBATCHER_H_
+
+#include "RHI.h"
+#include <cstdint>
+#include <vector>
+
+// World matrix of one instance, transposed like Mesh::World.
+struct InstanceTransform
+{
+	float World[16] = {
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f };
+};
+
+// Geometry drawn with instancing. Quantized positions are decoded with
+// PositionOffset and PositionScale, see VertexFormat.h.
+struct InstancedGeometry
+{
+	VertexBufferBinding VertexBuffer;
+	VertexBufferBinding AttributeBuffer;
+	IndexBufferBinding IndexBuffer;
+	std::uint32_t IndexCount = 0;
+	std::uint32_t StartIndexLocation = 0;
+	std::int32_t BaseVertexLocation = 0;
+	float PositionOffset[3] = { 0.0f, 0.0f, 0.0f };
+	float PositionScale[3] = { 1.0f, 1.0f, 1.0f };
+};
+
+// Root constants of one batch. Matches cbPerBatch in VertexShader.hlsl.
+struct InstanceBatchConstants
+{
+	std::uint32_t InstanceOffset = 0;
+	float PositionOffset[3] = { 0.0f, 0.0f, 0.0f };
+	float PositionScale[3] = { 1.0f, 1.0f, 1.0f };
+};
+
+static const std::uint32_t InstanceBatchConstantCount = sizeof(InstanceBatchConstants) / 4;
+
+// All instances of one geometry, drawn with a single DrawIndexedInstanced.
+// SV_InstanceID starts at 0 for every draw, so the shader finds the
+// transforms of the batch through the InstanceOffset root constant.
+struct InstanceBatch
+{
+	std::uint32_t Geometry = 0;
+	std::uint32_t StartInstance = 0;
+	std::uint32_t InstanceCount = 0;
+};
+
+// Collects the instances to draw in a frame and groups them by geometry so the
+// transforms of each batch are contiguous in the per-frame instance buffer.
+class InstanceBatcher
+{
+public:
+	std::uint32_t AddGeometry(const InstancedGeometry& geometry);
+	const InstancedGeometry& GetGeometry(std::uint32_t geometry) const;
+	std::size_t GetGeometryCount() const;
+
+	void Begin();
+	void Add(std::uint32_t geometry, const InstanceTransform& transform);
+	void End();
+
+	// Valid after End until the next Begin.
+	const std::vector<InstanceBatch>& GetBatches() const;
+	const std::vector<InstanceTransform>& GetTransforms() const;
+	InstanceBatchConstants GetBatchConstants(const InstanceBatch& batch) const;
+
+private:
+	std::vector<InstancedGeometry> m_geometries;
+
+	// Instances in the order they were added.
+	std::vector<std::uint32_t> m_addedGeometries;
+	std::vector<InstanceTransform> m_addedTransforms;
+
+	std::vector<std::uint32_t> m_offsets;
+	std::vector<InstanceTransform> m_transforms;
+	std::vector<InstanceBatch> m_batches;
+};
+
+#endif
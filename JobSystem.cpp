@@ -0,0 +1,297 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace {
+
+// Owning job system and index of the current thread.
+thread_local const JobSystem* t_jobSystem = nullptr;
+thread_local std::uint32_t t_threadIndex = 0;
+
+// Time of the jobs that ran inside the job currently being timed on this thread.
+thread_local double t_nestedMs = 0.0;
+
+}
+
+double JobFrameStats::GetUtilization() const
+{
+	if (WallMs <= 0.0 || BusyMs.empty()) {
+		return 0.0;
+	}
+
+	double busy = 0.0;
+	for (auto ms : BusyMs) {
+		busy += ms;
+	}
+	return busy / (WallMs * BusyMs.size());
+}
+
+JobSystem::JobSystem(std::uint32_t threadCount) :
+	m_epoch(std::chrono::steady_clock::now())
+{
+	if (threadCount == 0) {
+		threadCount = std::max<std::uint32_t>(std::thread::hardware_concurrency(), 1);
+	}
+
+	for (std::uint32_t i = 0; i < threadCount; i++) {
+		m_threadData.push_back(std::make_unique<ThreadData>());
+	}
+
+	t_jobSystem = this;
+	t_threadIndex = 0;
+
+	for (std::uint32_t i = 1; i < threadCount; i++) {
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_wakeUp.notify_all();
+
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+
+	if (t_jobSystem == this) {
+		t_jobSystem = nullptr;
+	}
+}
+
+std::uint32_t JobSystem::GetThreadCount() const
+{
+	return static_cast<std::uint32_t>(m_threadData.size());
+}
+
+std::uint32_t JobSystem::GetThreadIndex() const
+{
+	return t_jobSystem == this ? t_threadIndex : 0;
+}
+
+void JobSystem::Run(const char* name, std::function<void()> job, JobCounter* counter)
+{
+	if (counter != nullptr) {
+		counter->m_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Job newJob;
+	newJob.Name = name;
+	newJob.Function = std::move(job);
+	newJob.Counter = counter;
+	Push(std::move(newJob));
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, const char* name, std::function<void()> job, JobCounter* counter)
+{
+	if (counter != nullptr) {
+		counter->m_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		// Finish takes the same lock before it starts the continuations, so the
+		// job is either started there or seen as ready here.
+		std::lock_guard<std::mutex> lock(dependency.m_mutex);
+		if (!dependency.IsDone()) {
+			dependency.m_continuations.push_back({ name, std::move(job), counter });
+			return;
+		}
+	}
+
+	Job newJob;
+	newJob.Name = name;
+	newJob.Function = std::move(job);
+	newJob.Counter = counter;
+	Push(std::move(newJob));
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	auto threadIndex = GetThreadIndex();
+	while (!counter.IsDone()) {
+		if (!TryRunJob(threadIndex)) {
+			std::this_thread::yield();
+		}
+	}
+
+	// Waits for the job that finished the counter to let go of it.
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::BeginFrame()
+{
+	for (auto& threadData : m_threadData) {
+		std::lock_guard<std::mutex> lock(threadData->TimingMutex);
+		threadData->Timings.clear();
+	}
+	m_frameStartMs = Now();
+}
+
+JobFrameStats JobSystem::GetFrameStats() const
+{
+	JobFrameStats stats;
+	stats.WallMs = Now() - m_frameStartMs;
+	stats.BusyMs.assign(m_threadData.size(), 0.0);
+
+	for (std::size_t i = 0; i < m_threadData.size(); i++) {
+		std::lock_guard<std::mutex> lock(m_threadData[i]->TimingMutex);
+		for (const auto& timing : m_threadData[i]->Timings) {
+			stats.BusyMs[i] += timing.EndMs - timing.StartMs - timing.NestedMs;
+			stats.JobCount++;
+		}
+	}
+	return stats;
+}
+
+std::vector<JobTiming> JobSystem::GetFrameTimings() const
+{
+	std::vector<JobTiming> timings;
+	for (const auto& threadData : m_threadData) {
+		std::lock_guard<std::mutex> lock(threadData->TimingMutex);
+		timings.insert(timings.end(), threadData->Timings.begin(), threadData->Timings.end());
+	}
+	return timings;
+}
+
+void JobSystem::Push(Job job)
+{
+	auto& threadData = *m_threadData[GetThreadIndex()];
+	{
+		std::lock_guard<std::mutex> lock(threadData.QueueMutex);
+		threadData.Queue.push_back(std::move(job));
+	}
+	m_queuedJobs.fetch_add(1, std::memory_order_release);
+
+	{
+		// Taking the lock orders the push before a worker going to sleep.
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wakeUp.notify_one();
+}
+
+bool JobSystem::TryRunJob(std::uint32_t threadIndex)
+{
+	Job job;
+	if (!PopOrSteal(threadIndex, job)) {
+		return false;
+	}
+
+	Execute(job);
+	return true;
+}
+
+bool JobSystem::PopOrSteal(std::uint32_t threadIndex, Job& job)
+{
+	// Newest job of our own first, it is most likely still in the cache.
+	{
+		auto& own = *m_threadData[threadIndex];
+		std::lock_guard<std::mutex> lock(own.QueueMutex);
+		if (!own.Queue.empty()) {
+			job = std::move(own.Queue.back());
+			own.Queue.pop_back();
+			m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// Otherwise the oldest job of another thread.
+	auto threadCount = static_cast<std::uint32_t>(m_threadData.size());
+	for (std::uint32_t i = 1; i < threadCount; i++) {
+		auto& victim = *m_threadData[(threadIndex + i) % threadCount];
+		std::lock_guard<std::mutex> lock(victim.QueueMutex);
+		if (!victim.Queue.empty()) {
+			job = std::move(victim.Queue.front());
+			victim.Queue.pop_front();
+			m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(Job& job)
+{
+	auto scope = BeginTiming();
+	job.Function();
+	EndTiming(job.Name, scope);
+
+	Finish(job.Counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (counter == nullptr) {
+		return;
+	}
+
+	// The last decrement and taking the continuations happen under the lock Wait
+	// takes before it returns, so the counter is not touched after it could be destroyed.
+	std::vector<JobCounter::Continuation> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		if (counter->m_count.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+			return;
+		}
+		continuations.swap(counter->m_continuations);
+	}
+
+	for (auto& continuation : continuations) {
+		Job job;
+		job.Name = continuation.Name;
+		job.Function = std::move(continuation.Job);
+		job.Counter = continuation.Counter;
+		Push(std::move(job));
+	}
+}
+
+void JobSystem::WorkerLoop(std::uint32_t threadIndex)
+{
+	t_jobSystem = this;
+	t_threadIndex = threadIndex;
+
+	for (;;) {
+		if (TryRunJob(threadIndex)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wakeUp.wait(lock, [this]() { return m_stop || m_queuedJobs.load(std::memory_order_acquire) > 0; });
+		if (m_stop) {
+			return;
+		}
+	}
+}
+
+double JobSystem::Now() const
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+JobSystem::TimingScope JobSystem::BeginTiming()
+{
+	TimingScope scope;
+	scope.StartMs = Now();
+	scope.OuterNestedMs = t_nestedMs;
+	t_nestedMs = 0.0;
+	return scope;
+}
+
+void JobSystem::EndTiming(const char* name, const TimingScope& scope)
+{
+	JobTiming timing;
+	timing.Name = name;
+	timing.Thread = GetThreadIndex();
+	timing.StartMs = scope.StartMs;
+	timing.EndMs = Now();
+	timing.NestedMs = t_nestedMs;
+
+	// The whole job is nested time of the job it ran in.
+	t_nestedMs = scope.OuterNestedMs + (timing.EndMs - timing.StartMs);
+
+	auto& threadData = *m_threadData[timing.Thread];
+	std::lock_guard<std::mutex> lock(threadData.TimingMutex);
+	threadData.Timings.push_back(timing);
+}
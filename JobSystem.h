@@ -0,0 +1,168 @@
+#ifndef JOBSYSTEM_H_
+#define JOBSYSTEM_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Counts the unfinished jobs that were started with it. Jobs started with
+// JobSystem::RunAfter wait for a counter to reach zero without blocking a thread.
+class JobCounter
+{
+public:
+	bool IsDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	struct Continuation
+	{
+		const char* Name;
+		std::function<void()> Job;
+		JobCounter* Counter;
+	};
+
+	std::atomic<std::uint32_t> m_count{ 0 };
+	std::mutex m_mutex;
+	std::vector<Continuation> m_continuations;
+};
+
+// Execution of one job, for seeing how busy the threads were in a frame.
+struct JobTiming
+{
+	const char* Name = nullptr;
+	std::uint32_t Thread = 0;
+	double StartMs = 0.0;
+	double EndMs = 0.0;
+	// Time spent running other jobs while waiting inside this one.
+	double NestedMs = 0.0;
+};
+
+struct JobFrameStats
+{
+	double WallMs = 0.0;
+	std::uint32_t JobCount = 0;
+	// Time spent running jobs, per thread. Thread 0 is the thread that created the job system.
+	std::vector<double> BusyMs;
+
+	double GetUtilization() const;
+};
+
+// Work-stealing task scheduler. Every thread has its own deque: it pushes and
+// pops jobs at the back, idle threads steal from the front of the others. The
+// thread that creates the job system is thread 0 and runs jobs while it waits,
+// so threadCount includes it. Jobs are timed per frame, see BeginFrame.
+class JobSystem
+{
+public:
+	// 0 uses one thread per hardware thread.
+	explicit JobSystem(std::uint32_t threadCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	std::uint32_t GetThreadCount() const;
+
+	// Index of the calling thread, or 0 for threads not owned by the job system.
+	std::uint32_t GetThreadIndex() const;
+
+	// Name must outlive the frame, string literals are fine. counter, if given, is
+	// incremented now and decremented when the job finished.
+	void Run(const char* name, std::function<void()> job, JobCounter* counter = nullptr);
+
+	// Runs the job once dependency reached zero.
+	void RunAfter(JobCounter& dependency, const char* name, std::function<void()> job, JobCounter* counter = nullptr);
+
+	// Runs other jobs until counter reached zero.
+	void Wait(JobCounter& counter);
+
+	// Calls func(begin, end) for ranges of at most grainSize elements of
+	// [0, count) and returns once all are done.
+	template <typename TFunc>
+	void ParallelFor(const char* name, std::size_t count, std::size_t grainSize, TFunc&& func)
+	{
+		if (count == 0) {
+			return;
+		}
+		grainSize = grainSize > 0 ? grainSize : 1;
+
+		JobCounter counter;
+		for (std::size_t begin = grainSize; begin < count; begin += grainSize) {
+			auto end = begin + grainSize < count ? begin + grainSize : count;
+			Run(name, [&func, begin, end]() { func(begin, end); }, &counter);
+		}
+
+		// The calling thread takes the first range itself.
+		auto scope = BeginTiming();
+		func(std::size_t(0), grainSize < count ? grainSize : count);
+		EndTiming(name, scope);
+
+		Wait(counter);
+	}
+
+	// Clears the timings and starts measuring a new frame.
+	void BeginFrame();
+	JobFrameStats GetFrameStats() const;
+	// Copies of all timings since BeginFrame, sorted by thread.
+	std::vector<JobTiming> GetFrameTimings() const;
+
+private:
+	struct Job
+	{
+		const char* Name = nullptr;
+		std::function<void()> Function;
+		JobCounter* Counter = nullptr;
+	};
+
+	struct ThreadData
+	{
+		std::mutex QueueMutex;
+		std::deque<Job> Queue;
+
+		mutable std::mutex TimingMutex;
+		std::vector<JobTiming> Timings;
+	};
+
+	void Push(Job job);
+	bool TryRunJob(std::uint32_t threadIndex);
+	bool PopOrSteal(std::uint32_t threadIndex, Job& job);
+	void Execute(Job& job);
+	void Finish(JobCounter* counter);
+	void WorkerLoop(std::uint32_t threadIndex);
+
+	// Jobs run on this thread between BeginTiming and EndTiming count as nested time.
+	struct TimingScope
+	{
+		double StartMs = 0.0;
+		double OuterNestedMs = 0.0;
+	};
+
+	double Now() const;
+	TimingScope BeginTiming();
+	void EndTiming(const char* name, const TimingScope& scope);
+
+	std::vector<std::unique_ptr<ThreadData>> m_threadData;
+	std::vector<std::thread> m_workers;
+
+	// Jobs queued but not yet taken, lets idle workers sleep.
+	std::atomic<std::uint32_t> m_queuedJobs{ 0 };
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeUp;
+	bool m_stop = false;
+
+	std::chrono::steady_clock::time_point m_epoch;
+	std::atomic<double> m_frameStartMs{ 0.0 };
+};
+
+#endif
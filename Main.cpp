@@ -8,6 +8,8 @@
 #include "d3dUtility.h"
 #include "CameraManager.h"
 #include <iostream>
+#include <cwchar>
+#include <shellapi.h>
 
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	_In_opt_ HINSTANCE hPrevInstance,
@@ -24,8 +26,31 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	FPSCamera camera = cameraManager.GetFPSCamera();
 	auto inputManager = InputManager(camera);
 
+	// -framesInFlight N and -backBuffers N trade latency against throughput.
+	// -depthPrepass 0|1 and -depthBuckets N choose how opaque draws are ordered and shaded.
+	FramePacingSettings framePacing;
+	DepthSettings depthSettings;
+	int argCount = 0;
+	auto args = CommandLineToArgvW(lpCmdLine, &argCount);
+	for (int i = 0; args != nullptr && i + 1 < argCount; i++) {
+		std::wstring arg = args[i];
+		if (arg == L"-framesInFlight") {
+			framePacing.FrameContextCount = std::wcstoul(args[++i], nullptr, 10);
+		}
+		else if (arg == L"-backBuffers") {
+			framePacing.BackBufferCount = std::wcstoul(args[++i], nullptr, 10);
+		}
+		else if (arg == L"-depthPrepass") {
+			depthSettings.DepthPrepass = std::wcstoul(args[++i], nullptr, 10) != 0;
+		}
+		else if (arg == L"-depthBuckets") {
+			depthSettings.DepthBucketCount = std::wcstoul(args[++i], nullptr, 10);
+		}
+	}
+	LocalFree(args);
+
 	try {
-		auto engine = Engine(windowManager, camera, inputManager);
+		auto engine = Engine(windowManager, camera, inputManager, framePacing, depthSettings);
 
 		engine.Initialize();
 
@@ -1,8 +1,8 @@
 #include "MathHelper.h"
 
-DirectX::XMFLOAT4X4 MathHelper::GetIdentity4x4()
+Float4x4 MathHelper::GetIdentity4x4()
 {
-	return DirectX::XMFLOAT4X4(
+	return Float4x4(
 		1.0f, 0.0f, 0.0f, 0.0f,
 		0.0f, 1.0f, 0.0f, 0.0f,
 		0.0f, 0.0f, 1.0f, 0.0f,
@@ -1,12 +1,12 @@
 #ifndef MATHHELPER_H_ 
 #define MATHHELPER_H_
 
-#include <DirectXMath.h>
+#include "MathTypes.h"
 
 class MathHelper
 {
 public:
-	static DirectX::XMFLOAT4X4 GetIdentity4x4();
+	static Float4x4 GetIdentity4x4();
 };
 
 #endif
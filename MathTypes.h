@@ -0,0 +1,55 @@
+#ifndef MATHTYPES_H_
+#define MATHTYPES_H_
+
+// Storage types of the platform neutral core. They have the layout of the
+// DirectXMath XMFLOAT types, so the Windows code can load and store them with
+// DirectXMath through a reinterpret_cast. Like those, the default constructor
+// leaves them uninitialized and value initialization zeroes them.
+
+struct Float2
+{
+	float x;
+	float y;
+
+	Float2() = default;
+	constexpr Float2(float _x, float _y) : x(_x), y(_y) {}
+};
+
+struct Float3
+{
+	float x;
+	float y;
+	float z;
+
+	Float3() = default;
+	constexpr Float3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+};
+
+struct Float4
+{
+	float x;
+	float y;
+	float z;
+	float w;
+
+	Float4() = default;
+	constexpr Float4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+};
+
+// Row-major 4x4 matrix.
+struct Float4x4
+{
+	float m[4][4];
+
+	Float4x4() = default;
+	constexpr Float4x4(
+		float m00, float m01, float m02, float m03,
+		float m10, float m11, float m12, float m13,
+		float m20, float m21, float m22, float m23,
+		float m30, float m31, float m32, float m33) :
+		m{ { m00, m01, m02, m03 }, { m10, m11, m12, m13 }, { m20, m21, m22, m23 }, { m30, m31, m32, m33 } }
+	{
+	}
+};
+
+#endif
@@ -4,13 +4,12 @@
 #include <vector>
 #include "VertexDefs.h"
 #include <string>
-#include <wrl.h>
-#include <d3dcommon.h>
-#include <d3d12.h>
+#include <cstdint>
 #include <unordered_map>
-#include <DirectXCollision.h>
-#include <DirectXMath.h>
 #include "MathHelper.h"
+#include "VertexFormat.h"
+#include "FrustumCulling.h"
+#include "RHI.h"
 
 // From Frank Luna's Dx12 Book.
 
@@ -20,15 +19,24 @@
 // buffers so that we can implement the technique described by Figure 6.3.
 struct SubmeshGeometry
 {
-	UINT IndexCount = 0;
-	UINT StartIndexLocation = 0;
-	INT BaseVertexLocation = 0;
+	std::uint32_t IndexCount = 0;
+	std::uint32_t StartIndexLocation = 0;
+	std::int32_t BaseVertexLocation = 0;
 
 	// Bounding box of the geometry defined by this submesh. 
 	// This is used in later chapters of the book.
-	DirectX::BoundingBox Bounds;
+	Aabb Bounds;
 };
 
+// Reference to the vertices and indices of one mesh in a GeometryArena.
+struct GeometryHandle
+{
+	static const std::uint32_t InvalidIndex = 0xffffffff;
+
+	std::uint32_t Index = InvalidIndex;
+
+	bool IsValid() const { return Index != InvalidIndex; }
+};
 
 struct Mesh
 {
@@ -37,60 +45,42 @@ public:
 
 	std::string Name;
 	std::vector<Vertex> Vertices;
+	// A mesh carries either 16 or 32 bit indices. ResourceManager::AddMesh packs
+	// Indices32 into Indices16 whenever the vertex count allows it.
 	std::vector<uint32> Indices32;
+	std::vector<std::uint16_t> Indices16;
 
 	int cbPerObjectIndex = -1;
-	DirectX::XMFLOAT4X4 World = MathHelper().GetIdentity4x4();
+	Float4x4 World = MathHelper().GetIdentity4x4();
 
-	// System memory copies.  Use Blobs because the vertex/index format can be generic.
-	// It is up to the client to cast appropriately.  
-	Microsoft::WRL::ComPtr<ID3DBlob> VertexBufferCPU = nullptr;
-	Microsoft::WRL::ComPtr<ID3DBlob> IndexBufferCPU = nullptr;
+	// Vertices packed into the GPU vertex format. Quantization holds what the
+	// vertex shader needs to decode quantized positions.
+	std::uint32_t VertexFormat = VertexFormatFlags_None;
+	std::vector<std::uint8_t> PackedVertices;
+	PositionQuantization Quantization;
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferGPU = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferGPU = nullptr;
+	// Place of the packed vertices and indices in the shared geometry buffers.
+	// Meshes with identical content share one place, found through GeometryHash.
+	GeometryHandle Geometry;
+	std::uint64_t GeometryHash = 0;
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferUploader = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
+	// The geometry is uploaded asynchronously. The mesh is drawn once the upload
+	// fence reached UploadFenceValue and ResourceManager marked it resident.
+	std::uint64_t UploadFenceValue = 0;
+	bool IsResident = false;
 
 	// Data about the buffers.
-	UINT VertexByteStride = 0;
-	UINT VertexBufferByteSize = 0;
-	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R32_UINT;
-	UINT IndexBufferByteSize = 0;
+	std::uint32_t VertexByteStride = 0;
+	// Stride of the position stream of split vertices, 0 if interleaved.
+	std::uint32_t PositionByteStride = 0;
+	std::uint32_t VertexBufferByteSize = 0;
+	::IndexFormat IndexFormat = ::IndexFormat::Uint32;
+	std::uint32_t IndexBufferByteSize = 0;
 
 	// A MeshGeometry may store multiple geometries in one vertex/index buffer.
 	// Use this container to define the Submesh geometries so we can draw
 	// the Submeshes individually.
 	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
-
-	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
-	{
-		D3D12_VERTEX_BUFFER_VIEW vbv;
-		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
-		vbv.StrideInBytes = VertexByteStride;
-		vbv.SizeInBytes = VertexBufferByteSize;
-
-		return vbv;
-	}
-
-	D3D12_INDEX_BUFFER_VIEW IndexBufferView()const
-	{
-		D3D12_INDEX_BUFFER_VIEW ibv;
-		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress();
-		ibv.Format = IndexFormat;
-		ibv.SizeInBytes = IndexBufferByteSize;
-
-		return ibv;
-	}
-
-	// We can free this memory after we finish upload to the GPU.
-	void DisposeUploaders()
-	{
-		VertexBufferUploader = nullptr;
-		IndexBufferUploader = nullptr;
-	}
-
 };
 
 #endif
@@ -1,12 +1,25 @@
 #include "MeshGenerator.h"
 #include "VertexDefs.h"
-#include <DirectXColors.h>
+#include <algorithm>
 #include <array>
-#include <GeometricPrimitive.h>
+#include <cfloat>
+#include <cmath>
 
-using namespace DirectX;
+namespace Colors {
 
-Mesh MeshGenerator::GenerateTriangle(XMFLOAT3 v1, XMFLOAT3 v2, XMFLOAT3 v3, std::string name)
+// The DirectXColors values of the colors used here.
+const Float4 White(1.0f, 1.0f, 1.0f, 1.0f);
+const Float4 Black(0.0f, 0.0f, 0.0f, 1.0f);
+const Float4 Red(1.0f, 0.0f, 0.0f, 1.0f);
+const Float4 Green(0.0f, 0.501960814f, 0.0f, 1.0f);
+const Float4 Blue(0.0f, 0.0f, 1.0f, 1.0f);
+const Float4 Yellow(1.0f, 1.0f, 0.0f, 1.0f);
+const Float4 Cyan(0.0f, 1.0f, 1.0f, 1.0f);
+const Float4 Magenta(1.0f, 0.0f, 1.0f, 1.0f);
+
+}
+
+Mesh MeshGenerator::GenerateTriangle(Float3 v1, Float3 v2, Float3 v3, std::string name)
 {
 	return Mesh();
 }
@@ -20,14 +33,14 @@ Mesh MeshGenerator::GenerateUnitBox(std::string name)
 {
 	std::vector<Vertex> vertices =
 	{
-		Vertex(XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT4(Colors::White), XMFLOAT3(), XMFLOAT3(), XMFLOAT2()),
-		Vertex(XMFLOAT3(-1.0f, +1.0f, -1.0f), XMFLOAT4(Colors::Black), XMFLOAT3(), XMFLOAT3(), XMFLOAT2()),
-		Vertex(XMFLOAT3(+1.0f, +1.0f, -1.0f), XMFLOAT4(Colors::Red), XMFLOAT3(), XMFLOAT3(), XMFLOAT2()),
-		Vertex(XMFLOAT3(+1.0f, -1.0f, -1.0f), XMFLOAT4(Colors::Green), XMFLOAT3(), XMFLOAT3(), XMFLOAT2()),
-		Vertex(XMFLOAT3(-1.0f, -1.0f, +1.0f), XMFLOAT4(Colors::Blue), XMFLOAT3(), XMFLOAT3(), XMFLOAT2()),
-		Vertex(XMFLOAT3(-1.0f, +1.0f, +1.0f), XMFLOAT4(Colors::Yellow), XMFLOAT3(), XMFLOAT3(), XMFLOAT2()),
-		Vertex(XMFLOAT3(+1.0f, +1.0f, +1.0f), XMFLOAT4(Colors::Cyan), XMFLOAT3(), XMFLOAT3(), XMFLOAT2()),
-		Vertex(XMFLOAT3(+1.0f, -1.0f, +1.0f), XMFLOAT4(Colors::Magenta), XMFLOAT3(), XMFLOAT3(), XMFLOAT2())
+		Vertex(Float3(-1.0f, -1.0f, -1.0f), Float4(Colors::White), Float3(), Float3(), Float2()),
+		Vertex(Float3(-1.0f, +1.0f, -1.0f), Float4(Colors::Black), Float3(), Float3(), Float2()),
+		Vertex(Float3(+1.0f, +1.0f, -1.0f), Float4(Colors::Red), Float3(), Float3(), Float2()),
+		Vertex(Float3(+1.0f, -1.0f, -1.0f), Float4(Colors::Green), Float3(), Float3(), Float2()),
+		Vertex(Float3(-1.0f, -1.0f, +1.0f), Float4(Colors::Blue), Float3(), Float3(), Float2()),
+		Vertex(Float3(-1.0f, +1.0f, +1.0f), Float4(Colors::Yellow), Float3(), Float3(), Float2()),
+		Vertex(Float3(+1.0f, +1.0f, +1.0f), Float4(Colors::Cyan), Float3(), Float3(), Float2()),
+		Vertex(Float3(+1.0f, -1.0f, +1.0f), Float4(Colors::Magenta), Float3(), Float3(), Float2())
 	};
 
 	// Indices defined in a clockwise order to indicate the front facing side
@@ -69,7 +82,7 @@ Mesh MeshGenerator::GenerateUnitBox(std::string name)
 
 	boxMesh.VertexByteStride = sizeof(Vertex);
 	boxMesh.VertexBufferByteSize = verticesByteSize;
-	boxMesh.IndexFormat = DXGI_FORMAT_R32_UINT;
+	boxMesh.IndexFormat = IndexFormat::Uint32;
 	boxMesh.IndexBufferByteSize = indicesByteSize;
 
 	SubmeshGeometry submesh;
@@ -78,6 +91,7 @@ Mesh MeshGenerator::GenerateUnitBox(std::string name)
 	submesh.BaseVertexLocation = 0;
 
 	boxMesh.DrawArgs[boxMesh.Name] = submesh;
+	ComputeBounds(boxMesh);
 
 	return boxMesh;
 }
@@ -89,13 +103,13 @@ Mesh MeshGenerator::GenerateGrid(std::string name, int width, int length)
 	// Compute grid vertices
 	for (int row = 0; row <= width; row++) {
 		for (int col = 0; col <= length; col++) {
-			auto color = col * row % 2 == 0 ? XMFLOAT4(Colors::Black) : XMFLOAT4(Colors::White);
+			auto color = col * row % 2 == 0 ? Float4(Colors::Black) : Float4(Colors::White);
 			Vertex vertex = Vertex(
-				XMFLOAT3(-width / 2 + row, -1.0f, -length / 2 + col),
+				Float3(-width / 2 + row, -1.0f, -length / 2 + col),
 				color,
-				XMFLOAT3(), // Normal
-				XMFLOAT3(), // Tangent
-				XMFLOAT2()  // Tex Coord
+				Float3(), // Normal
+				Float3(), // Tangent
+				Float2()  // Tex Coord
 			);
 			gridMesh.Vertices.push_back(vertex);
 		}
@@ -138,7 +152,7 @@ Mesh MeshGenerator::GenerateGrid(std::string name, int width, int length)
 
 	gridMesh.VertexByteStride = sizeof(Vertex);
 	gridMesh.VertexBufferByteSize = verticesByteSize;
-	gridMesh.IndexFormat = DXGI_FORMAT_R32_UINT;
+	gridMesh.IndexFormat = IndexFormat::Uint32;
 	gridMesh.IndexBufferByteSize = indicesByteSize;
 
 	SubmeshGeometry submesh;
@@ -147,6 +161,7 @@ Mesh MeshGenerator::GenerateGrid(std::string name, int width, int length)
 	submesh.BaseVertexLocation = 0;
 
 	gridMesh.DrawArgs[gridMesh.Name] = submesh;
+	ComputeBounds(gridMesh);
 
 	return gridMesh;
 }
@@ -154,77 +169,147 @@ Mesh MeshGenerator::GenerateGrid(std::string name, int width, int length)
 Mesh MeshGenerator::GenerateSphere(std::string name, float radius)
 {
 	Mesh sphereMesh = Mesh();
-	std::vector<uint16_t> indices;
-	auto vertices = std::vector<GeometricPrimitive::VertexType>();
-	GeometricPrimitive::CreateSphere(vertices, indices, radius, 16, false);
-
-	for (auto v : vertices) {
-		auto color = XMFLOAT4(v.position.x, v.position.y, v.position.z, 1.0f);
-		sphereMesh.Vertices.push_back(
-			Vertex(v.position, color, XMFLOAT3(), XMFLOAT3(), XMFLOAT2())
-		);
+
+	// Latitude rings from the bottom to the top pole, the tessellation of
+	// DirectXTK's GeometricPrimitive::CreateSphere with radius as its diameter.
+	const int verticalSegments = 16;
+	const int horizontalSegments = verticalSegments * 2;
+	const float pi = 3.14159265f;
+	for (int i = 0; i <= verticalSegments; i++) {
+		float latitude = i * pi / verticalSegments - pi / 2;
+		float dy = std::sin(latitude);
+		float dxz = std::cos(latitude);
+
+		for (int j = 0; j <= horizontalSegments; j++) {
+			float longitude = j * 2 * pi / horizontalSegments;
+			float dx = std::sin(longitude) * dxz;
+			float dz = std::cos(longitude) * dxz;
+
+			auto position = Float3(dx * radius / 2, dy * radius / 2, dz * radius / 2);
+			auto color = Float4(position.x, position.y, position.z, 1.0f);
+			sphereMesh.Vertices.push_back(
+				Vertex(position, color, Float3(), Float3(), Float2())
+			);
+		}
 	}
 
-	for (auto indice16 : indices) {
-		sphereMesh.Indices32.push_back(indice16);
+	// Clockwise triangles between neighbouring rings, for a left-handed view.
+	const int stride = horizontalSegments + 1;
+	for (int i = 0; i < verticalSegments; i++) {
+		for (int j = 0; j <= horizontalSegments; j++) {
+			int nextI = i + 1;
+			int nextJ = (j + 1) % stride;
+
+			sphereMesh.Indices16.push_back(static_cast<uint16_t>(i * stride + nextJ));
+			sphereMesh.Indices16.push_back(static_cast<uint16_t>(nextI * stride + j));
+			sphereMesh.Indices16.push_back(static_cast<uint16_t>(i * stride + j));
+
+			sphereMesh.Indices16.push_back(static_cast<uint16_t>(nextI * stride + nextJ));
+			sphereMesh.Indices16.push_back(static_cast<uint16_t>(nextI * stride + j));
+			sphereMesh.Indices16.push_back(static_cast<uint16_t>(i * stride + nextJ));
+		}
 	}
 
 	sphereMesh.Name = name;
 
 	int verticesByteSize = sphereMesh.Vertices.size() * sizeof(Vertex);
-	int indicesByteSize = sphereMesh.Indices32.size() * sizeof(uint32_t);
+	int indicesByteSize = sphereMesh.Indices16.size() * sizeof(uint16_t);
 
 
 	sphereMesh.VertexByteStride = sizeof(Vertex);
 	sphereMesh.VertexBufferByteSize = verticesByteSize;
-	sphereMesh.IndexFormat = DXGI_FORMAT_R32_UINT;
+	sphereMesh.IndexFormat = IndexFormat::Uint16;
 	sphereMesh.IndexBufferByteSize = indicesByteSize;
 
 	SubmeshGeometry submesh;
-	submesh.IndexCount = sphereMesh.Indices32.size();
+	submesh.IndexCount = sphereMesh.Indices16.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
 	sphereMesh.DrawArgs[sphereMesh.Name] = submesh;
+	ComputeBounds(sphereMesh);
 
 	return sphereMesh;
 }
 
-Mesh MeshGenerator::GenerateTeapot(std::string name)
+MeshOptimizationStats MeshGenerator::OptimizeMesh(Mesh& mesh)
 {
-	Mesh teapotMesh = Mesh();
-	std::vector<uint16_t> indices;
-	auto vertices = std::vector<GeometricPrimitive::VertexType>();
-	GeometricPrimitive::CreateTeapot(vertices, indices, 1.0f, 16, false);
-
-	for (auto v : vertices) {
-		auto color = XMFLOAT4(v.position.x, v.position.y, v.position.z, 1.0f);
-		teapotMesh.Vertices.push_back(
-			Vertex(v.position, color, XMFLOAT3(), XMFLOAT3(), XMFLOAT2())
-		);
-	}
+	std::vector<uint32_t> indices = mesh.Indices16.empty() ?
+		mesh.Indices32 : std::vector<uint32_t>(mesh.Indices16.begin(), mesh.Indices16.end());
+
+	// Stats are measured on absolute vertex indices so submeshes sharing vertices count correctly.
+	auto analyze = [&]() {
+		std::vector<uint32_t> absolute;
+		absolute.reserve(indices.size());
+		for (const auto& drawArg : mesh.DrawArgs) {
+			const auto& submesh = drawArg.second;
+			for (std::uint32_t i = 0; i < submesh.IndexCount; i++) {
+				absolute.push_back(indices[submesh.StartIndexLocation + i] + submesh.BaseVertexLocation);
+			}
+		}
+		return AnalyzeVertexCache(absolute.data(), absolute.size(), mesh.Vertices.size());
+	};
 
-	for (auto indice16 : indices) {
-		teapotMesh.Indices32.push_back(indice16);
-	}
+	MeshOptimizationStats stats;
+	stats.Before = analyze();
+
+	for (const auto& drawArg : mesh.DrawArgs) {
+		const auto& submesh = drawArg.second;
+		if (submesh.IndexCount == 0) {
+			continue;
+		}
 
-	teapotMesh.Name = name;
+		auto* submeshIndices = indices.data() + submesh.StartIndexLocation;
+		auto vertexCount = mesh.Vertices.size() - submesh.BaseVertexLocation;
 
-	int verticesByteSize = teapotMesh.Vertices.size() * sizeof(Vertex);
-	int indicesByteSize = teapotMesh.Indices32.size() * sizeof(uint32_t);
+		OptimizeVertexCache(submeshIndices, submeshIndices, submesh.IndexCount, vertexCount);
+		OptimizeOverdraw(submeshIndices, submeshIndices, submesh.IndexCount,
+			&mesh.Vertices[submesh.BaseVertexLocation].Position.x, sizeof(Vertex), vertexCount);
+	}
 
+	// Vertices can only be renumbered when a single submesh owns all of them.
+	bool ownsAllVertices = mesh.DrawArgs.size() == 1 && mesh.DrawArgs.begin()->second.BaseVertexLocation == 0 &&
+		mesh.DrawArgs.begin()->second.IndexCount == indices.size();
+	if (ownsAllVertices) {
+		std::vector<uint32_t> remap;
+		auto vertexCount = OptimizeVertexFetch(indices.data(), indices.size(), mesh.Vertices.size(), remap);
+		RemapVertices(mesh.Vertices, remap, vertexCount);
+		mesh.VertexBufferByteSize = mesh.Vertices.size() * sizeof(Vertex);
+	}
 
-	teapotMesh.VertexByteStride = sizeof(Vertex);
-	teapotMesh.VertexBufferByteSize = verticesByteSize;
-	teapotMesh.IndexFormat = DXGI_FORMAT_R32_UINT;
-	teapotMesh.IndexBufferByteSize = indicesByteSize;
+	stats.After = analyze();
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = teapotMesh.Indices32.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
+	if (mesh.Indices16.empty()) {
+		mesh.Indices32 = indices;
+	}
+	else {
+		mesh.Indices16.assign(indices.begin(), indices.end());
+	}
 
-	teapotMesh.DrawArgs[teapotMesh.Name] = submesh;
+	return stats;
+}
 
-	return teapotMesh;
+void MeshGenerator::ComputeBounds(Mesh& mesh)
+{
+	for (auto& drawArg : mesh.DrawArgs) {
+		auto& submesh = drawArg.second;
+
+		float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (std::uint32_t i = 0; i < submesh.IndexCount; i++) {
+			auto index = mesh.Indices16.empty() ?
+				mesh.Indices32[submesh.StartIndexLocation + i] : mesh.Indices16[submesh.StartIndexLocation + i];
+			const auto& position = mesh.Vertices[index + submesh.BaseVertexLocation].Position;
+			minimum[0] = std::min(minimum[0], position.x);
+			minimum[1] = std::min(minimum[1], position.y);
+			minimum[2] = std::min(minimum[2], position.z);
+			maximum[0] = std::max(maximum[0], position.x);
+			maximum[1] = std::max(maximum[1], position.y);
+			maximum[2] = std::max(maximum[2], position.z);
+		}
+
+		if (submesh.IndexCount > 0) {
+			submesh.Bounds = MakeAabb(minimum, maximum);
+		}
+	}
 }
@@ -1,16 +1,27 @@
 #ifndef MESHGENERATOR_H_ 
 #define MESHGENERATOR_H_
 #include "Mesh.h"
+#include "MeshOptimizer.h"
 
 class MeshGenerator
 {
 public:
-	static Mesh GenerateTriangle(XMFLOAT3 v1, XMFLOAT3 v2, XMFLOAT3 v3, std::string name);
+	static Mesh GenerateTriangle(Float3 v1, Float3 v2, Float3 v3, std::string name);
 	static Mesh GenerateUnitCircle(std::string name);
 	static Mesh GenerateUnitBox(std::string name);
 	static Mesh GenerateGrid(std::string name, int width, int length);
 	static Mesh GenerateSphere(std::string name, float radius = 1.0f);
+#if defined(_WIN32)
+	// Uses DirectXTK, see MeshGeneratorTeapot.cpp.
 	static Mesh GenerateTeapot(std::string name);
+#endif
+
+	// Reorders the triangles and vertices of every submesh for the post-transform
+	// cache, overdraw and vertex fetch. Call before ResourceManager::AddMesh.
+	static MeshOptimizationStats OptimizeMesh(Mesh& mesh);
+
+	// Sets the bounds of every submesh from the vertices its indices reference.
+	static void ComputeBounds(Mesh& mesh);
 
 private:
 };
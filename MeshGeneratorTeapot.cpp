@@ -0,0 +1,46 @@
+#include "MeshGenerator.h"
+#include "VertexDefs.h"
+#include <GeometricPrimitive.h>
+
+// The teapot is tessellated from the Bezier patches of DirectXTK, so unlike the
+// other meshes of MeshGenerator it is only built with the Windows application.
+
+using namespace DirectX;
+
+Mesh MeshGenerator::GenerateTeapot(std::string name)
+{
+	Mesh teapotMesh = Mesh();
+	std::vector<uint16_t> indices;
+	auto vertices = std::vector<GeometricPrimitive::VertexType>();
+	GeometricPrimitive::CreateTeapot(vertices, indices, 1.0f, 16, false);
+
+	for (auto v : vertices) {
+		auto color = Float4(v.position.x, v.position.y, v.position.z, 1.0f);
+		teapotMesh.Vertices.push_back(
+			Vertex(Float3(v.position.x, v.position.y, v.position.z), color, Float3(), Float3(), Float2())
+		);
+	}
+
+	teapotMesh.Indices16 = std::move(indices);
+
+	teapotMesh.Name = name;
+
+	int verticesByteSize = teapotMesh.Vertices.size() * sizeof(Vertex);
+	int indicesByteSize = teapotMesh.Indices16.size() * sizeof(uint16_t);
+
+
+	teapotMesh.VertexByteStride = sizeof(Vertex);
+	teapotMesh.VertexBufferByteSize = verticesByteSize;
+	teapotMesh.IndexFormat = IndexFormat::Uint16;
+	teapotMesh.IndexBufferByteSize = indicesByteSize;
+
+	SubmeshGeometry submesh;
+	submesh.IndexCount = teapotMesh.Indices16.size();
+	submesh.StartIndexLocation = 0;
+	submesh.BaseVertexLocation = 0;
+
+	teapotMesh.DrawArgs[teapotMesh.Name] = submesh;
+	ComputeBounds(teapotMesh);
+
+	return teapotMesh;
+}
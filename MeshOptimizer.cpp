@@ -0,0 +1,379 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const std::uint32_t InvalidIndex = 0xffffffff;
+
+// Size of the LRU cache modelled by the Forsyth scores. It is larger than the
+// real FIFO caches on purpose, the scores only need to prefer recent vertices.
+const int ForsythCacheSize = 32;
+const int ForsythMaxValence = 32;
+
+struct ForsythScoreTable
+{
+	float CachePosition[ForsythCacheSize];
+	float Valence[ForsythMaxValence + 1];
+
+	ForsythScoreTable()
+	{
+		// The vertices of the last triangle get a fixed lower score so the next
+		// triangle does not simply reuse the same edge every time.
+		for (int i = 0; i < ForsythCacheSize; i++) {
+			CachePosition[i] = i < 3 ? 0.75f :
+				std::pow(1.0f - static_cast<float>(i - 3) / (ForsythCacheSize - 3), 1.5f);
+		}
+
+		// Vertices with few triangles left are boosted to get rid of lone triangles.
+		Valence[0] = 0.0f;
+		for (int i = 1; i <= ForsythMaxValence; i++) {
+			Valence[i] = 2.0f / std::sqrt(static_cast<float>(i));
+		}
+	}
+
+	float VertexScore(int cachePosition, std::uint32_t remainingValence) const
+	{
+		if (remainingValence == 0) {
+			return 0.0f;
+		}
+
+		float score = cachePosition >= 0 ? CachePosition[cachePosition] : 0.0f;
+		return score + Valence[std::min<std::uint32_t>(remainingValence, ForsythMaxValence)];
+	}
+};
+
+// FIFO cache simulation. A vertex is cached while fewer than cacheSize
+// transforms happened since its own transform.
+class FifoCache
+{
+public:
+	FifoCache(std::size_t vertexCount, std::uint32_t cacheSize) :
+		m_timestamps(vertexCount, 0),
+		m_cacheSize(cacheSize),
+		m_time(cacheSize + 1)
+	{
+	}
+
+	// Returns true if the vertex had to be transformed.
+	bool Access(std::uint32_t vertex)
+	{
+		if (m_time - m_timestamps[vertex] > m_cacheSize) {
+			m_timestamps[vertex] = m_time++;
+			return true;
+		}
+		return false;
+	}
+
+	void Flush()
+	{
+		m_time += m_cacheSize + 1;
+	}
+
+private:
+	std::vector<std::uint32_t> m_timestamps;
+	std::uint32_t m_cacheSize;
+	std::uint32_t m_time;
+};
+
+void Subtract(const float* a, const float* b, float* result)
+{
+	for (int i = 0; i < 3; i++) {
+		result[i] = a[i] - b[i];
+	}
+}
+
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::uint32_t* indices, std::size_t indexCount, std::size_t vertexCount,
+	std::uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+	stats.TriangleCount = static_cast<std::uint32_t>(indexCount / 3);
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	std::uint32_t referencedCount = 0;
+
+	for (std::size_t i = 0; i < stats.TriangleCount * 3; i++) {
+		if (cache.Access(indices[i])) {
+			stats.VertexTransforms++;
+		}
+		if (!referenced[indices[i]]) {
+			referenced[indices[i]] = true;
+			referencedCount++;
+		}
+	}
+
+	stats.Acmr = stats.TriangleCount > 0 ? static_cast<float>(stats.VertexTransforms) / stats.TriangleCount : 0.0f;
+	stats.Atvr = referencedCount > 0 ? static_cast<float>(stats.VertexTransforms) / referencedCount : 0.0f;
+	return stats;
+}
+
+void OptimizeVertexCache(std::uint32_t* destination, const std::uint32_t* indices, std::size_t indexCount, std::size_t vertexCount)
+{
+	static const ForsythScoreTable scoreTable;
+
+	std::vector<std::uint32_t> input(indices, indices + indexCount);
+	std::size_t triangleCount = indexCount / 3;
+
+	// Triangles using each vertex. The first Remaining entries of every list are
+	// the triangles that have not been emitted yet.
+	std::vector<std::uint32_t> remaining(vertexCount, 0);
+	for (std::size_t i = 0; i < triangleCount * 3; i++) {
+		remaining[input[i]]++;
+	}
+
+	std::vector<std::uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (std::size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+	}
+
+	std::vector<std::uint32_t> adjacency(triangleCount * 3);
+	std::vector<std::uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (std::size_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[fill[input[i]]++] = static_cast<std::uint32_t>(i / 3);
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (std::size_t v = 0; v < vertexCount; v++) {
+		vertexScores[v] = scoreTable.VertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	std::uint32_t bestTriangle = InvalidIndex;
+	float bestScore = -1.0f;
+	for (std::size_t t = 0; t < triangleCount; t++) {
+		triangleScores[t] = vertexScores[input[t * 3]] + vertexScores[input[t * 3 + 1]] + vertexScores[input[t * 3 + 2]];
+		if (triangleScores[t] > bestScore) {
+			bestScore = triangleScores[t];
+			bestTriangle = static_cast<std::uint32_t>(t);
+		}
+	}
+
+	std::uint32_t cache[ForsythCacheSize + 3];
+	int cacheCount = 0;
+	std::size_t fallbackCursor = 0;
+
+	for (std::size_t output = 0; output < triangleCount; output++) {
+		// Nothing in the cache is connected to a remaining triangle, restart at the
+		// next triangle in input order.
+		if (bestTriangle == InvalidIndex) {
+			while (emitted[fallbackCursor]) {
+				fallbackCursor++;
+			}
+			bestTriangle = static_cast<std::uint32_t>(fallbackCursor);
+		}
+
+		const std::uint32_t* triangle = &input[bestTriangle * 3];
+		destination[output * 3] = triangle[0];
+		destination[output * 3 + 1] = triangle[1];
+		destination[output * 3 + 2] = triangle[2];
+		emitted[bestTriangle] = true;
+
+		for (int i = 0; i < 3; i++) {
+			auto vertex = triangle[i];
+			auto* list = &adjacency[adjacencyOffsets[vertex]];
+			auto count = remaining[vertex];
+			for (std::uint32_t j = 0; j < count; j++) {
+				if (list[j] == bestTriangle) {
+					std::swap(list[j], list[count - 1]);
+					remaining[vertex]--;
+					break;
+				}
+			}
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache.
+		std::uint32_t newCache[ForsythCacheSize + 3];
+		int newCacheCount = 0;
+		for (int i = 0; i < 3; i++) {
+			if (std::find(newCache, newCache + newCacheCount, triangle[i]) == newCache + newCacheCount) {
+				newCache[newCacheCount++] = triangle[i];
+			}
+		}
+		for (int i = 0; i < cacheCount; i++) {
+			if (std::find(newCache, newCache + newCacheCount, cache[i]) == newCache + newCacheCount) {
+				newCache[newCacheCount++] = cache[i];
+			}
+		}
+
+		// Entries pushed past the end are evicted but still need their scores updated.
+		for (int i = 0; i < newCacheCount; i++) {
+			auto vertex = newCache[i];
+			cachePositions[vertex] = i < ForsythCacheSize ? i : -1;
+			vertexScores[vertex] = scoreTable.VertexScore(cachePositions[vertex], remaining[vertex]);
+		}
+
+		bestTriangle = InvalidIndex;
+		bestScore = -1.0f;
+		for (int i = 0; i < newCacheCount; i++) {
+			auto vertex = newCache[i];
+			const auto* list = &adjacency[adjacencyOffsets[vertex]];
+			for (std::uint32_t j = 0; j < remaining[vertex]; j++) {
+				auto t = list[j];
+				const std::uint32_t* tri = &input[t * 3];
+				triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+				if (triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCacheCount, ForsythCacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+	}
+}
+
+void OptimizeOverdraw(std::uint32_t* destination, const std::uint32_t* indices, std::size_t indexCount,
+	const float* positions, std::size_t positionStride, std::size_t vertexCount, float threshold)
+{
+	std::vector<std::uint32_t> input(indices, indices + indexCount);
+	std::size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	auto position = [&](std::uint32_t vertex) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const std::uint8_t*>(positions) + positionStride * vertex);
+	};
+
+	// Hard boundaries are where all three vertices of a triangle miss the cache.
+	// Reordering whole clusters between them barely changes the ACMR.
+	std::vector<std::uint32_t> triangleMisses(triangleCount);
+	std::vector<std::uint32_t> hardClusters;
+	{
+		FifoCache cache(vertexCount, DefaultVertexCacheSize);
+		for (std::size_t t = 0; t < triangleCount; t++) {
+			triangleMisses[t] = cache.Access(input[t * 3]) + cache.Access(input[t * 3 + 1]) + cache.Access(input[t * 3 + 2]);
+			if (t == 0 || triangleMisses[t] == 3) {
+				hardClusters.push_back(static_cast<std::uint32_t>(t));
+			}
+		}
+	}
+	hardClusters.push_back(static_cast<std::uint32_t>(triangleCount));
+
+	// Soft boundaries split hard clusters further as long as restarting with an
+	// empty cache keeps the cluster's ACMR within the threshold.
+	std::vector<std::uint32_t> clusters;
+	{
+		FifoCache cache(vertexCount, DefaultVertexCacheSize);
+		for (std::size_t c = 0; c + 1 < hardClusters.size(); c++) {
+			auto start = hardClusters[c];
+			auto end = hardClusters[c + 1];
+
+			std::uint32_t clusterMisses = 0;
+			for (auto t = start; t < end; t++) {
+				clusterMisses += triangleMisses[t];
+			}
+			float targetAcmr = static_cast<float>(clusterMisses) / (end - start) * threshold;
+
+			cache.Flush();
+			clusters.push_back(start);
+			std::uint32_t softStart = start;
+			std::uint32_t softMisses = 0;
+			for (auto t = start; t < end; t++) {
+				softMisses += cache.Access(input[t * 3]) + cache.Access(input[t * 3 + 1]) + cache.Access(input[t * 3 + 2]);
+				if (t + 1 < end && static_cast<float>(softMisses) / (t + 1 - softStart) <= targetAcmr) {
+					cache.Flush();
+					clusters.push_back(t + 1);
+					softStart = t + 1;
+					softMisses = 0;
+				}
+			}
+		}
+	}
+	clusters.push_back(static_cast<std::uint32_t>(triangleCount));
+
+	// Area weighted centroid and normal of every cluster.
+	std::size_t clusterCount = clusters.size() - 1;
+	std::vector<float> clusterData(clusterCount * 6, 0.0f);
+	std::vector<float> clusterArea(clusterCount, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+
+	for (std::size_t c = 0; c < clusterCount; c++) {
+		float* centroid = &clusterData[c * 6];
+		float* normal = &clusterData[c * 6 + 3];
+		for (auto t = clusters[c]; t < clusters[c + 1]; t++) {
+			const float* p0 = position(input[t * 3]);
+			const float* p1 = position(input[t * 3 + 1]);
+			const float* p2 = position(input[t * 3 + 2]);
+
+			float e1[3], e2[3];
+			Subtract(p1, p0, e1);
+			Subtract(p2, p0, e2);
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int i = 0; i < 3; i++) {
+				centroid[i] += (p0[i] + p1[i] + p2[i]) / 3.0f * area;
+				normal[i] += n[i];
+			}
+			clusterArea[c] += area;
+		}
+
+		for (int i = 0; i < 3; i++) {
+			meshCentroid[i] += centroid[i];
+			if (clusterArea[c] > 0.0f) {
+				centroid[i] /= clusterArea[c];
+			}
+		}
+		meshArea += clusterArea[c];
+	}
+
+	for (int i = 0; i < 3; i++) {
+		meshCentroid[i] = meshArea > 0.0f ? meshCentroid[i] / meshArea : 0.0f;
+	}
+
+	// Clusters far out along their own normal occlude the rest and go first.
+	std::vector<float> sortKeys(clusterCount);
+	std::vector<std::uint32_t> order(clusterCount);
+	for (std::size_t c = 0; c < clusterCount; c++) {
+		const float* centroid = &clusterData[c * 6];
+		const float* normal = &clusterData[c * 6 + 3];
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		float offset[3];
+		Subtract(centroid, meshCentroid, offset);
+		sortKeys[c] = length > 0.0f ? (offset[0] * normal[0] + offset[1] * normal[1] + offset[2] * normal[2]) / length : 0.0f;
+		order[c] = static_cast<std::uint32_t>(c);
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	std::vector<std::uint32_t> result;
+	result.reserve(triangleCount * 3);
+	for (auto c : order) {
+		result.insert(result.end(), input.begin() + clusters[c] * 3, input.begin() + clusters[c + 1] * 3);
+	}
+
+	// The tail of a cluster can be worse than its head, never trade more vertex
+	// work than the threshold allows.
+	auto before = AnalyzeVertexCache(input.data(), triangleCount * 3, vertexCount);
+	auto after = AnalyzeVertexCache(result.data(), triangleCount * 3, vertexCount);
+	const auto& chosen = after.Acmr <= before.Acmr * threshold ? result : input;
+	std::copy(chosen.begin(), chosen.begin() + triangleCount * 3, destination);
+}
+
+std::size_t OptimizeVertexFetch(std::uint32_t* indices, std::size_t indexCount, std::size_t vertexCount,
+	std::vector<std::uint32_t>& remap)
+{
+	remap.assign(vertexCount, InvalidIndex);
+
+	std::uint32_t nextVertex = 0;
+	for (std::size_t i = 0; i < indexCount; i++) {
+		auto& index = indices[i];
+		if (remap[index] == InvalidIndex) {
+			remap[index] = nextVertex++;
+		}
+		index = remap[index];
+	}
+
+	return nextVertex;
+}
@@ -0,0 +1,65 @@
+#ifndef MESHOPTIMIZER_H_
+#define MESHOPTIMIZER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Triangle list reordering for the GPU. The usual pipeline is
+// OptimizeVertexCache -> OptimizeOverdraw -> OptimizeVertexFetch -> RemapVertices.
+// Every function that writes indices accepts destination == indices.
+
+static const std::uint32_t DefaultVertexCacheSize = 16;
+
+// Results of running a triangle list through a FIFO post-transform cache.
+// ACMR is transformed vertices per triangle (0.5 is ideal for large regular
+// meshes, 3 is the worst case). ATVR is transformed vertices per referenced
+// vertex (1 is ideal).
+struct VertexCacheStats
+{
+	std::uint32_t VertexTransforms = 0;
+	std::uint32_t TriangleCount = 0;
+	float Acmr = 0.0f;
+	float Atvr = 0.0f;
+};
+
+struct MeshOptimizationStats
+{
+	VertexCacheStats Before;
+	VertexCacheStats After;
+};
+
+VertexCacheStats AnalyzeVertexCache(const std::uint32_t* indices, std::size_t indexCount, std::size_t vertexCount,
+	std::uint32_t cacheSize = DefaultVertexCacheSize);
+
+// Reorders triangles for vertex reuse using Forsyth's linear speed algorithm.
+void OptimizeVertexCache(std::uint32_t* destination, const std::uint32_t* indices, std::size_t indexCount, std::size_t vertexCount);
+
+// Splits a cache optimized triangle list into clusters and sorts them so that
+// outward facing clusters on the outside of the mesh are drawn first, which
+// reduces overdraw from most view directions. Clusters are only split where the
+// ACMR of the result stays within threshold times that of the input.
+void OptimizeOverdraw(std::uint32_t* destination, const std::uint32_t* indices, std::size_t indexCount,
+	const float* positions, std::size_t positionStride, std::size_t vertexCount, float threshold = 1.05f);
+
+// Renumbers vertices in the order they are first referenced so vertex fetches
+// walk memory linearly. Rewrites indices in place and fills remap with the new
+// index of every old vertex, or 0xffffffff for unreferenced vertices. Returns the
+// number of referenced vertices.
+std::size_t OptimizeVertexFetch(std::uint32_t* indices, std::size_t indexCount, std::size_t vertexCount,
+	std::vector<std::uint32_t>& remap);
+
+// Applies a remap produced by OptimizeVertexFetch to a vertex array.
+template <typename TVertex>
+void RemapVertices(std::vector<TVertex>& vertices, const std::vector<std::uint32_t>& remap, std::size_t remappedCount)
+{
+	std::vector<TVertex> remapped(remappedCount);
+	for (std::size_t i = 0; i < vertices.size() && i < remap.size(); i++) {
+		if (remap[i] != 0xffffffff) {
+			remapped[remap[i]] = vertices[i];
+		}
+	}
+	vertices.swap(remapped);
+}
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef MESHREGISTRY_H_
+#define MESHREGISTRY_H_
+
+#include "DrawItem.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Stable reference to a mesh in a MeshRegistry. The generation is bumped every
+// time a slot is reused so handles to removed meshes are detected.
+struct MeshHandle
+{
+	static const std::uint32_t InvalidIndex = 0xffffffff;
+
+	std::uint32_t Index = InvalidIndex;
+	std::uint32_t Generation = 0;
+
+	bool IsValid() const { return Index != InvalidIndex; }
+	bool operator==(const MeshHandle& other) const { return Index == other.Index && Generation == other.Generation; }
+	bool operator!=(const MeshHandle& other) const { return !(*this == other); }
+};
+
+// Generational slot map for meshes. The data needed to draw the meshes is kept in
+// a dense array of draw items that can be iterated without any copies, while the
+// rest of the mesh (CPU side geometry, owned GPU resources, ...) is kept in a
+// parallel array. A mesh owns a contiguous block of draw items, which is empty
+// while the mesh can not be drawn yet.
+// Removing a mesh moves the last mesh into the hole, and the draw items at the
+// end of the array into the hole its draw items leave, so all arrays stay packed.
+template <typename TMesh>
+class MeshRegistry
+{
+public:
+	MeshHandle Add(TMesh mesh, const DrawItem& drawItem, const std::string& name = std::string())
+	{
+		return Add(std::move(mesh), &drawItem, 1, name);
+	}
+
+	MeshHandle Add(TMesh mesh, const DrawItem* drawItems, std::uint32_t drawItemCount, const std::string& name = std::string())
+	{
+		std::uint32_t slotIndex;
+		if (m_freeSlotHead != MeshHandle::InvalidIndex) {
+			slotIndex = m_freeSlotHead;
+			m_freeSlotHead = m_slots[slotIndex].NextFree;
+		}
+		else {
+			slotIndex = static_cast<std::uint32_t>(m_slots.size());
+			m_slots.push_back(Slot());
+		}
+
+		auto& slot = m_slots[slotIndex];
+		slot.DenseIndex = static_cast<std::uint32_t>(m_meshes.size());
+		slot.NextFree = MeshHandle::InvalidIndex;
+
+		DrawRange drawRange;
+		drawRange.First = static_cast<std::uint32_t>(m_drawItems.size());
+		drawRange.Count = drawItemCount;
+		m_drawItems.insert(m_drawItems.end(), drawItems, drawItems + drawItemCount);
+		m_drawItemOwners.insert(m_drawItemOwners.end(), drawItemCount, slot.DenseIndex);
+
+		m_meshes.push_back(std::move(mesh));
+		m_drawRanges.push_back(drawRange);
+		m_denseToSlot.push_back(slotIndex);
+		m_version++;
+
+		MeshHandle handle;
+		handle.Index = slotIndex;
+		handle.Generation = slot.Generation;
+
+		if (!name.empty()) {
+			m_nameIndex[name] = handle;
+			m_denseNames.push_back(name);
+		}
+		else {
+			m_denseNames.push_back(std::string());
+		}
+
+		return handle;
+	}
+
+	bool Remove(MeshHandle handle)
+	{
+		if (!IsValid(handle)) {
+			return false;
+		}
+
+		auto& slot = m_slots[handle.Index];
+		auto denseIndex = slot.DenseIndex;
+		auto lastIndex = static_cast<std::uint32_t>(m_meshes.size() - 1);
+
+		if (!m_denseNames[denseIndex].empty()) {
+			m_nameIndex.erase(m_denseNames[denseIndex]);
+		}
+
+		RemoveDrawItems(m_drawRanges[denseIndex]);
+
+		// Move the last element into the hole to keep the arrays dense.
+		if (denseIndex != lastIndex) {
+			m_meshes[denseIndex] = std::move(m_meshes[lastIndex]);
+			m_drawRanges[denseIndex] = m_drawRanges[lastIndex];
+			m_denseNames[denseIndex] = std::move(m_denseNames[lastIndex]);
+			m_denseToSlot[denseIndex] = m_denseToSlot[lastIndex];
+			m_slots[m_denseToSlot[denseIndex]].DenseIndex = denseIndex;
+
+			const auto& drawRange = m_drawRanges[denseIndex];
+			std::fill(m_drawItemOwners.begin() + drawRange.First, m_drawItemOwners.begin() + drawRange.First + drawRange.Count, denseIndex);
+		}
+
+		m_meshes.pop_back();
+		m_drawRanges.pop_back();
+		m_denseNames.pop_back();
+		m_denseToSlot.pop_back();
+
+		slot.Generation++;
+		slot.DenseIndex = MeshHandle::InvalidIndex;
+		slot.NextFree = m_freeSlotHead;
+		m_freeSlotHead = handle.Index;
+		m_version++;
+
+		return true;
+	}
+
+	bool IsValid(MeshHandle handle) const
+	{
+		return handle.Index < m_slots.size() &&
+			m_slots[handle.Index].Generation == handle.Generation &&
+			m_slots[handle.Index].DenseIndex != MeshHandle::InvalidIndex;
+	}
+
+	// Returns nullptr if the handle no longer refers to a mesh.
+	TMesh* GetMesh(MeshHandle handle)
+	{
+		return IsValid(handle) ? &m_meshes[m_slots[handle.Index].DenseIndex] : nullptr;
+	}
+
+	const TMesh* GetMesh(MeshHandle handle) const
+	{
+		return IsValid(handle) ? &m_meshes[m_slots[handle.Index].DenseIndex] : nullptr;
+	}
+
+	// Returns nullptr if the handle no longer refers to a mesh or index is out of range.
+	DrawItem* GetDrawItem(MeshHandle handle, std::uint32_t index = 0)
+	{
+		if (index >= GetDrawItemCount(handle)) {
+			return nullptr;
+		}
+		m_version++;
+		return &m_drawItems[m_drawRanges[m_slots[handle.Index].DenseIndex].First + index];
+	}
+
+	// Replaces all draw items of the mesh, e.g. once its geometry is on the GPU.
+	// The draw items of other meshes may move.
+	bool SetDrawItems(MeshHandle handle, const DrawItem* drawItems, std::uint32_t drawItemCount)
+	{
+		if (!IsValid(handle)) {
+			return false;
+		}
+
+		auto denseIndex = m_slots[handle.Index].DenseIndex;
+		auto drawRange = m_drawRanges[denseIndex];
+		m_version++;
+
+		if (drawRange.Count == drawItemCount) {
+			std::copy(drawItems, drawItems + drawItemCount, m_drawItems.begin() + drawRange.First);
+			return true;
+		}
+
+		// Another count does not fit in place, move the mesh's draw items to the end.
+		RemoveDrawItems(drawRange);
+		m_drawRanges[denseIndex].First = static_cast<std::uint32_t>(m_drawItems.size());
+		m_drawRanges[denseIndex].Count = drawItemCount;
+		m_drawItems.insert(m_drawItems.end(), drawItems, drawItems + drawItemCount);
+		m_drawItemOwners.insert(m_drawItemOwners.end(), drawItemCount, denseIndex);
+		return true;
+	}
+
+	std::uint32_t GetDrawItemCount(MeshHandle handle) const
+	{
+		return IsValid(handle) ? m_drawRanges[m_slots[handle.Index].DenseIndex].Count : 0;
+	}
+
+	// Optional lookup for meshes that were added with a name.
+	MeshHandle Find(const std::string& name) const
+	{
+		auto it = m_nameIndex.find(name);
+		return it != m_nameIndex.end() ? it->second : MeshHandle();
+	}
+
+	// Dense array of draw data, valid until the next Add, Remove or SetDrawItems.
+	const std::vector<DrawItem>& GetDrawItems() const
+	{
+		return m_drawItems;
+	}
+
+	// Changes whenever the draw items may have changed: on Add, Remove, SetDrawItems
+	// and every call of the non-const GetDrawItem. Lets users cache data derived from them.
+	std::uint64_t GetVersion() const
+	{
+		return m_version;
+	}
+
+	// Calls func(MeshHandle, TMesh&) for every mesh.
+	template <typename TFunc>
+	void ForEach(TFunc&& func)
+	{
+		for (std::uint32_t i = 0; i < m_meshes.size(); i++) {
+			auto slotIndex = m_denseToSlot[i];
+			MeshHandle handle;
+			handle.Index = slotIndex;
+			handle.Generation = m_slots[slotIndex].Generation;
+			func(handle, m_meshes[i]);
+		}
+	}
+
+	std::size_t Size() const
+	{
+		return m_meshes.size();
+	}
+
+	void Reserve(std::size_t count)
+	{
+		m_drawItems.reserve(count);
+		m_drawItemOwners.reserve(count);
+		m_meshes.reserve(count);
+		m_drawRanges.reserve(count);
+		m_denseNames.reserve(count);
+		m_denseToSlot.reserve(count);
+		m_slots.reserve(count);
+	}
+
+private:
+	struct Slot
+	{
+		std::uint32_t DenseIndex = MeshHandle::InvalidIndex;
+		std::uint32_t Generation = 0;
+		std::uint32_t NextFree = MeshHandle::InvalidIndex;
+	};
+
+	struct DrawRange
+	{
+		std::uint32_t First = 0;
+		std::uint32_t Count = 0;
+	};
+
+	// Fills hole, the draw items of a mesh that go away, with the draw items at the
+	// end of the array, a whole mesh at a time. That costs as many moves as the
+	// hole is long. Only if the last mesh has more draw items than are left to fill
+	// is the gap closed by moving everything behind it.
+	void RemoveDrawItems(DrawRange hole)
+	{
+		while (hole.Count > 0) {
+			auto end = static_cast<std::uint32_t>(m_drawItems.size());
+			if (hole.First + hole.Count == end) {
+				m_drawItems.resize(hole.First);
+				m_drawItemOwners.resize(hole.First);
+				return;
+			}
+
+			auto& tailRange = m_drawRanges[m_drawItemOwners.back()];
+			if (tailRange.Count > hole.Count) {
+				break;
+			}
+
+			std::copy(m_drawItems.begin() + tailRange.First, m_drawItems.end(), m_drawItems.begin() + hole.First);
+			std::copy(m_drawItemOwners.begin() + tailRange.First, m_drawItemOwners.end(), m_drawItemOwners.begin() + hole.First);
+			m_drawItems.resize(tailRange.First);
+			m_drawItemOwners.resize(tailRange.First);
+
+			tailRange.First = hole.First;
+			hole.First += tailRange.Count;
+			hole.Count -= tailRange.Count;
+		}
+		if (hole.Count == 0) {
+			return;
+		}
+
+		for (auto i = hole.First + hole.Count; i < m_drawItems.size(); i++) {
+			auto& range = m_drawRanges[m_drawItemOwners[i]];
+			if (range.First == i) {
+				range.First -= hole.Count;
+			}
+		}
+		m_drawItems.erase(m_drawItems.begin() + hole.First, m_drawItems.begin() + hole.First + hole.Count);
+		m_drawItemOwners.erase(m_drawItemOwners.begin() + hole.First, m_drawItemOwners.begin() + hole.First + hole.Count);
+	}
+
+	std::vector<Slot> m_slots;
+	std::uint32_t m_freeSlotHead = MeshHandle::InvalidIndex;
+
+	std::vector<DrawItem> m_drawItems;
+	// Dense index of the mesh owning each draw item.
+	std::vector<std::uint32_t> m_drawItemOwners;
+	std::uint64_t m_version = 0;
+
+	// Dense arrays, all indexed by the same dense index.
+	std::vector<TMesh> m_meshes;
+	std::vector<DrawRange> m_drawRanges;
+	std::vector<std::string> m_denseNames;
+	std::vector<std::uint32_t> m_denseToSlot;
+
+	std::unordered_map<std::string, MeshHandle> m_nameIndex;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "ObjectTransform.h"
+
+ObjectTransform MakeObjectTransform(const float world[16], const PositionQuantization& quantization)
+{
+	// world * translate(Offset) * scale(Scale)
+	ObjectTransform transform;
+	for (int row = 0; row < 3; row++) {
+		const float* source = world + row * 4;
+		transform.Rows[row][3] = source[3];
+		for (int column = 0; column < 3; column++) {
+			transform.Rows[row][column] = source[column] * quantization.Scale[column];
+			transform.Rows[row][3] += source[column] * quantization.Offset[column];
+		}
+	}
+	return transform;
+}
@@ -0,0 +1,25 @@
+#ifndef OBJECTTRANSFORM_H_
+#define OBJECTTRANSFORM_H_
+
+#include "VertexFormat.h"
+
+// World transform of one object: the top three rows of a row-major affine
+// matrix that transforms column vectors, 48 bytes. The transforms of all
+// objects are packed tightly into one structured buffer that the vertex shader
+// indexes with the draw's object index, see VertexShader.hlsl.
+struct ObjectTransform
+{
+	float Rows[3][4] = {
+		{ 1.0f, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f } };
+};
+
+static_assert(sizeof(ObjectTransform) == 48, "ObjectTransform must match the structured buffer stride");
+
+// Builds the transform from a 4x4 matrix in the layout of Mesh::World. The
+// decoding of quantized positions is folded into it, so the shader transforms
+// the stored positions directly.
+ObjectTransform MakeObjectTransform(const float world[16], const PositionQuantization& quantization);
+
+#endif
@@ -2,6 +2,8 @@ struct VertexOut
 {
 	float4 PosH  : SV_POSITION;
 	float4 Color : COLOR;
+	float3 NormalL : NORMAL;
+	float3 TangentL : TANGENT;
 };
 
 float4 main(VertexOut pIn) : SV_TARGET
@@ -0,0 +1,346 @@
+#ifndef RHI_H_
+#define RHI_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Thin render hardware interface used by the platform neutral core.
+// The enum values mirror their D3D12 counterparts so the D3D12 backend can
+// translate with a static_cast, while the recording backend can run on any
+// platform without a GPU.
+
+using GpuVirtualAddress = std::uint64_t;
+
+// Opaque handles. The D3D12 backend stores the native interface pointers in
+// them, the recording backend hands out plain increasing ids.
+using RHIResource = std::uintptr_t;
+using PipelineStateHandle = std::uintptr_t;
+using RootSignatureHandle = std::uintptr_t;
+using DescriptorHeapHandle = std::uintptr_t;
+
+struct CpuDescriptorHandle
+{
+	std::size_t ptr = 0;
+};
+
+struct GpuDescriptorHandle
+{
+	std::uint64_t ptr = 0;
+};
+
+enum class ResourceState : std::uint32_t
+{
+	Common = 0,
+	Present = 0,
+	VertexAndConstantBuffer = 0x1,
+	IndexBuffer = 0x2,
+	RenderTarget = 0x4,
+	UnorderedAccess = 0x8,
+	DepthWrite = 0x10,
+	DepthRead = 0x20,
+	NonPixelShaderResource = 0x40,
+	PixelShaderResource = 0x80,
+	IndirectArgument = 0x200,
+	CopyDest = 0x400,
+	CopySource = 0x800,
+	GenericRead = 0x1 | 0x2 | 0x40 | 0x80 | 0x200 | 0x800
+};
+
+inline ResourceState operator|(ResourceState a, ResourceState b)
+{
+	return static_cast<ResourceState>(static_cast<std::uint32_t>(a) | static_cast<std::uint32_t>(b));
+}
+
+inline ResourceState operator&(ResourceState a, ResourceState b)
+{
+	return static_cast<ResourceState>(static_cast<std::uint32_t>(a) & static_cast<std::uint32_t>(b));
+}
+
+enum class BarrierType : std::uint32_t
+{
+	Transition = 0,
+	Aliasing = 1,
+	UnorderedAccess = 2
+};
+
+enum class BarrierFlags : std::uint32_t
+{
+	None = 0,
+	BeginOnly = 0x1,
+	EndOnly = 0x2
+};
+
+static const std::uint32_t AllSubresources = 0xffffffff;
+
+struct ResourceBarrier
+{
+	BarrierType Type = BarrierType::Transition;
+	BarrierFlags Flags = BarrierFlags::None;
+
+	// Transition and UAV barriers use Resource, aliasing barriers use
+	// ResourceBefore (stored in Resource) and ResourceAfter.
+	RHIResource Resource = 0;
+	RHIResource ResourceAfter = 0;
+	ResourceState StateBefore = ResourceState::Common;
+	ResourceState StateAfter = ResourceState::Common;
+	std::uint32_t Subresource = AllSubresources;
+
+	static ResourceBarrier Transition(RHIResource resource, ResourceState before, ResourceState after,
+		BarrierFlags flags = BarrierFlags::None)
+	{
+		ResourceBarrier barrier;
+		barrier.Type = BarrierType::Transition;
+		barrier.Flags = flags;
+		barrier.Resource = resource;
+		barrier.StateBefore = before;
+		barrier.StateAfter = after;
+		return barrier;
+	}
+
+	static ResourceBarrier Aliasing(RHIResource resourceBefore, RHIResource resourceAfter)
+	{
+		ResourceBarrier barrier;
+		barrier.Type = BarrierType::Aliasing;
+		barrier.Resource = resourceBefore;
+		barrier.ResourceAfter = resourceAfter;
+		return barrier;
+	}
+
+	static ResourceBarrier UnorderedAccess(RHIResource resource)
+	{
+		ResourceBarrier barrier;
+		barrier.Type = BarrierType::UnorderedAccess;
+		barrier.Resource = resource;
+		return barrier;
+	}
+};
+
+enum class IndexFormat : std::uint32_t
+{
+	Uint16,
+	Uint32
+};
+
+enum class PrimitiveTopology : std::uint32_t
+{
+	Undefined = 0,
+	TriangleList = 4
+};
+
+enum class HeapType : std::uint32_t
+{
+	Default = 1,
+	Upload = 2,
+	Readback = 3
+};
+
+enum class CommandListType : std::uint32_t
+{
+	Direct = 0,
+	Copy = 3
+};
+
+struct VertexBufferBinding
+{
+	GpuVirtualAddress BufferLocation = 0;
+	std::uint32_t SizeInBytes = 0;
+	std::uint32_t StrideInBytes = 0;
+};
+
+struct IndexBufferBinding
+{
+	GpuVirtualAddress BufferLocation = 0;
+	std::uint32_t SizeInBytes = 0;
+	IndexFormat Format = IndexFormat::Uint32;
+};
+
+inline bool operator==(const VertexBufferBinding& a, const VertexBufferBinding& b)
+{
+	return a.BufferLocation == b.BufferLocation && a.SizeInBytes == b.SizeInBytes && a.StrideInBytes == b.StrideInBytes;
+}
+
+inline bool operator!=(const VertexBufferBinding& a, const VertexBufferBinding& b)
+{
+	return !(a == b);
+}
+
+inline bool operator==(const IndexBufferBinding& a, const IndexBufferBinding& b)
+{
+	return a.BufferLocation == b.BufferLocation && a.SizeInBytes == b.SizeInBytes && a.Format == b.Format;
+}
+
+inline bool operator!=(const IndexBufferBinding& a, const IndexBufferBinding& b)
+{
+	return !(a == b);
+}
+
+struct Viewport
+{
+	float TopLeftX = 0.0f;
+	float TopLeftY = 0.0f;
+	float Width = 0.0f;
+	float Height = 0.0f;
+	float MinDepth = 0.0f;
+	float MaxDepth = 1.0f;
+};
+
+struct ScissorRect
+{
+	std::int32_t Left = 0;
+	std::int32_t Top = 0;
+	std::int32_t Right = 0;
+	std::int32_t Bottom = 0;
+};
+
+// Records GPU work. Mirrors the subset of ID3D12GraphicsCommandList the engine uses.
+class ICommandRecorder
+{
+public:
+	virtual ~ICommandRecorder() {}
+
+	virtual void ResourceBarrier(std::uint32_t numBarriers, const ::ResourceBarrier* barriers) = 0;
+	virtual void CopyBufferRegion(RHIResource dst, std::uint64_t dstOffset, RHIResource src, std::uint64_t srcOffset, std::uint64_t numBytes) = 0;
+
+	virtual void SetPipelineState(PipelineStateHandle pipelineState) = 0;
+	virtual void SetGraphicsRootSignature(RootSignatureHandle rootSignature) = 0;
+	virtual void SetDescriptorHeaps(std::uint32_t numHeaps, const DescriptorHeapHandle* heaps) = 0;
+	virtual void SetGraphicsRootDescriptorTable(std::uint32_t rootParameterIndex, GpuDescriptorHandle baseDescriptor) = 0;
+	virtual void SetGraphicsRoot32BitConstant(std::uint32_t rootParameterIndex, std::uint32_t srcData, std::uint32_t destOffsetIn32BitValues) = 0;
+	virtual void SetGraphicsRoot32BitConstants(std::uint32_t rootParameterIndex, std::uint32_t num32BitValuesToSet, const void* srcData, std::uint32_t destOffsetIn32BitValues) = 0;
+	virtual void SetGraphicsRootConstantBufferView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation) = 0;
+	virtual void SetGraphicsRootShaderResourceView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation) = 0;
+
+	virtual void IASetPrimitiveTopology(PrimitiveTopology topology) = 0;
+	virtual void IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t numViews, const VertexBufferBinding* views) = 0;
+	virtual void IASetIndexBuffer(const IndexBufferBinding* view) = 0;
+
+	virtual void RSSetViewports(std::uint32_t numViewports, const Viewport* viewports) = 0;
+	virtual void RSSetScissorRects(std::uint32_t numRects, const ScissorRect* rects) = 0;
+	virtual void OMSetRenderTargets(std::uint32_t numRenderTargets, const CpuDescriptorHandle* renderTargets, const CpuDescriptorHandle* depthStencil) = 0;
+	virtual void ClearRenderTargetView(CpuDescriptorHandle renderTarget, const float color[4]) = 0;
+	virtual void ClearDepthStencilView(CpuDescriptorHandle depthStencil, float depth, std::uint8_t stencil) = 0;
+
+	virtual void DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation) = 0;
+};
+
+// A command recorder with memory of its own, like a D3D12 command list and its
+// allocator. Created closed.
+class ICommandList
+{
+public:
+	virtual ~ICommandList() {}
+
+	virtual ICommandRecorder& GetRecorder() = 0;
+	// Starts recording anew. Only call once the GPU has executed the list.
+	virtual void Reset() = 0;
+	virtual void Close() = 0;
+};
+
+// Value the GPU sets once it reaches a Signal on a queue, values only grow.
+class IFence
+{
+public:
+	virtual ~IFence() {}
+
+	virtual std::uint64_t GetCompletedValue() const = 0;
+	// Blocks until the fence reached value.
+	virtual void Wait(std::uint64_t value) = 0;
+};
+
+class ICommandQueue
+{
+public:
+	virtual ~ICommandQueue() {}
+
+	virtual CommandListType GetType() const = 0;
+	virtual void ExecuteCommandLists(std::uint32_t numCommandLists, ICommandList* const* commandLists) = 0;
+	// Sets fence to value once the work submitted so far has executed.
+	virtual void Signal(IFence& fence, std::uint64_t value) = 0;
+};
+
+// Device level operations that do not go through a command list.
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() {}
+
+	virtual void CreateConstantBufferView(GpuVirtualAddress bufferLocation, std::uint32_t sizeInBytes, CpuDescriptorHandle destDescriptor) = 0;
+	virtual void CopyDescriptorsSimple(std::uint32_t numDescriptors, CpuDescriptorHandle destStart, CpuDescriptorHandle srcStart) = 0;
+
+	// Resources are reference counted. CreateBuffer returns the first reference,
+	// usually handed to a ResourceRef.
+	virtual RHIResource CreateBuffer(std::uint64_t byteSize, HeapType heapType, ResourceState initialState) = 0;
+	virtual void AddRef(RHIResource resource) = 0;
+	virtual void Release(RHIResource resource) = 0;
+
+	// Upload and readback buffers stay mapped for their whole lifetime.
+	virtual void* Map(RHIResource buffer) = 0;
+	virtual GpuVirtualAddress GetGpuVirtualAddress(RHIResource buffer) = 0;
+
+	virtual std::unique_ptr<ICommandList> CreateCommandList(CommandListType type) = 0;
+	virtual std::unique_ptr<IFence> CreateFence() = 0;
+};
+
+// Owning reference to a resource of a device, the counterpart of ComPtr.
+class ResourceRef
+{
+public:
+	ResourceRef() {}
+
+	// Takes over a reference the caller owns, e.g. the one CreateBuffer returned.
+	ResourceRef(IRenderDevice* device, RHIResource resource) :
+		m_device(device),
+		m_resource(resource)
+	{
+	}
+
+	ResourceRef(const ResourceRef& other) :
+		m_device(other.m_device),
+		m_resource(other.m_resource)
+	{
+		if (m_resource != 0) {
+			m_device->AddRef(m_resource);
+		}
+	}
+
+	ResourceRef(ResourceRef&& other) noexcept :
+		m_device(other.m_device),
+		m_resource(other.m_resource)
+	{
+		other.m_device = nullptr;
+		other.m_resource = 0;
+	}
+
+	~ResourceRef()
+	{
+		Reset();
+	}
+
+	ResourceRef& operator=(ResourceRef other) noexcept
+	{
+		std::swap(m_device, other.m_device);
+		std::swap(m_resource, other.m_resource);
+		return *this;
+	}
+
+	void Reset()
+	{
+		if (m_resource != 0) {
+			m_device->Release(m_resource);
+		}
+		m_device = nullptr;
+		m_resource = 0;
+	}
+
+	RHIResource Get() const { return m_resource; }
+	explicit operator bool() const { return m_resource != 0; }
+
+private:
+	IRenderDevice* m_device = nullptr;
+	RHIResource m_resource = 0;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "RangeAllocator.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+std::uint64_t AlignUp(std::uint64_t offset, std::uint64_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+}
+
+RangeAllocator::RangeAllocator()
+{
+}
+
+RangeAllocator::RangeAllocator(std::uint64_t size)
+{
+	Reset(size);
+}
+
+void RangeAllocator::Reset(std::uint64_t size)
+{
+	m_size = size;
+	m_usedSize = 0;
+	m_freeRanges.clear();
+	m_allocations.clear();
+
+	if (size > 0) {
+		m_freeRanges[0] = size;
+	}
+}
+
+std::uint64_t RangeAllocator::Allocate(std::uint64_t size, std::uint64_t alignment)
+{
+	if (size == 0) {
+		return InvalidOffset;
+	}
+	alignment = std::max<std::uint64_t>(alignment, 1);
+
+	for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it) {
+		auto rangeOffset = it->first;
+		auto rangeSize = it->second;
+		auto offset = AlignUp(rangeOffset, alignment);
+		if (offset + size > rangeOffset + rangeSize) {
+			continue;
+		}
+
+		// Give back the padding in front and the tail of the range.
+		m_freeRanges.erase(it);
+		if (offset > rangeOffset) {
+			m_freeRanges[rangeOffset] = offset - rangeOffset;
+		}
+		if (offset + size < rangeOffset + rangeSize) {
+			m_freeRanges[offset + size] = rangeOffset + rangeSize - offset - size;
+		}
+
+		Allocation allocation;
+		allocation.Size = size;
+		allocation.Alignment = alignment;
+		m_allocations[offset] = allocation;
+		m_usedSize += size;
+		return offset;
+	}
+
+	return InvalidOffset;
+}
+
+void RangeAllocator::Free(std::uint64_t offset)
+{
+	auto it = m_allocations.find(offset);
+	if (it == m_allocations.end()) {
+		return;
+	}
+
+	auto size = it->second.Size;
+	m_usedSize -= size;
+	m_allocations.erase(it);
+	AddFreeRange(offset, size);
+}
+
+std::vector<RangeAllocator::Move> RangeAllocator::Compact()
+{
+	std::vector<Move> moves;
+	moves.reserve(m_allocations.size());
+
+	std::map<std::uint64_t, Allocation> compacted;
+	std::uint64_t end = 0;
+	m_freeRanges.clear();
+
+	for (const auto& allocation : m_allocations) {
+		auto offset = AlignUp(end, allocation.second.Alignment);
+		if (offset > end) {
+			m_freeRanges[end] = offset - end;
+		}
+
+		Move move;
+		move.SourceOffset = allocation.first;
+		move.DestOffset = offset;
+		move.Size = allocation.second.Size;
+		moves.push_back(move);
+
+		compacted[offset] = allocation.second;
+		end = offset + allocation.second.Size;
+	}
+
+	if (end < m_size) {
+		m_freeRanges[end] = m_size - end;
+	}
+	m_allocations.swap(compacted);
+
+	return moves;
+}
+
+std::uint64_t RangeAllocator::GetLargestFreeRange() const
+{
+	std::uint64_t largest = 0;
+	for (const auto& range : m_freeRanges) {
+		largest = std::max(largest, range.second);
+	}
+	return largest;
+}
+
+bool RangeAllocator::IsCompact() const
+{
+	return m_freeRanges.empty() ||
+		(m_freeRanges.size() == 1 && m_freeRanges.begin()->first + m_freeRanges.begin()->second == m_size);
+}
+
+void RangeAllocator::AddFreeRange(std::uint64_t offset, std::uint64_t size)
+{
+	auto next = m_freeRanges.lower_bound(offset);
+
+	// Merge with the range ending where this one starts.
+	if (next != m_freeRanges.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			offset = previous->first;
+			size += previous->second;
+			m_freeRanges.erase(previous);
+		}
+	}
+
+	// Merge with the range starting where this one ends.
+	if (next != m_freeRanges.end() && offset + size == next->first) {
+		size += next->second;
+		m_freeRanges.erase(next);
+	}
+
+	m_freeRanges[offset] = size;
+}
@@ -0,0 +1,65 @@
+#ifndef RANGEALLOCATOR_H_
+#define RANGEALLOCATOR_H_
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Sub-allocates offsets from a fixed size range, e.g. a GPU buffer. Free ranges
+// are kept sorted by offset and merged with their neighbours when released.
+// Allocations use first fit. Alignments do not need to be powers of two so
+// vertex buffers can be aligned to their stride.
+class RangeAllocator
+{
+public:
+	static const std::uint64_t InvalidOffset = ~0ull;
+
+	// Describes one allocation moving during Compact.
+	struct Move
+	{
+		std::uint64_t SourceOffset = 0;
+		std::uint64_t DestOffset = 0;
+		std::uint64_t Size = 0;
+	};
+
+	RangeAllocator();
+	explicit RangeAllocator(std::uint64_t size);
+
+	// Forgets all allocations.
+	void Reset(std::uint64_t size);
+
+	// Returns InvalidOffset if no free range is large enough.
+	std::uint64_t Allocate(std::uint64_t size, std::uint64_t alignment = 1);
+	void Free(std::uint64_t offset);
+
+	// Packs all allocations to the front of the range in offset order, keeping
+	// their alignment. Returns every live allocation, including the ones that did
+	// not move, so the caller can copy the contents into a fresh buffer.
+	std::vector<Move> Compact();
+
+	std::uint64_t GetSize() const { return m_size; }
+	std::uint64_t GetUsedSize() const { return m_usedSize; }
+	std::uint64_t GetLargestFreeRange() const;
+	// True if all free space is one range at the end.
+	bool IsCompact() const;
+	std::size_t GetAllocationCount() const { return m_allocations.size(); }
+	std::size_t GetFreeRangeCount() const { return m_freeRanges.size(); }
+
+private:
+	struct Allocation
+	{
+		std::uint64_t Size = 0;
+		std::uint64_t Alignment = 1;
+	};
+
+	void AddFreeRange(std::uint64_t offset, std::uint64_t size);
+
+	std::uint64_t m_size = 0;
+	std::uint64_t m_usedSize = 0;
+
+	// Offset -> size of every free range.
+	std::map<std::uint64_t, std::uint64_t> m_freeRanges;
+	std::map<std::uint64_t, Allocation> m_allocations;
+};
+
+#endif
@@ -0,0 +1,381 @@
+#include "RecordingBackend.h"
+
+void RecordedCommandStream::Clear()
+{
+	Commands.clear();
+	Barriers.clear();
+	VertexBuffers.clear();
+	Handles.clear();
+	Descriptors.clear();
+	Viewports.clear();
+	ScissorRects.clear();
+	Constants.clear();
+	CommandCounts.fill(0);
+}
+
+void RecordedCommandStream::Append(const RecordedCommandStream& other)
+{
+	auto barrierBase = static_cast<std::uint32_t>(Barriers.size());
+	auto vertexBufferBase = static_cast<std::uint32_t>(VertexBuffers.size());
+	auto handleBase = static_cast<std::uint32_t>(Handles.size());
+	auto descriptorBase = static_cast<std::uint32_t>(Descriptors.size());
+	auto viewportBase = static_cast<std::uint32_t>(Viewports.size());
+	auto scissorBase = static_cast<std::uint32_t>(ScissorRects.size());
+	auto constantBase = static_cast<std::uint32_t>(Constants.size());
+
+	Barriers.insert(Barriers.end(), other.Barriers.begin(), other.Barriers.end());
+	VertexBuffers.insert(VertexBuffers.end(), other.VertexBuffers.begin(), other.VertexBuffers.end());
+	Handles.insert(Handles.end(), other.Handles.begin(), other.Handles.end());
+	Descriptors.insert(Descriptors.end(), other.Descriptors.begin(), other.Descriptors.end());
+	Viewports.insert(Viewports.end(), other.Viewports.begin(), other.Viewports.end());
+	ScissorRects.insert(ScissorRects.end(), other.ScissorRects.begin(), other.ScissorRects.end());
+	Constants.insert(Constants.end(), other.Constants.begin(), other.Constants.end());
+
+	// Rebase the array ranges onto the side arrays of this stream.
+	Commands.reserve(Commands.size() + other.Commands.size());
+	for (auto command : other.Commands) {
+		switch (command.Type) {
+		case RecordedCommandType::ResourceBarrier:
+			command.Range.First += barrierBase;
+			break;
+		case RecordedCommandType::IASetVertexBuffers:
+			command.VertexBuffers.First += vertexBufferBase;
+			break;
+		case RecordedCommandType::SetDescriptorHeaps:
+			command.Range.First += handleBase;
+			break;
+		case RecordedCommandType::OMSetRenderTargets:
+			command.RenderTargets.First += descriptorBase;
+			break;
+		case RecordedCommandType::RSSetViewports:
+			command.Range.First += viewportBase;
+			break;
+		case RecordedCommandType::RSSetScissorRects:
+			command.Range.First += scissorBase;
+			break;
+		case RecordedCommandType::SetGraphicsRoot32BitConstants:
+			command.RootConstants.First += constantBase;
+			break;
+		default:
+			break;
+		}
+		Commands.push_back(command);
+	}
+
+	for (size_t i = 0; i < CommandCounts.size(); i++) {
+		CommandCounts[i] += other.CommandCounts[i];
+	}
+}
+
+std::uint32_t RecordedCommandStream::GetCount(RecordedCommandType type) const
+{
+	return CommandCounts[static_cast<std::size_t>(type)];
+}
+
+RecordedCommand& RecordedCommandStream::Push(RecordedCommandType type)
+{
+	CommandCounts[static_cast<std::size_t>(type)]++;
+
+	RecordedCommand command{};
+	command.Type = type;
+	Commands.push_back(command);
+	return Commands.back();
+}
+
+const RecordedCommandStream& RecordingCommandList::GetStream() const
+{
+	return m_stream;
+}
+
+ICommandRecorder& RecordingCommandList::GetRecorder()
+{
+	return *this;
+}
+
+void RecordingCommandList::Reset()
+{
+	m_stream.Clear();
+}
+
+void RecordingCommandList::Close()
+{
+}
+
+void RecordingCommandList::ResourceBarrier(std::uint32_t numBarriers, const ::ResourceBarrier* barriers)
+{
+	auto& command = m_stream.Push(RecordedCommandType::ResourceBarrier);
+	command.Range = { static_cast<std::uint32_t>(m_stream.Barriers.size()), numBarriers };
+	m_stream.Barriers.insert(m_stream.Barriers.end(), barriers, barriers + numBarriers);
+}
+
+void RecordingCommandList::CopyBufferRegion(RHIResource dst, std::uint64_t dstOffset, RHIResource src, std::uint64_t srcOffset, std::uint64_t numBytes)
+{
+	auto& command = m_stream.Push(RecordedCommandType::CopyBufferRegion);
+	command.Copy = { dst, dstOffset, src, srcOffset, numBytes };
+}
+
+void RecordingCommandList::SetPipelineState(PipelineStateHandle pipelineState)
+{
+	m_stream.Push(RecordedCommandType::SetPipelineState).Handle = pipelineState;
+}
+
+void RecordingCommandList::SetGraphicsRootSignature(RootSignatureHandle rootSignature)
+{
+	m_stream.Push(RecordedCommandType::SetGraphicsRootSignature).Handle = rootSignature;
+}
+
+void RecordingCommandList::SetDescriptorHeaps(std::uint32_t numHeaps, const DescriptorHeapHandle* heaps)
+{
+	auto& command = m_stream.Push(RecordedCommandType::SetDescriptorHeaps);
+	command.Range = { static_cast<std::uint32_t>(m_stream.Handles.size()), numHeaps };
+	m_stream.Handles.insert(m_stream.Handles.end(), heaps, heaps + numHeaps);
+}
+
+void RecordingCommandList::SetGraphicsRootDescriptorTable(std::uint32_t rootParameterIndex, GpuDescriptorHandle baseDescriptor)
+{
+	auto& command = m_stream.Push(RecordedCommandType::SetGraphicsRootDescriptorTable);
+	command.Root = { rootParameterIndex, 0, baseDescriptor.ptr };
+}
+
+void RecordingCommandList::SetGraphicsRoot32BitConstant(std::uint32_t rootParameterIndex, std::uint32_t srcData, std::uint32_t destOffsetIn32BitValues)
+{
+	auto& command = m_stream.Push(RecordedCommandType::SetGraphicsRoot32BitConstant);
+	command.Root = { rootParameterIndex, destOffsetIn32BitValues, srcData };
+}
+
+void RecordingCommandList::SetGraphicsRoot32BitConstants(std::uint32_t rootParameterIndex, std::uint32_t num32BitValuesToSet, const void* srcData, std::uint32_t destOffsetIn32BitValues)
+{
+	auto& command = m_stream.Push(RecordedCommandType::SetGraphicsRoot32BitConstants);
+	command.RootConstants = { rootParameterIndex, destOffsetIn32BitValues, static_cast<std::uint32_t>(m_stream.Constants.size()), num32BitValuesToSet };
+
+	auto values = static_cast<const std::uint32_t*>(srcData);
+	m_stream.Constants.insert(m_stream.Constants.end(), values, values + num32BitValuesToSet);
+}
+
+void RecordingCommandList::SetGraphicsRootConstantBufferView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation)
+{
+	auto& command = m_stream.Push(RecordedCommandType::SetGraphicsRootConstantBufferView);
+	command.Root = { rootParameterIndex, 0, bufferLocation };
+}
+
+void RecordingCommandList::SetGraphicsRootShaderResourceView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation)
+{
+	auto& command = m_stream.Push(RecordedCommandType::SetGraphicsRootShaderResourceView);
+	command.Root = { rootParameterIndex, 0, bufferLocation };
+}
+
+void RecordingCommandList::IASetPrimitiveTopology(PrimitiveTopology topology)
+{
+	m_stream.Push(RecordedCommandType::IASetPrimitiveTopology).Topology = topology;
+}
+
+void RecordingCommandList::IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t numViews, const VertexBufferBinding* views)
+{
+	auto& command = m_stream.Push(RecordedCommandType::IASetVertexBuffers);
+	command.VertexBuffers = { static_cast<std::uint32_t>(m_stream.VertexBuffers.size()), numViews, startSlot };
+	m_stream.VertexBuffers.insert(m_stream.VertexBuffers.end(), views, views + numViews);
+}
+
+void RecordingCommandList::IASetIndexBuffer(const IndexBufferBinding* view)
+{
+	m_stream.Push(RecordedCommandType::IASetIndexBuffer).IndexBuffer = view ? *view : IndexBufferBinding();
+}
+
+void RecordingCommandList::RSSetViewports(std::uint32_t numViewports, const Viewport* viewports)
+{
+	auto& command = m_stream.Push(RecordedCommandType::RSSetViewports);
+	command.Range = { static_cast<std::uint32_t>(m_stream.Viewports.size()), numViewports };
+	m_stream.Viewports.insert(m_stream.Viewports.end(), viewports, viewports + numViewports);
+}
+
+void RecordingCommandList::RSSetScissorRects(std::uint32_t numRects, const ScissorRect* rects)
+{
+	auto& command = m_stream.Push(RecordedCommandType::RSSetScissorRects);
+	command.Range = { static_cast<std::uint32_t>(m_stream.ScissorRects.size()), numRects };
+	m_stream.ScissorRects.insert(m_stream.ScissorRects.end(), rects, rects + numRects);
+}
+
+void RecordingCommandList::OMSetRenderTargets(std::uint32_t numRenderTargets, const CpuDescriptorHandle* renderTargets, const CpuDescriptorHandle* depthStencil)
+{
+	auto& command = m_stream.Push(RecordedCommandType::OMSetRenderTargets);
+	command.RenderTargets = { static_cast<std::uint32_t>(m_stream.Descriptors.size()), numRenderTargets,
+		depthStencil ? *depthStencil : CpuDescriptorHandle() };
+	m_stream.Descriptors.insert(m_stream.Descriptors.end(), renderTargets, renderTargets + numRenderTargets);
+}
+
+void RecordingCommandList::ClearRenderTargetView(CpuDescriptorHandle renderTarget, const float color[4])
+{
+	auto& command = m_stream.Push(RecordedCommandType::ClearRenderTargetView);
+	command.Clear.View = renderTarget;
+	for (int i = 0; i < 4; i++) {
+		command.Clear.Color[i] = color[i];
+	}
+}
+
+void RecordingCommandList::ClearDepthStencilView(CpuDescriptorHandle depthStencil, float depth, std::uint8_t stencil)
+{
+	auto& command = m_stream.Push(RecordedCommandType::ClearDepthStencilView);
+	command.Clear.View = depthStencil;
+	command.Clear.Color[0] = depth;
+	command.Clear.Stencil = stencil;
+}
+
+void RecordingCommandList::DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+	std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation)
+{
+	auto& command = m_stream.Push(RecordedCommandType::DrawIndexedInstanced);
+	command.Draw = { indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation };
+}
+
+RHIResource RecordingDevice::CreateResource()
+{
+	return m_nextResource++;
+}
+
+void RecordingDevice::Reset()
+{
+	m_stream.Clear();
+}
+
+const RecordedCommandStream& RecordingDevice::GetStream() const
+{
+	return m_stream;
+}
+
+const RecordedBufferStats& RecordingDevice::GetBufferStats() const
+{
+	return m_bufferStats;
+}
+
+void RecordingDevice::CreateConstantBufferView(GpuVirtualAddress bufferLocation, std::uint32_t sizeInBytes, CpuDescriptorHandle destDescriptor)
+{
+	auto& command = m_stream.Push(RecordedCommandType::CreateConstantBufferView);
+	command.Descriptor = { bufferLocation, sizeInBytes, destDescriptor, CpuDescriptorHandle() };
+}
+
+void RecordingDevice::CopyDescriptorsSimple(std::uint32_t numDescriptors, CpuDescriptorHandle destStart, CpuDescriptorHandle srcStart)
+{
+	auto& command = m_stream.Push(RecordedCommandType::CopyDescriptors);
+	command.Descriptor = { 0, numDescriptors, destStart, srcStart };
+}
+
+RHIResource RecordingDevice::CreateBuffer(std::uint64_t byteSize, HeapType heapType, ResourceState initialState)
+{
+	auto resource = CreateResource();
+
+	Buffer buffer;
+	buffer.ByteSize = byteSize;
+	if (heapType != HeapType::Default) {
+		buffer.Data.resize(static_cast<std::size_t>(byteSize));
+	}
+	m_buffers.emplace(resource, std::move(buffer));
+
+	m_bufferStats.LiveBuffers++;
+	m_bufferStats.LiveBytes += byteSize;
+	m_bufferStats.CreatedBuffers++;
+	return resource;
+}
+
+void RecordingDevice::AddRef(RHIResource resource)
+{
+	auto buffer = m_buffers.find(resource);
+	if (buffer != m_buffers.end()) {
+		buffer->second.RefCount++;
+	}
+}
+
+void RecordingDevice::Release(RHIResource resource)
+{
+	auto buffer = m_buffers.find(resource);
+	if (buffer == m_buffers.end() || --buffer->second.RefCount > 0) {
+		return;
+	}
+
+	m_bufferStats.LiveBuffers--;
+	m_bufferStats.LiveBytes -= buffer->second.ByteSize;
+	m_buffers.erase(buffer);
+}
+
+void* RecordingDevice::Map(RHIResource buffer)
+{
+	auto found = m_buffers.find(buffer);
+	return found != m_buffers.end() && !found->second.Data.empty() ? found->second.Data.data() : nullptr;
+}
+
+GpuVirtualAddress RecordingDevice::GetGpuVirtualAddress(RHIResource buffer)
+{
+	return static_cast<GpuVirtualAddress>(buffer) << 32;
+}
+
+std::unique_ptr<ICommandList> RecordingDevice::CreateCommandList(CommandListType type)
+{
+	return std::make_unique<RecordingCommandList>();
+}
+
+std::unique_ptr<IFence> RecordingDevice::CreateFence()
+{
+	return std::make_unique<RecordingFence>();
+}
+
+void RecordingFence::Signal(std::uint64_t value)
+{
+	m_completedValue = value;
+}
+
+std::uint64_t RecordingFence::GetCompletedValue() const
+{
+	return m_completedValue;
+}
+
+void RecordingFence::Wait(std::uint64_t value)
+{
+}
+
+RecordingCommandQueue::RecordingCommandQueue(CommandListType type) :
+	m_type(type)
+{
+}
+
+void RecordingCommandQueue::ExecuteCommandLists(std::uint32_t numCommandLists, RecordingCommandList* const* commandLists)
+{
+	for (std::uint32_t i = 0; i < numCommandLists; i++) {
+		m_stream.Append(commandLists[i]->GetStream());
+	}
+}
+
+void RecordingCommandQueue::Signal(std::uint64_t fenceValue)
+{
+	m_completedFenceValue = fenceValue;
+}
+
+std::uint64_t RecordingCommandQueue::GetCompletedValue() const
+{
+	return m_completedFenceValue;
+}
+
+CommandListType RecordingCommandQueue::GetType() const
+{
+	return m_type;
+}
+
+void RecordingCommandQueue::ExecuteCommandLists(std::uint32_t numCommandLists, ICommandList* const* commandLists)
+{
+	for (std::uint32_t i = 0; i < numCommandLists; i++) {
+		m_stream.Append(static_cast<RecordingCommandList*>(commandLists[i])->GetStream());
+	}
+}
+
+void RecordingCommandQueue::Signal(IFence& fence, std::uint64_t value)
+{
+	static_cast<RecordingFence&>(fence).Signal(value);
+}
+
+void RecordingCommandQueue::Reset()
+{
+	m_stream.Clear();
+}
+
+const RecordedCommandStream& RecordingCommandQueue::GetStream() const
+{
+	return m_stream;
+}
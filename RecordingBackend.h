@@ -0,0 +1,218 @@
+#ifndef RECORDINGBACKEND_H_
+#define RECORDINGBACKEND_H_
+
+#include "RHI.h"
+#include <vector>
+#include <array>
+#include <unordered_map>
+
+// Null GPU backend. Every command is captured into an in-memory stream instead
+// of being sent to a driver so CPU side rendering code can be profiled and
+// inspected on machines without a D3D12 capable GPU.
+
+enum class RecordedCommandType : std::uint8_t
+{
+	ResourceBarrier,
+	CopyBufferRegion,
+	SetPipelineState,
+	SetGraphicsRootSignature,
+	SetDescriptorHeaps,
+	SetGraphicsRootDescriptorTable,
+	SetGraphicsRoot32BitConstant,
+	SetGraphicsRoot32BitConstants,
+	SetGraphicsRootConstantBufferView,
+	SetGraphicsRootShaderResourceView,
+	IASetPrimitiveTopology,
+	IASetVertexBuffers,
+	IASetIndexBuffer,
+	RSSetViewports,
+	RSSetScissorRects,
+	OMSetRenderTargets,
+	ClearRenderTargetView,
+	ClearDepthStencilView,
+	DrawIndexedInstanced,
+	CreateConstantBufferView,
+	CopyDescriptors,
+	Count
+};
+
+struct RecordedCommand
+{
+	// Commands taking arrays (barriers, vertex buffers, heaps, render targets...)
+	// store them in the side arrays of the stream and reference them by range.
+	struct ArrayRange { std::uint32_t First; std::uint32_t Count; };
+	struct VertexBufferArgs { std::uint32_t First; std::uint32_t Count; std::uint32_t StartSlot; };
+	struct CopyArgs { RHIResource Dst; std::uint64_t DstOffset; RHIResource Src; std::uint64_t SrcOffset; std::uint64_t NumBytes; };
+	struct RootArgs { std::uint32_t RootParameterIndex; std::uint32_t DestOffset; std::uint64_t Value; };
+	struct RootConstantsArgs { std::uint32_t RootParameterIndex; std::uint32_t DestOffset; std::uint32_t First; std::uint32_t Count; };
+	struct DrawArgs { std::uint32_t IndexCountPerInstance; std::uint32_t InstanceCount; std::uint32_t StartIndexLocation; std::int32_t BaseVertexLocation; std::uint32_t StartInstanceLocation; };
+	struct RenderTargetArgs { std::uint32_t First; std::uint32_t Count; CpuDescriptorHandle DepthStencil; };
+	struct ClearArgs { CpuDescriptorHandle View; float Color[4]; std::uint8_t Stencil; };
+	struct DescriptorArgs { GpuVirtualAddress BufferLocation; std::uint32_t SizeInBytes; CpuDescriptorHandle Dest; CpuDescriptorHandle Src; };
+
+	RecordedCommandType Type;
+	union
+	{
+		ArrayRange Range;
+		VertexBufferArgs VertexBuffers;
+		CopyArgs Copy;
+		RootArgs Root;
+		RootConstantsArgs RootConstants;
+		DrawArgs Draw;
+		RenderTargetArgs RenderTargets;
+		ClearArgs Clear;
+		DescriptorArgs Descriptor;
+		std::uintptr_t Handle;
+		IndexBufferBinding IndexBuffer;
+		PrimitiveTopology Topology;
+	};
+};
+
+struct RecordedCommandStream
+{
+	std::vector<RecordedCommand> Commands;
+	std::vector<::ResourceBarrier> Barriers;
+	std::vector<VertexBufferBinding> VertexBuffers;
+	std::vector<std::uintptr_t> Handles;
+	std::vector<CpuDescriptorHandle> Descriptors;
+	std::vector<Viewport> Viewports;
+	std::vector<ScissorRect> ScissorRects;
+	std::vector<std::uint32_t> Constants;
+
+	std::array<std::uint32_t, static_cast<std::size_t>(RecordedCommandType::Count)> CommandCounts{};
+
+	void Clear();
+	void Append(const RecordedCommandStream& other);
+	std::uint32_t GetCount(RecordedCommandType type) const;
+
+	RecordedCommand& Push(RecordedCommandType type);
+};
+
+class RecordingCommandList : public ICommandRecorder, public ICommandList
+{
+public:
+	const RecordedCommandStream& GetStream() const;
+
+	// Inherited via ICommandList
+	virtual ICommandRecorder& GetRecorder() override;
+	virtual void Reset() override;
+	virtual void Close() override;
+
+	// Inherited via ICommandRecorder
+	virtual void ResourceBarrier(std::uint32_t numBarriers, const ::ResourceBarrier* barriers) override;
+	virtual void CopyBufferRegion(RHIResource dst, std::uint64_t dstOffset, RHIResource src, std::uint64_t srcOffset, std::uint64_t numBytes) override;
+
+	virtual void SetPipelineState(PipelineStateHandle pipelineState) override;
+	virtual void SetGraphicsRootSignature(RootSignatureHandle rootSignature) override;
+	virtual void SetDescriptorHeaps(std::uint32_t numHeaps, const DescriptorHeapHandle* heaps) override;
+	virtual void SetGraphicsRootDescriptorTable(std::uint32_t rootParameterIndex, GpuDescriptorHandle baseDescriptor) override;
+	virtual void SetGraphicsRoot32BitConstant(std::uint32_t rootParameterIndex, std::uint32_t srcData, std::uint32_t destOffsetIn32BitValues) override;
+	virtual void SetGraphicsRoot32BitConstants(std::uint32_t rootParameterIndex, std::uint32_t num32BitValuesToSet, const void* srcData, std::uint32_t destOffsetIn32BitValues) override;
+	virtual void SetGraphicsRootConstantBufferView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation) override;
+	virtual void SetGraphicsRootShaderResourceView(std::uint32_t rootParameterIndex, GpuVirtualAddress bufferLocation) override;
+
+	virtual void IASetPrimitiveTopology(PrimitiveTopology topology) override;
+	virtual void IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t numViews, const VertexBufferBinding* views) override;
+	virtual void IASetIndexBuffer(const IndexBufferBinding* view) override;
+
+	virtual void RSSetViewports(std::uint32_t numViewports, const Viewport* viewports) override;
+	virtual void RSSetScissorRects(std::uint32_t numRects, const ScissorRect* rects) override;
+	virtual void OMSetRenderTargets(std::uint32_t numRenderTargets, const CpuDescriptorHandle* renderTargets, const CpuDescriptorHandle* depthStencil) override;
+	virtual void ClearRenderTargetView(CpuDescriptorHandle renderTarget, const float color[4]) override;
+	virtual void ClearDepthStencilView(CpuDescriptorHandle depthStencil, float depth, std::uint8_t stencil) override;
+
+	virtual void DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation) override;
+
+private:
+	RecordedCommandStream m_stream;
+};
+
+// Buffers created by a RecordingDevice.
+struct RecordedBufferStats
+{
+	std::uint32_t LiveBuffers = 0;
+	std::uint64_t LiveBytes = 0;
+	std::uint64_t CreatedBuffers = 0;
+};
+
+class RecordingDevice : public IRenderDevice
+{
+public:
+	// Hands out unique ids that stand in for ID3D12Resource pointers.
+	RHIResource CreateResource();
+
+	void Reset();
+	const RecordedCommandStream& GetStream() const;
+	const RecordedBufferStats& GetBufferStats() const;
+
+	// Inherited via IRenderDevice
+	virtual void CreateConstantBufferView(GpuVirtualAddress bufferLocation, std::uint32_t sizeInBytes, CpuDescriptorHandle destDescriptor) override;
+	virtual void CopyDescriptorsSimple(std::uint32_t numDescriptors, CpuDescriptorHandle destStart, CpuDescriptorHandle srcStart) override;
+
+	// Buffers get an id from CreateResource and a GPU address of the id shifted
+	// up by 32 bits. Only upload and readback buffers get memory, for Map.
+	virtual RHIResource CreateBuffer(std::uint64_t byteSize, HeapType heapType, ResourceState initialState) override;
+	virtual void AddRef(RHIResource resource) override;
+	virtual void Release(RHIResource resource) override;
+	virtual void* Map(RHIResource buffer) override;
+	virtual GpuVirtualAddress GetGpuVirtualAddress(RHIResource buffer) override;
+
+	virtual std::unique_ptr<ICommandList> CreateCommandList(CommandListType type) override;
+	virtual std::unique_ptr<IFence> CreateFence() override;
+
+private:
+	struct Buffer
+	{
+		std::uint64_t ByteSize = 0;
+		std::uint32_t RefCount = 1;
+		std::vector<std::uint8_t> Data;
+	};
+
+	RecordedCommandStream m_stream;
+	RHIResource m_nextResource = 1;
+	std::unordered_map<RHIResource, Buffer> m_buffers;
+	RecordedBufferStats m_bufferStats;
+};
+
+// There is no GPU, so a fence reaches a value as soon as it is signaled.
+class RecordingFence : public IFence
+{
+public:
+	void Signal(std::uint64_t value);
+
+	// Inherited via IFence
+	virtual std::uint64_t GetCompletedValue() const override;
+	virtual void Wait(std::uint64_t value) override;
+
+private:
+	std::uint64_t m_completedValue = 0;
+};
+
+// Executes command lists by appending them, in submission order, to one stream.
+class RecordingCommandQueue : public ICommandQueue
+{
+public:
+	explicit RecordingCommandQueue(CommandListType type = CommandListType::Direct);
+
+	void ExecuteCommandLists(std::uint32_t numCommandLists, RecordingCommandList* const* commandLists);
+	void Signal(std::uint64_t fenceValue);
+	std::uint64_t GetCompletedValue() const;
+
+	void Reset();
+	const RecordedCommandStream& GetStream() const;
+
+	// Inherited via ICommandQueue. Takes the lists and fences of a RecordingDevice.
+	virtual CommandListType GetType() const override;
+	virtual void ExecuteCommandLists(std::uint32_t numCommandLists, ICommandList* const* commandLists) override;
+	virtual void Signal(IFence& fence, std::uint64_t value) override;
+
+private:
+	CommandListType m_type;
+	RecordedCommandStream m_stream;
+
+	// There is no GPU so all submitted work is complete as soon as it is signaled.
+	std::uint64_t m_completedFenceValue = 0;
+};
+
+#endif
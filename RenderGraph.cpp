@@ -0,0 +1,419 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+bool HasState(ResourceState state, ResourceState flag)
+{
+	return (state & flag) != ResourceState::Common;
+}
+
+}
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_accesses.clear();
+	m_livePasses.clear();
+	m_barriers.clear();
+	m_batchOffsets.clear();
+	m_stats = RenderGraphStats();
+}
+
+std::uint32_t RenderGraph::ImportResource(const char* name, RHIResource resource, ResourceState initialState, ResourceState finalState)
+{
+	Resource imported;
+	imported.Name = name;
+	imported.Handle = resource;
+	imported.InitialState = initialState;
+	imported.FinalState = finalState;
+	m_resources.push_back(imported);
+	return static_cast<std::uint32_t>(m_resources.size() - 1);
+}
+
+std::uint32_t RenderGraph::CreateTransientResource(const char* name, const TransientResourceDesc& desc)
+{
+	Resource transient;
+	transient.Name = name;
+	transient.IsTransient = true;
+	transient.InitialState = desc.InitialState;
+	transient.FinalState = desc.InitialState;
+	transient.Desc = desc;
+	m_resources.push_back(transient);
+	return static_cast<std::uint32_t>(m_resources.size() - 1);
+}
+
+std::uint32_t RenderGraph::AddPass(const char* name, ExecuteFunc execute)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Execute = std::move(execute);
+	m_passes.push_back(std::move(pass));
+	return static_cast<std::uint32_t>(m_passes.size() - 1);
+}
+
+void RenderGraph::Read(std::uint32_t pass, std::uint32_t resource, ResourceState state)
+{
+	m_accesses.push_back({ pass, resource, state, false });
+}
+
+void RenderGraph::Write(std::uint32_t pass, std::uint32_t resource, ResourceState state)
+{
+	m_accesses.push_back({ pass, resource, state, true });
+}
+
+void RenderGraph::SetSideEffects(std::uint32_t pass)
+{
+	m_passes[pass].HasSideEffects = true;
+}
+
+void RenderGraph::Compile()
+{
+	m_livePasses.clear();
+	m_barriers.clear();
+	m_stats = RenderGraphStats();
+	for (auto& resource : m_resources) {
+		resource.FirstUse = InvalidIndex;
+		resource.LastUse = InvalidIndex;
+		resource.HeapOffset = InvalidOffset;
+	}
+
+	// Accesses grouped by pass, in the order they were declared in.
+	std::stable_sort(m_accesses.begin(), m_accesses.end(), [](const Access& a, const Access& b) { return a.Pass < b.Pass; });
+
+	CullPasses();
+	PlaceBarriers();
+	PlaceTransientResources();
+	PlaceAliasingBarriers();
+
+	// Batch offsets, batch i is [m_batchOffsets[i], m_batchOffsets[i + 1]).
+	std::stable_sort(m_barriers.begin(), m_barriers.end(), [](const Barrier& a, const Barrier& b) {
+		return a.Batch != b.Batch ? a.Batch < b.Batch : a.Order < b.Order;
+	});
+	auto batchCount = m_livePasses.size() + 1;
+	m_batchOffsets.assign(batchCount + 1, 0);
+	for (const auto& barrier : m_barriers) {
+		m_batchOffsets[barrier.Batch + 1]++;
+	}
+	for (std::size_t batch = 0; batch < batchCount; batch++) {
+		if (m_batchOffsets[batch + 1] > 0) {
+			m_stats.BarrierBatchCount++;
+		}
+		m_batchOffsets[batch + 1] += m_batchOffsets[batch];
+	}
+
+	m_stats.PassCount = static_cast<std::uint32_t>(m_passes.size());
+	m_stats.CulledPassCount = static_cast<std::uint32_t>(m_passes.size() - m_livePasses.size());
+}
+
+bool RenderGraph::IsPassCulled(std::uint32_t pass) const
+{
+	return m_passes[pass].IsCulled;
+}
+
+std::uint64_t RenderGraph::GetTransientHeapSize() const
+{
+	return m_stats.TransientHeapSize;
+}
+
+std::uint64_t RenderGraph::GetTransientOffset(std::uint32_t resource) const
+{
+	return m_resources[resource].HeapOffset;
+}
+
+void RenderGraph::SetTransientResource(std::uint32_t resource, RHIResource placedResource)
+{
+	m_resources[resource].Handle = placedResource;
+}
+
+void RenderGraph::Execute(ICommandRecorder& recorder, ICommandRecorder* endRecorder)
+{
+	auto recordBatch = [&](ICommandRecorder& batchRecorder, std::size_t batch) {
+		m_recordedBarriers.clear();
+		for (auto i = m_batchOffsets[batch]; i < m_batchOffsets[batch + 1]; i++) {
+			const auto& barrier = m_barriers[i];
+			switch (barrier.Type) {
+			case BarrierType::Transition:
+				m_recordedBarriers.push_back(::ResourceBarrier::Transition(GetResource(barrier.Resource),
+					barrier.StateBefore, barrier.StateAfter, barrier.Flags));
+				break;
+			case BarrierType::Aliasing:
+				m_recordedBarriers.push_back(::ResourceBarrier::Aliasing(
+					barrier.Resource != InvalidIndex ? GetResource(barrier.Resource) : 0, GetResource(barrier.ResourceAfter)));
+				break;
+			case BarrierType::UnorderedAccess:
+				m_recordedBarriers.push_back(::ResourceBarrier::UnorderedAccess(GetResource(barrier.Resource)));
+				break;
+			}
+		}
+		if (!m_recordedBarriers.empty()) {
+			batchRecorder.ResourceBarrier(static_cast<std::uint32_t>(m_recordedBarriers.size()), m_recordedBarriers.data());
+		}
+	};
+
+	for (std::size_t i = 0; i < m_livePasses.size(); i++) {
+		recordBatch(recorder, i);
+		m_passes[m_livePasses[i]].Execute(recorder);
+	}
+	recordBatch(endRecorder != nullptr ? *endRecorder : recorder, m_livePasses.size());
+}
+
+const char* RenderGraph::GetPassName(std::uint32_t pass) const
+{
+	return m_passes[pass].Name;
+}
+
+const char* RenderGraph::GetResourceName(std::uint32_t resource) const
+{
+	return m_resources[resource].Name;
+}
+
+RHIResource RenderGraph::GetResource(std::uint32_t resource) const
+{
+	return m_resources[resource].Handle;
+}
+
+const RenderGraphStats& RenderGraph::GetStats() const
+{
+	return m_stats;
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walk back from the passes that have to run, everything they access is
+	// needed and so are the passes writing it before them.
+	std::vector<bool> needed(m_resources.size(), false);
+	auto end = m_accesses.size();
+	for (auto pass = static_cast<std::uint32_t>(m_passes.size()); pass-- > 0;) {
+		auto begin = end;
+		while (begin > 0 && m_accesses[begin - 1].Pass == pass) {
+			begin--;
+		}
+
+		bool live = m_passes[pass].HasSideEffects;
+		for (auto i = begin; i < end && !live; i++) {
+			const auto& access = m_accesses[i];
+			live = access.IsWrite && (!m_resources[access.Resource].IsTransient || needed[access.Resource]);
+		}
+		if (live) {
+			for (auto i = begin; i < end; i++) {
+				needed[m_accesses[i].Resource] = true;
+			}
+		}
+		m_passes[pass].IsCulled = !live;
+		end = begin;
+	}
+
+	for (std::uint32_t pass = 0; pass < m_passes.size(); pass++) {
+		if (!m_passes[pass].IsCulled) {
+			m_livePasses.push_back(pass);
+		}
+	}
+}
+
+void RenderGraph::PlaceBarriers()
+{
+	// Accesses of the passes left, by resource and then in the order of the passes.
+	std::vector<std::uint32_t> liveIndices(m_passes.size(), InvalidIndex);
+	for (std::uint32_t i = 0; i < m_livePasses.size(); i++) {
+		liveIndices[m_livePasses[i]] = i;
+	}
+	std::vector<Access> accesses;
+	for (const auto& access : m_accesses) {
+		if (liveIndices[access.Pass] != InvalidIndex) {
+			accesses.push_back({ liveIndices[access.Pass], access.Resource, access.State, access.IsWrite });
+		}
+	}
+	std::stable_sort(accesses.begin(), accesses.end(), [](const Access& a, const Access& b) { return a.Resource < b.Resource; });
+
+	auto liveCount = static_cast<std::uint32_t>(m_livePasses.size());
+	std::size_t next = 0;
+	for (std::uint32_t resourceIndex = 0; resourceIndex < m_resources.size(); resourceIndex++) {
+		auto& resource = m_resources[resourceIndex];
+
+		// One use per pass, then reads following one another merged into one use.
+		m_uses.clear();
+		for (; next < accesses.size() && accesses[next].Resource == resourceIndex; next++) {
+			const auto& access = accesses[next];
+			if (!m_uses.empty() && m_uses.back().Last == access.Pass) {
+				m_uses.back().State = m_uses.back().State | access.State;
+				m_uses.back().IsWrite = m_uses.back().IsWrite || access.IsWrite;
+			}
+			else {
+				m_uses.push_back({ access.Pass, access.Pass, access.State, access.IsWrite });
+			}
+		}
+		std::size_t useCount = 0;
+		for (std::size_t i = 0; i < m_uses.size(); i++) {
+			if (useCount > 0 && !m_uses[useCount - 1].IsWrite && !m_uses[i].IsWrite) {
+				m_uses[useCount - 1].Last = m_uses[i].Last;
+				m_uses[useCount - 1].State = m_uses[useCount - 1].State | m_uses[i].State;
+			}
+			else {
+				m_uses[useCount++] = m_uses[i];
+			}
+		}
+		m_uses.resize(useCount);
+
+		if (m_uses.empty()) {
+			// Imported resources still end in their final state.
+			if (!resource.IsTransient) {
+				AddTransition(resourceIndex, resource.InitialState, resource.FinalState, 0, liveCount, 2);
+			}
+			continue;
+		}
+		resource.FirstUse = m_uses.front().First;
+		resource.LastUse = m_uses.back().Last;
+
+		// Transient resources only become active with their aliasing barrier in
+		// front of the first use, their transition cannot begin earlier.
+		const auto& first = m_uses.front();
+		AddTransition(resourceIndex, resource.InitialState, first.State, resource.IsTransient ? first.First : 0, first.First, 2);
+
+		for (std::size_t i = 1; i < m_uses.size(); i++) {
+			const auto& before = m_uses[i - 1];
+			const auto& after = m_uses[i];
+			if (before.State != after.State) {
+				AddTransition(resourceIndex, before.State, after.State, before.Last + 1, after.First, 2);
+			}
+			else if ((before.IsWrite || after.IsWrite) && HasState(after.State, ResourceState::UnorderedAccess)) {
+				AddBarrier(after.First, 2, BarrierType::UnorderedAccess, BarrierFlags::None,
+					resourceIndex, InvalidIndex, after.State, after.State);
+				m_stats.UavBarrierCount++;
+			}
+		}
+
+		// Transient resources go back to their initial state before the memory is
+		// handed to the next resource, imported ones may take until the end.
+		const auto& last = m_uses.back();
+		if (resource.IsTransient) {
+			AddTransition(resourceIndex, last.State, resource.FinalState, last.Last + 1, last.Last + 1, 0);
+		}
+		else {
+			AddTransition(resourceIndex, last.State, resource.FinalState, last.Last + 1, liveCount, 2);
+		}
+	}
+}
+
+void RenderGraph::PlaceTransientResources()
+{
+	// Largest first, each at the lowest offset that is free while it is used.
+	std::vector<std::uint32_t> order;
+	for (std::uint32_t i = 0; i < m_resources.size(); i++) {
+		if (m_resources[i].IsTransient && m_resources[i].FirstUse != InvalidIndex) {
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+		return m_resources[a].Desc.Size > m_resources[b].Desc.Size;
+	});
+
+	std::vector<std::uint32_t> placed;
+	std::vector<std::uint32_t> overlapping;
+	std::vector<std::uint64_t> candidates;
+	for (auto index : order) {
+		auto& resource = m_resources[index];
+		auto alignment = std::max<std::uint64_t>(resource.Desc.Alignment, 1);
+		auto size = resource.Desc.Size;
+
+		overlapping.clear();
+		candidates.assign(1, 0);
+		for (auto other : placed) {
+			const auto& placedResource = m_resources[other];
+			if (placedResource.FirstUse <= resource.LastUse && resource.FirstUse <= placedResource.LastUse) {
+				overlapping.push_back(other);
+				candidates.push_back(AlignUp(placedResource.HeapOffset + placedResource.Desc.Size, alignment));
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		for (auto offset : candidates) {
+			bool fits = std::none_of(overlapping.begin(), overlapping.end(), [&](std::uint32_t other) {
+				const auto& placedResource = m_resources[other];
+				return offset < placedResource.HeapOffset + placedResource.Desc.Size && placedResource.HeapOffset < offset + size;
+			});
+			if (fits) {
+				resource.HeapOffset = offset;
+				break;
+			}
+		}
+
+		placed.push_back(index);
+		m_stats.TransientHeapSize = std::max<std::uint64_t>(m_stats.TransientHeapSize, resource.HeapOffset + size);
+		m_stats.TransientResourceSize += size;
+	}
+}
+
+void RenderGraph::PlaceAliasingBarriers()
+{
+	// A resource sharing memory gets it from the last resource that used it this
+	// frame, or from any resource if it is the first, which last frame's may be.
+	for (std::uint32_t index = 0; index < m_resources.size(); index++) {
+		const auto& resource = m_resources[index];
+		if (resource.HeapOffset == InvalidOffset) {
+			continue;
+		}
+
+		bool sharesMemory = false;
+		auto before = InvalidIndex;
+		for (std::uint32_t other = 0; other < m_resources.size(); other++) {
+			const auto& otherResource = m_resources[other];
+			if (other == index || otherResource.HeapOffset == InvalidOffset ||
+				otherResource.HeapOffset >= resource.HeapOffset + resource.Desc.Size ||
+				resource.HeapOffset >= otherResource.HeapOffset + otherResource.Desc.Size) {
+				continue;
+			}
+			sharesMemory = true;
+			if (otherResource.LastUse < resource.FirstUse &&
+				(before == InvalidIndex || otherResource.LastUse > m_resources[before].LastUse)) {
+				before = other;
+			}
+		}
+
+		if (sharesMemory) {
+			AddBarrier(resource.FirstUse, 1, BarrierType::Aliasing, BarrierFlags::None,
+				before, index, ResourceState::Common, ResourceState::Common);
+			m_stats.AliasingBarrierCount++;
+		}
+	}
+}
+
+void RenderGraph::AddTransition(std::uint32_t resource, ResourceState before, ResourceState after,
+	std::uint32_t afterBatch, std::uint32_t batch, std::uint32_t order)
+{
+	if (before == after) {
+		return;
+	}
+
+	if (afterBatch < batch) {
+		AddBarrier(afterBatch, order, BarrierType::Transition, BarrierFlags::BeginOnly, resource, InvalidIndex, before, after);
+		AddBarrier(batch, order, BarrierType::Transition, BarrierFlags::EndOnly, resource, InvalidIndex, before, after);
+		m_stats.SplitTransitionCount++;
+	}
+	else {
+		AddBarrier(batch, order, BarrierType::Transition, BarrierFlags::None, resource, InvalidIndex, before, after);
+	}
+	m_stats.TransitionCount++;
+}
+
+void RenderGraph::AddBarrier(std::uint32_t batch, std::uint32_t order, BarrierType type, BarrierFlags flags,
+	std::uint32_t resource, std::uint32_t resourceAfter, ResourceState before, ResourceState after)
+{
+	Barrier barrier;
+	barrier.Batch = batch;
+	barrier.Order = order;
+	barrier.Type = type;
+	barrier.Flags = flags;
+	barrier.Resource = resource;
+	barrier.ResourceAfter = resourceAfter;
+	barrier.StateBefore = before;
+	barrier.StateAfter = after;
+	m_barriers.push_back(barrier);
+}
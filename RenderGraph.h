@@ -0,0 +1,174 @@
+#ifndef RENDERGRAPH_H_
+#define RENDERGRAPH_H_
+
+#include "RHI.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Memory a transient resource needs in the heap of the graph.
+struct TransientResourceDesc
+{
+	std::uint64_t Size = 0;
+	std::uint64_t Alignment = 65536;
+	// State the placed resource is created in. It is back in it after its last
+	// use, so the same resource can be used again next frame.
+	ResourceState InitialState = ResourceState::Common;
+};
+
+// Of the last Compile. Split transitions count once.
+struct RenderGraphStats
+{
+	std::uint32_t PassCount = 0;
+	std::uint32_t CulledPassCount = 0;
+	std::uint32_t TransitionCount = 0;
+	std::uint32_t SplitTransitionCount = 0;
+	std::uint32_t AliasingBarrierCount = 0;
+	std::uint32_t UavBarrierCount = 0;
+	// ResourceBarrier calls Execute records.
+	std::uint32_t BarrierBatchCount = 0;
+	// Heap size of the transient resources, and what they would take without aliasing.
+	std::uint64_t TransientHeapSize = 0;
+	std::uint64_t TransientResourceSize = 0;
+};
+
+// The passes of a frame and the resources they read and write. Compile culls the
+// passes no other pass depends on, places the barriers between the passes that
+// are left and places the transient resources in one heap, sharing memory
+// between resources that are not used at the same time. Execute records the
+// passes with the barriers in front of them.
+//
+// Barriers are as few and as early as possible:
+// - Reads following one another transition once, to all of their states.
+// - With passes between two accesses the transition is split: it begins after
+//   the earlier access and ends before the later one.
+// - UAV writes following one another are separated by a UAV barrier.
+// - All barriers between two passes are recorded with one ResourceBarrier call.
+// Imported resources start in their initial state and end in their final state.
+// Transient resources get an aliasing barrier before their first use if they
+// share memory, and their first pass has to write all of them (clear or discard).
+class RenderGraph
+{
+public:
+	using ExecuteFunc = std::function<void(ICommandRecorder& recorder)>;
+
+	static constexpr std::uint32_t InvalidIndex = 0xffffffff;
+	static constexpr std::uint64_t InvalidOffset = ~0ull;
+
+	// Starts the next frame, forgets all passes and resources.
+	void Reset();
+
+	// Resources return indices used with Read and Write.
+	std::uint32_t ImportResource(const char* name, RHIResource resource, ResourceState initialState, ResourceState finalState);
+	std::uint32_t CreateTransientResource(const char* name, const TransientResourceDesc& desc);
+
+	// Passes run in the order they are added. Access states of one pass are
+	// combined. A write keeps what was written before it, so the earlier writers
+	// of the resource stay alive.
+	std::uint32_t AddPass(const char* name, ExecuteFunc execute);
+	void Read(std::uint32_t pass, std::uint32_t resource, ResourceState state);
+	void Write(std::uint32_t pass, std::uint32_t resource, ResourceState state);
+	// Passes writing imported resources are never culled, neither are passes with
+	// side effects the graph does not see, e.g. queries.
+	void SetSideEffects(std::uint32_t pass);
+
+	void Compile();
+
+	// After Compile. Transient resources only used by culled passes get no memory
+	// and have the offset InvalidOffset.
+	bool IsPassCulled(std::uint32_t pass) const;
+	std::uint64_t GetTransientHeapSize() const;
+	std::uint64_t GetTransientOffset(std::uint32_t resource) const;
+	// The resource placed at GetTransientOffset, created in its initial state.
+	void SetTransientResource(std::uint32_t resource, RHIResource placedResource);
+
+	// Records the passes that were not culled. The barriers after the last pass
+	// are recorded on endRecorder if given, for passes that record into command
+	// lists of their own that are executed after recorder.
+	void Execute(ICommandRecorder& recorder, ICommandRecorder* endRecorder = nullptr);
+
+	const char* GetPassName(std::uint32_t pass) const;
+	const char* GetResourceName(std::uint32_t resource) const;
+	RHIResource GetResource(std::uint32_t resource) const;
+	const RenderGraphStats& GetStats() const;
+
+private:
+	struct Resource
+	{
+		const char* Name = nullptr;
+		RHIResource Handle = 0;
+		bool IsTransient = false;
+		ResourceState InitialState = ResourceState::Common;
+		ResourceState FinalState = ResourceState::Common;
+		TransientResourceDesc Desc;
+
+		// Compiled: first and last pass using it, in the passes that are not culled.
+		std::uint32_t FirstUse = InvalidIndex;
+		std::uint32_t LastUse = InvalidIndex;
+		std::uint64_t HeapOffset = InvalidOffset;
+	};
+
+	struct Pass
+	{
+		const char* Name = nullptr;
+		ExecuteFunc Execute;
+		bool HasSideEffects = false;
+		bool IsCulled = false;
+	};
+
+	struct Access
+	{
+		std::uint32_t Pass;
+		std::uint32_t Resource;
+		ResourceState State;
+		bool IsWrite;
+	};
+
+	// Barriers name graph resources, transient ones only get their handles after Compile.
+	struct Barrier
+	{
+		// Barriers of one batch are recorded by Order: transitions of transient
+		// resources back to their initial state, then aliasing barriers, then the others.
+		std::uint32_t Batch;
+		std::uint32_t Order;
+		BarrierType Type;
+		BarrierFlags Flags;
+		std::uint32_t Resource;
+		std::uint32_t ResourceAfter;
+		ResourceState StateBefore;
+		ResourceState StateAfter;
+	};
+
+	// A run of accesses of one resource in the same state: one write or reads following one another.
+	struct Use
+	{
+		std::uint32_t First;
+		std::uint32_t Last;
+		ResourceState State;
+		bool IsWrite;
+	};
+
+	void CullPasses();
+	void PlaceBarriers();
+	void PlaceTransientResources();
+	void PlaceAliasingBarriers();
+	void AddTransition(std::uint32_t resource, ResourceState before, ResourceState after,
+		std::uint32_t afterBatch, std::uint32_t batch, std::uint32_t order);
+	void AddBarrier(std::uint32_t batch, std::uint32_t order, BarrierType type, BarrierFlags flags,
+		std::uint32_t resource, std::uint32_t resourceAfter, ResourceState before, ResourceState after);
+
+	std::vector<Resource> m_resources;
+	std::vector<Pass> m_passes;
+	std::vector<Access> m_accesses;
+
+	// Compiled. Batch i is recorded in front of the i-th pass that is not culled,
+	// the last batch after all of them.
+	std::vector<std::uint32_t> m_livePasses;
+	std::vector<Barrier> m_barriers;
+	std::vector<std::uint32_t> m_batchOffsets;
+	std::vector<Use> m_uses;
+	std::vector<::ResourceBarrier> m_recordedBarriers;
+	RenderGraphStats m_stats;
+};
+
+#endif
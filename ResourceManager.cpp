@@ -1,21 +1,67 @@
 #include "ResourceManager.h"
-#include "d3dUtility.h"
-#include "d3dx12.h"
-using namespace Microsoft::WRL;
+#include "IndexPacking.h"
+#include "ContentHash.h"
+#include "DirtyRanges.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+VertexSource GetVertexSource(const Mesh& mesh)
+{
+	VertexSource source;
+	if (!mesh.Vertices.empty()) {
+		source.Position = &mesh.Vertices[0].Position.x;
+		source.Color = &mesh.Vertices[0].Color.x;
+		source.Normal = &mesh.Vertices[0].Normal.x;
+		source.Tangent = &mesh.Vertices[0].TangentU.x;
+		source.TexCoord = &mesh.Vertices[0].TexCord.x;
+	}
+	source.Stride = sizeof(Vertex);
+	source.Count = mesh.Vertices.size();
+	return source;
+}
+
+const void* GetIndexData(const Mesh& mesh)
+{
+	return mesh.IndexFormat == IndexFormat::Uint16 ?
+		static_cast<const void*>(mesh.Indices16.data()) : static_cast<const void*>(mesh.Indices32.data());
+}
+
+std::uint32_t GetIndexCount(const Mesh& mesh)
+{
+	return static_cast<std::uint32_t>(mesh.IndexFormat == IndexFormat::Uint16 ? mesh.Indices16.size() : mesh.Indices32.size());
+}
+
+}
 
 ResourceManager::ResourceManager()
 {
 }
 
-ResourceManager::ResourceManager(ID3D12GraphicsCommandList* commandList, ID3D12Device* device) :
-	m_commandList(commandList)
+ResourceManager::ResourceManager(IRenderDevice& device, ICommandQueue& copyQueue, ICommandQueue& directQueue,
+	std::uint32_t frameContextCount)
 {
-	m_device = device;
-	InitializeFrameContexts();
+	m_device = &device;
+	m_geometryArena = GeometryArena(device);
+	m_uploader = std::make_unique<StagingUploader>(device, copyQueue);
+	m_updateUploader = std::make_unique<StagingUploader>(device, directQueue, 8 * 1024 * 1024);
+	InitializeFrameContexts(frameContextCount);
 }
 
-void ResourceManager::AddMesh(Mesh mesh)
+void ResourceManager::SetVertexFormat(std::uint32_t vertexFormatFlags)
 {
+	m_vertexFormat = vertexFormatFlags;
+}
+
+MeshHandle ResourceManager::AddMesh(Mesh mesh)
+{
+	auto existingMesh = m_meshes.Find(mesh.Name);
+	if (existingMesh.IsValid()) {
+		ReplaceMesh(existingMesh, std::move(mesh));
+		return existingMesh;
+	}
+
 	if (!m_freeCBPerObjectIndex.empty()) {
 		mesh.cbPerObjectIndex = m_freeCBPerObjectIndex.back();
 		m_freeCBPerObjectIndex.pop_back();
@@ -23,72 +69,303 @@ void ResourceManager::AddMesh(Mesh mesh)
 	else {
 		mesh.cbPerObjectIndex = m_newCBPerObjectIndex;
 		m_newCBPerObjectIndex++;
+		m_objectTransforms.resize(m_newCBPerObjectIndex);
+		// No frame context has a copy of the new transform yet, even if it is the identity.
+		m_transformChanges.MarkChanged(mesh.cbPerObjectIndex);
 	}
-	if (m_meshes.count(mesh.Name) == 0) {
-		mesh.VertexBufferGPU = CreateDefaultBuffer(m_device,
-			m_commandList, mesh.Vertices.data(), mesh.VertexBufferByteSize, mesh.VertexBufferUploader);
 
-		mesh.IndexBufferGPU = CreateDefaultBuffer(m_device,
-			m_commandList, mesh.Indices32.data(), mesh.IndexBufferByteSize, mesh.IndexBufferUploader);
+	PackVertices(mesh);
+	PackIndices(mesh);
+
+	AcquireGeometry(mesh, *m_uploader);
+	WriteObjectTransform(mesh);
 
-		m_meshes[mesh.Name] = mesh;
+	// Meshes sharing geometry that is already on the GPU can be drawn right away.
+	std::vector<DrawItem> drawItems;
+	mesh.IsResident = mesh.UploadFenceValue <= m_uploader->GetCompletedFenceValue();
+	if (mesh.IsResident) {
+		BuildDrawItems(mesh, drawItems);
 	}
-	else {
-		UpdateMesh(mesh);
+
+	auto name = mesh.Name;
+	auto isResident = mesh.IsResident;
+	auto handle = m_meshes.Add(std::move(mesh), drawItems.data(), static_cast<std::uint32_t>(drawItems.size()), name);
+	if (!isResident) {
+		m_pendingMeshes.push_back(handle);
 	}
+	return handle;
 }
 
 void ResourceManager::UpdateMesh(Mesh mesh)
 {
-	throw("UpdateMesh() function not implemented");
+	auto handle = m_meshes.Find(mesh.Name);
+	if (!handle.IsValid()) {
+		AddMesh(std::move(mesh));
+		return;
+	}
+
+	ReplaceMesh(handle, std::move(mesh));
 }
 
-void ResourceManager::DeleteMesh(const Mesh& mesh)
+void ResourceManager::UpdateVertices(MeshHandle handle, std::size_t firstVertex, std::size_t vertexCount)
 {
-	m_meshes.erase(mesh.Name);
-	m_freeCBPerObjectIndex.push_back(mesh.cbPerObjectIndex);
+	auto mesh = m_meshes.GetMesh(handle);
+	if (mesh == nullptr || firstVertex >= mesh->Vertices.size()) {
+		return;
+	}
+	vertexCount = std::min<std::size_t>(vertexCount, mesh->Vertices.size() - firstVertex);
+
+	// Conservative bounds, the submesh the vertices belong to is not known.
+	auto changedBounds = ComputeAabb(&mesh->Vertices[firstVertex].Position.x, vertexCount, sizeof(Vertex));
+	for (auto& drawArg : mesh->DrawArgs) {
+		drawArg.second.Bounds = MergeAabb(drawArg.second.Bounds, changedBounds);
+	}
+
+	// Shared geometry needs a copy of its own, and vertices that left the
+	// quantization bounds change the encoding of all others. Both take the full
+	// compare of UpdateMesh.
+	auto shared = m_sharedGeometry.find(mesh->GeometryHash);
+	bool isShared = mesh->GeometryHash != 0 && shared != m_sharedGeometry.end() && shared->second.RefCount > 1;
+	if (isShared || mesh->VertexFormat != m_vertexFormat ||
+		!EncodeVertexRange(GetVertexSource(*mesh), mesh->VertexFormat, mesh->Quantization, firstVertex, vertexCount, mesh->PackedVertices)) {
+		ReplaceMesh(handle, *mesh);
+		return;
+	}
+
+	// The content no longer matches the hash it could be shared by.
+	if (mesh->GeometryHash != 0 && shared != m_sharedGeometry.end()) {
+		m_sharedGeometry.erase(shared);
+	}
+	mesh->GeometryHash = 0;
+
+	// One range per vertex stream.
+	auto& uploader = mesh->IsResident ? *m_updateUploader : *m_uploader;
+	auto layout = BuildVertexLayout(mesh->VertexFormat);
+	auto byteSize = static_cast<std::uint64_t>(vertexCount) * mesh->VertexByteStride;
+	for (std::uint32_t stream = 0; stream < layout.StreamCount; stream++) {
+		auto byteOffset = GetStreamOffset(layout, stream, mesh->Vertices.size()) +
+			static_cast<std::uint64_t>(firstVertex) * layout.StreamStrides[stream];
+		m_geometryArena.UploadVertices(uploader, mesh->Geometry, byteOffset, mesh->PackedVertices.data() + byteOffset,
+			static_cast<std::uint64_t>(vertexCount) * layout.StreamStrides[stream]);
+	}
+	if (!mesh->IsResident) {
+		mesh->UploadFenceValue = m_uploader->GetNextFenceValue();
+	}
+
+	m_updateStats.UpdateCount++;
+	m_updateStats.UploadedBytes += byteSize;
+	m_updateStats.UnchangedBytes += mesh->PackedVertices.size() + mesh->IndexBufferByteSize - byteSize;
+	RefreshDrawItems(handle);
 }
 
-Mesh ResourceManager::GetMesh(std::string meshName)
+MeshUpdateStats ResourceManager::GetUpdateStats() const
 {
-	return m_meshes[meshName];
+	return m_updateStats;
 }
 
-std::unordered_map<std::string, Mesh> ResourceManager::GetAllMeshes()
+void ResourceManager::DeleteMesh(MeshHandle handle)
 {
-	return m_meshes;
+	auto mesh = m_meshes.GetMesh(handle);
+	if (mesh == nullptr) {
+		return;
+	}
+
+	m_freeCBPerObjectIndex.push_back(mesh->cbPerObjectIndex);
+	ReleaseGeometry(*mesh);
+	m_meshes.Remove(handle);
 }
 
-void ResourceManager::AddConstantBuffer(std::string name, UINT elementByteSize, UINT numOfElements, ID3D12DescriptorHeap* cbvHeap, UINT cbvHeapDescriptorSize)
+Mesh* ResourceManager::GetMesh(MeshHandle handle)
 {
-	for (int i = 0; i < numFrameContexts; i++) {
-		m_frameContexts[i].m_constantBuffers[name] = std::make_unique<UploadBuffer>(m_device, numOfElements, elementByteSize, true);
+	return m_meshes.GetMesh(handle);
+}
 
-		D3D12_GPU_VIRTUAL_ADDRESS cbAddress = m_frameContexts[i].m_constantBuffers[name]->Resource()->GetGPUVirtualAddress();
-		UINT objCBByteSize = m_frameContexts[i].m_constantBuffers[name]->GetElementPaddedByteSize();
+void ResourceManager::SetMeshWorld(MeshHandle handle, const Float4x4& world)
+{
+	auto mesh = m_meshes.GetMesh(handle);
+	if (mesh == nullptr) {
+		return;
+	}
+
+	mesh->World = world;
+	WriteObjectTransform(*mesh);
+
+	// The draw items carry world space bounds.
+	if (mesh->IsResident) {
+		RefreshDrawItems(handle);
+	}
+}
+
+MeshHandle ResourceManager::FindMesh(const std::string& meshName)
+{
+	return m_meshes.Find(meshName);
+}
+
+const std::vector<DrawItem>& ResourceManager::GetDrawItems() const
+{
+	return m_meshes.GetDrawItems();
+}
+
+std::uint64_t ResourceManager::GetDrawItemsVersion() const
+{
+	return m_meshes.GetVersion();
+}
 
-		for (int j = 0; j < numOfElements; j++) {
-			D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-			cbvDesc.BufferLocation = cbAddress + j * objCBByteSize;
-			cbvDesc.SizeInBytes = objCBByteSize;
+void ResourceManager::CompactGeometry(ICommandRecorder& recorder)
+{
+	// The uploads run on other command lists and have to land in the pages
+	// before they are copied. Queued ones still name the old buffers.
+	FlushUploads();
+	WaitForUploads();
+	UpdateResidency();
+	if (m_geometryArena.Compact(recorder) == 0) {
+		return;
+	}
+	m_geometryArena.TakeRetiredBuffers(GetCurrentFrameContext()->m_retiredBuffers);
+
+	std::vector<DrawItem> drawItems;
+	m_meshes.ForEach([&](MeshHandle handle, Mesh& mesh) {
+		BuildDrawItems(mesh, drawItems);
+		m_meshes.SetDrawItems(handle, drawItems.data(), static_cast<std::uint32_t>(drawItems.size()));
+	});
+}
 
-			auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(cbvHeap->GetCPUDescriptorHandleForHeapStart());
-			handle.Offset(m_currCBVHeapIndex, cbvHeapDescriptorSize);
+std::uint64_t ResourceManager::GetFragmentedGeometrySize() const
+{
+	return m_geometryArena.GetFragmentedSize();
+}
 
+void ResourceManager::FlushUploads()
+{
+	m_uploader->Flush();
+	m_updateUploader->Flush();
+}
 
-			m_device->CreateConstantBufferView(&cbvDesc, handle);
+void ResourceManager::UpdateResidency()
+{
+	if (m_pendingMeshes.empty()) {
+		return;
+	}
 
-			m_currCBVHeapIndex++;
+	auto completedValue = m_uploader->GetCompletedFenceValue();
+	std::vector<DrawItem> drawItems;
+	auto stillPending = std::remove_if(m_pendingMeshes.begin(), m_pendingMeshes.end(), [&](MeshHandle handle) {
+		auto mesh = m_meshes.GetMesh(handle);
+		if (mesh == nullptr) {
+			return true;
+		}
+		if (mesh->UploadFenceValue > completedValue) {
+			return false;
 		}
+
+		mesh->IsResident = true;
+		BuildDrawItems(*mesh, drawItems);
+		m_meshes.SetDrawItems(handle, drawItems.data(), static_cast<std::uint32_t>(drawItems.size()));
+		return true;
+	});
+	m_pendingMeshes.erase(stillPending, m_pendingMeshes.end());
+}
+
+bool ResourceManager::IsMeshResident(MeshHandle handle)
+{
+	auto mesh = m_meshes.GetMesh(handle);
+	return mesh != nullptr && mesh->IsResident;
+}
+
+void ResourceManager::WaitForUploads()
+{
+	m_uploader->WaitForIdle();
+	m_updateUploader->WaitForIdle();
+}
+
+void ResourceManager::FreeRetiredGeometry()
+{
+	auto& retiredGeometry = GetCurrentFrameContext()->m_retiredGeometry;
+	for (auto geometry : retiredGeometry) {
+		m_geometryArena.Free(geometry);
+	}
+	retiredGeometry.clear();
+	GetCurrentFrameContext()->m_retiredBuffers.clear();
+}
+
+StagingUploader::Stats ResourceManager::GetUploadStats() const
+{
+	return m_uploader->GetStats();
+}
+
+InstancedGeometry ResourceManager::GetInstancedGeometry(MeshHandle handle, std::uint32_t drawItemIndex)
+{
+	InstancedGeometry geometry;
+
+	// Built from the mesh itself, pending meshes have no draw items yet.
+	auto mesh = m_meshes.GetMesh(handle);
+	std::vector<DrawItem> drawItems;
+	if (mesh != nullptr) {
+		BuildDrawItems(*mesh, drawItems);
+	}
+	if (drawItemIndex >= drawItems.size()) {
+		return geometry;
 	}
 
+	const auto* drawItem = &drawItems[drawItemIndex];
+
+	geometry.VertexBuffer = drawItem->VertexBuffer;
+	geometry.AttributeBuffer = drawItem->AttributeBuffer;
+	geometry.IndexBuffer = drawItem->IndexBuffer;
+	geometry.IndexCount = drawItem->IndexCount;
+	geometry.StartIndexLocation = drawItem->StartIndexLocation;
+	geometry.BaseVertexLocation = drawItem->BaseVertexLocation;
+	for (int i = 0; i < 3; i++) {
+		geometry.PositionOffset[i] = mesh->Quantization.Offset[i];
+		geometry.PositionScale[i] = mesh->Quantization.Scale[i];
+	}
+	return geometry;
 }
 
-void ResourceManager::RemoveConstantBuffer(std::string name)
+GpuVirtualAddress ResourceManager::UpdateInstanceBuffer(const std::vector<InstanceTransform>& transforms)
 {
-	for (int i = 0; i < numFrameContexts; i++) {
-		m_frameContexts[i].m_constantBuffers.erase(name);
+	auto byteSize = std::max<std::uint64_t>(transforms.size() * sizeof(InstanceTransform), sizeof(InstanceTransform));
+	auto allocation = AllocateFrameData(byteSize, sizeof(InstanceTransform));
+	if (!transforms.empty()) {
+		std::memcpy(allocation.CpuAddress, transforms.data(), transforms.size() * sizeof(InstanceTransform));
 	}
+	return allocation.GpuAddress;
+}
+
+GpuVirtualAddress ResourceManager::UpdateObjectTransforms()
+{
+	auto& frameContext = m_frameContexts[m_currFrameContextIndex];
+	auto count = static_cast<std::uint32_t>(m_objectTransforms.size());
+	ReserveObjectTransforms(frameContext, count);
+
+	auto updated = m_transformChanges.Sync(m_currFrameContextIndex, count, [&](std::uint32_t index) {
+		frameContext.m_mappedObjectTransforms[index] = m_objectTransforms[index];
+	});
+
+	m_transformUploadStats.LastFrameCount = static_cast<std::uint32_t>(updated);
+	m_transformUploadStats.LastFrameBytes = updated * sizeof(ObjectTransform);
+	m_transformUploadStats.TotalBytes += m_transformUploadStats.LastFrameBytes;
+	return m_device->GetGpuVirtualAddress(frameContext.m_objectTransforms.Get());
+}
+
+TransformUploadStats ResourceManager::GetTransformUploadStats() const
+{
+	return m_transformUploadStats;
+}
+
+UploadAllocation ResourceManager::AllocateFrameData(std::uint64_t byteSize, std::uint64_t alignment)
+{
+	return GetCurrentFrameContext()->m_uploadAllocator.Allocate(byteSize, alignment);
+}
+
+std::uint32_t ResourceManager::GetUniqueGeometryCount() const
+{
+	return m_uniqueGeometryCount;
+}
+
+std::uint32_t ResourceManager::GetFrameContextCount() const
+{
+	return static_cast<std::uint32_t>(m_frameContexts.size());
 }
 
 FrameContext* ResourceManager::GetCurrentFrameContext()
@@ -103,86 +380,285 @@ int ResourceManager::GetCurrentFrameIndex()
 
 void ResourceManager::CycleFrameContext()
 {
-	m_currFrameContextIndex = (m_currFrameContextIndex + 1) % numFrameContexts;
+	m_currFrameContextIndex = (m_currFrameContextIndex + 1) % static_cast<int>(m_frameContexts.size());
 }
 
-template <typename T>
-void ResourceManager::UpdateConstantBuffer(std::string name, int elementIndex, const T& pData)
+void ResourceManager::PackVertices(Mesh& mesh)
 {
-	m_frameContexts[m_currFrameContextIndex].m_constantBuffers[name]->CopyData(elementIndex, pData);
+	mesh.VertexFormat = m_vertexFormat;
+	mesh.Quantization = EncodeVertices(GetVertexSource(mesh), m_vertexFormat, mesh.PackedVertices);
+	auto layout = BuildVertexLayout(m_vertexFormat);
+	mesh.VertexByteStride = layout.Stride;
+	mesh.PositionByteStride = layout.StreamCount > 1 ? layout.StreamStrides[0] : 0;
+	mesh.VertexBufferByteSize = static_cast<std::uint32_t>(mesh.PackedVertices.size());
 }
 
-Microsoft::WRL::ComPtr<ID3D12Resource> ResourceManager::CreateDefaultBuffer(
-	ID3D12Device* device,
-	ID3D12GraphicsCommandList* commandList,
-	const void* pData,
-	UINT64 pDataByteSize,
-	Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer)
+void ResourceManager::PackIndices(Mesh& mesh)
 {
-	ComPtr<ID3D12Resource> defaultBuffer;
+	if (mesh.Indices16.empty() && !mesh.Indices32.empty()) {
+		if (ChooseIndexFormat(mesh.Vertices.size()) == IndexFormat::Uint16) {
+			mesh.Indices16.assign(mesh.Indices32.begin(), mesh.Indices32.end());
+			mesh.Indices32.clear();
+		}
+		else if (mesh.DrawArgs.size() <= 1) {
+			// Meshes just over the 16 bit limit are split into submeshes that each
+			// address their vertices relative to their own BaseVertexLocation.
+			auto submesh = mesh.DrawArgs.empty() ? SubmeshGeometry() : mesh.DrawArgs.begin()->second;
+			bool coversAllIndices = mesh.DrawArgs.empty() ||
+				(submesh.StartIndexLocation == 0 && submesh.IndexCount == mesh.Indices32.size());
+
+			std::vector<IndexRange> ranges;
+			if (coversAllIndices && mesh.Indices32.size() % 3 == 0 &&
+				PackIndices16(mesh.Indices32.data(), mesh.Indices32.size(), mesh.Indices16, ranges)) {
+				mesh.DrawArgs.clear();
+				for (std::size_t i = 0; i < ranges.size(); i++) {
+					SubmeshGeometry range = submesh;
+					range.IndexCount = ranges[i].IndexCount;
+					range.StartIndexLocation = ranges[i].StartIndexLocation;
+					range.BaseVertexLocation = submesh.BaseVertexLocation + ranges[i].BaseVertexLocation;
+
+					auto rangeName = i == 0 ? mesh.Name : mesh.Name + "_" + std::to_string(i);
+					mesh.DrawArgs[rangeName] = range;
+				}
+				mesh.Indices32.clear();
+			}
+		}
+	}
 
-	// Create the actual default buffer resource.
-	auto defaultProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	auto defaultDesc = CD3DX12_RESOURCE_DESC::Buffer(pDataByteSize);
-	device->CreateCommittedResource(
-		&defaultProperties,
-		D3D12_HEAP_FLAG_NONE,
-		&defaultDesc,
-		D3D12_RESOURCE_STATE_COMMON,
-		nullptr,
-		IID_PPV_ARGS(defaultBuffer.GetAddressOf()));
+	if (!mesh.Indices16.empty()) {
+		mesh.IndexFormat = IndexFormat::Uint16;
+		mesh.IndexBufferByteSize = static_cast<std::uint32_t>(mesh.Indices16.size() * sizeof(std::uint16_t));
+	}
+	else {
+		mesh.IndexFormat = IndexFormat::Uint32;
+		mesh.IndexBufferByteSize = static_cast<std::uint32_t>(mesh.Indices32.size() * sizeof(std::uint32_t));
+	}
+}
 
-	// In order to copy CPU memory data into our default buffer, we need to create
-	// an intermediate upload heap. 
-	auto uploadProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(pDataByteSize);
-	device->CreateCommittedResource(
-		&uploadProperties,
-		D3D12_HEAP_FLAG_NONE,
-		&uploadDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(uploadBuffer.GetAddressOf()));
+void ResourceManager::AcquireGeometry(Mesh& mesh, StagingUploader& uploader)
+{
+	auto indexData = GetIndexData(mesh);
+	auto indexCount = GetIndexCount(mesh);
+
+	auto hash = HashBytes(mesh.PackedVertices.data(), mesh.PackedVertices.size());
+	hash = HashCombine(hash, HashBytes(indexData, mesh.IndexBufferByteSize));
+	hash = HashCombine(hash, mesh.VertexByteStride);
+	hash = HashCombine(hash, mesh.PositionByteStride);
+	hash = HashCombine(hash, static_cast<std::uint64_t>(mesh.IndexFormat));
+
+	auto shared = m_sharedGeometry.find(hash);
+	if (shared != m_sharedGeometry.end()) {
+		if (shared->second.VertexByteSize == mesh.VertexBufferByteSize && shared->second.IndexByteSize == mesh.IndexBufferByteSize) {
+			mesh.Geometry = shared->second.Geometry;
+			mesh.GeometryHash = hash;
+			mesh.UploadFenceValue = shared->second.UploadFenceValue;
+			shared->second.RefCount++;
+			return;
+		}
 
+		// Hash collision, the mesh gets geometry of its own that is never shared.
+		hash = 0;
+	}
 
-	// Describe the data we want to copy into the default buffer.
-	D3D12_SUBRESOURCE_DATA subResourceData = {};
-	subResourceData.pData = pData;
-	subResourceData.RowPitch = pDataByteSize;
-	subResourceData.SlicePitch = subResourceData.RowPitch;
+	// The mesh gets a place in the shared geometry buffers instead of buffers of its own.
+	mesh.Geometry = m_geometryArena.Allocate(mesh.VertexByteStride, mesh.PositionByteStride,
+		mesh.VertexBufferByteSize / mesh.VertexByteStride, mesh.IndexFormat, indexCount);
+	m_geometryArena.Upload(uploader, mesh.Geometry, mesh.PackedVertices.data(), indexData);
+	// Uploads on the direct queue are seen by every frame executed after them.
+	mesh.UploadFenceValue = &uploader == m_uploader.get() ? m_uploader->GetNextFenceValue() : 0;
+	mesh.GeometryHash = hash;
+	m_uniqueGeometryCount++;
+
+	if (hash != 0) {
+		SharedGeometry geometry;
+		geometry.Geometry = mesh.Geometry;
+		geometry.RefCount = 1;
+		geometry.VertexByteSize = mesh.VertexBufferByteSize;
+		geometry.IndexByteSize = mesh.IndexBufferByteSize;
+		geometry.UploadFenceValue = mesh.UploadFenceValue;
+		m_sharedGeometry[hash] = geometry;
+	}
+}
 
-	// Schedule to copy the data to the default buffer resource.  At a high level, the helper function UpdateSubresources
-	// will copy the CPU memory into the intermediate upload heap.  Then, using ID3D12CommandList::CopySubresourceRegion,
-	// the intermediate upload heap data will be copied to mBuffer.
+void ResourceManager::ReleaseGeometry(const Mesh& mesh)
+{
+	auto shared = m_sharedGeometry.find(mesh.GeometryHash);
+	if (mesh.GeometryHash != 0 && shared != m_sharedGeometry.end()) {
+		if (--shared->second.RefCount > 0) {
+			return;
+		}
+		m_sharedGeometry.erase(shared);
+	}
+
+	RetireGeometry(mesh.Geometry);
+	m_uniqueGeometryCount--;
+}
+
+void ResourceManager::RetireGeometry(GeometryHandle geometry)
+{
+	GetCurrentFrameContext()->m_retiredGeometry.push_back(geometry);
+}
+
+void ResourceManager::ReplaceMesh(MeshHandle handle, Mesh mesh)
+{
+	auto current = m_meshes.GetMesh(handle);
+	mesh.cbPerObjectIndex = current->cbPerObjectIndex;
+
+	PackVertices(mesh);
+	PackIndices(mesh);
+	UpdateGeometry(*current, mesh);
+	WriteObjectTransform(mesh);
+
+	*current = std::move(mesh);
+	m_updateStats.UpdateCount++;
+	RefreshDrawItems(handle);
+}
+
+void ResourceManager::UpdateGeometry(const Mesh& current, Mesh& mesh)
+{
+	// Meshes that are drawn stay drawn, their changes are copied on the direct
+	// queue ahead of the frame. Changes of pending meshes queue up behind their
+	// first upload on the copy queue.
+	auto& uploader = current.IsResident ? *m_updateUploader : *m_uploader;
+	auto indexData = GetIndexData(mesh);
+	auto indexCount = GetIndexCount(mesh);
+	auto vertexCount = mesh.VertexBufferByteSize / mesh.VertexByteStride;
+
+	auto shared = m_sharedGeometry.find(current.GeometryHash);
+	bool isShared = current.GeometryHash != 0 && shared != m_sharedGeometry.end();
+	if (isShared && shared->second.RefCount > 1) {
+		// Copy on write, the other meshes keep the shared geometry.
+		ReleaseGeometry(current);
+		AcquireGeometry(mesh, uploader);
+		mesh.IsResident = current.IsResident && mesh.UploadFenceValue <= m_uploader->GetCompletedFenceValue();
+		m_updateStats.CopyOnWriteCount++;
+		m_updateStats.UploadedBytes += mesh.VertexBufferByteSize + mesh.IndexBufferByteSize;
+		return;
+	}
+
+	// The content no longer matches the hash it could be shared by.
+	if (isShared) {
+		m_sharedGeometry.erase(shared);
+	}
+	mesh.GeometryHash = 0;
+	mesh.IsResident = current.IsResident;
+	mesh.UploadFenceValue = current.IsResident ? current.UploadFenceValue : m_uploader->GetNextFenceValue();
+
+	bool sameLayout = mesh.VertexByteStride == current.VertexByteStride &&
+		mesh.PositionByteStride == current.PositionByteStride && mesh.IndexFormat == current.IndexFormat;
+	if (sameLayout && m_geometryArena.Resize(current.Geometry, vertexCount, indexCount)) {
+		mesh.Geometry = current.Geometry;
+
+		std::vector<ByteRange> vertexRanges;
+		std::vector<ByteRange> indexRanges;
+		FindDirtyRanges(current.PackedVertices.data(), current.PackedVertices.size(),
+			mesh.PackedVertices.data(), mesh.PackedVertices.size(), vertexRanges);
+		FindDirtyRanges(GetIndexData(current), current.IndexBufferByteSize, indexData, mesh.IndexBufferByteSize, indexRanges);
+
+		for (const auto& range : vertexRanges) {
+			m_geometryArena.UploadVertices(uploader, mesh.Geometry, range.Offset, mesh.PackedVertices.data() + range.Offset, range.Size);
+		}
+		auto indexBytes = static_cast<const std::uint8_t*>(indexData);
+		for (const auto& range : indexRanges) {
+			m_geometryArena.UploadIndices(uploader, mesh.Geometry, range.Offset, indexBytes + range.Offset, range.Size);
+		}
 
-	auto defaultTransitionAsDest = CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(),
-		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
-	commandList->ResourceBarrier(1, &defaultTransitionAsDest);
+		auto uploadedBytes = GetTotalSize(vertexRanges) + GetTotalSize(indexRanges);
+		m_updateStats.UploadedBytes += uploadedBytes;
+		m_updateStats.UnchangedBytes += mesh.VertexBufferByteSize + mesh.IndexBufferByteSize - uploadedBytes;
+		return;
+	}
 
-	UpdateSubresources<1>(commandList, defaultBuffer.Get(), uploadBuffer.Get(), 0, 0, 1, &subResourceData);
+	// The mesh outgrew its place. Reserve half as much again so meshes that keep
+	// growing do not move on every update.
+	auto vertexCapacity = std::max<std::uint32_t>(vertexCount, m_geometryArena.GetVertexCapacity(current.Geometry) * 3 / 2);
+	auto indexCapacity = std::max<std::uint32_t>(indexCount, m_geometryArena.GetIndexCapacity(current.Geometry) * 3 / 2);
+	RetireGeometry(current.Geometry);
+
+	mesh.Geometry = m_geometryArena.Allocate(mesh.VertexByteStride, mesh.PositionByteStride, vertexCount, mesh.IndexFormat, indexCount,
+		vertexCapacity, indexCapacity);
+	m_geometryArena.Upload(uploader, mesh.Geometry, mesh.PackedVertices.data(), indexData);
+	m_updateStats.ReallocationCount++;
+	m_updateStats.UploadedBytes += mesh.VertexBufferByteSize + mesh.IndexBufferByteSize;
+}
 
-	auto defaultTransitionAsGPURead = CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(),
-		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
-	commandList->ResourceBarrier(1, &defaultTransitionAsGPURead);
+void ResourceManager::RefreshDrawItems(MeshHandle handle)
+{
+	auto mesh = m_meshes.GetMesh(handle);
 
-	// Note: uploadBuffer has to be kept alive after the above function calls because
-	// the command list has not been executed yet that performs the actual copy.
-	// The caller can Release the uploadBuffer after it knows the copy has been executed.
+	std::vector<DrawItem> drawItems;
+	if (mesh->IsResident) {
+		BuildDrawItems(*mesh, drawItems);
+	}
+	else if (std::find(m_pendingMeshes.begin(), m_pendingMeshes.end(), handle) == m_pendingMeshes.end()) {
+		m_pendingMeshes.push_back(handle);
+	}
+	m_meshes.SetDrawItems(handle, drawItems.data(), static_cast<std::uint32_t>(drawItems.size()));
+}
 
-	return defaultBuffer;
+void ResourceManager::WriteObjectTransform(const Mesh& mesh)
+{
+	auto transform = MakeObjectTransform(&mesh.World.m[0][0], mesh.Quantization);
+	auto& current = m_objectTransforms[mesh.cbPerObjectIndex];
+	if (std::memcmp(&current, &transform, sizeof(ObjectTransform)) != 0) {
+		current = transform;
+		m_transformChanges.MarkChanged(mesh.cbPerObjectIndex);
+	}
+}
 
+void ResourceManager::BuildDrawItems(const Mesh& mesh, std::vector<DrawItem>& drawItems)
+{
+	auto placement = m_geometryArena.GetPlacement(mesh.Geometry);
+	auto vertexBuffer = m_geometryArena.GetVertexBufferView(mesh.Geometry);
+	auto attributeBuffer = m_geometryArena.GetAttributeBufferView(mesh.Geometry);
+	auto indexBuffer = m_geometryArena.GetIndexBufferView(mesh.Geometry);
+
+	// One draw per submesh. Meshes split for 16 bit indices have several.
+	drawItems.clear();
+	for (const auto& drawArg : mesh.DrawArgs) {
+		const auto& submesh = drawArg.second;
+
+		DrawItem drawItem;
+		drawItem.VertexBuffer = vertexBuffer;
+		drawItem.AttributeBuffer = attributeBuffer;
+		drawItem.IndexBuffer = indexBuffer;
+		drawItem.IndexCount = submesh.IndexCount;
+		drawItem.StartIndexLocation = placement.StartIndexLocation + submesh.StartIndexLocation;
+		drawItem.BaseVertexLocation = placement.BaseVertexLocation + submesh.BaseVertexLocation;
+		drawItem.ObjectIndex = static_cast<std::uint32_t>(mesh.cbPerObjectIndex);
+
+		// World is stored transposed, the layout TransformAabb expects.
+		drawItem.Bounds = TransformAabb(submesh.Bounds, &mesh.World.m[0][0]);
+
+		drawItems.push_back(drawItem);
+	}
 }
 
-void ResourceManager::InitializeFrameContexts()
+void ResourceManager::InitializeFrameContexts(std::uint32_t frameContextCount)
 {
-	for (int i = 0; i < numFrameContexts; i++) {
-		m_frameContexts[i] = FrameContext();
-		ThrowIfFailed(m_device->CreateCommandAllocator(
-			D3D12_COMMAND_LIST_TYPE_DIRECT,
-			IID_PPV_ARGS(m_frameContexts[i].m_cmdListAlloc.GetAddressOf())));
+	m_frameContexts.resize(std::max<std::uint32_t>(frameContextCount, 1));
+	for (auto& frameContext : m_frameContexts) {
+		frameContext.m_uploadAllocator = UploadAllocator(*m_device);
+	}
 
+	m_transformChanges = ChangeTracker(static_cast<std::uint32_t>(m_frameContexts.size()));
+}
+
+void ResourceManager::ReserveObjectTransforms(FrameContext& frameContext, std::uint32_t count)
+{
+	if (frameContext.m_objectTransformCapacity >= count && frameContext.m_objectTransforms) {
+		return;
 	}
+
+	// The frame context's last frame has executed, so its copy can be replaced.
+	// The new copy starts out empty and is filled by the next sync.
+	auto capacity = std::max<std::uint32_t>(std::max<std::uint32_t>(count, frameContext.m_objectTransformCapacity * 2), 1024);
+	frameContext.m_objectTransforms = ResourceRef(m_device, m_device->CreateBuffer(
+		static_cast<std::uint64_t>(capacity) * sizeof(ObjectTransform), HeapType::Upload, ResourceState::GenericRead));
+
+	// Upload heaps can stay mapped for their whole lifetime.
+	frameContext.m_mappedObjectTransforms = static_cast<ObjectTransform*>(m_device->Map(frameContext.m_objectTransforms.Get()));
+	frameContext.m_objectTransformCapacity = capacity;
+	m_transformChanges.Invalidate(static_cast<std::uint32_t>(&frameContext - m_frameContexts.data()));
 }
 
-template void ResourceManager::UpdateConstantBuffer<MeshConstants>(std::string name, int elementIndex, const MeshConstants& pData);
-template void ResourceManager::UpdateConstantBuffer<PassConstants>(std::string name, int elementIndex, const PassConstants& pData);
@@ -2,74 +2,199 @@
 #define RESOURCEMANAGER_H_
 
 #include "Mesh.h"
-#include "UploadBuffer.h"
-#include <DirectXMath.h>
+#include "RHI.h"
 #include "FrameContext.h"
+#include "MeshRegistry.h"
+#include "GeometryArena.h"
+#include "InstanceBatcher.h"
+#include "StagingUploader.h"
+#include "ObjectTransform.h"
+#include "ChangeTracker.h"
+#include <memory>
+
+struct PassConstants
+{
+	Float4x4 ViewProj = MathHelper().GetIdentity4x4();
+	double DeltaTime = 0;
+	double TotalTime = 0;
+
+	// Explicit padding of alignment of 256 as required by constant buffers.
+	std::uint8_t padding[176];
+};
+
+// Counters of UpdateMesh and UpdateVertices since the start.
+struct MeshUpdateStats
+{
+	std::uint64_t UpdateCount = 0;
+	// Packed vertex and index bytes sent to the GPU and the ones skipped as unchanged.
+	std::uint64_t UploadedBytes = 0;
+	std::uint64_t UnchangedBytes = 0;
+	// Updates that outgrew the mesh's place and moved it.
+	std::uint64_t ReallocationCount = 0;
+	// Updates of geometry shared with other meshes, which got a copy of their own.
+	std::uint64_t CopyOnWriteCount = 0;
+};
+
+// Object transforms written by UpdateObjectTransforms.
+struct TransformUploadStats
+{
+	std::uint32_t LastFrameCount = 0;
+	std::uint64_t LastFrameBytes = 0;
+	std::uint64_t TotalBytes = 0;
+};
 
 class ResourceManager
 {
 public:
 	ResourceManager();
-	ResourceManager(ID3D12GraphicsCommandList* commandList, ID3D12Device* device);
-
-	void AddMesh(Mesh mesh);
+	// New geometry is uploaded through copyQueue, updates of meshes that are drawn
+	// through directQueue, see FlushUploads.
+	ResourceManager(IRenderDevice& device, ICommandQueue& copyQueue, ICommandQueue& directQueue,
+		std::uint32_t frameContextCount = DefaultFrameContextCount);
+
+	// Vertex format meshes are packed into when they are added.
+	void SetVertexFormat(std::uint32_t vertexFormatFlags);
+
+	// The mesh is pending until its geometry has been uploaded, it has no draw
+	// items until then. Returns immediately. Adding a mesh with the name of an
+	// existing one updates that mesh.
+	MeshHandle AddMesh(Mesh mesh);
+
+	// Replaces the geometry, submeshes and transform of the mesh with the same
+	// name. The new vertices and indices are packed and compared with the current
+	// ones, only the byte ranges that changed are uploaded. A mesh that outgrows
+	// its place moves to one with room to grow.
 	void UpdateMesh(Mesh mesh);
-	void DeleteMesh(const Mesh& mesh);
-	Mesh GetMesh(std::string meshName);
-	std::unordered_map<std::string, Mesh> GetAllMeshes();
-
-	void AddConstantBuffer(std::string name, UINT elementByteSize, UINT numOfElements, ID3D12DescriptorHeap* cbvHeap, UINT cbvHeapDescriptorSize);
-	void RemoveConstantBuffer(std::string name);
+	// Uploads the vertices [firstVertex, firstVertex + vertexCount) after they
+	// were changed in GetMesh(handle)->Vertices. The submesh bounds grow to
+	// contain them.
+	void UpdateVertices(MeshHandle handle, std::size_t firstVertex, std::size_t vertexCount);
+	MeshUpdateStats GetUpdateStats() const;
+
+	void DeleteMesh(MeshHandle handle);
+	Mesh* GetMesh(MeshHandle handle);
+	// Moves the mesh. Only the transforms of moved meshes are uploaded.
+	void SetMeshWorld(MeshHandle handle, const Float4x4& world);
+	MeshHandle FindMesh(const std::string& meshName);
+
+	// Draw data of all meshes, stored contiguously. Valid until the next AddMesh or DeleteMesh.
+	const std::vector<DrawItem>& GetDrawItems() const;
+	// Changes whenever the draw items may have changed.
+	std::uint64_t GetDrawItemsVersion() const;
+
+	// Closes the holes deleted meshes left in the shared geometry buffers and
+	// updates the draw items. Records the copies into recorder, a command list of
+	// the frame executed before its draws. The old buffers are freed with the
+	// frame's retired geometry, see FreeRetiredGeometry.
+	void CompactGeometry(ICommandRecorder& recorder);
+	// Bytes CompactGeometry would merge into larger free ranges.
+	std::uint64_t GetFragmentedGeometrySize() const;
+
+	// Submits the geometry uploads of the meshes added and updated since the last
+	// call. Call before executing the frame's command lists, updates of meshes
+	// that are drawn are executed on the direct queue ahead of them.
+	void FlushUploads();
+	// Gives the pending meshes whose uploads completed their draw items. Call
+	// once per frame before culling.
+	void UpdateResidency();
+	bool IsMeshResident(MeshHandle handle);
+	// Blocks until all uploads executed.
+	void WaitForUploads();
+	// Frees the geometry and geometry buffers the current frame context retired.
+	// Call once per frame after waiting for the frame context's fence.
+	void FreeRetiredGeometry();
+	StagingUploader::Stats GetUploadStats() const;
+
+	// Geometry of one of the mesh's draw items for drawing it instanced.
+	InstancedGeometry GetInstancedGeometry(MeshHandle handle, std::uint32_t drawItemIndex = 0);
+
+	// Copies the instance transforms of the frame into the current frame context's
+	// upload memory and returns their address.
+	GpuVirtualAddress UpdateInstanceBuffer(const std::vector<InstanceTransform>& transforms);
+
+	// Brings the current frame context's copy of the object transforms up to
+	// date, writing only the transforms changed since the frame context was last
+	// used. The transform of DrawItem::ObjectIndex is at the returned address
+	// plus ObjectIndex * sizeof(ObjectTransform).
+	GpuVirtualAddress UpdateObjectTransforms();
+	TransformUploadStats GetTransformUploadStats() const;
+
+	// Allocates from the current frame context's upload memory, for data only
+	// used by the frame being recorded.
+	UploadAllocation AllocateFrameData(std::uint64_t byteSize, std::uint64_t alignment = UploadAllocator::ConstantBufferAlignment);
 
 	template <typename T>
-	void UpdateConstantBuffer(std::string name, int elementIndex, const T& pData);
+	GpuVirtualAddress UploadFrameData(const T& data)
+	{
+		return GetCurrentFrameContext()->m_uploadAllocator.Upload(&data, sizeof(T)).GpuAddress;
+	}
 
-	static const int numFrameContexts = 3;
+	// Number of distinct pieces of geometry on the GPU. Meshes with identical
+	// packed vertices and indices share one.
+	std::uint32_t GetUniqueGeometryCount() const;
+
+	static const std::uint32_t DefaultFrameContextCount = 3;
+	std::uint32_t GetFrameContextCount() const;
 	FrameContext* GetCurrentFrameContext();
 	int GetCurrentFrameIndex();
 	void CycleFrameContext();
 private:
 
-	ID3D12GraphicsCommandList* m_commandList = nullptr;
-	ID3D12Device* m_device = nullptr;
-	std::unordered_map<std::string, Mesh> m_meshes;
+	IRenderDevice* m_device = nullptr;
+	MeshRegistry<Mesh> m_meshes;
+	GeometryArena m_geometryArena;
+	std::unique_ptr<StagingUploader> m_uploader;
+	// Updates of meshes that are drawn run on the direct queue ahead of the
+	// frame: the frames before it have finished drawing the old geometry and the
+	// frame draws the new one.
+	std::unique_ptr<StagingUploader> m_updateUploader;
+	MeshUpdateStats m_updateStats;
+	std::vector<MeshHandle> m_pendingMeshes;
+
+	// Refcounted geometry keyed by the hash of its content. The sizes guard
+	// against sharing on a hash collision.
+	struct SharedGeometry
+	{
+		GeometryHandle Geometry;
+		std::uint32_t RefCount = 0;
+		std::uint64_t VertexByteSize = 0;
+		std::uint64_t IndexByteSize = 0;
+		std::uint64_t UploadFenceValue = 0;
+	};
+	std::unordered_map<std::uint64_t, SharedGeometry> m_sharedGeometry;
+	std::uint32_t m_uniqueGeometryCount = 0;
+	std::uint32_t m_vertexFormat = VertexFormatFlags_None;
 
 	int m_currFrameContextIndex = 0;
-	FrameContext m_frameContexts[numFrameContexts];
-
+	std::vector<FrameContext> m_frameContexts;
+
+	// Transforms of every object, indexed by Mesh::cbPerObjectIndex. Every
+	// frame context keeps a copy, m_transformChanges tracks which transforms
+	// each copy is missing.
+	std::vector<ObjectTransform> m_objectTransforms;
+	ChangeTracker m_transformChanges;
+	TransformUploadStats m_transformUploadStats;
 	std::vector<int> m_freeCBPerObjectIndex;
 	int m_newCBPerObjectIndex = 0;
-	UINT m_currCBVHeapIndex = 0;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
-		ID3D12Device* device,
-		ID3D12GraphicsCommandList* commandList,
-		const void* pData,
-		UINT64 pDataByteSize,
-		Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
-
-	void InitializeFrameContexts();
-};
-
-
-struct MeshConstants
-{
-	DirectX::XMFLOAT4X4 World = MathHelper().GetIdentity4x4();
 
-	// Explicit padding of 192 BYTES for a total of 256 as required by constant buffers.
-	DirectX::XMFLOAT4X4 Pad0 = DirectX::XMFLOAT4X4();
-	DirectX::XMFLOAT4X4 Pad1 = DirectX::XMFLOAT4X4();
-	DirectX::XMFLOAT4X4 Pad2 = DirectX::XMFLOAT4X4();
+	void PackVertices(Mesh& mesh);
+	// Uses 16 bit indices when possible, splitting meshes just over 65 536 vertices.
+	void PackIndices(Mesh& mesh);
+	void BuildDrawItems(const Mesh& mesh, std::vector<DrawItem>& drawItems);
+	void WriteObjectTransform(const Mesh& mesh);
+	void AcquireGeometry(Mesh& mesh, StagingUploader& uploader);
+	void ReleaseGeometry(const Mesh& mesh);
+	// Frees the geometry once the frames recorded so far are done with it.
+	void RetireGeometry(GeometryHandle geometry);
+
+	// Replaces the mesh with the packed mesh, uploading the differences.
+	void ReplaceMesh(MeshHandle handle, Mesh mesh);
+	void UpdateGeometry(const Mesh& current, Mesh& mesh);
+	// Rebuilds the draw items of a resident mesh, or queues the mesh as pending.
+	void RefreshDrawItems(MeshHandle handle);
+	void InitializeFrameContexts(std::uint32_t frameContextCount);
+	void ReserveObjectTransforms(FrameContext& frameContext, std::uint32_t count);
 };
 
-struct PassConstants
-{
-	DirectX::XMFLOAT4X4 ViewProj = MathHelper().GetIdentity4x4();
-	double DeltaTime = 0;
-	double TotalTime = 0;
-
-	// Explicit padding of alignment of 256 as required by constant buffers.
-	BYTE padding[176];
-};
 
 #endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "ResourceStateTracker.h"
+#include <algorithm>
+
+namespace {
+
+const ResourceState ReadStates = ResourceState::GenericRead | ResourceState::DepthRead;
+
+// Read states can be combined, a resource in several of them can be used as any.
+bool IncludesReadState(ResourceState current, ResourceState state)
+{
+	bool isRead = state != ResourceState::Common && (state & ReadStates) == state;
+	return isRead && (current & ReadStates) == current && (current & state) == state;
+}
+
+}
+
+ResourceState GlobalResourceStates::GetState(RHIResource resource) const
+{
+	auto found = m_states.find(resource);
+	return found != m_states.end() ? found->second : ResourceState::Common;
+}
+
+void GlobalResourceStates::SetState(RHIResource resource, ResourceState state)
+{
+	m_states[resource] = state;
+}
+
+void GlobalResourceStates::Remove(RHIResource resource)
+{
+	m_states.erase(resource);
+}
+
+void ResourceStateTracker::Reset()
+{
+	m_resources.clear();
+	m_queuedBarriers.clear();
+}
+
+void ResourceStateTracker::SetInitialState(RHIResource resource, ResourceState state)
+{
+	auto inserted = m_resources.emplace(resource, TrackedResource());
+	if (inserted.second) {
+		auto& tracked = inserted.first->second;
+		tracked.State = state;
+		tracked.InitialState = state;
+		tracked.IsInitialStateKnown = true;
+	}
+}
+
+void ResourceStateTracker::Transition(RHIResource resource, ResourceState state)
+{
+	m_stats.Requested++;
+
+	auto inserted = m_resources.emplace(resource, TrackedResource());
+	auto& tracked = inserted.first->second;
+	if (inserted.second) {
+		tracked.State = state;
+		tracked.InitialState = state;
+		m_stats.Deferred++;
+		return;
+	}
+
+	if (tracked.State == state || IncludesReadState(tracked.State, state)) {
+		m_stats.Elided++;
+		return;
+	}
+
+	// A queued transition that was not recorded yet goes straight to the new state.
+	if (tracked.QueuedBarrier != NoBarrier) {
+		auto& queued = m_queuedBarriers[tracked.QueuedBarrier];
+		queued.StateAfter = state;
+		tracked.State = state;
+		m_stats.Merged++;
+		return;
+	}
+
+	tracked.QueuedBarrier = static_cast<std::uint32_t>(m_queuedBarriers.size());
+	m_queuedBarriers.push_back(::ResourceBarrier::Transition(resource, tracked.State, state));
+	tracked.State = state;
+}
+
+void ResourceStateTracker::UavBarrier(RHIResource resource)
+{
+	m_queuedBarriers.push_back(::ResourceBarrier::UnorderedAccess(resource));
+}
+
+void ResourceStateTracker::FlushBarriers(ICommandRecorder& recorder)
+{
+	// Merged transitions that ended where they started are dropped.
+	std::size_t barrierCount = 0;
+	for (const auto& barrier : m_queuedBarriers) {
+		if (barrier.Type == BarrierType::Transition) {
+			m_resources[barrier.Resource].QueuedBarrier = NoBarrier;
+			if (barrier.StateBefore == barrier.StateAfter) {
+				continue;
+			}
+		}
+		m_queuedBarriers[barrierCount++] = barrier;
+	}
+
+	if (barrierCount > 0) {
+		recorder.ResourceBarrier(static_cast<std::uint32_t>(barrierCount), m_queuedBarriers.data());
+		m_stats.Recorded += std::count_if(m_queuedBarriers.begin(), m_queuedBarriers.begin() + barrierCount,
+			[](const ::ResourceBarrier& barrier) { return barrier.Type == BarrierType::Transition; });
+		m_stats.ResourceBarrierCalls++;
+	}
+	m_queuedBarriers.clear();
+}
+
+void ResourceStateTracker::Resolve(GlobalResourceStates& globalStates, std::vector<::ResourceBarrier>& barriers) const
+{
+	for (const auto& entry : m_resources) {
+		const auto& tracked = entry.second;
+		if (!tracked.IsInitialStateKnown) {
+			auto state = globalStates.GetState(entry.first);
+			if (state != tracked.InitialState) {
+				barriers.push_back(::ResourceBarrier::Transition(entry.first, state, tracked.InitialState));
+			}
+		}
+		globalStates.SetState(entry.first, tracked.State);
+	}
+}
+
+ResourceState ResourceStateTracker::GetState(RHIResource resource) const
+{
+	return m_resources.at(resource).State;
+}
+
+bool ResourceStateTracker::IsTracked(RHIResource resource) const
+{
+	return m_resources.find(resource) != m_resources.end();
+}
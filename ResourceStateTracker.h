@@ -0,0 +1,90 @@
+#ifndef RESOURCESTATETRACKER_H_
+#define RESOURCESTATETRACKER_H_
+
+#include "RHI.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// States of resources between command lists, as of the last command list
+// resolved against it. Resources not in it are in the common state, which is
+// what buffers are created in.
+class GlobalResourceStates
+{
+public:
+	ResourceState GetState(RHIResource resource) const;
+	void SetState(RHIResource resource, ResourceState state);
+	// For resources that are released.
+	void Remove(RHIResource resource);
+
+private:
+	std::unordered_map<RHIResource, ResourceState> m_states;
+};
+
+struct ResourceStateStats
+{
+	// Transitions asked for, and how many were recorded.
+	std::uint64_t Requested = 0;
+	std::uint64_t Recorded = 0;
+	// Already in the state, or in a read state that includes it.
+	std::uint64_t Elided = 0;
+	// Merged with an earlier transition of the same batch.
+	std::uint64_t Merged = 0;
+	// First transitions of a resource in a list, left for Resolve.
+	std::uint64_t Deferred = 0;
+	std::uint64_t ResourceBarrierCalls = 0;
+};
+
+// Tracks the states of resources in one command list. Transition only queues
+// barriers that change something and FlushBarriers records all queued ones
+// with one ResourceBarrier call. The first transition of a resource the list
+// does not know the state of is not recorded: the list only notes the state it
+// needs the resource in, and Resolve compares it with the global state when the
+// list is submitted. So lists can be recorded on any thread in any order, and
+// the barriers Resolve returns are recorded in a small list executed in front.
+class ResourceStateTracker
+{
+public:
+	// Forgets all resources, for the next command list.
+	void Reset();
+
+	// State the resource is in when the list starts executing, if known at
+	// recording time. Ignored for resources the list already tracks.
+	void SetInitialState(RHIResource resource, ResourceState state);
+
+	void Transition(RHIResource resource, ResourceState state);
+	void UavBarrier(RHIResource resource);
+
+	// Records the queued barriers, if any, in one call. Has to be called before
+	// recording commands that use the resources in their new states.
+	void FlushBarriers(ICommandRecorder& recorder);
+
+	// At submit, in submission order: appends the transitions into the states the
+	// list expects its resources in and sets the global states to the states the
+	// list leaves them in.
+	void Resolve(GlobalResourceStates& globalStates, std::vector<::ResourceBarrier>& barriers) const;
+
+	// State at the current point of the list. The resource has to be tracked.
+	ResourceState GetState(RHIResource resource) const;
+	bool IsTracked(RHIResource resource) const;
+	const ResourceStateStats& GetStats() const { return m_stats; }
+
+private:
+	static const std::uint32_t NoBarrier = 0xffffffff;
+
+	struct TrackedResource
+	{
+		ResourceState State = ResourceState::Common;
+		// State the list needs the resource in when it starts.
+		ResourceState InitialState = ResourceState::Common;
+		bool IsInitialStateKnown = false;
+		// Index of the resource's transition in the queued barriers.
+		std::uint32_t QueuedBarrier = NoBarrier;
+	};
+
+	std::unordered_map<RHIResource, TrackedResource> m_resources;
+	std::vector<::ResourceBarrier> m_queuedBarriers;
+	ResourceStateStats m_stats;
+};
+
+#endif
@@ -0,0 +1,305 @@
+#include "SceneRenderer.h"
+#include <algorithm>
+
+namespace {
+
+void CountStateChange(StateChangeCount& count, bool issued)
+{
+	if (issued) {
+		count.Issued++;
+	}
+	else {
+		count.Filtered++;
+	}
+}
+
+void AddStateChanges(StateChangeCount& count, const StateChangeCount& other)
+{
+	count.Issued += other.Issued;
+	count.Filtered += other.Filtered;
+}
+
+}
+
+void SubmitStats::Add(const SubmitStats& other)
+{
+	AddStateChanges(PipelineState, other.PipelineState);
+	AddStateChanges(Topology, other.Topology);
+	AddStateChanges(VertexBuffer, other.VertexBuffer);
+	AddStateChanges(IndexBuffer, other.IndexBuffer);
+	AddStateChanges(ObjectIndex, other.ObjectIndex);
+	Draws += other.Draws;
+	DepthPrepassDraws += other.DepthPrepassDraws;
+}
+
+std::uint64_t SubmitStats::GetIssued() const
+{
+	return PipelineState.Issued + Topology.Issued + VertexBuffer.Issued + IndexBuffer.Issued + ObjectIndex.Issued;
+}
+
+std::uint64_t SubmitStats::GetFiltered() const
+{
+	return PipelineState.Filtered + Topology.Filtered + VertexBuffer.Filtered + IndexBuffer.Filtered + ObjectIndex.Filtered;
+}
+
+void SceneRenderer::RecordFrame(ICommandRecorder& recorder, const FrameTargets& targets,
+	const FrameBindings& bindings, const std::vector<DrawItem>& drawItems)
+{
+	static const InstanceBatcher noInstances;
+	RecordFrame(recorder, targets, bindings, drawItems, noInstances);
+}
+
+void SceneRenderer::RecordFrame(ICommandRecorder& recorder, const FrameTargets& targets,
+	const FrameBindings& bindings, const std::vector<DrawItem>& drawItems, const InstanceBatcher& instances)
+{
+	m_submitStats = SubmitStats();
+	RecordFrameBegin(recorder, targets);
+	auto drawCount = drawItems.size();
+	RecordPassDraws(recorder, targets, bindings, drawItems, nullptr, drawCount,
+		0, bindings.HasDepthPrepass() ? drawCount * 2 : drawCount, &m_submitStats);
+	RecordFrameEnd(recorder, targets, bindings, instances, &m_submitStats);
+}
+
+void SceneRenderer::RecordFrame(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+	const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>& visibleDrawItems, const InstanceBatcher& instances)
+{
+	m_submitStats = SubmitStats();
+	RecordFrameBegin(recorder, targets);
+	auto drawCount = visibleDrawItems.size();
+	RecordPassDraws(recorder, targets, bindings, drawItems, &visibleDrawItems, drawCount,
+		0, bindings.HasDepthPrepass() ? drawCount * 2 : drawCount, &m_submitStats);
+	RecordFrameEnd(recorder, targets, bindings, instances, &m_submitStats);
+}
+
+void SceneRenderer::RecordFrameParallel(JobSystem& jobs, ICommandRecorder* const* recorders, std::uint32_t recorderCount,
+	const FrameTargets& targets, const FrameBindings& bindings, const std::vector<DrawItem>& drawItems,
+	const std::vector<std::uint32_t>* visibleDrawItems, const InstanceBatcher& instances)
+{
+	auto drawCount = visibleDrawItems != nullptr ? visibleDrawItems->size() : drawItems.size();
+	auto totalCount = bindings.HasDepthPrepass() ? drawCount * 2 : drawCount;
+	auto chunkSize = (totalCount + recorderCount - 1) / recorderCount;
+
+	// One slot per chunk, summed once all are recorded.
+	m_chunkStats.assign(recorderCount, SubmitStats());
+
+	jobs.ParallelFor("RecordDrawChunk", recorderCount, 1, [&](std::size_t chunk, std::size_t) {
+		auto& recorder = *recorders[chunk];
+		auto first = std::min<std::size_t>(chunk * chunkSize, totalCount);
+		auto count = std::min<std::size_t>(chunkSize, totalCount - first);
+		auto stats = &m_chunkStats[chunk];
+
+		if (chunk == 0) {
+			RecordFrameBegin(recorder, targets);
+		}
+		RecordPassDraws(recorder, targets, bindings, drawItems, visibleDrawItems, drawCount, first, count, stats);
+		if (chunk == recorderCount - 1) {
+			RecordFrameEnd(recorder, targets, bindings, instances, stats);
+		}
+	});
+
+	m_submitStats = SubmitStats();
+	for (const auto& stats : m_chunkStats) {
+		m_submitStats.Add(stats);
+	}
+}
+
+std::uint32_t SceneRenderer::GetRecorderCount(std::size_t drawCount, std::uint32_t maxRecorders, std::uint32_t minDrawsPerChunk)
+{
+	auto recorderCount = drawCount / std::max<std::uint32_t>(minDrawsPerChunk, 1);
+	return static_cast<std::uint32_t>(std::max<std::size_t>(std::min<std::size_t>(recorderCount, maxRecorders), 1));
+}
+
+void SceneRenderer::RecordFrameBegin(ICommandRecorder& recorder, const FrameTargets& targets) const
+{
+	// Change current front buffer to be the render target/back buffer
+	if (targets.BackBuffer != 0) {
+		auto resourceBarrier = ::ResourceBarrier::Transition(targets.BackBuffer,
+			ResourceState::Present, ResourceState::RenderTarget);
+		recorder.ResourceBarrier(1, &resourceBarrier);
+	}
+
+	// Clear the back buffer and depth buffer.
+	recorder.ClearRenderTargetView(targets.RenderTargetView, targets.ClearColor);
+	recorder.ClearDepthStencilView(targets.DepthStencilView, 1.0f, 0);
+}
+
+void SceneRenderer::RecordDrawChunk(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+	const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>* visibleDrawItems,
+	std::size_t first, std::size_t count, SubmitStats* stats) const
+{
+	RecordDrawChunk(recorder, targets, bindings, drawItems, visibleDrawItems, first, count, DrawPass_Color, stats);
+}
+
+void SceneRenderer::RecordDrawChunk(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+	const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>* visibleDrawItems,
+	std::size_t first, std::size_t count, DrawPass pass, SubmitStats* stats) const
+{
+	BoundState bound;
+	SetPipeline(recorder, bound, targets, bindings, pass);
+
+	for (auto i = first; i < first + count; i++) {
+		const auto& drawItem = visibleDrawItems != nullptr ? drawItems[(*visibleDrawItems)[i]] : drawItems[i];
+
+		BindGeometry(recorder, bound, drawItem.VertexBuffer,
+			pass == DrawPass_Depth ? nullptr : &drawItem.AttributeBuffer, drawItem.IndexBuffer);
+		// Submeshes of a mesh are drawn one after another with the same transform.
+		SetObjectIndex(recorder, bound, drawItem.ObjectIndex);
+
+		recorder.DrawIndexedInstanced(drawItem.IndexCount, 1,
+			drawItem.StartIndexLocation, drawItem.BaseVertexLocation, 0);
+	}
+
+	bound.Stats.Draws += count;
+	if (pass == DrawPass_Depth) {
+		bound.Stats.DepthPrepassDraws += count;
+	}
+	if (stats != nullptr) {
+		stats->Add(bound.Stats);
+	}
+}
+
+void SceneRenderer::RecordPassDraws(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+	const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>* visibleDrawItems,
+	std::size_t drawCount, std::size_t first, std::size_t count, SubmitStats* stats) const
+{
+	if (!bindings.HasDepthPrepass()) {
+		RecordDrawChunk(recorder, targets, bindings, drawItems, visibleDrawItems, first, count, DrawPass_Color, stats);
+		return;
+	}
+
+	auto end = first + count;
+	auto depthEnd = std::min<std::size_t>(end, drawCount);
+	if (first < depthEnd) {
+		RecordDrawChunk(recorder, targets, bindings, drawItems, visibleDrawItems, first, depthEnd - first, DrawPass_Depth, stats);
+	}
+	// Empty chunks still set the color pass state, RecordFrameEnd relies on it.
+	auto colorBegin = std::max<std::size_t>(first, drawCount);
+	if (colorBegin < end || count == 0) {
+		auto colorCount = colorBegin < end ? end - colorBegin : 0;
+		RecordDrawChunk(recorder, targets, bindings, drawItems, visibleDrawItems, colorBegin - drawCount, colorCount, DrawPass_Color, stats);
+	}
+}
+
+void SceneRenderer::RecordFrameEnd(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+	const InstanceBatcher& instances, SubmitStats* stats) const
+{
+	const auto& batches = instances.GetBatches();
+	if (!batches.empty()) {
+		BoundState bound;
+		SetPipelineState(recorder, bound, bindings.InstancedPipelineState);
+		recorder.SetGraphicsRootShaderResourceView(RootParameter_InstanceTransforms, bindings.InstanceBuffer);
+
+		for (const auto& batch : batches) {
+			const auto& geometry = instances.GetGeometry(batch.Geometry);
+			BindGeometry(recorder, bound, geometry.VertexBuffer, &geometry.AttributeBuffer, geometry.IndexBuffer);
+
+			auto constants = instances.GetBatchConstants(batch);
+			recorder.SetGraphicsRoot32BitConstants(RootParameter_BatchConstants, InstanceBatchConstantCount, &constants, 0);
+
+			recorder.DrawIndexedInstanced(geometry.IndexCount, batch.InstanceCount,
+				geometry.StartIndexLocation, geometry.BaseVertexLocation, 0);
+		}
+
+		bound.Stats.Draws += batches.size();
+		if (stats != nullptr) {
+			stats->Add(bound.Stats);
+		}
+	}
+
+	// Indicate a state transition on the resource usage.
+	if (targets.BackBuffer != 0) {
+		auto resourceBarrier = ::ResourceBarrier::Transition(targets.BackBuffer,
+			ResourceState::RenderTarget, ResourceState::Present);
+		recorder.ResourceBarrier(1, &resourceBarrier);
+	}
+}
+
+void SceneRenderer::SetPipeline(ICommandRecorder& recorder, BoundState& bound, const FrameTargets& targets,
+	const FrameBindings& bindings, DrawPass pass)
+{
+	if (pass == DrawPass_Depth) {
+		SetPipelineState(recorder, bound, bindings.DepthPrepassPipelineState);
+	}
+	else {
+		SetPipelineState(recorder, bound, bindings.HasDepthPrepass() ? bindings.DepthEqualPipelineState : bindings.PipelineState);
+	}
+	recorder.RSSetViewports(1, &targets.View);
+	recorder.RSSetScissorRects(1, &targets.Scissor);
+
+	// Specify the buffers we are going to render to. The depth pass only writes depth.
+	if (pass == DrawPass_Depth) {
+		recorder.OMSetRenderTargets(0, nullptr, &targets.DepthStencilView);
+	}
+	else {
+		recorder.OMSetRenderTargets(1, &targets.RenderTargetView, &targets.DepthStencilView);
+	}
+
+	recorder.SetDescriptorHeaps(1, &bindings.CbvHeap);
+	recorder.SetGraphicsRootSignature(bindings.RootSignature);
+	recorder.SetGraphicsRootConstantBufferView(RootParameter_PassCbv, bindings.PassConstants);
+	recorder.SetGraphicsRootShaderResourceView(RootParameter_ObjectTransforms, bindings.ObjectTransforms);
+
+	SetTopology(recorder, bound, PrimitiveTopology::TriangleList);
+}
+
+void SceneRenderer::SetPipelineState(ICommandRecorder& recorder, BoundState& bound, PipelineStateHandle pipelineState)
+{
+	bool changed = !bound.HasPipelineState || bound.PipelineState != pipelineState;
+	if (changed) {
+		recorder.SetPipelineState(pipelineState);
+		bound.HasPipelineState = true;
+		bound.PipelineState = pipelineState;
+	}
+	CountStateChange(bound.Stats.PipelineState, changed);
+}
+
+void SceneRenderer::SetTopology(ICommandRecorder& recorder, BoundState& bound, PrimitiveTopology topology)
+{
+	bool changed = bound.Topology != topology;
+	if (changed) {
+		recorder.IASetPrimitiveTopology(topology);
+		bound.Topology = topology;
+	}
+	CountStateChange(bound.Stats.Topology, changed);
+}
+
+void SceneRenderer::BindGeometry(ICommandRecorder& recorder, BoundState& bound, const VertexBufferBinding& vertexBuffer,
+	const VertexBufferBinding* attributeBuffer, const IndexBufferBinding& indexBuffer)
+{
+	bool vertexBufferChanged = !bound.HasVertexBuffer || bound.VertexBuffer != vertexBuffer;
+	if (vertexBufferChanged) {
+		recorder.IASetVertexBuffers(0, 1, &vertexBuffer);
+		bound.HasVertexBuffer = true;
+		bound.VertexBuffer = vertexBuffer;
+	}
+	CountStateChange(bound.Stats.VertexBuffer, vertexBufferChanged);
+
+	if (attributeBuffer != nullptr && attributeBuffer->SizeInBytes > 0) {
+		bool attributeBufferChanged = !bound.HasAttributeBuffer || bound.AttributeBuffer != *attributeBuffer;
+		if (attributeBufferChanged) {
+			recorder.IASetVertexBuffers(1, 1, attributeBuffer);
+			bound.HasAttributeBuffer = true;
+			bound.AttributeBuffer = *attributeBuffer;
+		}
+		CountStateChange(bound.Stats.VertexBuffer, attributeBufferChanged);
+	}
+
+	bool indexBufferChanged = !bound.HasIndexBuffer || bound.IndexBuffer != indexBuffer;
+	if (indexBufferChanged) {
+		recorder.IASetIndexBuffer(&indexBuffer);
+		bound.HasIndexBuffer = true;
+		bound.IndexBuffer = indexBuffer;
+	}
+	CountStateChange(bound.Stats.IndexBuffer, indexBufferChanged);
+}
+
+void SceneRenderer::SetObjectIndex(ICommandRecorder& recorder, BoundState& bound, std::uint32_t objectIndex)
+{
+	bool changed = !bound.HasObjectIndex || bound.ObjectIndex != objectIndex;
+	if (changed) {
+		recorder.SetGraphicsRoot32BitConstant(RootParameter_ObjectIndex, objectIndex, 0);
+		bound.HasObjectIndex = true;
+		bound.ObjectIndex = objectIndex;
+	}
+	CountStateChange(bound.Stats.ObjectIndex, changed);
+}
@@ -0,0 +1,184 @@
+#ifndef SCENERENDERER_H_
+#define SCENERENDERER_H_
+
+#include "RHI.h"
+#include "DrawItem.h"
+#include "InstanceBatcher.h"
+#include "JobSystem.h"
+#include <vector>
+
+// The render target and depth buffer a frame is drawn into.
+struct FrameTargets
+{
+	// Moved from present to render target state and back if set. Leave it 0 when
+	// a RenderGraph places the barriers.
+	RHIResource BackBuffer = 0;
+	CpuDescriptorHandle RenderTargetView;
+	CpuDescriptorHandle DepthStencilView;
+	Viewport View;
+	ScissorRect Scissor;
+	float ClearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+};
+
+// Root parameters of the root signature built in Engine::BuildRootSignatures.
+enum RootParameter : std::uint32_t
+{
+	RootParameter_ObjectIndex = 0,
+	RootParameter_PassCbv = 1,
+	RootParameter_InstanceTransforms = 2,
+	RootParameter_BatchConstants = 3,
+	RootParameter_ObjectTransforms = 4,
+	RootParameter_Count
+};
+
+// Passes the draw items are recorded in. The depth pass only runs if
+// FrameBindings::DepthPrepassPipelineState is set.
+enum DrawPass : std::uint32_t
+{
+	DrawPass_Depth = 0,
+	DrawPass_Color = 1
+};
+
+// Pipeline objects bound once per frame.
+struct FrameBindings
+{
+	PipelineStateHandle PipelineState = 0;
+	RootSignatureHandle RootSignature = 0;
+	DescriptorHeapHandle CbvHeap = 0;
+
+	// Bound as a root CBV.
+	GpuVirtualAddress PassConstants = 0;
+	// Structured buffer of ObjectTransform, bound as a root SRV. Every draw sets
+	// its DrawItem::ObjectIndex as a root constant.
+	GpuVirtualAddress ObjectTransforms = 0;
+
+	// Optional depth pre-pass: all draw items are drawn with DepthPrepassPipelineState
+	// into the depth buffer first, without a render target, and then with
+	// DepthEqualPipelineState instead of PipelineState, which only shades the
+	// fragments that passed the EQUAL depth test.
+	PipelineStateHandle DepthPrepassPipelineState = 0;
+	PipelineStateHandle DepthEqualPipelineState = 0;
+
+	bool HasDepthPrepass() const { return DepthPrepassPipelineState != 0; }
+
+	// Used by instanced draws only. InstanceBuffer holds the transforms of the
+	// frame in the order of InstanceBatcher::GetTransforms.
+	PipelineStateHandle InstancedPipelineState = 0;
+	GpuVirtualAddress InstanceBuffer = 0;
+};
+
+// State changes the draw loop asked for. Issued ones reached the recorder,
+// filtered ones were skipped because the state was already bound.
+struct StateChangeCount
+{
+	std::uint64_t Issued = 0;
+	std::uint64_t Filtered = 0;
+};
+
+struct SubmitStats
+{
+	StateChangeCount PipelineState;
+	StateChangeCount Topology;
+	StateChangeCount VertexBuffer;
+	StateChangeCount IndexBuffer;
+	StateChangeCount ObjectIndex;
+	// Including the draws of the depth pre-pass.
+	std::uint64_t Draws = 0;
+	std::uint64_t DepthPrepassDraws = 0;
+
+	void Add(const SubmitStats& other);
+	std::uint64_t GetIssued() const;
+	std::uint64_t GetFiltered() const;
+};
+
+// Records the commands for a frame through the render hardware interface. This
+// is the CPU side of Engine::Render and is shared by the D3D12 and the recording
+// backend so its cost can be measured without a GPU.
+class SceneRenderer
+{
+public:
+	void RecordFrame(ICommandRecorder& recorder, const FrameTargets& targets,
+		const FrameBindings& bindings, const std::vector<DrawItem>& drawItems);
+
+	// Draws the batches of instances after the draw items, one draw per batch.
+	void RecordFrame(ICommandRecorder& recorder, const FrameTargets& targets,
+		const FrameBindings& bindings, const std::vector<DrawItem>& drawItems, const InstanceBatcher& instances);
+
+	// Only draws the draw items at the indices in visibleDrawItems, in that order,
+	// e.g. the output of FrustumCuller::Cull or DrawQueue::GetDrawOrder.
+	void RecordFrame(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+		const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>& visibleDrawItems, const InstanceBatcher& instances);
+
+	// Splits the draws into one chunk per recorder and records every chunk as a
+	// job. The frame begins in the first recorder and ends in the last one, so
+	// executing the recorders in order draws the same frame as RecordFrame. With
+	// a depth pre-pass the chunks split the draws of both passes, the depth pass
+	// in the first recorders and the color pass in the following ones.
+	// visibleDrawItems may be null to draw all draw items.
+	void RecordFrameParallel(JobSystem& jobs, ICommandRecorder* const* recorders, std::uint32_t recorderCount,
+		const FrameTargets& targets, const FrameBindings& bindings, const std::vector<DrawItem>& drawItems,
+		const std::vector<std::uint32_t>* visibleDrawItems, const InstanceBatcher& instances);
+
+	// Summed over all chunks of the last recorded frame.
+	const SubmitStats& GetSubmitStats() const { return m_submitStats; }
+
+	// Number of recorders worth using for drawCount draws: one per minDrawsPerChunk
+	// draws, at most maxRecorders.
+	static std::uint32_t GetRecorderCount(std::size_t drawCount, std::uint32_t maxRecorders, std::uint32_t minDrawsPerChunk = 1024);
+
+	// The pieces of a frame. Command lists do not inherit state, so every chunk
+	// sets the full pipeline state. None of these change the renderer, chunks can
+	// be recorded on different threads. The state changes are added to stats if given.
+	void RecordFrameBegin(ICommandRecorder& recorder, const FrameTargets& targets) const;
+	void RecordDrawChunk(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+		const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>* visibleDrawItems,
+		std::size_t first, std::size_t count, SubmitStats* stats = nullptr) const;
+	// first and count are in the draws of one pass.
+	void RecordDrawChunk(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+		const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>* visibleDrawItems,
+		std::size_t first, std::size_t count, DrawPass pass, SubmitStats* stats = nullptr) const;
+	// Records on the recorder of the last chunk.
+	void RecordFrameEnd(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+		const InstanceBatcher& instances, SubmitStats* stats = nullptr) const;
+
+private:
+	// State bound on one recorder. Draws sorted by DrawQueue share most of it,
+	// every change is compared against it and skipped if nothing changes.
+	struct BoundState
+	{
+		bool HasPipelineState = false;
+		PipelineStateHandle PipelineState = 0;
+		PrimitiveTopology Topology = PrimitiveTopology::Undefined;
+		bool HasVertexBuffer = false;
+		VertexBufferBinding VertexBuffer;
+		bool HasAttributeBuffer = false;
+		VertexBufferBinding AttributeBuffer;
+		bool HasIndexBuffer = false;
+		IndexBufferBinding IndexBuffer;
+		bool HasObjectIndex = false;
+		std::uint32_t ObjectIndex = 0;
+
+		SubmitStats Stats;
+	};
+
+	// first and count are in the draws of all passes: with a depth pre-pass
+	// [0, drawCount) are drawn in the depth pass and [drawCount, 2 * drawCount) in the color pass.
+	void RecordPassDraws(ICommandRecorder& recorder, const FrameTargets& targets, const FrameBindings& bindings,
+		const std::vector<DrawItem>& drawItems, const std::vector<std::uint32_t>* visibleDrawItems,
+		std::size_t drawCount, std::size_t first, std::size_t count, SubmitStats* stats) const;
+
+	static void SetPipeline(ICommandRecorder& recorder, BoundState& bound, const FrameTargets& targets,
+		const FrameBindings& bindings, DrawPass pass);
+	static void SetPipelineState(ICommandRecorder& recorder, BoundState& bound, PipelineStateHandle pipelineState);
+	static void SetTopology(ICommandRecorder& recorder, BoundState& bound, PrimitiveTopology topology);
+	// attributeBuffer is bound to slot 1 unless it is null or empty, e.g. in the
+	// depth pass that only reads positions.
+	static void BindGeometry(ICommandRecorder& recorder, BoundState& bound, const VertexBufferBinding& vertexBuffer,
+		const VertexBufferBinding* attributeBuffer, const IndexBufferBinding& indexBuffer);
+	static void SetObjectIndex(ICommandRecorder& recorder, BoundState& bound, std::uint32_t objectIndex);
+
+	SubmitStats m_submitStats;
+	std::vector<SubmitStats> m_chunkStats;
+};
+
+#endif
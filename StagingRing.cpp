@@ -0,0 +1,75 @@
+#include "StagingRing.h"
+#include <algorithm>
+
+StagingRing::StagingRing()
+{
+}
+
+StagingRing::StagingRing(std::uint64_t size) :
+	m_size(size)
+{
+}
+
+std::uint64_t StagingRing::Allocate(std::uint64_t size, std::uint64_t alignment)
+{
+	if (size == 0 || size > m_size) {
+		return InvalidOffset;
+	}
+	alignment = std::max<std::uint64_t>(alignment, 1);
+
+	// Start over at the front when the ring is empty, it keeps large
+	// allocations from needlessly hitting the wrap.
+	if (m_stats.BytesInFlight == 0) {
+		m_head = 0;
+	}
+
+	auto offset = (m_head + alignment - 1) / alignment * alignment;
+	auto padding = offset - m_head;
+
+	// Allocations do not wrap, skip the rest of the ring instead.
+	if (offset + size > m_size) {
+		padding = m_size - m_head;
+		offset = 0;
+	}
+
+	auto used = padding + size;
+	if (m_stats.BytesInFlight + used > m_size) {
+		return InvalidOffset;
+	}
+
+	m_head = offset + size == m_size ? 0 : offset + size;
+	m_stats.BytesInFlight += used;
+	m_stats.BytesPending += used;
+	m_stats.TotalBytesAllocated += size;
+	m_stats.PeakBytesInFlight = std::max<std::uint64_t>(m_stats.PeakBytesInFlight, m_stats.BytesInFlight);
+	return offset;
+}
+
+void StagingRing::Submit(std::uint64_t fenceValue)
+{
+	if (m_stats.BytesPending == 0) {
+		return;
+	}
+
+	Submission submission;
+	submission.FenceValue = fenceValue;
+	submission.Bytes = m_stats.BytesPending;
+	m_submissions.push_back(submission);
+
+	m_stats.BytesPending = 0;
+	m_stats.SubmissionsInFlight = static_cast<std::uint32_t>(m_submissions.size());
+}
+
+void StagingRing::Reclaim(std::uint64_t completedFenceValue)
+{
+	while (!m_submissions.empty() && m_submissions.front().FenceValue <= completedFenceValue) {
+		m_stats.BytesInFlight -= m_submissions.front().Bytes;
+		m_submissions.pop_front();
+	}
+	m_stats.SubmissionsInFlight = static_cast<std::uint32_t>(m_submissions.size());
+}
+
+std::uint64_t StagingRing::GetOldestFenceValue() const
+{
+	return m_submissions.empty() ? 0 : m_submissions.front().FenceValue;
+}
@@ -0,0 +1,59 @@
+#ifndef STAGINGRING_H_
+#define STAGINGRING_H_
+
+#include <cstdint>
+#include <deque>
+
+// Sub-allocates staging space from a fixed size ring, e.g. an upload buffer.
+// Allocations are handed out in order and retired in the same order: Submit
+// tags everything allocated since the previous Submit with a fence value, and
+// Reclaim frees it once that value has been reached.
+class StagingRing
+{
+public:
+	static const std::uint64_t InvalidOffset = ~0ull;
+
+	struct Stats
+	{
+		// Allocated and not yet reclaimed, including padding at the wrap.
+		std::uint64_t BytesInFlight = 0;
+		// Allocated since the last Submit.
+		std::uint64_t BytesPending = 0;
+		std::uint64_t PeakBytesInFlight = 0;
+		std::uint64_t TotalBytesAllocated = 0;
+		std::uint32_t SubmissionsInFlight = 0;
+	};
+
+	StagingRing();
+	explicit StagingRing(std::uint64_t size);
+
+	// Returns InvalidOffset if there is not enough free space. An allocation never
+	// wraps, so at most GetSize bytes fit at once.
+	std::uint64_t Allocate(std::uint64_t size, std::uint64_t alignment = 1);
+
+	// The pending allocations are freed by the first Reclaim with a completed
+	// fence value of at least fenceValue. Fence values must not decrease.
+	void Submit(std::uint64_t fenceValue);
+	void Reclaim(std::uint64_t completedFenceValue);
+
+	// Fence value of the oldest submission still in flight, 0 if there is none.
+	std::uint64_t GetOldestFenceValue() const;
+
+	std::uint64_t GetSize() const { return m_size; }
+	const Stats& GetStats() const { return m_stats; }
+
+private:
+	struct Submission
+	{
+		std::uint64_t FenceValue = 0;
+		std::uint64_t Bytes = 0;
+	};
+
+	std::uint64_t m_size = 0;
+	// Next free byte. The used bytes end here and start BytesInFlight before it.
+	std::uint64_t m_head = 0;
+	std::deque<Submission> m_submissions;
+	Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "StagingUploader.h"
+#include <algorithm>
+#include <cstring>
+
+StagingUploader::StagingUploader(IRenderDevice& device, ICommandQueue& queue, std::uint64_t stagingSize) :
+	m_device(&device),
+	m_queue(&queue),
+	m_fence(device),
+	m_ring(stagingSize)
+{
+	m_stagingBuffer = ResourceRef(&device, device.CreateBuffer(stagingSize, HeapType::Upload, ResourceState::GenericRead));
+	m_stagingData = static_cast<std::uint8_t*>(device.Map(m_stagingBuffer.Get()));
+}
+
+void StagingUploader::Upload(const ResourceRef& dest, std::uint64_t destOffset, const void* data, std::uint64_t byteSize, ResourceState destState)
+{
+	auto source = static_cast<const std::uint8_t*>(data);
+	while (byteSize > 0) {
+		auto chunkSize = std::min<std::uint64_t>(byteSize, m_ring.GetSize());
+		auto stagingOffset = AllocateStaging(chunkSize);
+		std::memcpy(m_stagingData + stagingOffset, source, static_cast<std::size_t>(chunkSize));
+
+		PendingCopy copy;
+		copy.Dest = dest;
+		copy.DestOffset = destOffset;
+		copy.SourceOffset = stagingOffset;
+		copy.Size = chunkSize;
+		copy.DestState = destState;
+		m_pendingCopies.push_back(std::move(copy));
+
+		source += chunkSize;
+		destOffset += chunkSize;
+		byteSize -= chunkSize;
+	}
+}
+
+std::uint64_t StagingUploader::Flush()
+{
+	Reclaim();
+	if (m_pendingCopies.empty()) {
+		return m_lastFenceValue;
+	}
+
+	auto commandSet = AcquireCommandSet();
+	auto& recorder = commandSet.CommandList->GetRecorder();
+
+	// Every destination is transitioned once around all of its copies, with all
+	// transitions of the flush in one call. Buffers in the COMMON state are
+	// promoted implicitly and left to it.
+	m_stateTracker.Reset();
+	for (const auto& copy : m_pendingCopies) {
+		if (copy.DestState != ResourceState::Common) {
+			m_stateTracker.SetInitialState(copy.Dest.Get(), copy.DestState);
+			m_stateTracker.Transition(copy.Dest.Get(), ResourceState::CopyDest);
+		}
+	}
+	m_stateTracker.FlushBarriers(recorder);
+
+	for (const auto& copy : m_pendingCopies) {
+		recorder.CopyBufferRegion(copy.Dest.Get(), copy.DestOffset, m_stagingBuffer.Get(), copy.SourceOffset, copy.Size);
+	}
+
+	for (const auto& copy : m_pendingCopies) {
+		if (copy.DestState != ResourceState::Common) {
+			m_stateTracker.Transition(copy.Dest.Get(), copy.DestState);
+		}
+	}
+	m_stateTracker.FlushBarriers(recorder);
+
+	commandSet.CommandList->Close();
+	ICommandList* commandLists[] = { commandSet.CommandList.get() };
+	m_queue->ExecuteCommandLists(1, commandLists);
+
+	m_lastFenceValue = m_fence.Signal(*m_queue);
+	m_ring.Submit(m_lastFenceValue);
+	commandSet.FenceValue = m_lastFenceValue;
+	m_submittedCommandSets.push_back(std::move(commandSet));
+
+	m_stats.CopyCount += m_pendingCopies.size();
+	m_stats.FlushCount++;
+	m_pendingCopies.clear();
+	return m_lastFenceValue;
+}
+
+void StagingUploader::WaitForIdle()
+{
+	m_fence.Wait(Flush());
+	Reclaim();
+}
+
+std::uint64_t StagingUploader::GetNextFenceValue() const
+{
+	return m_pendingCopies.empty() ? m_lastFenceValue : m_lastFenceValue + 1;
+}
+
+std::uint64_t StagingUploader::GetCompletedFenceValue() const
+{
+	return m_fence.GetCompletedValue();
+}
+
+bool StagingUploader::HasPendingUploads() const
+{
+	return !m_pendingCopies.empty();
+}
+
+StagingUploader::Stats StagingUploader::GetStats() const
+{
+	auto stats = m_stats;
+	stats.Ring = m_ring.GetStats();
+	return stats;
+}
+
+std::uint64_t StagingUploader::AllocateStaging(std::uint64_t byteSize)
+{
+	// Copy sources need no more than 4 byte alignment for buffers.
+	auto offset = m_ring.Allocate(byteSize, 4);
+	while (offset == StagingRing::InvalidOffset) {
+		// Out of space: submit what is queued and wait for the oldest submission.
+		if (!m_pendingCopies.empty()) {
+			Flush();
+		}
+		m_stats.StallMs += m_fence.Wait(m_ring.GetOldestFenceValue());
+		Reclaim();
+		offset = m_ring.Allocate(byteSize, 4);
+	}
+	return offset;
+}
+
+void StagingUploader::Reclaim()
+{
+	auto completedValue = m_fence.GetCompletedValue();
+	m_ring.Reclaim(completedValue);
+
+	while (!m_submittedCommandSets.empty() && m_submittedCommandSets.front().FenceValue <= completedValue) {
+		m_freeCommandSets.push_back(std::move(m_submittedCommandSets.front()));
+		m_submittedCommandSets.pop_front();
+	}
+}
+
+StagingUploader::CommandSet StagingUploader::AcquireCommandSet()
+{
+	CommandSet commandSet;
+	if (!m_freeCommandSets.empty()) {
+		commandSet = std::move(m_freeCommandSets.back());
+		m_freeCommandSets.pop_back();
+	}
+	else {
+		// Command lists are created closed.
+		commandSet.CommandList = m_device->CreateCommandList(m_queue->GetType());
+	}
+
+	commandSet.CommandList->Reset();
+	return commandSet;
+}
@@ -0,0 +1,98 @@
+#ifndef STAGINGUPLOADER_H_
+#define STAGINGUPLOADER_H_
+
+#include "FramePacer.h"
+#include "StagingRing.h"
+#include "ResourceStateTracker.h"
+#include "RHI.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Uploads data into default heap buffers through one persistently mapped
+// staging buffer. Upload copies the data into the staging ring right away and
+// queues the GPU copy; Flush records all queued copies into a single command
+// list and submits it. Staging space is reclaimed once the submission's fence
+// has been reached, so no upload resources are created per buffer or kept
+// alive after the copy. The queue may be a copy queue, uploads then run
+// alongside rendering and users check GetCompletedFenceValue before drawing
+// what was uploaded.
+class StagingUploader
+{
+public:
+	struct Stats
+	{
+		StagingRing::Stats Ring;
+		std::uint64_t CopyCount = 0;
+		std::uint64_t FlushCount = 0;
+		// Time spent waiting for staging space to be reclaimed.
+		double StallMs = 0.0;
+	};
+
+	StagingUploader(IRenderDevice& device, ICommandQueue& queue, std::uint64_t stagingSize = 32 * 1024 * 1024);
+
+	StagingUploader(const StagingUploader&) = delete;
+	StagingUploader& operator=(const StagingUploader&) = delete;
+
+	// Queues a copy of byteSize bytes of data to destOffset in dest. dest is in
+	// destState when the copies execute and is returned to it afterwards. Buffers
+	// in the COMMON state need no barriers, they are promoted implicitly and decay
+	// back once the copies are done. Uploads larger than the staging buffer are split.
+	void Upload(const ResourceRef& dest, std::uint64_t destOffset, const void* data, std::uint64_t byteSize, ResourceState destState);
+
+	// Submits the queued copies and returns the fence value they complete with,
+	// or the last one if there was nothing to submit. On a direct queue command
+	// lists executed after this see the data, other queues have to wait for the
+	// fence value.
+	std::uint64_t Flush();
+
+	// Flushes and blocks until all uploads have executed.
+	void WaitForIdle();
+
+	// Fence value the uploads queued so far complete with.
+	std::uint64_t GetNextFenceValue() const;
+	std::uint64_t GetCompletedFenceValue() const;
+
+	bool HasPendingUploads() const;
+	Stats GetStats() const;
+
+private:
+	struct PendingCopy
+	{
+		ResourceRef Dest;
+		std::uint64_t DestOffset = 0;
+		std::uint64_t SourceOffset = 0;
+		std::uint64_t Size = 0;
+		ResourceState DestState = ResourceState::Common;
+	};
+
+	struct CommandSet
+	{
+		std::unique_ptr<ICommandList> CommandList;
+		std::uint64_t FenceValue = 0;
+	};
+
+	// Returns the staging offset of byteSize bytes, waiting for space if needed.
+	std::uint64_t AllocateStaging(std::uint64_t byteSize);
+	void Reclaim();
+	CommandSet AcquireCommandSet();
+
+	IRenderDevice* m_device = nullptr;
+	ICommandQueue* m_queue = nullptr;
+	FramePacer m_fence;
+	std::uint64_t m_lastFenceValue = 0;
+
+	ResourceRef m_stagingBuffer;
+	std::uint8_t* m_stagingData = nullptr;
+	StagingRing m_ring;
+
+	std::vector<PendingCopy> m_pendingCopies;
+	ResourceStateTracker m_stateTracker;
+	std::deque<CommandSet> m_submittedCommandSets;
+	std::vector<CommandSet> m_freeCommandSets;
+
+	Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "UploadAllocator.h"
+#include <algorithm>
+#include <cstring>
+
+UploadAllocator::UploadAllocator(IRenderDevice& device, std::uint64_t pageSize) :
+	m_device(&device),
+	m_pageSize(pageSize)
+{
+	m_pages.push_back(CreatePage(m_pageSize));
+}
+
+UploadAllocation UploadAllocator::Allocate(std::uint64_t byteSize, std::uint64_t alignment)
+{
+	auto offset = (m_offset + alignment - 1) & ~(alignment - 1);
+
+	if (m_pages.empty() || offset + byteSize > m_pages[m_currentPage].Size) {
+		if (!m_pages.empty()) {
+			m_usedInFullPages += m_offset;
+			m_currentPage++;
+		}
+		if (m_currentPage >= m_pages.size() || m_pages[m_currentPage].Size < byteSize) {
+			m_pages.insert(m_pages.begin() + m_currentPage, CreatePage(std::max<std::uint64_t>(m_pageSize, byteSize)));
+		}
+		offset = 0;
+	}
+
+	const auto& page = m_pages[m_currentPage];
+	m_offset = offset + byteSize;
+
+	UploadAllocation allocation;
+	allocation.CpuAddress = page.CpuAddress + offset;
+	allocation.GpuAddress = page.GpuAddress + offset;
+	allocation.Resource = page.Resource.Get();
+	allocation.Offset = offset;
+	return allocation;
+}
+
+UploadAllocation UploadAllocator::Upload(const void* data, std::uint64_t byteSize, std::uint64_t alignment)
+{
+	auto allocation = Allocate(byteSize, alignment);
+	std::memcpy(allocation.CpuAddress, data, static_cast<std::size_t>(byteSize));
+	return allocation;
+}
+
+void UploadAllocator::Reset()
+{
+	// The last frame needed more than one page, replace them with one page that
+	// fits all of it. The GPU is done with the old pages.
+	if (m_currentPage > 0) {
+		auto capacity = GetCapacity();
+		m_pages.clear();
+		m_pages.push_back(CreatePage(capacity));
+	}
+
+	m_currentPage = 0;
+	m_offset = 0;
+	m_usedInFullPages = 0;
+}
+
+std::uint64_t UploadAllocator::GetUsedBytes() const
+{
+	return m_usedInFullPages + m_offset;
+}
+
+std::uint64_t UploadAllocator::GetCapacity() const
+{
+	std::uint64_t capacity = 0;
+	for (const auto& page : m_pages) {
+		capacity += page.Size;
+	}
+	return capacity;
+}
+
+UploadAllocator::Page UploadAllocator::CreatePage(std::uint64_t size)
+{
+	Page page;
+	page.Size = size;
+
+	page.Resource = ResourceRef(m_device, m_device->CreateBuffer(size, HeapType::Upload, ResourceState::GenericRead));
+
+	// Upload heaps can stay mapped for their whole lifetime.
+	page.CpuAddress = static_cast<std::uint8_t*>(m_device->Map(page.Resource.Get()));
+	page.GpuAddress = m_device->GetGpuVirtualAddress(page.Resource.Get());
+	return page;
+}
@@ -0,0 +1,67 @@
+#ifndef UPLOADALLOCATOR_H_
+#define UPLOADALLOCATOR_H_
+
+#include "RHI.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Space for data the GPU reads once, written by the CPU and valid until the
+// allocator is reset.
+struct UploadAllocation
+{
+	void* CpuAddress = nullptr;
+	GpuVirtualAddress GpuAddress = 0;
+	RHIResource Resource = 0;
+	std::uint64_t Offset = 0;
+};
+
+// Linear allocator over persistently mapped upload heap pages. Every frame
+// context owns one, resets it once the frame's fence has been reached and then
+// allocates the frame's dynamic data (constants, instance transforms, dynamic
+// vertices) by bumping an offset. A frame that does not fit moves on to a new
+// page, and the next Reset merges the pages into one so a steady workload ends
+// up with a single page and no resource creation.
+class UploadAllocator
+{
+public:
+	// D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT.
+	static const std::uint64_t ConstantBufferAlignment = 256;
+
+	UploadAllocator() {};
+	UploadAllocator(IRenderDevice& device, std::uint64_t pageSize = 1024 * 1024);
+
+	// alignment must be a power of two. Constant buffers need 256 bytes.
+	UploadAllocation Allocate(std::uint64_t byteSize, std::uint64_t alignment = ConstantBufferAlignment);
+
+	// Allocates and copies byteSize bytes of data.
+	UploadAllocation Upload(const void* data, std::uint64_t byteSize, std::uint64_t alignment = ConstantBufferAlignment);
+
+	// Only call once the GPU has finished all work using the allocations.
+	void Reset();
+
+	// Bytes allocated since the last Reset, including alignment padding.
+	std::uint64_t GetUsedBytes() const;
+	std::uint64_t GetCapacity() const;
+
+private:
+	struct Page
+	{
+		ResourceRef Resource;
+		std::uint8_t* CpuAddress = nullptr;
+		GpuVirtualAddress GpuAddress = 0;
+		std::uint64_t Size = 0;
+	};
+
+	Page CreatePage(std::uint64_t size);
+
+	IRenderDevice* m_device = nullptr;
+	std::uint64_t m_pageSize = 0;
+	std::vector<Page> m_pages;
+	std::size_t m_currentPage = 0;
+	std::uint64_t m_offset = 0;
+	// Bytes used by the pages before the current one.
+	std::uint64_t m_usedInFullPages = 0;
+};
+
+#endif
@@ -1,20 +1,16 @@
 #ifndef VERTEXDEFS_H_ 
 #define VERTEXDEFS_H_
-#include <DirectXMath.h>
-
-using DirectX::XMFLOAT4;
-using DirectX::XMFLOAT3;
-using DirectX::XMFLOAT2;
+#include "MathTypes.h"
 
 struct Vertex {
 	Vertex() = default;
 
 	Vertex(
-		const XMFLOAT3& position,
-		const XMFLOAT4& color,
-		const XMFLOAT3& normal,
-		const XMFLOAT3& tangent,
-		const XMFLOAT2& texCord) :
+		const Float3& position,
+		const Float4& color,
+		const Float3& normal,
+		const Float3& tangent,
+		const Float2& texCord) :
 		Position(position),
 		Color(color),
 		Normal(normal),
@@ -33,11 +29,11 @@ struct Vertex {
 		TangentU(tangentX, tangentY, tangentZ),
 		TexCord(u, v) {}
 
-	XMFLOAT3 Position;
-	XMFLOAT4 Color;
-	XMFLOAT3 Normal;
-	XMFLOAT3 TangentU;
-	XMFLOAT2 TexCord;
+	Float3 Position;
+	Float4 Color;
+	Float3 Normal;
+	Float3 TangentU;
+	Float2 TexCord;
 };
 
 #endif
@@ -0,0 +1,348 @@
+#include "VertexFormat.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+std::uint32_t GetFormatByteSize(VertexElementFormat format)
+{
+	switch (format) {
+	case VertexElementFormat::R32G32B32A32_FLOAT: return 16;
+	case VertexElementFormat::R32G32B32_FLOAT: return 12;
+	case VertexElementFormat::R16G16B16A16_UNORM: return 8;
+	case VertexElementFormat::R32G32_FLOAT: return 8;
+	case VertexElementFormat::R8G8B8A8_UNORM: return 4;
+	case VertexElementFormat::R16G16_FLOAT: return 4;
+	case VertexElementFormat::R16G16_SNORM: return 4;
+	}
+	return 0;
+}
+
+float Saturate(float value)
+{
+	return std::min(std::max(value, 0.0f), 1.0f);
+}
+
+std::uint16_t ToUnorm16(float value)
+{
+	return static_cast<std::uint16_t>(std::lround(Saturate(value) * 65535.0f));
+}
+
+std::uint8_t ToUnorm8(float value)
+{
+	return static_cast<std::uint8_t>(std::lround(Saturate(value) * 255.0f));
+}
+
+std::int16_t ToSnorm16(float value)
+{
+	return static_cast<std::int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+float SignNotZero(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+const float* Attribute(const float* base, std::size_t stride, std::size_t index)
+{
+	return base ? reinterpret_cast<const float*>(reinterpret_cast<const std::uint8_t*>(base) + stride * index) : nullptr;
+}
+
+void WriteAttribute(std::uint8_t* dest, VertexElementFormat format, const float* value, int componentCount,
+	const PositionQuantization* quantization)
+{
+	float components[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; value && i < componentCount; i++) {
+		components[i] = value[i];
+	}
+
+	switch (format) {
+	case VertexElementFormat::R32G32B32A32_FLOAT:
+	case VertexElementFormat::R32G32B32_FLOAT:
+	case VertexElementFormat::R32G32_FLOAT:
+		std::memcpy(dest, components, GetFormatByteSize(format));
+		break;
+	case VertexElementFormat::R16G16B16A16_UNORM: {
+		// Only positions use this format. Store them relative to the mesh bounds.
+		std::uint16_t encoded[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < 3; i++) {
+			float scale = quantization->Scale[i];
+			encoded[i] = ToUnorm16(scale > 0.0f ? (components[i] - quantization->Offset[i]) / scale : 0.0f);
+		}
+		std::memcpy(dest, encoded, sizeof(encoded));
+		break;
+	}
+	case VertexElementFormat::R8G8B8A8_UNORM: {
+		std::uint8_t encoded[4];
+		for (int i = 0; i < 4; i++) {
+			encoded[i] = ToUnorm8(components[i]);
+		}
+		std::memcpy(dest, encoded, sizeof(encoded));
+		break;
+	}
+	case VertexElementFormat::R16G16_FLOAT: {
+		std::uint16_t encoded[2] = { FloatToHalf(components[0]), FloatToHalf(components[1]) };
+		std::memcpy(dest, encoded, sizeof(encoded));
+		break;
+	}
+	case VertexElementFormat::R16G16_SNORM: {
+		std::int16_t encoded[2];
+		OctahedralEncode(components, encoded);
+		std::memcpy(dest, encoded, sizeof(encoded));
+		break;
+	}
+	}
+}
+
+// Writes the vertices [first, first + count) into packedVertices, which holds all
+// source.Count vertices.
+void WriteVertices(const VertexSource& source, const VertexLayout& layout, const PositionQuantization& quantization,
+	std::size_t first, std::size_t count, std::uint8_t* packedVertices)
+{
+	const float* attributes[] = { source.Position, source.Color, source.Normal, source.Tangent, source.TexCoord };
+	const int componentCounts[] = { 3, 4, 3, 3, 2 };
+
+	std::uint8_t* streams[MaxVertexStreams];
+	for (std::uint32_t stream = 0; stream < layout.StreamCount; stream++) {
+		streams[stream] = packedVertices + GetStreamOffset(layout, stream, source.Count) + layout.StreamStrides[stream] * first;
+	}
+
+	for (std::size_t v = first; v < first + count; v++) {
+		for (std::size_t e = 0; e < layout.Elements.size(); e++) {
+			const auto& element = layout.Elements[e];
+			WriteAttribute(streams[element.InputSlot] + element.AlignedByteOffset, element.Format,
+				Attribute(attributes[e], source.Stride, v), componentCounts[e], &quantization);
+		}
+		for (std::uint32_t stream = 0; stream < layout.StreamCount; stream++) {
+			streams[stream] += layout.StreamStrides[stream];
+		}
+	}
+}
+
+}
+
+VertexLayout BuildVertexLayout(std::uint32_t flags)
+{
+	VertexLayout layout;
+	layout.Flags = flags;
+
+	std::uint32_t stream = 0;
+	auto addElement = [&](const char* semanticName, VertexElementFormat format) {
+		VertexElement element;
+		element.SemanticName = semanticName;
+		element.Format = format;
+		element.InputSlot = stream;
+		element.AlignedByteOffset = layout.StreamStrides[stream];
+		layout.Elements.push_back(element);
+		layout.StreamStrides[stream] += GetFormatByteSize(format);
+		layout.Stride += GetFormatByteSize(format);
+	};
+
+	addElement("POSITION", flags & VertexFormatFlags_QuantizedPosition ?
+		VertexElementFormat::R16G16B16A16_UNORM : VertexElementFormat::R32G32B32_FLOAT);
+	if (flags & VertexFormatFlags_SplitStreams) {
+		stream = 1;
+		layout.StreamCount = 2;
+	}
+	addElement("COLOR", flags & VertexFormatFlags_Unorm8Color ?
+		VertexElementFormat::R8G8B8A8_UNORM : VertexElementFormat::R32G32B32A32_FLOAT);
+	addElement("NORMAL", flags & VertexFormatFlags_OctahedralNormal ?
+		VertexElementFormat::R16G16_SNORM : VertexElementFormat::R32G32B32_FLOAT);
+	addElement("TANGENT", flags & VertexFormatFlags_OctahedralNormal ?
+		VertexElementFormat::R16G16_SNORM : VertexElementFormat::R32G32B32_FLOAT);
+	addElement("TEXCOORD", flags & VertexFormatFlags_HalfTexCoord ?
+		VertexElementFormat::R16G16_FLOAT : VertexElementFormat::R32G32_FLOAT);
+
+	return layout;
+}
+
+VertexLayout BuildPositionLayout(std::uint32_t flags)
+{
+	auto layout = BuildVertexLayout(flags);
+	layout.Elements.resize(1);
+	layout.Stride = layout.StreamStrides[0];
+	layout.StreamCount = 1;
+	layout.StreamStrides[1] = 0;
+	return layout;
+}
+
+std::size_t GetStreamOffset(const VertexLayout& layout, std::uint32_t stream, std::size_t vertexCount)
+{
+	std::size_t offset = 0;
+	for (std::uint32_t i = 0; i < stream && i < layout.StreamCount; i++) {
+		offset += static_cast<std::size_t>(layout.StreamStrides[i]) * vertexCount;
+	}
+	return offset;
+}
+
+PositionQuantization EncodeVertices(const VertexSource& source, std::uint32_t flags, std::vector<std::uint8_t>& packedVertices)
+{
+	PositionQuantization quantization;
+
+	if ((flags & VertexFormatFlags_QuantizedPosition) && source.Position && source.Count > 0) {
+		float boundsMin[3] = { INFINITY, INFINITY, INFINITY };
+		float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (std::size_t v = 0; v < source.Count; v++) {
+			auto position = Attribute(source.Position, source.Stride, v);
+			for (int i = 0; i < 3; i++) {
+				boundsMin[i] = std::min(boundsMin[i], position[i]);
+				boundsMax[i] = std::max(boundsMax[i], position[i]);
+			}
+		}
+
+		for (int i = 0; i < 3; i++) {
+			quantization.Offset[i] = boundsMin[i];
+			quantization.Scale[i] = boundsMax[i] - boundsMin[i];
+		}
+	}
+
+	auto layout = BuildVertexLayout(flags);
+	packedVertices.assign(layout.Stride * source.Count, 0);
+	WriteVertices(source, layout, quantization, 0, source.Count, packedVertices.data());
+
+	return quantization;
+}
+
+bool EncodeVertexRange(const VertexSource& source, std::uint32_t flags, const PositionQuantization& quantization,
+	std::size_t first, std::size_t count, std::vector<std::uint8_t>& packedVertices)
+{
+	auto layout = BuildVertexLayout(flags);
+	if (first + count > source.Count || packedVertices.size() != layout.Stride * source.Count) {
+		return false;
+	}
+
+	if ((flags & VertexFormatFlags_QuantizedPosition) && source.Position) {
+		for (std::size_t v = first; v < first + count; v++) {
+			auto position = Attribute(source.Position, source.Stride, v);
+			for (int i = 0; i < 3; i++) {
+				if (position[i] < quantization.Offset[i] || position[i] > quantization.Offset[i] + quantization.Scale[i]) {
+					return false;
+				}
+			}
+		}
+	}
+
+	WriteVertices(source, layout, quantization, first, count, packedVertices.data());
+	return true;
+}
+
+std::vector<const char*> GetVertexFormatDefines(std::uint32_t flags)
+{
+	std::vector<const char*> defines;
+	if (flags & VertexFormatFlags_QuantizedPosition) defines.push_back("QUANTIZED_POSITION");
+	if (flags & VertexFormatFlags_Unorm8Color) defines.push_back("UNORM8_COLOR");
+	if (flags & VertexFormatFlags_OctahedralNormal) defines.push_back("OCTAHEDRAL_NORMAL");
+	if (flags & VertexFormatFlags_HalfTexCoord) defines.push_back("HALF_TEXCOORD");
+	defines.push_back(nullptr);
+	return defines;
+}
+
+std::uint16_t FloatToHalf(float value)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	std::uint32_t sign = (bits >> 16) & 0x8000;
+	std::uint32_t exponent = (bits >> 23) & 0xff;
+	std::uint32_t mantissa = bits & 0x7fffff;
+
+	// Infinity and NaN
+	if (exponent == 0xff) {
+		return static_cast<std::uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	}
+
+	int halfExponent = static_cast<int>(exponent) - 127 + 15;
+	if (halfExponent >= 0x1f) {
+		return static_cast<std::uint16_t>(sign | 0x7c00);
+	}
+
+	// Denormalized half, round to nearest even.
+	if (halfExponent <= 0) {
+		if (halfExponent < -10) {
+			return static_cast<std::uint16_t>(sign);
+		}
+
+		mantissa |= 0x800000;
+		int shift = 14 - halfExponent;
+		std::uint32_t halfMantissa = mantissa >> shift;
+		std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+		std::uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (halfMantissa & 1))) {
+			halfMantissa++;
+		}
+		return static_cast<std::uint16_t>(sign | halfMantissa);
+	}
+
+	// Rounding may carry into the exponent which is the correct result.
+	std::uint32_t half = sign | (static_cast<std::uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+	std::uint32_t remainder = mantissa & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+		half++;
+	}
+	return static_cast<std::uint16_t>(half);
+}
+
+float HalfToFloat(std::uint16_t value)
+{
+	std::uint32_t sign = static_cast<std::uint32_t>(value & 0x8000) << 16;
+	std::uint32_t exponent = (value >> 10) & 0x1f;
+	std::uint32_t mantissa = value & 0x3ff;
+
+	if (exponent == 0) {
+		float result = std::ldexp(static_cast<float>(mantissa), -24);
+		return sign ? -result : result;
+	}
+
+	std::uint32_t bits;
+	if (exponent == 0x1f) {
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void OctahedralEncode(const float normal[3], std::int16_t encoded[2])
+{
+	float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	if (length <= 0.0f) {
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	float x = normal[0] / length;
+	float y = normal[1] / length;
+
+	// Fold the lower hemisphere over the diagonals.
+	if (normal[2] < 0.0f) {
+		float foldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+		float foldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = ToSnorm16(x);
+	encoded[1] = ToSnorm16(y);
+}
+
+void OctahedralDecode(const std::int16_t encoded[2], float normal[3])
+{
+	float x = std::max(encoded[0] / 32767.0f, -1.0f);
+	float y = std::max(encoded[1] / 32767.0f, -1.0f);
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+	float t = Saturate(-z);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float length = std::sqrt(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
@@ -0,0 +1,116 @@
+#ifndef VERTEXFORMAT_H_
+#define VERTEXFORMAT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Configurable GPU vertex format. Every attribute of Vertex can either be stored
+// at full float precision or in a compact encoding:
+//   Position  R32G32B32_FLOAT    or R16G16B16A16_UNORM relative to the mesh bounds
+//   Color     R32G32B32A32_FLOAT or R8G8B8A8_UNORM
+//   Normal    R32G32B32_FLOAT    or octahedral R16G16_SNORM (tangent likewise)
+//   TexCoord  R32G32_FLOAT       or R16G16_FLOAT
+// The full format is 60 bytes per vertex, the compact one 24.
+// Interleaved vertices keep all attributes in one stream. Split streams store
+// the positions tightly packed in stream 0 and the other attributes in stream 1,
+// so passes that only need positions fetch 12 (or 8 quantized) bytes per vertex.
+enum VertexFormatFlags : std::uint32_t
+{
+	VertexFormatFlags_None = 0,
+	VertexFormatFlags_QuantizedPosition = 1 << 0,
+	VertexFormatFlags_Unorm8Color = 1 << 1,
+	VertexFormatFlags_OctahedralNormal = 1 << 2,
+	VertexFormatFlags_HalfTexCoord = 1 << 3,
+	VertexFormatFlags_SplitStreams = 1 << 4,
+
+	VertexFormatFlags_Compact = VertexFormatFlags_QuantizedPosition | VertexFormatFlags_Unorm8Color |
+		VertexFormatFlags_OctahedralNormal | VertexFormatFlags_HalfTexCoord
+};
+
+// Mirrors the DXGI_FORMAT values of the formats used for vertex attributes.
+enum class VertexElementFormat : std::uint32_t
+{
+	R32G32B32A32_FLOAT = 2,
+	R32G32B32_FLOAT = 6,
+	R16G16B16A16_UNORM = 11,
+	R32G32_FLOAT = 16,
+	R8G8B8A8_UNORM = 28,
+	R16G16_FLOAT = 34,
+	R16G16_SNORM = 37
+};
+
+struct VertexElement
+{
+	const char* SemanticName = nullptr;
+	std::uint32_t SemanticIndex = 0;
+	VertexElementFormat Format = VertexElementFormat::R32G32B32_FLOAT;
+	std::uint32_t InputSlot = 0;
+	std::uint32_t AlignedByteOffset = 0;
+};
+
+static const std::uint32_t MaxVertexStreams = 2;
+
+// Element offsets are relative to the start of a vertex in its stream. Packed
+// vertices store the streams one after another: all vertices of stream 0, then
+// all of stream 1.
+struct VertexLayout
+{
+	std::uint32_t Flags = VertexFormatFlags_None;
+	// Bytes per vertex over all streams.
+	std::uint32_t Stride = 0;
+	std::uint32_t StreamCount = 1;
+	std::uint32_t StreamStrides[MaxVertexStreams] = {};
+	std::vector<VertexElement> Elements;
+};
+
+// Positions stored as UNORM are decoded in the vertex shader as Offset + value * Scale.
+struct PositionQuantization
+{
+	float Offset[3] = { 0.0f, 0.0f, 0.0f };
+	float Scale[3] = { 1.0f, 1.0f, 1.0f };
+};
+
+// Strided view of unpacked float vertex attributes. Any pointer may be null, in
+// which case the attribute is written as zero.
+struct VertexSource
+{
+	const float* Position = nullptr;
+	const float* Color = nullptr;
+	const float* Normal = nullptr;
+	const float* Tangent = nullptr;
+	const float* TexCoord = nullptr;
+	std::size_t Stride = 0;
+	std::size_t Count = 0;
+};
+
+VertexLayout BuildVertexLayout(std::uint32_t flags);
+
+// The elements a position-only pass reads, in the layout of flags: the position
+// element of stream 0. With interleaved vertices it keeps the full vertex stride.
+VertexLayout BuildPositionLayout(std::uint32_t flags);
+
+// Byte offset of a stream in packed vertices of vertexCount vertices.
+std::size_t GetStreamOffset(const VertexLayout& layout, std::uint32_t stream, std::size_t vertexCount);
+
+// Packs the source vertices into the layout described by flags. Returns the
+// parameters needed to decode quantized positions.
+PositionQuantization EncodeVertices(const VertexSource& source, std::uint32_t flags, std::vector<std::uint8_t>& packedVertices);
+
+// Packs the vertices [first, first + count) of source into packedVertices, which
+// holds all of source packed with quantization by EncodeVertices. Returns false
+// and writes nothing if a position lies outside the quantization bounds, the
+// vertices then have to be packed again with EncodeVertices.
+bool EncodeVertexRange(const VertexSource& source, std::uint32_t flags, const PositionQuantization& quantization,
+	std::size_t first, std::size_t count, std::vector<std::uint8_t>& packedVertices);
+
+// Shader macro names matching the flags, terminated by a null entry.
+std::vector<const char*> GetVertexFormatDefines(std::uint32_t flags);
+
+// Encoding helpers, exposed for tools and the headless build.
+std::uint16_t FloatToHalf(float value);
+float HalfToFloat(std::uint16_t value);
+void OctahedralEncode(const float normal[3], std::int16_t encoded[2]);
+void OctahedralDecode(const std::int16_t encoded[2], float normal[3]);
+
+#endif
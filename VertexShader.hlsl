@@ -1,11 +1,7 @@
-// Explicit padding to an alignment of 256 bytes
-// The padding can be removed for implicit padding
+// Index of the draw's transform in ObjectTransforms, set as a root constant.
 cbuffer cbPerObject : register(b0)
 {
-	float4x4 World;
-	float4x4 Pad0;
-	float4x4 Pad1;
-	float4x4 Pad2;
+	uint ObjectIndex;
 };
 
 cbuffer cbPerRenderPass : register(b1)
@@ -18,33 +14,126 @@ cbuffer cbPerRenderPass : register(b1)
 	float4x4 Pad5;
 };
 
+// The top three rows of every object's world matrix, see ObjectTransform.h. The
+// decoding of quantized positions is folded into them.
+struct ObjectTransform
+{
+	float4 Rows[3];
+};
+StructuredBuffer<ObjectTransform> ObjectTransforms : register(t1);
+
+#ifdef INSTANCED
+// Transposed world matrices of all instances drawn this frame. The instances of
+// a batch start at InstanceOffset because SV_InstanceID restarts at 0 per draw.
+StructuredBuffer<float4x4> InstanceWorld : register(t0);
+
+cbuffer cbPerBatch : register(b2)
+{
+	uint InstanceOffset;
+	float3 BatchPositionOffset;
+	float3 BatchPositionScale;
+};
+#endif
+
+// The vertex format is selected when the shader is compiled, see VertexFormat.h.
+// UNORM8 colors and half float texture coordinates are expanded by the input
+// assembler, positions and normals need decoding here.
+// DEPTH_ONLY builds the shader of the depth pre-pass, which only reads positions.
 struct VertexIn
 {
+#ifdef QUANTIZED_POSITION
+	float4 PosL  : POSITION;
+#else
 	float3 PosL  : POSITION;
+#endif
+#ifndef DEPTH_ONLY
 	float4 Color : COLOR;
+#ifdef OCTAHEDRAL_NORMAL
+	float2 normalL : NORMAL;
+	float2 tangentL : TANGENT;
+#else
 	float3 normalL : NORMAL;
 	float3 tangentL : TANGENT;
+#endif
 	float2 texCord : TEXCOORD;
+#endif
 };
 
+// Normals and tangents are decoded to object space, the pixel shader does not
+// shade with them yet.
 struct VertexOut
 {
-	float4 PosH  : SV_POSITION;
+	precise float4 PosH  : SV_POSITION;
+#ifndef DEPTH_ONLY
 	float4 Color : COLOR;
+	float3 NormalL : NORMAL;
+	float3 TangentL : TANGENT;
+#endif
 };
 
+float3 DecodeOctahedral(float2 encoded)
+{
+	float3 n = float3(encoded.x, encoded.y, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+float3 DecodePosition(VertexIn vIn)
+{
+#if defined(QUANTIZED_POSITION) && defined(INSTANCED)
+	return BatchPositionOffset + vIn.PosL.xyz * BatchPositionScale;
+#else
+	return vIn.PosL.xyz;
+#endif
+}
+
+#ifndef DEPTH_ONLY
+float3 DecodeNormal(VertexIn vIn)
+{
+#ifdef OCTAHEDRAL_NORMAL
+	return DecodeOctahedral(vIn.normalL);
+#else
+	return vIn.normalL;
+#endif
+}
+
+float3 DecodeTangent(VertexIn vIn)
+{
+#ifdef OCTAHEDRAL_NORMAL
+	return DecodeOctahedral(vIn.tangentL);
+#else
+	return vIn.tangentL;
+#endif
+}
+#endif
+
+#ifdef INSTANCED
+VertexOut main(VertexIn vIn, uint instanceId : SV_InstanceID)
+{
+	float4 posW = mul(float4(DecodePosition(vIn), 1.0f), InstanceWorld[InstanceOffset + instanceId]);
+#else
 VertexOut main(VertexIn vIn)
 {
+	ObjectTransform transform = ObjectTransforms[ObjectIndex];
+	// precise keeps the depth pre-pass and the color pass bit identical for the EQUAL depth test.
+	precise float4 posL = float4(DecodePosition(vIn), 1.0f);
+	precise float4 posW = float4(dot(transform.Rows[0], posL), dot(transform.Rows[1], posL), dot(transform.Rows[2], posL), 1.0f);
+#endif
 	VertexOut vOut;
 
 	// Transform to homogeneous clip space.
-	vOut.PosH = mul(float4(vIn.PosL.x, vIn.PosL.y, vIn.PosL.z, 1.0f), World);
+	vOut.PosH = posW;
 	//vOut.PosH.y += sin(TotalTime) * 3;
 	vOut.PosH = mul(vOut.PosH, ViewProj);
 	//vOut.PosH = float4(-vIn.PosL.x-0.5, -vIn.PosL.y-0.5, 0.5, 1.0);
 
+#ifndef DEPTH_ONLY
 	vOut.Color = vIn.Color;
+	vOut.NormalL = DecodeNormal(vIn);
+	vOut.TangentL = DecodeTangent(vIn);
+#endif
 	//vOut.Color.r *= sin(TotalTime*4) * 0.5 + 0.5;
 
 	return vOut;
-}
\ No newline at end of file
+}